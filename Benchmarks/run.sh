@@ -0,0 +1,46 @@
+#!/bin/sh
+# Times every benchmark with the AST interpreter, the bytecode VM and a native build at -O0. The allocation benchmarks
+# (`Alloc-*`) are only built natively instead, once with each allocator `new` and `del` lower to.
+# Usage: Benchmarks/run.sh [path to marblec], run from the directory with `Libs/`.
+MARBLEC=${1:-./marblec}
+DIR=$(dirname "$0")
+TMP=$(mktemp -d)
+
+measure() {
+    start=$(date +%s.%N)
+    "$@" > /dev/null
+    end=$(date +%s.%N)
+    awk -v s="$start" -v e="$end" 'BEGIN { printf "%8.3fs", e - s }'
+}
+
+printf "%-12s %9s %9s %9s %9s\n" benchmark interp vm vm-file native-O0
+for src in "$DIR"/*.mr; do
+    name=$(basename "$src" .mr)
+    case "$name" in Alloc-*) continue ;; esac
+    "$MARBLEC" "$src" -emit=bc -o "$TMP/$name.mrbc" || exit 1
+    "$MARBLEC" "$src" -O0 && mv "$name" "$TMP/$name" || exit 1    # executables are written to the current directory
+    printf "%-12s " "$name"
+    measure "$MARBLEC" "$src" --interp
+    printf " "
+    measure "$MARBLEC" "$src" --vm
+    printf " "
+    measure "$MARBLEC" "$TMP/$name.mrbc"
+    printf " "
+    measure "$TMP/$name"
+    printf "\n"
+done
+
+printf "\n%-12s %9s %9s %9s %9s\n" benchmark system-O0 slab-O0 system-O2 slab-O2
+for src in "$DIR"/Alloc-*.mr; do
+    name=$(basename "$src" .mr)
+    printf "%-12s " "$name"
+    for opt in -O0 -O2; do
+        for allocator in system slab; do
+            "$MARBLEC" "$src" $opt -fallocator=$allocator && mv "$name" "$TMP/$name" || exit 1
+            measure "$TMP/$name"
+            printf " "
+        done
+    done
+    printf "\n"
+done
+rm -rf "$TMP"
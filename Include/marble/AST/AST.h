@@ -19,6 +19,7 @@
 #include <marble/AST/Statements/DelStmt.h>
 #include <marble/AST/Statements/ImportStmt.h>
 #include <marble/AST/Statements/ModuleDeclStmt.h>
+#include <marble/AST/Statements/ArenaStmt.h>
 
 #include <marble/AST/Expressions/BinaryExpr.h>
 #include <marble/AST/Expressions/LiteralExpr.h>
@@ -1,8 +1,12 @@
 #pragma once
 #include <marble/AST/Node.h>
+#include <marble/Basic/ASTVal.h>
+#include <optional>
 
 namespace marble {
     class Expr : public Node {
+        std::optional<ASTVal> _constVal;   // value computed by Sema at compile time
+
     public:
         explicit Expr(NodeKind kind, llvm::SMLoc startLoc, llvm::SMLoc endLoc) : Node(kind, startLoc, endLoc) {}
 
@@ -10,5 +14,15 @@ namespace marble {
         classof(const Node *node) {
             return node->GetKind() > NkStartExprs && node->GetKind() < NkEndExprs;
         }
+
+        const std::optional<ASTVal> &
+        GetConstVal() const {
+            return _constVal;
+        }
+
+        void
+        SetConstVal(ASTVal val) {
+            _constVal = val;
+        }
     };
 }
\ No newline at end of file
@@ -10,6 +10,7 @@ namespace marble {
         ASTType _objType;
         bool _isModule;
         bool _isStaticAccessing = false;
+        int _fieldIndex = -1;
 
     public:
         explicit FieldAccessExpr(Expr *obj, std::string name, llvm::SMLoc startLoc, llvm::SMLoc endLoc)
@@ -59,5 +60,15 @@ namespace marble {
         SetStaticAccessing(bool isStaticAccessing) {
             _isStaticAccessing = isStaticAccessing;
         }
+
+        int
+        GetFieldIndex() const {
+            return _fieldIndex;
+        }
+
+        void
+        SetFieldIndex(int index) {
+            _fieldIndex = index;
+        }
     };
 }
@@ -5,6 +5,7 @@
 namespace marble {
     class VarExpr : public Expr {
         std::string _name;
+        int _slot = -1;         // slot of the local variable which Sema resolved the name to, -1 for a global
 
     public:
         explicit VarExpr(std::string name, llvm::SMLoc startLoc, llvm::SMLoc endLoc) : _name(name), Expr(NkVarExpr, startLoc, endLoc) {}
@@ -18,5 +19,15 @@ namespace marble {
         GetName() const {
             return _name;
         }
+
+        int
+        GetSlot() const {
+            return _slot;
+        }
+
+        void
+        SetSlot(int slot) {
+            _slot = slot;
+        }
     };
 }
\ No newline at end of file
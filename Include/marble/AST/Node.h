@@ -22,6 +22,7 @@ namespace marble {
         NkDelStmt,
         NkImportStmt,
         NkModuleDeclStmt,
+        NkArenaStmt,
         NkEndStmts,
 
         NkStartExprs,
@@ -56,6 +56,9 @@ namespace marble {
         void
         VisitModuleDeclStmt(ModuleDeclStmt *mds);
 
+        void
+        VisitArenaStmt(ArenaStmt *as);
+
         void
         VisitFieldAsgnStmt(FieldAsgnStmt *fas);
 
@@ -0,0 +1,23 @@
+#pragma once
+#include <marble/AST/Stmt.h>
+#include <vector>
+
+namespace marble {
+    class ArenaStmt : public Stmt {
+        std::vector<Stmt *> _body;
+
+    public:
+        explicit ArenaStmt(std::vector<Stmt *> body, AccessModifier access, llvm::SMLoc startLoc, llvm::SMLoc endLoc)
+                         : _body(body), Stmt(NkArenaStmt, access, startLoc, endLoc) {}
+
+        constexpr static bool
+        classof(const Node *node) {
+            return node->GetKind() == NkArenaStmt;
+        }
+
+        std::vector<Stmt *>
+        GetBody() const {
+            return _body;
+        }
+    };
+}
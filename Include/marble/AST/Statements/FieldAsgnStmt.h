@@ -10,6 +10,7 @@ namespace marble {
         Expr *_expr;
         ASTType _objType;
         bool _isStaticAccessing = false;
+        int _fieldIndex = -1;
 
     public:
         explicit FieldAsgnStmt(Expr *obj, std::string name, Expr *expr, AccessModifier access, llvm::SMLoc startLoc, llvm::SMLoc endLoc)
@@ -54,5 +55,15 @@ namespace marble {
         SetStaticAccessing(bool isStaticAccessing) {
             _isStaticAccessing = isStaticAccessing;
         }
+
+        int
+        GetFieldIndex() const {
+            return _fieldIndex;
+        }
+
+        void
+        SetFieldIndex(int index) {
+            _fieldIndex = index;
+        }
     };
 }
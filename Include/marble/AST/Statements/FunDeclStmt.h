@@ -5,6 +5,16 @@
 #include <vector>
 
 namespace marble {
+    // attributes which can be written before a function or a method, e.g. `@inline @hot fun f() {}`
+    enum FunAttribute : unsigned {
+        FunAttrInline = 1 << 0,
+        FunAttrNoInline = 1 << 1,
+        FunAttrCold = 1 << 2,
+        FunAttrHot = 1 << 3,
+        FunAttrFlatten = 1 << 4,
+        FunAttrPure = 1 << 5,
+    };
+
     class FunDeclStmt : public Stmt {
         std::string _name;
         ASTType _retType;
@@ -12,6 +22,12 @@ namespace marble {
         std::vector<Stmt *> _block;
         bool _isDeclaration;
         bool _isStatic;
+        bool _isConst = false;  // `const fun` can be evaluated at compile time
+        unsigned _attrs = 0;
+        int _optLevel = -1;     // requested with `@opt(N)`, -1 for the level of the whole program
+        bool _isUnchecked = false;  // the body is in an imported module and was not analyzed, because it is never referenced
+        unsigned _numSlots = 0;     // local variables, arguments and `this` of the body, numbered by Sema
+        llvm::SMRange _bodyRange;   // from `{` to `}` of the body, empty for a declaration
 
     public:
         explicit FunDeclStmt(std::string name, ASTType retType, std::vector<Argument> args, std::vector<Stmt *> block, bool isDeclaration, bool isStatic, AccessModifier access,
@@ -58,5 +74,70 @@ namespace marble {
         IsStatic() const {
             return _isStatic;
         }
+
+        bool
+        IsConst() const {
+            return _isConst;
+        }
+
+        void
+        SetConst(bool isConst) {
+            _isConst = isConst;
+        }
+
+        unsigned
+        GetAttrs() const {
+            return _attrs;
+        }
+
+        void
+        SetAttrs(unsigned attrs) {
+            _attrs = attrs;
+        }
+
+        bool
+        HasAttr(FunAttribute attr) const {
+            return _attrs & attr;
+        }
+
+        int
+        GetOptLevel() const {
+            return _optLevel;
+        }
+
+        void
+        SetOptLevel(int level) {
+            _optLevel = level;
+        }
+
+        bool
+        IsUnchecked() const {
+            return _isUnchecked;
+        }
+
+        void
+        SetUnchecked(bool isUnchecked) {
+            _isUnchecked = isUnchecked;
+        }
+
+        unsigned
+        GetNumSlots() const {
+            return _numSlots;
+        }
+
+        void
+        SetNumSlots(unsigned numSlots) {
+            _numSlots = numSlots;
+        }
+
+        llvm::SMRange
+        GetBodyRange() const {
+            return _bodyRange;
+        }
+
+        void
+        SetBodyRange(llvm::SMRange range) {
+            _bodyRange = range;
+        }
     };
 }
@@ -8,7 +8,8 @@ namespace marble {
     class VarAsgnStmt : public Stmt {
         std::string _name;
         Expr *_expr;
-        unsigned char _derefDepth;
+        unsigned char _derefDepth = 0;
+        int _slot = -1;         // slot of the local variable which Sema resolved the name to, -1 for a global
 
     public:
         explicit VarAsgnStmt(std::string name, Expr *expr, AccessModifier access, llvm::SMLoc startLoc, llvm::SMLoc endLoc)
@@ -38,5 +39,15 @@ namespace marble {
         SetDerefDepth(unsigned char dd) {
             _derefDepth = dd;
         }
+
+        int
+        GetSlot() const {
+            return _slot;
+        }
+
+        void
+        SetSlot(int slot) {
+            _slot = slot;
+        }
     };
 }
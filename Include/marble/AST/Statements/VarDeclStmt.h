@@ -11,6 +11,7 @@ namespace marble {
         ASTType _type;
         Expr *_expr;
         bool _isStatic;
+        int _slot = -1;         // index of a local variable in its function, set by Sema; -1 for a global
 
     public:
         explicit VarDeclStmt(std::string name, bool isConst, ASTType type, Expr *expr, bool isStatic, AccessModifier access, llvm::SMLoc startLoc, llvm::SMLoc endLoc)
@@ -50,5 +51,15 @@ namespace marble {
         IsStatic() const {
             return _isStatic;
         }
+
+        int
+        GetSlot() const {
+            return _slot;
+        }
+
+        void
+        SetSlot(int slot) {
+            _slot = slot;
+        }
     };
 }
@@ -45,6 +45,8 @@ namespace marble {
                     return NODE(VisitImportStmt, ImportStmt);
                 case NkModuleDeclStmt:
                     return NODE(VisitModuleDeclStmt, ModuleDeclStmt);
+                case NkArenaStmt:
+                    return NODE(VisitArenaStmt, ArenaStmt);
                 
                 case NkBinaryExpr:
                     return NODE(VisitBinaryExpr, BinaryExpr);
@@ -60,7 +60,7 @@ namespace marble {
             _kind = kind;
         }
 
-        std::string
+        const std::string &
         GetVal() const {
             return _val;
         }
@@ -1,8 +1,11 @@
 #pragma once
 #include <marble/Basic/ASTType.h>
+#include <cstdint>
+#include <vector>
 
 namespace marble {
     class Module;
+    class ASTVal;
     
     union ASTValData {
         bool    boolVal;
@@ -12,6 +15,7 @@ namespace marble {
         long    i64Val;
         float   f32Val;
         double  f64Val;
+        ASTVal *ptrVal;     // storage a pointer or a trait object refers to, only used by the interpreter
     };
 
     class ASTVal {
@@ -21,6 +25,9 @@ namespace marble {
         bool _createdByNew;
         Module *_mod;
         bool _isType = false;
+        unsigned _arenaDepth = 0;   // nesting depth of the arena the pointer was allocated in, 0 outside of arenas
+        uint64_t _arenaParams = 0;  // mask of the parameters of the analyzed function whose memory the pointer may lead to
+        std::vector<ASTVal> _fields;    // fields of a structure value in declaration order, only used by the interpreter
 
     public:
         explicit ASTVal(ASTType type, ASTValData data, bool isNil, bool createdByNew) : _type(type), _data(data), _isNil(isNil), _createdByNew(createdByNew) {}
@@ -70,6 +77,36 @@ namespace marble {
             _isType = isType;
         }
 
+        unsigned
+        GetArenaDepth() const {
+            return _arenaDepth;
+        }
+
+        void
+        SetArenaDepth(unsigned depth) {
+            _arenaDepth = depth;
+        }
+
+        uint64_t
+        GetArenaParams() const {
+            return _arenaParams;
+        }
+
+        void
+        SetArenaParams(uint64_t params) {
+            _arenaParams = params;
+        }
+
+        std::vector<ASTVal> &
+        GetFields() {
+            return _fields;
+        }
+
+        const std::vector<ASTVal> &
+        GetFields() const {
+            return _fields;
+        }
+
         std::string
         ToString() const;
 
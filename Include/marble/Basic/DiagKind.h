@@ -49,6 +49,7 @@ namespace marble {
         ErrCannotImplTraitMethod_RetTypeMismatch,
         ErrCannotImplTraitMethod_FewArgs,
         ErrCannotImplTraitMethod_ArgTypeMismatch,
+        ErrCannotImplTraitMethod_NotPure,
         ErrNotImplTraitMethod,
         ErrExpectedDeclarationInTrait,
         ErrDerefFromNonPtr,
@@ -66,5 +67,19 @@ namespace marble {
         ErrAccessingNonStaticFieldFromType,
         ErrAccessStaticMethodFromNonType,
         ErrAccessingNonStaticMethodFromType,
+        ErrArenaPtrEscapes,
+        ErrDelOfArenaPtr,
+        ErrUnknownAttribute,
+        ErrAttributesOnNonFunction,
+        ErrConflictingAttributes,
+        ErrImpureInPureFun,
+        ErrConstFunNonScalar,
+        ErrConstEvalFailed,
+        ErrNotSupportedByVM,
+        ErrInvalidOptLevel,
+        WarnConstEvalFailed,
+        RemarkOptPassed,
+        RemarkOptMissed,
+        RemarkOptAnalysis,
     };
 }
@@ -11,8 +11,11 @@ namespace marble {
 
         DiagnosticBuilder
         Report(llvm::SMLoc loc, DiagKind kind) {
-            _hasErrors = true;
-            return DiagnosticBuilder(_srcMgr, loc, GetDiagInfo(kind));
+            DiagInfo info = GetDiagInfo(kind);
+            if (info.Kind == llvm::SourceMgr::DiagKind::DK_Error) {
+                _hasErrors = true;
+            }
+            return DiagnosticBuilder(_srcMgr, loc, info);
         }
 
         bool
@@ -1,3 +1,4 @@
+#pragma once
 #include <marble/AST/Statements/FunDeclStmt.h>
 #include <marble/AST/Statements/StructStmt.h>
 #include <marble/AST/Statements/ImplStmt.h>
@@ -15,6 +16,9 @@ namespace marble {
         std::optional<ASTVal> Val;
         bool IsConst;
         AccessModifier Access;
+        unsigned ArenaDepth = 0;
+        std::optional<ASTVal> ConstVal;     // value of a `const` variable if it is known at compile time
+        int Slot = -1;                      // index of a local variable in its function, -1 for a global
     };
     
     struct Function {
@@ -24,6 +28,9 @@ namespace marble {
         std::vector<Stmt *> Body;
         bool IsDeclaration;
         AccessModifier Access;
+        unsigned Attrs = 0;     // mask of `FunAttribute`
+        bool IsConst = false;
+        FunDeclStmt *Decl = nullptr;    // nullptr for a method of a trait
     };
 
     struct Field {
@@ -34,6 +41,7 @@ namespace marble {
         AccessModifier Access;
         bool ManualInitialized;
         bool IsStatic;
+        int Index = -1;     // the position among the non-static fields, as laid out by the code generator
     };
     
     struct Method {
@@ -74,6 +82,7 @@ namespace marble {
             std::unordered_map<std::string, Module *> SubModules;
             std::unordered_map<std::string, Module *> Imports;
             llvm::Module *Mod = nullptr;
+            bool FromInterface = false;     // parsed from the interface of its precompiled library, not from its source
 
             Module(std::string name, std::string fullPath, AccessModifier access) : _name(name), _fullPath(fullPath), _access(access) {}
 
@@ -3,46 +3,150 @@
 #include <marble/Parser/Parser.h>
 #include <marble/Basic/DiagnosticEngine.h>
 #include <marble/Basic/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <algorithm>
+#include <functional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace marble {
+    // Loads every file once: the modules are keyed by the canonical path of their file, so `./x.mr` and `x.mr` are the
+    // same module. The imports found by the parser form the import graph of the loaded modules.
     class ModuleManager {
-        std::unordered_map<std::string, Module *> _loadedModules;
+        std::unordered_map<std::string, Module *> _loadedModules;   // by the canonical path of their file
+        std::unordered_map<std::string, std::string> _realPaths;    // the canonical paths of the looked up files, empty if there is no such file
+        std::vector<Module *> _modules;                             // in the order of loading
+        std::unordered_map<const Module *, std::vector<Module *>> _imports;
+        std::vector<Module *> _parsing;                             // the modules being parsed, the innermost last
+        std::function<std::unique_ptr<llvm::MemoryBuffer>(const std::string &, llvm::StringRef)> _interfaceLoader;
         DiagnosticEngine &_diag;
 
     public:
         ModuleManager(DiagnosticEngine &diag) : _diag(diag) {}
 
+        // `loader` gets the path and the source of every file which is imported, and returns the interface which is
+        // parsed instead of the source, or nullptr to parse the source
+        void
+        SetInterfaceLoader(std::function<std::unique_ptr<llvm::MemoryBuffer>(const std::string &fullPath, llvm::StringRef source)> loader) {
+            _interfaceLoader = std::move(loader);
+        }
+
         Module *
         LoadModule(std::string fullPath, AccessModifier access, llvm::SourceMgr &srcMgr) {
-            if (_loadedModules.find(fullPath) != _loadedModules.end()) {
-                return _loadedModules[fullPath];
+            const std::string &realPath = GetRealPath(fullPath);
+            if (realPath.empty()) {
+                return nullptr;
+            }
+            if (auto it = _loadedModules.find(realPath); it != _loadedModules.end()) {
+                addImport(it->second);
+                return it->second;
             }
-            auto bufferOrErr = llvm::MemoryBuffer::getFile(fullPath);
+            auto bufferOrErr = llvm::MemoryBuffer::getFile(fullPath);    // mapped into memory if the file is large enough
             if (std::error_code ec = bufferOrErr.getError()) {
                 return nullptr;
             }
+            if (_interfaceLoader) {
+                if (std::unique_ptr<llvm::MemoryBuffer> interface = _interfaceLoader(fullPath, (*bufferOrErr)->getBuffer())) {
+                    Module *mod = LoadModule(fullPath, std::move(interface), access, srcMgr);
+                    mod->FromInterface = true;
+                    return mod;
+                }
+            }
+            return LoadModule(fullPath, std::move(*bufferOrErr), access, srcMgr);
+        }
 
+        // Parses a module whose source is already read or is not read from `fullPath`, e.g. one made up by the compiler
+        Module *
+        LoadModule(std::string fullPath, std::unique_ptr<llvm::MemoryBuffer> buffer, AccessModifier access, llvm::SourceMgr &srcMgr) {
             Module *mod = new Module(fullPath, fullPath, access);
-            _loadedModules[fullPath] = mod;
+            const std::string &realPath = GetRealPath(fullPath);
+            _loadedModules[realPath.empty() ? fullPath : realPath] = mod;
+            _modules.push_back(mod);
+            addImport(mod);
 
-            std::unique_ptr<llvm::MemoryBuffer> buffer = std::move(*bufferOrErr);
-            const char *bufferStart = buffer->getBufferStart();
-            const char *bufferEnd = buffer->getBufferEnd();
             unsigned bufferID = srcMgr.AddNewSourceBuffer(std::move(buffer), llvm::SMLoc());
-            llvm::StringRef srcMgrBuffer = srcMgr.getMemoryBuffer(bufferID)->getBuffer();
-            
+
             Lexer lex(_diag, srcMgr, bufferID);
             Parser parser(lex, _diag, srcMgr, *this);
+            _parsing.push_back(mod);
             mod->AST = parser.ParseAll();
+            _parsing.pop_back();
 
             return mod;
         }
 
+        // Returns the canonical path of the file, or an empty string if there is no such file. The file system is asked
+        // once for every path.
+        const std::string &
+        GetRealPath(const std::string &path) {
+            auto [it, inserted] = _realPaths.try_emplace(path);
+            if (inserted) {
+                llvm::SmallString<256> realPath;
+                if (!llvm::sys::fs::real_path(path, realPath) && llvm::sys::fs::is_regular_file(realPath)) {
+                    it->second = realPath.str().str();
+                }
+            }
+            return it->second;
+        }
+
+        // Returns the path of the file of an imported module without the extension: `path` for `path.mr`, otherwise
+        // `path/mod` for a directory module
+        std::string
+        FindModuleFile(std::string path) {
+            if (GetRealPath(path + ".mr").empty()) {
+                path += "/mod";
+            }
+            return path;
+        }
+
         const std::unordered_map<std::string, Module *> &
         GetLoadedModules() const {
             return _loadedModules;
         }
+
+        // The modules which are imported by the file of `mod`, in the order of their imports
+        const std::vector<Module *> &
+        GetImports(const Module *mod) const {
+            static const std::vector<Module *> none;
+            auto it = _imports.find(mod);
+            return it != _imports.end() ? it->second : none;
+        }
+
+        // Returns the loaded modules, each one after the modules it imports. An import which closes a cycle is ignored,
+        // so the importing module comes before the imported one there.
+        std::vector<Module *>
+        GetModulesInImportOrder() const {
+            std::vector<Module *> order;
+            std::unordered_set<const Module *> visited;
+            for (Module *mod : _modules) {
+                visitImports(mod, visited, order);
+            }
+            return order;
+        }
+
+    private:
+        // records an import of `mod` by the module being parsed
+        void
+        addImport(Module *mod) {
+            if (_parsing.empty()) {
+                return;
+            }
+            std::vector<Module *> &imports = _imports[_parsing.back()];
+            if (std::find(imports.begin(), imports.end(), mod) == imports.end()) {
+                imports.push_back(mod);
+            }
+        }
+
+        void
+        visitImports(Module *mod, std::unordered_set<const Module *> &visited, std::vector<Module *> &order) const {
+            if (!visited.insert(mod).second) {
+                return;
+            }
+            for (Module *imported : GetImports(mod)) {
+                visitImports(imported, visited, order);
+            }
+            order.push_back(mod);
+        }
     };
 }
@@ -0,0 +1,125 @@
+#pragma once
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/FileSystem.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace marble {
+    // Every instruction is `Op A B C`, where `A`, `B` and `C` are registers of the current frame unless noted otherwise.
+    // `Bx` is `B | C << 8` (an index into the constants, globals or functions) and `sBx` is `Bx` as a signed jump offset
+    // relative to the next instruction. Integers are kept sign-extended to 64 bits (`true` is -1, as after `sext i1`),
+    // `f32` values are kept as doubles rounded to float precision.
+    #define MARBLE_OPCODES(OP)                                                                                          \
+        OP(Mov)         /* A = B */                                                                                     \
+        OP(LoadK)       /* A = Consts[Bx] */                                                                            \
+        OP(LoadG)       /* A = Globals[Bx] */                                                                           \
+        OP(StoreG)      /* Globals[Bx] = A */                                                                           \
+        OP(Add)  OP(Sub)  OP(Mul)  OP(Div)  OP(Mod)  OP(And)  OP(Or)  OP(LogAnd)  OP(LogOr)                            \
+        OP(Eq)   OP(Ne)   OP(Lt)   OP(Le)   OP(Gt)   OP(Ge)                                                             \
+        OP(FAdd) OP(FSub) OP(FMul) OP(FDiv) OP(FMod)                                                                    \
+        OP(FEq)  OP(FNe)  OP(FLt)  OP(FLe)  OP(FGt)  OP(FGe)                                                            \
+        OP(Neg)  OP(Not)  OP(FNeg)                                                                                      \
+        OP(Sext1) OP(Sext8) OP(Sext16) OP(Sext32)   /* A = B truncated to the width and sign-extended back */          \
+        OP(IToF)  OP(FToI)  OP(FToF32)                                                                                  \
+        OP(Jmp)         /* pc += sBx */                                                                                 \
+        OP(JmpF)        /* if A == 0 then pc += sBx */                                                                  \
+        OP(Call)        /* A = Functions[Bx](A, A + 1, ...), the callee frame starts at register A */                   \
+        OP(Ret)         /* returns A */                                                                                 \
+        OP(RetN)        /* returns without a value */                                                                   \
+        OP(EchoI) OP(EchoF) OP(EchoB) OP(EchoC)
+
+    enum Opcode : uint8_t {
+        #define OP(name) Op##name,
+        MARBLE_OPCODES(OP)
+        #undef OP
+        OpCount
+    };
+
+    union BCValue {
+        int64_t I;
+        double F;
+    };
+
+    struct Instr {
+        uint8_t Op;
+        uint8_t A;
+        uint8_t B;
+        uint8_t C;
+
+        uint16_t
+        GetBx() const {
+            return B | C << 8;
+        }
+
+        int16_t
+        GetSBx() const {
+            return static_cast<int16_t>(GetBx());
+        }
+
+        static Instr
+        MakeBx(Opcode op, uint8_t a, uint16_t bx) {
+            return Instr { op, a, static_cast<uint8_t>(bx & 0xff), static_cast<uint8_t>(bx >> 8) };
+        }
+    };
+
+    struct BCFunction {
+        uint32_t NameOffset;    // in `Strings`
+        uint32_t NameSize;
+        uint32_t NumArgs;
+        uint32_t NumRegs;
+        uint32_t CodeOffset;    // index of the first instruction in `Code`
+        uint32_t CodeSize;
+    };
+
+    struct BCLoc {
+        uint32_t Line;
+        uint32_t Col;
+    };
+
+    // A program for the VM. All sections are arrays of plain structures, so a loaded file is executed right from its
+    // mapping: the views below point either into the vectors filled by BytecodeGen or into the mapped file.
+    class BytecodeModule {
+        std::vector<BCFunction> _functions;
+        std::vector<BCValue> _consts;
+        std::vector<BCValue> _globals;
+        std::vector<Instr> _code;
+        std::vector<BCLoc> _locs;
+        std::string _strings;
+        std::unique_ptr<llvm::sys::fs::mapped_file_region> _region;
+
+    public:
+        llvm::ArrayRef<BCFunction> Functions;
+        llvm::ArrayRef<BCValue> Consts;
+        llvm::ArrayRef<BCValue> Globals;    // initial values
+        llvm::ArrayRef<Instr> Code;
+        llvm::ArrayRef<BCLoc> Locs;         // source location of every instruction, for runtime errors
+        llvm::StringRef Strings;
+        uint32_t Entry = 0;                 // index of `main`
+        uint32_t SourceNameOffset = 0;
+        uint32_t SourceNameSize = 0;
+
+        llvm::StringRef
+        GetSourceName() const {
+            return Strings.substr(SourceNameOffset, SourceNameSize);
+        }
+
+        llvm::StringRef
+        GetFunctionName(const BCFunction &fun) const {
+            return Strings.substr(fun.NameOffset, fun.NameSize);
+        }
+
+        // Takes the sections produced by BytecodeGen
+        void
+        Assign(std::vector<BCFunction> functions, std::vector<BCValue> consts, std::vector<BCValue> globals,
+               std::vector<Instr> code, std::vector<BCLoc> locs, std::string strings);
+
+        bool
+        Save(const std::string &path, std::string &error) const;
+
+        static std::unique_ptr<BytecodeModule>
+        Load(const std::string &path, std::string &error);
+    };
+}
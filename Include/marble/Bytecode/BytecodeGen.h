@@ -0,0 +1,240 @@
+#pragma once
+#include <marble/AST/Visitor.h>
+#include <marble/Basic/DiagnosticEngine.h>
+#include <marble/Basic/Module.h>
+#include <marble/Bytecode/Bytecode.h>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace marble {
+    struct BCOperand {
+        uint8_t Reg;
+        ASTType Type;
+    };
+
+    // Lowers an analyzed program to register bytecode for the VM. Only `main` and the functions reachable from it are
+    // lowered, with the same name resolution and conversions as CodeGen. The VM works with numbers, chars and bools,
+    // so structures, traits, pointers and arenas are reported as not supported.
+    class BytecodeGen : public ASTVisitor<BytecodeGen, BCOperand> {
+        struct FunInfo {
+            FunDeclStmt *Decl;
+            std::vector<std::string> Path;
+            uint16_t Index;
+            bool Queued;
+        };
+
+        struct GlobalInfo {
+            VarDeclStmt *Decl;
+            std::vector<std::string> Path;
+        };
+
+        struct Local {
+            bool IsGlobal;
+            uint16_t Index;     // register or global
+            ASTType Type;
+        };
+
+        struct Loop {
+            std::vector<size_t> Breaks;
+            std::vector<size_t> Continues;
+        };
+
+        Module *_rootMod;
+        llvm::SourceMgr &_srcMgr;
+        DiagnosticEngine &_diag;
+
+        std::unordered_map<std::string, FunInfo> _functions;
+        std::unordered_map<std::string, GlobalInfo> _globalDecls;
+        std::unordered_map<std::string, std::string> _globalsByName;    // CodeGen keeps all globals in one scope by their plain names
+        std::unordered_map<std::string, uint16_t> _globalIndexes;
+        std::unordered_map<VarDeclStmt *, uint16_t> _statics;
+        std::unordered_set<std::string> _modules;
+        std::vector<std::string> _modulesPath;
+        std::deque<FunInfo *> _queue;
+
+        std::vector<BCFunction> _bcFunctions;
+        std::vector<BCValue> _consts;
+        std::unordered_map<int64_t, uint16_t> _constIndexes;
+        std::vector<BCValue> _globals;
+        std::vector<Instr> _code;
+        std::vector<BCLoc> _locs;
+        std::string _strings;
+
+        // state of the function being lowered
+        FunDeclStmt *_fun = nullptr;
+        std::vector<std::string> _path;
+        std::vector<std::unordered_map<std::string, Local>> _scopes;
+        std::vector<Loop> _loops;
+        unsigned _nextReg = 0;
+        unsigned _localsTop = 0;    // registers below are taken by variables, the ones above are temporaries
+        unsigned _maxReg = 0;
+        BCLoc _loc = { 0, 0 };    // location recorded for the emitted instructions
+        bool _failed = false;
+
+    public:
+        explicit BytecodeGen(Module *mod, llvm::SourceMgr &srcMgr, DiagnosticEngine &diag) : _rootMod(mod), _srcMgr(srcMgr), _diag(diag) {}
+
+        // Returns nullptr if the program uses something the VM does not support, the reasons are reported to `diag`
+        std::unique_ptr<BytecodeModule>
+        Generate();
+
+        BCOperand
+        VisitVarDeclStmt(VarDeclStmt *vds);
+
+        BCOperand
+        VisitVarAsgnStmt(VarAsgnStmt *vas);
+
+        BCOperand
+        VisitFunDeclStmt(FunDeclStmt *fds);
+
+        BCOperand
+        VisitFunCallStmt(FunCallStmt *fcs);
+
+        BCOperand
+        VisitRetStmt(RetStmt *rs);
+
+        BCOperand
+        VisitIfElseStmt(IfElseStmt *ies);
+
+        BCOperand
+        VisitForLoopStmt(ForLoopStmt *fls);
+
+        BCOperand
+        VisitBreakStmt(BreakStmt *bs);
+
+        BCOperand
+        VisitContinueStmt(ContinueStmt *cs);
+
+        BCOperand
+        VisitStructStmt(StructStmt *ss);
+
+        BCOperand
+        VisitFieldAsgnStmt(FieldAsgnStmt *fas);
+
+        BCOperand
+        VisitImplStmt(ImplStmt *is);
+
+        BCOperand
+        VisitMethodCallStmt(MethodCallStmt *mcs);
+
+        BCOperand
+        VisitTraitDeclStmt(TraitDeclStmt *tds);
+
+        BCOperand
+        VisitEchoStmt(EchoStmt *es);
+
+        BCOperand
+        VisitDelStmt(DelStmt *ds);
+
+        BCOperand
+        VisitImportStmt(ImportStmt *is);
+
+        BCOperand
+        VisitModuleDeclStmt(ModuleDeclStmt *mds);
+
+        BCOperand
+        VisitArenaStmt(ArenaStmt *as);
+
+        BCOperand
+        VisitBinaryExpr(BinaryExpr *be);
+
+        BCOperand
+        VisitUnaryExpr(UnaryExpr *ue);
+
+        BCOperand
+        VisitVarExpr(VarExpr *ve);
+
+        BCOperand
+        VisitLiteralExpr(LiteralExpr *le);
+
+        BCOperand
+        VisitFunCallExpr(FunCallExpr *fce);
+
+        BCOperand
+        VisitStructExpr(StructExpr *se);
+
+        BCOperand
+        VisitFieldAccessExpr(FieldAccessExpr *fae);
+
+        BCOperand
+        VisitMethodCallExpr(MethodCallExpr *mce);
+
+        BCOperand
+        VisitNilExpr(NilExpr *ne);
+
+        BCOperand
+        VisitDerefExpr(DerefExpr *de);
+
+        BCOperand
+        VisitRefExpr(RefExpr *re);
+
+        BCOperand
+        VisitNewExpr(NewExpr *ne);
+
+    private:
+        void
+        declareMod(Module *mod);
+
+        void
+        declareStatements(const std::vector<Stmt *> &ast);
+
+        uint16_t
+        getGlobal(const std::string &mangled);
+
+        std::optional<BCValue>
+        constantValue(Expr *expr, ASTType type);
+
+        uint16_t
+        getFunction(const std::string &mangled, llvm::SMLoc loc);
+
+        void
+        generateFunction(FunInfo &fun);
+
+        void
+        generateBlock(const std::vector<Stmt *> &body);
+
+        BCOperand
+        emitCall(FunInfo &fun, const std::vector<Expr *> &args);
+
+        uint8_t
+        convert(BCOperand src, ASTType type, int dest = -1);
+
+        uint8_t
+        condition(Expr *expr);
+
+        BCOperand
+        loadConst(const ASTVal &val);
+
+        uint8_t
+        allocReg();
+
+        void
+        setLoc(llvm::SMLoc loc);
+
+        size_t
+        emit(Instr in);
+
+        size_t
+        emitJump(Opcode op, uint8_t cond = 0);
+
+        void
+        patchJump(size_t at, size_t target);
+
+        std::optional<Local>
+        lookup(const std::string &name);
+
+        std::vector<std::string>
+        getModulePath(Expr *expr);
+
+        std::string
+        getMangledName(const std::vector<std::string> &path, const std::string &name) const;
+
+        BCOperand
+        unsupported(Node *node, const std::string &what);
+    };
+}
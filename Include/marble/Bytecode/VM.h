@@ -0,0 +1,33 @@
+#pragma once
+#include <marble/Bytecode/Bytecode.h>
+#include <string>
+#include <vector>
+
+namespace marble {
+    // Executes a `BytecodeModule`. Registers of a call frame are a window of one value stack: a call passes its
+    // arguments in the registers the callee frame starts with and gets the result in the first of them. Instructions
+    // are dispatched with computed gotos where the compiler supports them and with a `switch` otherwise.
+    class VM {
+        struct Frame {
+            const Instr *RetPC;
+            BCValue *Base;
+        };
+
+        const BytecodeModule &_mod;
+        std::vector<BCValue> _globals;
+        std::vector<BCValue> _stack;
+        std::vector<Frame> _frames;
+
+    public:
+        explicit VM(const BytecodeModule &mod, size_t stackSize = 1 << 20)
+                  : _mod(mod), _globals(mod.Globals.begin(), mod.Globals.end()), _stack(stackSize) {}
+
+        // Executes `main` and returns its result as the exit code. `main` gets 1 as its first argument (`argc`).
+        int
+        Run();
+
+    private:
+        [[noreturn]] void
+        fatal(const std::string &msg, const Instr *at);
+    };
+}
@@ -1,10 +1,15 @@
 #pragma once
 #include <marble/Basic/ModuleManager.h>
 #include <marble/AST/Visitor.h>
+#include <marble/CodeGen/CodeGenOptions.h>
 #include <marble/Basic/DiagnosticEngine.h>
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/IRBuilder.h>
+#include <memory>
+#include <optional>
 #include <stack>
+#include <unordered_set>
 
 namespace marble {
     class CodeGen : public ASTVisitor<CodeGen, llvm::Value *> {
@@ -12,16 +17,47 @@ namespace marble {
         llvm::LLVMContext _context;
         Module *_module;
         llvm::IRBuilder<> _builder;
+        CodeGenOptions _opts;
 
-        std::stack<std::unordered_map<std::string, std::tuple<llvm::Value *, llvm::Type *, ASTType>>> _vars;
+        using VarInfo = std::tuple<llvm::Value *, llvm::Type *, ASTType>;
+        std::vector<std::unordered_map<std::string, VarInfo>> _vars;   // scopes, the globals first
+        std::vector<VarInfo> _locals;                                   // of the current function by the slots which Sema assigned
 
         std::unordered_map<std::string, llvm::Function *> _functions;
         std::unordered_map<std::string, std::vector<ASTType>> _funArgsTypes;
         std::stack<llvm::Type *> _funRetsTypes;
 
         std::stack<std::pair<llvm::BasicBlock *, llvm::BasicBlock *>> _loopDeth;    // first for break, second for continue
+        std::stack<size_t> _loopScopes;                                             // index in `_vars` of the body scope of every loop
+        struct ActiveArena {
+            llvm::Value *Handle;
+            size_t LoopDepth;       // of its creation
+            llvm::Value *Site;      // id of the `arena` block with `TrackAllocs`
+        };
+        std::vector<ActiveArena> _arenas;
+        llvm::Instruction *_allocaInsertPt = nullptr;                               // allocas of the current function go before it
+
+        static constexpr uint64_t MaxStackPromotedSize = 1024;
+        std::unordered_set<NewExpr *> _stackAllocs;     // `new`s of the current function which are placed on the stack
+        std::unordered_set<DelStmt *> _stackDels;       // `del`s of those objects
+
+        std::optional<std::unordered_set<FunDeclStmt *>> _reachable;    // with `PruneUnreachable`, the bodies to generate
+        std::vector<llvm::Function *> _skippedFunctions;                  // erased in `Finalize` if nothing refers to them
+        unsigned _generatedBodies = 0;
+        unsigned _skippedBodies = 0;
 
         std::vector<std::string> _modulesPath;
+        std::string _modulePrefix;      // mangled `_modulesPath`, e.g. `Std#Math#`, kept in step by `pushModule` and `popModule`
+
+        // The caches of one module scope by the name written in the source, as the meaning of `self` and `parent` depends on
+        // the scope
+        struct ScopeCache {
+            std::unordered_map<std::string, std::string> Mangled;         // `_modulePrefix` and the name
+            std::unordered_map<std::string, std::string> MangledPaths;
+            std::unordered_map<std::string, llvm::Type *> LoweredTypes;   // structs and traits
+        };
+        std::unordered_map<std::string, ScopeCache> _scopeCaches;          // by `_modulePrefix`
+        ScopeCache *_scopeCache = &_scopeCaches[""];                      // of `_modulePrefix`, switched by `pushModule` and `popModule`
         Module *_currentMod = nullptr;
         Module *_rootMod = nullptr;
 
@@ -57,18 +93,53 @@ namespace marble {
         };
         std::unordered_map<std::string, Struct> _structs;
 
+
+        struct DebugUnit {
+            std::unique_ptr<llvm::DIBuilder> Builder;
+            llvm::DICompileUnit *CU;
+            llvm::DIFile *File;
+        };
+        std::unordered_map<unsigned, DebugUnit> _debugUnits;        // compile unit of every source file, by its buffer in `_srcMgr`
+        std::unordered_map<std::string, llvm::DIType *> _debugTypes;
+        DebugUnit *_debugUnit = nullptr;                            // unit of the function being generated
+        llvm::DISubprogram *_debugScope = nullptr;
+
+        // Every source file is generated into an `llvm::Module` of its own, which is optimized and emitted on its own.
+        // The inline `mod` blocks of a file belong to the unit of the file. References to the functions and variables
+        // of other units are replaced by declarations in `Finalize`.
+        struct Unit {
+            llvm::Module *Mod;
+            std::unordered_map<std::string, llvm::GlobalVariable *> Strings;    // pool of string constants
+
+            std::vector<llvm::Constant *> ProfNames;    // names of the instrumented functions, indexed by their profiler id
+            llvm::GlobalVariable *ProfBase = nullptr;   // id of the first function of this unit, assigned by the runtime
+
+            std::vector<llvm::Constant *> AllocSites;   // `new` and `del` sites tracked with `TrackAllocs`, indexed by their site id
+            llvm::GlobalVariable *AllocSitesBase = nullptr;
+
+            std::unique_ptr<llvm::Module> Library;      // lazily loaded bitcode of a precompiled library, its bodies are not generated
+        };
+        std::vector<std::unique_ptr<Unit>> _units;                  // the unit of the root module first
+        std::unordered_map<std::string, Unit *> _unitsByPath;       // by the path of their file
+        Unit *_unit = nullptr;                                      // unit of the code being generated
+
     public:
-        explicit CodeGen(Module *mod, llvm::SourceMgr &srcMgr) : _srcMgr(srcMgr), _context(), _builder(_context),
-                                                                          _module(mod) {
-            _module->Mod = new llvm::Module(mod->GetName(), _context);
-            _vars.push({});
+        explicit CodeGen(Module *mod, llvm::SourceMgr &srcMgr, CodeGenOptions opts = CodeGenOptions())
+                       : _srcMgr(srcMgr), _context(), _builder(_context), _module(mod), _opts(opts) {
+            _vars.emplace_back();
+            _unit = &getUnit(mod);
         }
 
+        // The module of the unit being generated
         llvm::Module *
         GetLLVMModule() {
-            return _module->Mod;
+            return _unit->Mod;
         }
 
+        // The modules of all units, the one of the root module first
+        std::vector<llvm::Module *>
+        GetLLVMModules() const;
+
         void
         DeclareMod(Module *mod);
 
@@ -76,10 +147,34 @@ namespace marble {
         DeclareStatements(std::vector<Stmt *> ast);
 
         void
-        DeclareRuntimeFunctions();
+        GenerateBodies(Module *mod);
 
+        // Finishes the compile units and the profiler tables, declares the symbols every unit uses from the other
+        // ones and links the needed functions of the precompiled libraries, must be called after `GenerateBodies`
         void
-        GenerateBodies(Module *mod);
+        Finalize();
+
+        // Bodies which were not generated as `main` and the exported functions cannot reach them
+        unsigned
+        GetSkippedBodies() const {
+            return _skippedBodies;
+        }
+
+        unsigned
+        GetGeneratedBodies() const {
+            return _generatedBodies;
+        }
+
+        // Prepares the unit of the library at `fullPath` to be saved as precompiled bitcode: its symbols are made
+        // linkable by name and it is tagged with its source and the options it was generated with. `interface` is
+        // stored with it for `LoadLibraryInterface`. Returns `nullptr` if no unit was generated for the file.
+        llvm::Module *
+        ExportLibrary(const std::string &fullPath, llvm::StringRef interface);
+
+        // Returns the interface stored with the precompiled bitcode of the library at `fullPath`, or nullptr if there
+        // is no bitcode which was generated from `source` with `opts`
+        static std::unique_ptr<llvm::MemoryBuffer>
+        LoadLibraryInterface(const std::string &fullPath, llvm::StringRef source, const CodeGenOptions &opts);
 
         llvm::Value *
         VisitVarDeclStmt(VarDeclStmt *vds);
@@ -135,6 +230,9 @@ namespace marble {
         llvm::Value *
         VisitModuleDeclStmt(ModuleDeclStmt *mds);
 
+        llvm::Value *
+        VisitArenaStmt(ArenaStmt *as);
+
         llvm::Value *
         VisitBinaryExpr(BinaryExpr *be);
         
@@ -172,6 +270,33 @@ namespace marble {
         VisitNewExpr(NewExpr *ne);
 
     private:
+        Unit &
+        getUnit(Module *mod);
+
+        void
+        declareRuntimeFunctions();
+
+        void
+        localizeReferences(Unit &unit);
+
+        llvm::GlobalValue *
+        declareInModule(llvm::Module &mod, llvm::GlobalValue *gv);
+
+        std::unique_ptr<llvm::Module>
+        loadLibrary(Module *mod);
+
+        void
+        generateGlobals(const std::vector<Stmt *> &ast);
+
+        std::unordered_map<Unit *, std::vector<llvm::GlobalValue *>>
+        collectLibraryDefinitions();
+
+        void
+        linkLibrary(Unit &unit, const std::vector<llvm::GlobalValue *> &defs);
+
+        bool
+        shouldGenerate(FunDeclStmt *fds, llvm::Function *fun);
+
         llvm::Type *
         getCommonType(llvm::Type *left, llvm::Type *right);
         
@@ -187,12 +312,91 @@ namespace marble {
         llvm::Value *
         defaultStructConst(ASTType type);
 
+        llvm::Constant *
+        getConstant(const ASTVal &val);
+
         std::string
         resolveStructName(Expr *expr);
 
+        VarInfo *
+        findVar(const std::string &name, int slot);
+
         void
         createCheckForNil(llvm::Value *ptr, llvm::SMLoc loc);
 
+        llvm::GlobalValue::LinkageTypes
+        getFunctionLinkage(FunDeclStmt *fds, const std::string &mangled) const;
+
+        void
+        applyFunAttrs(llvm::Function *fun, FunDeclStmt *fds);
+
+        void
+        flattenCalls(llvm::Function *fun);
+
+        void
+        beginFunctionBody(llvm::Function *fun);
+
+        void
+        endFunctionBody();
+
+        DebugUnit &
+        getDebugUnit(llvm::SMLoc loc);
+
+        void
+        beginDebugFunction(llvm::Function *fun, FunDeclStmt *fds, const std::string &name, std::optional<ASTType> thisType);
+
+        void
+        setDebugLoc(llvm::SMLoc loc);
+
+        void
+        declareDebugVar(llvm::Value *storage, const std::string &name, ASTType type, llvm::SMLoc loc, unsigned argNo, bool isAddress);
+
+        llvm::DIType *
+        getDebugType(ASTType type);
+
+        // mirrors `MarbleSiteKind` of the runtime
+        enum AllocSiteKind {
+            SiteNew,
+            SiteDel,
+            SiteArena
+        };
+
+        llvm::Value *
+        createAllocSite(const std::string &type, llvm::SMLoc loc, AllocSiteKind kind);
+
+        void
+        createRegistration(llvm::StringRef registerFun, llvm::ArrayRef<llvm::Value *> args);
+
+        llvm::AllocaInst *
+        createEntryAlloca(llvm::Type *type, const llvm::Twine &name = "");
+
+        void
+        endLifetimes();
+
+        void
+        endLifetimes(size_t firstScope);
+
+        void
+        collectStackAllocs(FunDeclStmt *fds, bool hasThis);
+
+        void
+        destroyArenas(size_t loopDepth);
+
+        llvm::ReturnInst *
+        createRetVoid();
+
+        void
+        generateBlock(const std::vector<Stmt *> &body);
+
+        std::optional<std::string>
+        getConstantEchoText(Expr *expr);
+
+        void
+        createEchoStr(const std::string &str);
+
+        llvm::Constant *
+        getOrCreateString(const std::string &str);
+
         llvm::Value *
         getOrCreateVTable(const std::string &structName, const std::string &traitName);
 
@@ -202,22 +406,34 @@ namespace marble {
         llvm::Function *
         getFunction(std::string name);
 
+        llvm::Function *
+        findFunction(const std::string &mangled);
+
+        llvm::GlobalVariable *
+        findGlobal(const std::string &name);
+
         std::string
         getMangledName(const std::vector<std::string> &path, const std::string &name) const;
 
-        std::string
-        getCurrentMangled(const std::string &name) const;
+        const std::string &
+        getCurrentMangled(const std::string &name);
 
         std::vector<std::string>
         splitPath(const std::string &path);
 
-        std::string
+        const std::string &
         getMangledForPath(const std::string &path);
 
+        void
+        pushModule(const std::string &name);
+
+        void
+        popModule();
+
         std::string
         getModulePathFromExpr(Expr *expr);
 
-        std::string
+        const std::string &
         resolveFullTypeName(const ASTType& type);
     };
 }
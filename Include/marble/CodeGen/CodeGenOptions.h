@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+
+namespace marble {
+    struct CodeGenOptions {
+        enum AllocatorKind {
+            System,     // `new` and `del` call `malloc` and `free`
+            Slab        // `new` and `del` call the runtime size-class allocator
+        };
+
+        AllocatorKind Allocator = Slab;
+        bool PromoteAllocs = false;         // place `new` objects which do not escape their function on the stack
+        bool LifetimeMarkers = false;       // emit `llvm.lifetime.start/end` for variables of nested blocks
+        bool DebugInfo = false;             // emit DWARF for functions, variables and types
+        bool TrackLocations = false;        // attach source locations for optimization remarks, without emitting DWARF
+        bool LineTables = false;            // with `TrackLocations`, emit the locations as line tables, e.g. to annotate assembly
+        bool FramePointers = false;         // keep the frame pointer in every function, so profilers can unwind the stack
+        bool InstrumentFunctions = false;   // count calls and cycles of every function for the runtime profiler
+        bool TrackAllocs = false;           // report every heap `new` and `del` to the runtime allocation tracker
+        bool ReportLeaks = false;           // with `TrackAllocs`, list the objects which are still alive at exit
+        bool Optimized = false;             // recorded in the debug info, the optimization itself is done by `Optimizer`
+        bool PruneUnreachable = false;      // generate only the bodies of the functions `Reachability` finds
+        std::string PrecompiledLibs;        // modules in this directory are linked from their precompiled bitcode, if it is up to date
+    };
+}
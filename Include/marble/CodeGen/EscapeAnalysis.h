@@ -0,0 +1,138 @@
+#pragma once
+#include <marble/AST/Visitor.h>
+#include <llvm/Support/Casting.h>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace marble {
+    // Finds `var p: *T = new T { ... };` declarations whose pointer never leaves the variable `p`. Such objects can live
+    // in the stack frame of the function: `p` is the only reference to the object, so the object is dead as soon as the
+    // declaration is executed again or `p` goes out of scope.
+    //
+    // A pointer escapes when it is copied anywhere (passed to a function or method, returned, stored in a variable or a
+    // field, captured with `&`, the object of a method call also through its fields) or when the variable is reassigned.
+    // Reading and writing fields, dereferencing, comparing and `del` do not make it escape.
+    class EscapeAnalysis : public ASTVisitor<EscapeAnalysis> {
+    public:
+        struct PromotedAlloc {
+            NewExpr *New;
+            std::vector<DelStmt *> Dels;
+        };
+
+    private:
+        std::vector<std::unordered_map<std::string, VarDeclStmt *>> _scopes;  // nullptr for variables which are not candidates
+        std::unordered_set<VarDeclStmt *> _escaped;
+        std::vector<VarDeclStmt *> _candidates;
+        std::unordered_map<VarDeclStmt *, std::vector<DelStmt *>> _dels;
+
+    public:
+        std::vector<PromotedAlloc>
+        Analyze(const std::vector<Stmt *> &body, const std::vector<std::string> &args);
+
+        void
+        VisitVarDeclStmt(VarDeclStmt *vds);
+
+        void
+        VisitVarAsgnStmt(VarAsgnStmt *vas);
+
+        void
+        VisitFunDeclStmt(FunDeclStmt *fds);
+
+        void
+        VisitFunCallStmt(FunCallStmt *fcs);
+
+        void
+        VisitRetStmt(RetStmt *rs);
+
+        void
+        VisitIfElseStmt(IfElseStmt *ies);
+
+        void
+        VisitForLoopStmt(ForLoopStmt *fls);
+
+        void
+        VisitBreakStmt(BreakStmt *bs);
+
+        void
+        VisitContinueStmt(ContinueStmt *cs);
+
+        void
+        VisitStructStmt(StructStmt *ss);
+
+        void
+        VisitFieldAsgnStmt(FieldAsgnStmt *fas);
+
+        void
+        VisitImplStmt(ImplStmt *is);
+
+        void
+        VisitMethodCallStmt(MethodCallStmt *mcs);
+
+        void
+        VisitTraitDeclStmt(TraitDeclStmt *tds);
+
+        void
+        VisitEchoStmt(EchoStmt *es);
+
+        void
+        VisitDelStmt(DelStmt *ds);
+
+        void
+        VisitImportStmt(ImportStmt *is);
+
+        void
+        VisitModuleDeclStmt(ModuleDeclStmt *mds);
+
+        void
+        VisitArenaStmt(ArenaStmt *as);
+
+        void
+        VisitBinaryExpr(BinaryExpr *be);
+
+        void
+        VisitUnaryExpr(UnaryExpr *ue);
+
+        void
+        VisitVarExpr(VarExpr *ve);
+
+        void
+        VisitLiteralExpr(LiteralExpr *le);
+
+        void
+        VisitFunCallExpr(FunCallExpr *fce);
+
+        void
+        VisitStructExpr(StructExpr *se);
+
+        void
+        VisitFieldAccessExpr(FieldAccessExpr *fae);
+
+        void
+        VisitMethodCallExpr(MethodCallExpr *mce);
+
+        void
+        VisitNilExpr(NilExpr *ne);
+
+        void
+        VisitDerefExpr(DerefExpr *de);
+
+        void
+        VisitRefExpr(RefExpr *re);
+
+        void
+        VisitNewExpr(NewExpr *ne);
+
+    private:
+        void
+        visitBlock(const std::vector<Stmt *> &body);
+
+        void
+        visitPointerUse(Expr *expr);
+
+        void
+        visitExposedObject(Expr *expr);
+
+        VarDeclStmt *
+        lookup(const std::string &name) const;
+    };
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <marble/AST/Visitor.h>
+#include <marble/Basic/Module.h>
+#include <llvm/Support/Casting.h>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace marble {
+    // Finds the functions and methods whose bodies can be executed, so the others need not be generated. The roots are
+    // `main`, the `pub` functions and methods of the root file and the methods of trait implementations, which the
+    // vtables refer to.
+    //
+    // A call is matched by its name only: it reaches every function and method of that name in any module. The result
+    // may keep a few dead bodies, but it never misses one which is called.
+    class Reachability : public ASTVisitor<Reachability> {
+        std::unordered_map<std::string, std::vector<FunDeclStmt *>> _byName;   // functions and methods of all modules
+        std::unordered_set<FunDeclStmt *> _reachable;
+        std::vector<FunDeclStmt *> _worklist;
+        std::unordered_set<std::string> _visitedFiles;
+        std::vector<Stmt *> _initializers;      // global variables and structures, their initializers are always generated
+
+    public:
+        std::unordered_set<FunDeclStmt *>
+        Analyze(Module *root);
+
+        void
+        VisitVarDeclStmt(VarDeclStmt *vds);
+
+        void
+        VisitVarAsgnStmt(VarAsgnStmt *vas);
+
+        void
+        VisitFunDeclStmt(FunDeclStmt *fds);
+
+        void
+        VisitFunCallStmt(FunCallStmt *fcs);
+
+        void
+        VisitRetStmt(RetStmt *rs);
+
+        void
+        VisitIfElseStmt(IfElseStmt *ies);
+
+        void
+        VisitForLoopStmt(ForLoopStmt *fls);
+
+        void
+        VisitBreakStmt(BreakStmt *bs);
+
+        void
+        VisitContinueStmt(ContinueStmt *cs);
+
+        void
+        VisitStructStmt(StructStmt *ss);
+
+        void
+        VisitFieldAsgnStmt(FieldAsgnStmt *fas);
+
+        void
+        VisitImplStmt(ImplStmt *is);
+
+        void
+        VisitMethodCallStmt(MethodCallStmt *mcs);
+
+        void
+        VisitTraitDeclStmt(TraitDeclStmt *tds);
+
+        void
+        VisitEchoStmt(EchoStmt *es);
+
+        void
+        VisitDelStmt(DelStmt *ds);
+
+        void
+        VisitImportStmt(ImportStmt *is);
+
+        void
+        VisitModuleDeclStmt(ModuleDeclStmt *mds);
+
+        void
+        VisitArenaStmt(ArenaStmt *as);
+
+        void
+        VisitBinaryExpr(BinaryExpr *be);
+
+        void
+        VisitUnaryExpr(UnaryExpr *ue);
+
+        void
+        VisitVarExpr(VarExpr *ve);
+
+        void
+        VisitLiteralExpr(LiteralExpr *le);
+
+        void
+        VisitFunCallExpr(FunCallExpr *fce);
+
+        void
+        VisitStructExpr(StructExpr *se);
+
+        void
+        VisitFieldAccessExpr(FieldAccessExpr *fae);
+
+        void
+        VisitMethodCallExpr(MethodCallExpr *mce);
+
+        void
+        VisitNilExpr(NilExpr *ne);
+
+        void
+        VisitDerefExpr(DerefExpr *de);
+
+        void
+        VisitRefExpr(RefExpr *re);
+
+        void
+        VisitNewExpr(NewExpr *ne);
+
+    private:
+        void
+        collectModule(Module *mod, bool isRoot);
+
+        void
+        collectStatements(const std::vector<Stmt *> &ast, bool isRoot);
+
+        void
+        reach(FunDeclStmt *fds);
+
+        void
+        reachName(const std::string &name);
+
+        void
+        visitBlock(const std::vector<Stmt *> &body);
+    };
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+
+namespace marble {
+    // Writes `asmText`, the assembly `targetMachine` generated with line tables, with the source lines of `srcMgr` in
+    // place of the `.loc` directives and without the debug sections. Every instruction gets its latency and reciprocal
+    // throughput from the scheduling model of the target, every function a header with their sums, and a table of all
+    // functions is written at the end. The sums are only an estimate of one pass through the function, without loops,
+    // branches and stalls between the instructions.
+    void
+    WriteAsmListing(llvm::StringRef asmText, const llvm::TargetMachine &targetMachine, llvm::SourceMgr &srcMgr,
+                    llvm::raw_ostream &os);
+}
\ No newline at end of file
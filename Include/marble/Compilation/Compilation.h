@@ -1,6 +1,8 @@
 #pragma once
 #include <llvm/IR/Module.h>
+#include <llvm/Support/SourceMgr.h>
 #include <string>
+#include <vector>
 
 namespace marble {
     void
@@ -9,8 +11,30 @@ namespace marble {
     bool
     EmitObjectFile(llvm::Module *mod, const std::string &fileName, std::string targetTripleStr = "");
 
-    void
-    LinkObjectFile(const std::string &objFile, const std::string &exeFile);
+    bool
+    EmitAssemblyFile(llvm::Module *mod, const std::string &fileName, std::string targetTripleStr = "");
+
+    // Emits the assembly interleaved with the lines of `srcMgr` it was generated from, `mod` must have line tables
+    bool
+    EmitAnnotatedAssemblyFile(llvm::Module *mod, const std::string &fileName, llvm::SourceMgr &srcMgr,
+                              std::string targetTripleStr = "");
+
+    // Writes `mod` as bitcode with the ThinLTO summary of its functions, which the linker uses to import them into the
+    // other modules
+    bool
+    EmitThinLTOBitcode(llvm::Module *mod, const std::string &fileName, std::string targetTripleStr = "");
+
+    // Writes `mod` as bitcode as it is, e.g. a precompiled library which is linked into the programs for any target
+    bool
+    EmitBitcodeFile(llvm::Module *mod, const std::string &fileName);
+
+    // Links `srcs` into `dest` and deletes them, returns false if they cannot be linked (e.g. a symbol is defined twice)
+    bool
+    LinkModules(llvm::Module &dest, llvm::ArrayRef<llvm::Module *> srcs);
+
+    // Links the objects with the runtime by `clang`, returns false if it fails
+    bool
+    LinkObjectFiles(const std::vector<std::string> &objFiles, const std::string &exeFile, bool thinLTO = false);
 
     std::string
     GetOutputName(const std::string &inputFile, const llvm::Triple &triple);
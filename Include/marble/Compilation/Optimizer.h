@@ -1,6 +1,7 @@
 #pragma once
 #include <llvm/IR/Module.h>
 #include <llvm/Passes/PassBuilder.h>
+#include <string>
 
 namespace marble {
     class Optimizer {
@@ -12,7 +13,12 @@ namespace marble {
             O3
         };
 
-        static void
-        Optimize(llvm::Module &M, Level L);
+        // Runs the default pipeline of `level` over the module, or `passes` (a textual new pass manager pipeline) if it
+        // is not empty. Functions with `@opt(N)` are left out of it and then run through the function simplification
+        // pipeline of their own level, `@opt(0)` ones are left as they are. With `thinLTOPreLink` the default pipelines
+        // are the ThinLTO pre-link ones, which leave the rest to the link. Returns false if `passes` cannot be parsed,
+        // the error is written to `errs()`.
+        static bool
+        Optimize(llvm::Module &M, Level L, const std::string &passes = "", bool printPipeline = false, bool thinLTOPreLink = false);
     };
 }
\ No newline at end of file
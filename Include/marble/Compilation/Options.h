@@ -29,7 +29,11 @@ namespace marble {
         EmitAST,
         EmitLLVM,
         EmitObj,
-        EmitBinary
+        EmitAsm,
+        EmitAsmAnnotated,
+        EmitBinary,
+        EmitBytecode,
+        EmitLibrary
     };
 
     static llvm::cl::opt<ActionKind> EmitAction(
@@ -38,11 +42,154 @@ namespace marble {
             clEnumValN(EmitAST, "ast", "Print the AST to stdout"),
             clEnumValN(EmitLLVM, "llvm", "Emit LLVM IR (.ll)"),
             clEnumValN(EmitObj, "obj", "Emit object file (.o)"),
-            clEnumValN(EmitBinary, "bin", "Emit executable (default)")),
+            clEnumValN(EmitAsm, "asm", "Emit assembly (.s)"),
+            clEnumValN(EmitAsmAnnotated, "asm-annotated",
+                       "Emit assembly interleaved with the source lines, with instruction counts and cycle estimates (.s)"),
+            clEnumValN(EmitBinary, "bin", "Emit executable (default)"),
+            clEnumValN(EmitBytecode, "bc", "Emit bytecode for the VM (.mrbc)"),
+            clEnumValN(EmitLibrary, "lib", "Precompile a module of Libs/ into bitcode, which is linked instead of its source (.bc)")),
         llvm::cl::init(EmitBinary), llvm::cl::cat(MarbleCat)
     );
 
     static llvm::cl::opt<std::string> OutputFilename(
         "o", llvm::cl::desc("Override output filename"), llvm::cl::value_desc("filename"), llvm::cl::cat(MarbleCat)
     );
-}
\ No newline at end of file
+
+    enum AllocatorKind {
+        AllocSystem,
+        AllocSlab
+    };
+
+    static llvm::cl::opt<AllocatorKind> Allocator(
+        "fallocator", llvm::cl::desc("Allocator used by `new` and `del`:"),
+        llvm::cl::values(
+            clEnumValN(AllocSystem, "system", "Use malloc and free"),
+            clEnumValN(AllocSlab, "slab", "Use the runtime size-class slab allocator (default)")),
+        llvm::cl::init(AllocSlab), llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<unsigned long> ConstEvalSteps(
+        "fconst-eval-steps", llvm::cl::desc("Maximum number of steps for evaluating one call of a `const fun` (default 1000000)"),
+        llvm::cl::value_desc("steps"), llvm::cl::init(1000000), llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<unsigned long> ConstEvalMemory(
+        "fconst-eval-memory", llvm::cl::desc("Maximum memory for evaluating one call of a `const fun` (default 262144)"),
+        llvm::cl::value_desc("bytes"), llvm::cl::init(256 * 1024), llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<bool> CheckAll(
+        "fcheck-all", llvm::cl::desc("Analyze the bodies of all functions of imported modules, also of the ones which are never referenced"),
+        llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<bool> Interpret(
+        "interp", llvm::cl::desc("Execute the program with the AST interpreter instead of compiling it"), llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<bool> RunVM(
+        "vm", llvm::cl::desc("Compile the program to bytecode and execute it with the VM, a .mrbc input is executed directly"),
+        llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<bool> DebugInfo(
+        "g", llvm::cl::desc("Emit DWARF debug info"), llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<bool> NoOmitFramePointer(
+        "fno-omit-frame-pointer", llvm::cl::desc("Keep the frame pointer in every function, so profilers can unwind the stack"),
+        llvm::cl::cat(MarbleCat)
+    );
+
+    enum InstrumentKind {
+        InstrumentNone,
+        InstrumentFunctions
+    };
+
+    static llvm::cl::opt<InstrumentKind> Instrument(
+        "finstrument", llvm::cl::desc("Instrument the program for the runtime profiler:"),
+        llvm::cl::values(
+            clEnumValN(InstrumentFunctions, "functions", "Count calls and cycles of every function, the profile is written at exit")),
+        llvm::cl::init(InstrumentNone), llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<bool> NoPruneUnreachable(
+        "fno-prune-unreachable", llvm::cl::desc("Generate the bodies of all functions, also of the ones which are never called"),
+        llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<bool> PrintPruned(
+        "print-pruned", llvm::cl::desc("Print how many function bodies were not generated because they are never called"),
+        llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<bool> PrintModuleGraph(
+        "print-module-graph", llvm::cl::desc("Print the loaded modules with their imports, every module after the ones it imports, `(interface)` marks the precompiled libraries"),
+        llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<bool> NoPrecompiledLibs(
+        "fno-precompiled-libs", llvm::cl::desc("Generate the imported modules of Libs/ from their source instead of linking their bitcode"),
+        llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<bool> TrackAllocs(
+        "ftrack-allocs", llvm::cl::desc("Record heap and arena allocations by `new` site, type and arena, the top sites are written at exit"),
+        llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<bool> ReportLeaks(
+        "freport-leaks", llvm::cl::desc("With -ftrack-allocs, also report the objects which are not deleted by exit"),
+        llvm::cl::cat(MarbleCat)
+    );
+
+    enum LTOKind {
+        LTONone,
+        LTOThin,
+        LTOFull
+    };
+
+    // without the option it is `full` when the program is optimized
+    static llvm::cl::opt<LTOKind> LTO(
+        "flto", llvm::cl::desc("Optimize across the modules of the program when it is linked:"),
+        llvm::cl::values(
+            clEnumValN(LTONone, "none", "Compile every module to an object of its own (default at -O0)"),
+            clEnumValN(LTOThin, "thin", "Emit every module as bitcode with a ThinLTO summary and link it with `clang -flto=thin`"),
+            clEnumValN(LTOFull, "full", "Link the modules before they are optimized and compile them as one (default at -O1 and above)")),
+        llvm::cl::init(LTONone), llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<std::string> Passes(
+        "passes", llvm::cl::desc("Run this LLVM pass pipeline instead of the default one of the optimization level"),
+        llvm::cl::value_desc("pipeline"), llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<bool> PrintPipeline(
+        "print-pipeline", llvm::cl::desc("Print the pass pipelines which are run on the program"), llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<std::string> Rpass(
+        "Rpass", llvm::cl::desc("Report the optimizations done by the passes whose name matches the regex"),
+        llvm::cl::value_desc("regex"), llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<std::string> RpassMissed(
+        "Rpass-missed", llvm::cl::desc("Report the optimizations missed by the passes whose name matches the regex"),
+        llvm::cl::value_desc("regex"), llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<std::string> RpassAnalysis(
+        "Rpass-analysis", llvm::cl::desc("Report the analysis results of the passes whose name matches the regex"),
+        llvm::cl::value_desc("regex"), llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<bool> SaveOptRecord(
+        "fsave-optimization-record", llvm::cl::desc("Write all optimization remarks to a YAML file (<input>.opt.yaml by default)"),
+        llvm::cl::cat(MarbleCat)
+    );
+
+    static llvm::cl::opt<std::string> OptRecordFile(
+        "foptimization-record-file", llvm::cl::desc("The file for -fsave-optimization-record"), llvm::cl::value_desc("filename"),
+        llvm::cl::cat(MarbleCat)
+    );
+}
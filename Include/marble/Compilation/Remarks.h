@@ -0,0 +1,47 @@
+#pragma once
+#include <marble/Basic/DiagnosticEngine.h>
+#include <llvm/IR/DiagnosticHandler.h>
+#include <llvm/Support/Regex.h>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace marble {
+    // Receives the optimization remarks of LLVM passes and reports the ones selected by `-Rpass`, `-Rpass-missed` and
+    // `-Rpass-analysis` through `DiagnosticEngine`. Remarks carry the debug locations CodeGen creates from the start
+    // locations of statements, which are mapped back to the buffers of `srcMgr`.
+    class RemarkHandler : public llvm::DiagnosticHandler {
+        llvm::SourceMgr &_srcMgr;
+        DiagnosticEngine &_diag;
+        std::optional<llvm::Regex> _passed;
+        std::optional<llvm::Regex> _missed;
+        std::optional<llvm::Regex> _analysis;
+
+    public:
+        explicit RemarkHandler(llvm::SourceMgr &srcMgr, DiagnosticEngine &diag) : _srcMgr(srcMgr), _diag(diag) {}
+
+        // Returns nullptr if one of the patterns is not a valid regular expression, empty patterns select nothing
+        static std::unique_ptr<RemarkHandler>
+        Create(llvm::SourceMgr &srcMgr, DiagnosticEngine &diag, const std::string &passed, const std::string &missed,
+               const std::string &analysis, std::string &error);
+
+        bool
+        handleDiagnostics(const llvm::DiagnosticInfo &di) override;
+
+        bool
+        isAnalysisRemarkEnabled(llvm::StringRef passName) const override;
+
+        bool
+        isMissedOptRemarkEnabled(llvm::StringRef passName) const override;
+
+        bool
+        isPassedOptRemarkEnabled(llvm::StringRef passName) const override;
+
+        bool
+        isAnyRemarkEnabled() const override;
+
+    private:
+        llvm::SMLoc
+        findLoc(llvm::StringRef path, unsigned line, unsigned col) const;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,257 @@
+#pragma once
+#include <marble/AST/Visitor.h>
+#include <marble/Basic/Module.h>
+#include <llvm/Support/SourceMgr.h>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace marble {
+    // Executes an analyzed program by walking its AST, so it starts without generating and linking any code. Values
+    // are `ASTVal`s: numbers live in `ASTValData`, a structure value keeps its fields in `GetFields()` and a pointer or
+    // a trait object keeps the address of the value it refers to in `ptrVal`. Every variable, field and object created
+    // with `new` is such a value with a stable address, so `&`, `*` and `this` work as in the compiled program.
+    //
+    // Names are resolved as in CodeGen (`path#name` for module members, `Struct.method` for methods), arithmetic is
+    // shared with `ConstEvaluator`, `echo` prints exactly what the runtime prints and a nil dereference aborts with the
+    // same message.
+    class Interpreter : public ASTVisitor<Interpreter, std::optional<ASTVal>> {
+        enum class Flow {
+            Normal,
+            Break,
+            Continue,
+            Return
+        };
+
+        struct FunInfo {
+            FunDeclStmt *Decl;
+            std::vector<std::string> Path;      // module path the function is declared in
+        };
+
+        struct StructInfo {
+            std::vector<VarDeclStmt *> Fields;
+            std::unordered_map<std::string, size_t> Indexes;
+            std::vector<std::string> Path;
+        };
+
+        struct GlobalInfo {
+            VarDeclStmt *Decl;
+            std::string Mangled;
+            std::vector<std::string> Path;
+            bool IsStaticField;
+        };
+
+        struct Frame {
+            std::vector<std::string> Path;
+            ASTVal *This = nullptr;
+            std::vector<std::unordered_map<std::string, ASTVal>> Scopes;
+            std::unordered_map<std::string, ASTVal *> Statics;
+            std::vector<std::unique_ptr<ASTVal>> Temps;     // storage of temporary objects, e.g. of rvalues converted to traits
+        };
+
+        Module *_rootMod;
+        llvm::SourceMgr &_srcMgr;
+
+        std::unordered_map<std::string, FunInfo> _functions;
+        std::unordered_map<std::string, StructInfo> _structs;
+        std::unordered_set<std::string> _modules;
+        std::vector<GlobalInfo> _globalDecls;
+        std::unordered_map<std::string, ASTVal> _globals;
+        std::unordered_map<std::string, ASTVal *> _globalsByName;  // CodeGen keeps all globals in one scope by their plain names
+        std::unordered_map<VarDeclStmt *, ASTVal> _statics;
+
+        std::vector<std::string> _modulesPath;
+        std::vector<Frame> _frames;
+        std::unordered_set<ASTVal *> _heap;
+        std::vector<std::vector<std::unique_ptr<ASTVal>>> _arenas;
+        Flow _flow = Flow::Normal;
+        std::optional<ASTVal> _retVal;
+
+    public:
+        explicit Interpreter(Module *mod, llvm::SourceMgr &srcMgr) : _rootMod(mod), _srcMgr(srcMgr) {}
+
+        ~Interpreter();
+
+        // Executes `main` and returns its result as the exit code
+        int
+        Run();
+
+        std::optional<ASTVal>
+        VisitVarDeclStmt(VarDeclStmt *vds);
+
+        std::optional<ASTVal>
+        VisitVarAsgnStmt(VarAsgnStmt *vas);
+
+        std::optional<ASTVal>
+        VisitFunDeclStmt(FunDeclStmt *fds);
+
+        std::optional<ASTVal>
+        VisitFunCallStmt(FunCallStmt *fcs);
+
+        std::optional<ASTVal>
+        VisitRetStmt(RetStmt *rs);
+
+        std::optional<ASTVal>
+        VisitIfElseStmt(IfElseStmt *ies);
+
+        std::optional<ASTVal>
+        VisitForLoopStmt(ForLoopStmt *fls);
+
+        std::optional<ASTVal>
+        VisitBreakStmt(BreakStmt *bs);
+
+        std::optional<ASTVal>
+        VisitContinueStmt(ContinueStmt *cs);
+
+        std::optional<ASTVal>
+        VisitStructStmt(StructStmt *ss);
+
+        std::optional<ASTVal>
+        VisitFieldAsgnStmt(FieldAsgnStmt *fas);
+
+        std::optional<ASTVal>
+        VisitImplStmt(ImplStmt *is);
+
+        std::optional<ASTVal>
+        VisitMethodCallStmt(MethodCallStmt *mcs);
+
+        std::optional<ASTVal>
+        VisitTraitDeclStmt(TraitDeclStmt *tds);
+
+        std::optional<ASTVal>
+        VisitEchoStmt(EchoStmt *es);
+
+        std::optional<ASTVal>
+        VisitDelStmt(DelStmt *ds);
+
+        std::optional<ASTVal>
+        VisitImportStmt(ImportStmt *is);
+
+        std::optional<ASTVal>
+        VisitModuleDeclStmt(ModuleDeclStmt *mds);
+
+        std::optional<ASTVal>
+        VisitArenaStmt(ArenaStmt *as);
+
+        std::optional<ASTVal>
+        VisitBinaryExpr(BinaryExpr *be);
+
+        std::optional<ASTVal>
+        VisitUnaryExpr(UnaryExpr *ue);
+
+        std::optional<ASTVal>
+        VisitVarExpr(VarExpr *ve);
+
+        std::optional<ASTVal>
+        VisitLiteralExpr(LiteralExpr *le);
+
+        std::optional<ASTVal>
+        VisitFunCallExpr(FunCallExpr *fce);
+
+        std::optional<ASTVal>
+        VisitStructExpr(StructExpr *se);
+
+        std::optional<ASTVal>
+        VisitFieldAccessExpr(FieldAccessExpr *fae);
+
+        std::optional<ASTVal>
+        VisitMethodCallExpr(MethodCallExpr *mce);
+
+        std::optional<ASTVal>
+        VisitNilExpr(NilExpr *ne);
+
+        std::optional<ASTVal>
+        VisitDerefExpr(DerefExpr *de);
+
+        std::optional<ASTVal>
+        VisitRefExpr(RefExpr *re);
+
+        std::optional<ASTVal>
+        VisitNewExpr(NewExpr *ne);
+
+    private:
+        void
+        declareMod(Module *mod);
+
+        void
+        declareStatements(const std::vector<Stmt *> &ast);
+
+        void
+        initGlobals();
+
+        ASTVal
+        eval(Expr *expr);
+
+        void
+        execBlock(const std::vector<Stmt *> &body);
+
+        std::vector<ASTVal>
+        evalArgs(const std::vector<Expr *> &args);
+
+        ASTVal
+        call(const FunInfo &fun, ASTVal *thisVal, std::vector<ASTVal> args);
+
+        ASTVal
+        callFunction(const std::string &name, const std::vector<Expr *> &args, llvm::SMLoc loc);
+
+        ASTVal
+        callMethod(Expr *obj, ASTType objType, bool staticAccessing, const std::string &name, const std::vector<Expr *> &args, llvm::SMLoc loc);
+
+        const FunInfo &
+        getFunction(const std::string &mangled, llvm::SMLoc loc);
+
+        ASTVal *
+        getAddress(Expr *expr);
+
+        ASTVal *
+        getObject(Expr *obj, ASTType objType, llvm::SMLoc loc);
+
+        ASTVal *
+        getField(ASTVal *obj, const std::string &name);
+
+        ASTVal *
+        getModuleVar(Expr *obj, const std::string &name);
+
+        ASTVal *
+        lookupVar(const std::string &name);
+
+        ASTVal *
+        createTemp(ASTVal val);
+
+        void
+        store(ASTVal *dest, ASTVal val);
+
+        ASTVal
+        convert(ASTVal val, ASTType type);
+
+        ASTVal
+        defaultValue(ASTType type, std::vector<std::string> path, bool withFieldInits);  // `path` is copied as it may point into a frame
+
+        ASTVal
+        deref(const ASTVal &ptr, llvm::SMLoc loc);
+
+        void
+        echo(const ASTVal &val);
+
+        const StructInfo &
+        getStruct(const std::string &mangled, llvm::SMLoc loc);
+
+        std::string
+        resolveStruct(const std::string &typePath, const std::vector<std::string> &path);
+
+        std::vector<std::string>
+        getModulePath(Expr *expr);
+
+        std::string
+        getMangledName(const std::vector<std::string> &path, const std::string &name) const;
+
+        std::string
+        getCurrentMangled(const std::string &name) const;
+
+        [[noreturn]] void
+        fatal(const std::string &msg, llvm::SMLoc loc);
+    };
+}
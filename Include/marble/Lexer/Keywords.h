@@ -34,5 +34,6 @@ namespace marble {
         { "import", TkImport },
         { "mod", TkMod },
         { "static", TkStatic },
+        { "arena", TkArena },
     };
 }
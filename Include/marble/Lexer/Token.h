@@ -33,6 +33,7 @@ namespace marble {
         TkImport,           // keyword `import`
         TkMod,              // keyword `mod`
         TkStatic,           // keyword `static`
+        TkArena,            // keyword `arena`
         
         TkBoolLit,          // bool literal
         TkCharLit,          // character literal
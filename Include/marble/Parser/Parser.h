@@ -78,6 +78,15 @@ namespace marble {
         Stmt *
         parseModuleDeclStmt();
 
+        Stmt *
+        parseArenaStmt();
+
+        unsigned
+        parseFunAttributes();
+
+        void
+        parseOptLevel();
+
         Argument
         parseArgument();
         
@@ -0,0 +1,100 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// ABI of the runtime library linked into every Marble executable. CodeGen declares these functions by hand in
+// `CodeGen::DeclareRuntimeFunctions`, so any change here must be mirrored there.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Buffered output used by `echo`. Every thread owns its own buffer, which is flushed when it fills up, at thread exit
+// and at process exit.
+void
+__marble_echo_str(const char *str, int64_t len);
+
+void
+__marble_echo_char(char val);
+
+void
+__marble_echo_bool(bool val);
+
+void
+__marble_echo_i64(int64_t val);
+
+void
+__marble_echo_f64(double val);
+
+void
+__marble_echo_ptr(const void *val);
+
+void
+__marble_echo_flush(void);
+
+// Size-class slab allocator used by `new` and `del` with `-fallocator=slab`. Pointers which were not returned by
+// `__marble_alloc` are passed to `free`.
+void *
+__marble_alloc(int64_t size);
+
+void
+__marble_free(void *ptr);
+
+// Bump-pointer arenas used by `new` inside `arena { ... }` blocks. Everything allocated from an arena is released by
+// `__marble_arena_destroy`.
+void *
+__marble_arena_create(void);
+
+void *
+__marble_arena_alloc(void *arena, int64_t size);
+
+void
+__marble_arena_destroy(void *arena);
+
+// Function profiler used with `-finstrument=functions`. Every module registers the names of its functions before `main`
+// and gets the id of the first one in `*base`. Instrumented functions call `__marble_prof_enter` on entry and
+// `__marble_prof_exit` before returning. Every thread profiles into its own buffers, which are merged at thread exit;
+// at process exit a flat profile and the call counts are written to stderr and as JSON to `marble-profile.json` (or the
+// file named by `MARBLE_PROFILE`).
+void
+__marble_prof_register(const char *const *names, uint32_t count, uint32_t *base);
+
+void
+__marble_prof_enter(uint32_t id);
+
+void
+__marble_prof_exit(void);
+
+// Allocation tracker used with `-ftrack-allocs`. Every module registers a table of its `new`, `del` and `arena` sites
+// before `main` and gets the id of the first one in `*base`. Heap allocations made by `new` are reported with
+// `__marble_track_alloc` and the pointers passed to `del` with `__marble_track_free` before they are released.
+// Allocations from an arena are reported with `__marble_track_arena_alloc`, they are released with the arena and never
+// live past it. At process exit the top allocation sites, the totals of every type and the arenas are written to
+// stderr, followed by the objects which were never deleted if `reportLeaks` is set.
+typedef enum {
+    MarbleSiteNew,
+    MarbleSiteDel,
+    MarbleSiteArena
+} MarbleSiteKind;
+
+typedef struct {
+    const char *Type;       // empty for `del` and `arena` sites
+    const char *Location;   // file:line:col
+    uint32_t Kind;          // `MarbleSiteKind`
+} MarbleAllocSite;
+
+void
+__marble_track_register(const MarbleAllocSite *sites, uint32_t count, uint32_t *base, bool reportLeaks);
+
+void
+__marble_track_alloc(void *ptr, int64_t size, uint32_t site);
+
+void
+__marble_track_free(void *ptr, uint32_t site);
+
+void
+__marble_track_arena_alloc(int64_t size, uint32_t site, uint32_t arenaSite);
+
+#ifdef __cplusplus
+}
+#endif
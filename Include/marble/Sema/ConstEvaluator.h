@@ -0,0 +1,206 @@
+#pragma once
+#include <marble/AST/Visitor.h>
+#include <marble/Basic/Module.h>
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace marble {
+    struct ConstEvalLimits {
+        unsigned long MaxSteps = 1000000;
+        unsigned long MaxMemory = 256 * 1024;   // bytes of call frames and variables which are alive at the same time
+    };
+
+    // Evaluates calls of `const fun` at compile time by walking the AST of their bodies. Only numbers, chars and bools
+    // are supported, so every value fits into an `ASTVal`. Arithmetic follows the code emitted by CodeGen: operands are
+    // converted to the wider type of the two, integers wrap around, and `/` and `%` are signed.
+    //
+    // Every visited statement and expression costs one step, every call frame and local variable costs memory. When a
+    // limit is exceeded or the body does something which is not possible at compile time, `Call` fails and `GetError`
+    // describes why.
+    class ConstEvaluator : public ASTVisitor<ConstEvaluator, std::optional<ASTVal>> {
+        enum class Flow {
+            Normal,
+            Break,
+            Continue,
+            Return
+        };
+
+        struct Frame {
+            Module *Mod;
+            ASTType RetType;
+            std::vector<std::unordered_map<std::string, ASTVal>> Scopes;
+            unsigned long Memory = 0;
+        };
+
+        ConstEvalLimits _limits;
+        std::vector<Frame> _frames;
+        unsigned long _steps = 0;
+        unsigned long _memory = 0;
+        Flow _flow = Flow::Normal;
+        std::optional<ASTVal> _retVal;
+        std::string _error;
+
+    public:
+        static constexpr unsigned long FrameCost = 256;
+        static constexpr unsigned long VarCost = 32;
+
+        explicit ConstEvaluator(ConstEvalLimits limits = ConstEvalLimits()) : _limits(limits) {}
+
+        // `mod` is the module `fun` is declared in, calls and global constants in the body are looked up there
+        std::optional<ASTVal>
+        Call(Function *fun, Module *mod, const std::vector<ASTVal> &args);
+
+        const std::string &
+        GetError() const {
+            return _error;
+        }
+
+        // Folds literals, expressions which already have a constant value, variables known to `lookup` and operators
+        // over them. Returns `std::nullopt` without an error if the value is not known at compile time.
+        static std::optional<ASTVal>
+        Fold(Expr *expr, const std::function<std::optional<ASTVal>(const std::string &)> &lookup = nullptr);
+
+        // Converts `val` as `implicitlyCast` in CodeGen does
+        static std::optional<ASTVal>
+        Convert(ASTVal val, ASTType type);
+
+        static bool
+        IsSupportedType(ASTType type);
+
+        // Applies an operator to scalar values as the code emitted by CodeGen does. On failure `error` describes why.
+        static std::optional<ASTVal>
+        BinaryOp(TokenKind op, ASTVal lhs, ASTVal rhs, std::string &error);
+
+        static std::optional<ASTVal>
+        UnaryOp(TokenKind op, ASTVal rhs, std::string &error);
+
+        static bool
+        IsTrue(const ASTVal &val);
+
+        std::optional<ASTVal>
+        VisitVarDeclStmt(VarDeclStmt *vds);
+
+        std::optional<ASTVal>
+        VisitVarAsgnStmt(VarAsgnStmt *vas);
+
+        std::optional<ASTVal>
+        VisitFunDeclStmt(FunDeclStmt *fds);
+
+        std::optional<ASTVal>
+        VisitFunCallStmt(FunCallStmt *fcs);
+
+        std::optional<ASTVal>
+        VisitRetStmt(RetStmt *rs);
+
+        std::optional<ASTVal>
+        VisitIfElseStmt(IfElseStmt *ies);
+
+        std::optional<ASTVal>
+        VisitForLoopStmt(ForLoopStmt *fls);
+
+        std::optional<ASTVal>
+        VisitBreakStmt(BreakStmt *bs);
+
+        std::optional<ASTVal>
+        VisitContinueStmt(ContinueStmt *cs);
+
+        std::optional<ASTVal>
+        VisitStructStmt(StructStmt *ss);
+
+        std::optional<ASTVal>
+        VisitFieldAsgnStmt(FieldAsgnStmt *fas);
+
+        std::optional<ASTVal>
+        VisitImplStmt(ImplStmt *is);
+
+        std::optional<ASTVal>
+        VisitMethodCallStmt(MethodCallStmt *mcs);
+
+        std::optional<ASTVal>
+        VisitTraitDeclStmt(TraitDeclStmt *tds);
+
+        std::optional<ASTVal>
+        VisitEchoStmt(EchoStmt *es);
+
+        std::optional<ASTVal>
+        VisitDelStmt(DelStmt *ds);
+
+        std::optional<ASTVal>
+        VisitImportStmt(ImportStmt *is);
+
+        std::optional<ASTVal>
+        VisitModuleDeclStmt(ModuleDeclStmt *mds);
+
+        std::optional<ASTVal>
+        VisitArenaStmt(ArenaStmt *as);
+
+        std::optional<ASTVal>
+        VisitBinaryExpr(BinaryExpr *be);
+
+        std::optional<ASTVal>
+        VisitUnaryExpr(UnaryExpr *ue);
+
+        std::optional<ASTVal>
+        VisitVarExpr(VarExpr *ve);
+
+        std::optional<ASTVal>
+        VisitLiteralExpr(LiteralExpr *le);
+
+        std::optional<ASTVal>
+        VisitFunCallExpr(FunCallExpr *fce);
+
+        std::optional<ASTVal>
+        VisitStructExpr(StructExpr *se);
+
+        std::optional<ASTVal>
+        VisitFieldAccessExpr(FieldAccessExpr *fae);
+
+        std::optional<ASTVal>
+        VisitMethodCallExpr(MethodCallExpr *mce);
+
+        std::optional<ASTVal>
+        VisitNilExpr(NilExpr *ne);
+
+        std::optional<ASTVal>
+        VisitDerefExpr(DerefExpr *de);
+
+        std::optional<ASTVal>
+        VisitRefExpr(RefExpr *re);
+
+        std::optional<ASTVal>
+        VisitNewExpr(NewExpr *ne);
+
+    private:
+        void
+        execBlock(const std::vector<Stmt *> &body);
+
+        std::optional<ASTVal>
+        callFunction(const std::string &name, const std::vector<Expr *> &args);
+
+        void
+        declareVar(const std::string &name, ASTVal val);
+
+        void
+        popScope();
+
+        bool
+        step();
+
+        bool
+        reserve(unsigned long bytes);
+
+        std::optional<ASTVal>
+        fail(const std::string &msg);
+
+        std::optional<ASTVal>
+        unsupported(const std::string &what);
+
+        bool
+        failed() const {
+            return !_error.empty();
+        }
+    };
+}
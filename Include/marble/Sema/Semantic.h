@@ -4,8 +4,10 @@
 #include <marble/AST/Visitor.h>
 #include <marble/Basic/DiagnosticEngine.h>
 #include <marble/Parser/Parser.h>
+#include <marble/Sema/ConstEvaluator.h>
 #include <stack>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace marble {
     class SemanticAnalyzer : public ASTVisitor<SemanticAnalyzer, std::optional<ASTVal>> {
@@ -16,20 +18,80 @@ namespace marble {
         Module *_currentMod = nullptr;
         const std::string &_libsPath;
         
-        std::stack<std::unordered_map<std::string, Variable>> _vars;
+        std::vector<std::unordered_map<std::string, Variable>> _vars;     // the scopes, the globals first
 
         std::stack<ASTType> _funRetsTypes;
         int _loopDeth = 0;
+        unsigned _arenaDepth = 0;
+        bool _inPureFun = false;
+        bool _inConstFun = false;
+        bool _inConstInit = false;  // in the initializer of a `const` variable, which must be a constant
+        int _nextSlot = 0;          // of the local variables of the function being analyzed
+        ConstEvalLimits _constEvalLimits;
+        std::unordered_set<const FunCallExpr *> _failedConstCalls;    // reported once, an expression may be analyzed again
+
+        // A body of a function or method of an imported module, which is analyzed only when it is referenced first
+        struct ImportedBody {
+            FunDeclStmt *Decl;
+            Module *Mod;
+            Struct *Self;           // nullptr for a function
+            bool Reached;
+        };
+        std::vector<ImportedBody> _importedBodies;
+        std::unordered_map<const Function *, size_t> _importedBodyIdx;
+        std::vector<size_t> _reachedBodies;
+        bool _checkAll = false;     // analyze all imported bodies, also the ones which are never referenced
+
+        // Found structures and traits by the context module and the path they are referred with
+        std::unordered_map<const Module *, std::unordered_map<std::string, Struct *>> _structPaths;
+        std::unordered_map<const Module *, std::unordered_map<std::string, Trait *>> _traitPaths;
+
+        // Where a value is stored: in the arena at `Depth` (0 outside of arenas) or in the memory the parameters in
+        // `Params` lead to. `Local` storage is a local variable, which is gone when the function returns
+        struct ArenaStorage {
+            unsigned Depth = 0;
+            uint64_t Params = 0;
+            bool Local = false;
+        };
+
+        // Where a function stores the memory its parameters lead to, by the index of the parameter (`this` is 0)
+        struct ParamFlow {
+            uint64_t Escapes = 0;                               // outside of the arguments, or deleted
+            std::unordered_map<unsigned, uint64_t> StoredInto;  // into the memory of other arguments
+        };
+        std::unordered_map<const FunDeclStmt *, ParamFlow> _paramFlows;
+        const FunDeclStmt *_currentFun = nullptr;
+
+        // A call which passes arena pointers or parameters, checked once the flows of all functions are known
+        struct ArenaCall {
+            const FunDeclStmt *Caller;
+            const FunDeclStmt *Callee;          // nullptr if unknown, then every argument escapes
+            std::vector<ArenaStorage> Args;     // what the arguments lead to, the object first for a method
+            llvm::SMLoc StartLoc;
+            llvm::SMLoc EndLoc;
+        };
+        std::vector<ArenaCall> _arenaCalls;
         
     public:
-        explicit SemanticAnalyzer(DiagnosticEngine &diag, llvm::SourceMgr &srcMgr, const std::string &libsPath, ModuleManager &mm)
-                                : _diag(diag), _srcMgr(srcMgr), _libsPath(libsPath), _modManager(mm) {
-            _vars.push({});
+        explicit SemanticAnalyzer(DiagnosticEngine &diag, llvm::SourceMgr &srcMgr, const std::string &libsPath, ModuleManager &mm,
+                                  ConstEvalLimits constEvalLimits = ConstEvalLimits())
+                                : _diag(diag), _srcMgr(srcMgr), _libsPath(libsPath), _modManager(mm), _constEvalLimits(constEvalLimits) {
+            _vars.emplace_back();
         }
         
         void
         Analyze(Module *mod);
 
+        void
+        SetCheckAll(bool checkAll) {
+            _checkAll = checkAll;
+        }
+
+        // The interface of the analyzed library `mod`, which programs parse instead of its source when they link its
+        // precompiled bitcode
+        std::string
+        GetLibraryInterface(Module *mod) const;
+
         std::optional<ASTVal>
         VisitVarDeclStmt(VarDeclStmt *vds);
 
@@ -84,6 +146,9 @@ namespace marble {
         std::optional<ASTVal>
         VisitModuleDeclStmt(ModuleDeclStmt *mds);
 
+        std::optional<ASTVal>
+        VisitArenaStmt(ArenaStmt *as);
+
         std::optional<ASTVal>
         VisitBinaryExpr(BinaryExpr *be);
         
@@ -127,9 +192,94 @@ namespace marble {
         void
         discover(Module *mod);
 
+        void
+        deferBody(const Function *fun, FunDeclStmt *decl, Module *mod, Struct *self, bool reached);
+
+        void
+        requireBody(const Function *fun);
+
+        void
+        analyzeReachedBodies();
+
+        void
+        analyzeMethodBody(FunDeclStmt *method, Struct *s);
+
         bool
         inRootMod(const Module *mod);
 
+        // must be called when a structure, a trait or a submodule is added to any module
+        void
+        invalidatePathCache();
+
+        Struct *
+        resolveStructPath(const std::string &path, Module *contextMod);
+
+        Trait *
+        resolveTraitPath(const std::string &path, Module *contextMod);
+
+        void
+        checkArenaEscape(const ASTVal &val, ArenaStorage storage, llvm::SMLoc startLoc, llvm::SMLoc endLoc);
+
+        bool
+        addParamFlow(const FunDeclStmt *fun, uint64_t params, ArenaStorage storage);
+
+        ArenaStorage
+        getStorageArena(Expr *obj, const ASTVal &objVal);
+
+        ArenaStorage
+        getVarArena(const std::string &name, bool pointee);
+
+        void
+        mergeIntoLocalVar(Expr *obj, const ASTVal &val);
+
+        void
+        deferArenaCall(const FunDeclStmt *callee, std::vector<ArenaStorage> args, llvm::SMLoc startLoc, llvm::SMLoc endLoc);
+
+        bool
+        applyArenaCall(const ArenaCall &call, bool report);
+
+        void
+        checkArenaCalls();
+
+        bool
+        passesParams(const FunDeclStmt *fun) const;
+
+        void
+        collectDroppedBodies(const std::vector<Stmt *> &stmts, std::vector<llvm::SMRange> &bodies) const;
+
+        bool
+        hasPointers(ASTType type);
+
+        ASTVal
+        getParamVal(ASTType type, unsigned idx);
+
+        static ArenaStorage
+        getArena(const ASTVal &val);
+
+        static void
+        setArena(ASTVal &val, ArenaStorage arena);
+
+        static ArenaStorage
+        mergeArenas(ArenaStorage lhs, ArenaStorage rhs);
+
+        void
+        checkFunAttrs(FunDeclStmt *fds);
+
+        void
+        checkPurity(const std::string &what, llvm::SMLoc startLoc, llvm::SMLoc endLoc);
+
+        void
+        checkConstFun(const std::string &what, llvm::SMLoc startLoc, llvm::SMLoc endLoc);
+
+        void
+        checkConstFunType(ASTType type, llvm::SMLoc startLoc, llvm::SMLoc endLoc);
+
+        void
+        evalConstCall(FunCallExpr *fce, Function *fun);
+
+        bool
+        isLocalStorage(Expr *expr);
+
         Variable *
         findVar(std::string name);
 
@@ -151,6 +301,10 @@ namespace marble {
         bool
         variableExists(std::string name) const;
 
+        // Finds the innermost variable with the name and sets `scope` to the index of its scope, 0 for a global.
+        Variable *
+        lookupVar(const std::string &name, size_t &scope);
+
         bool
         canImplicitlyCast(ASTVal src, ASTType expectType);
         
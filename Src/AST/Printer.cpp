@@ -32,7 +32,7 @@ namespace marble {
     void
     ASTPrinter::VisitFunDeclStmt(FunDeclStmt *fds) {
         llvm::outs() << std::string(_spaces, ' ');
-        llvm::outs() << "(FunDeclStmt: " << fds->GetRetType().ToString() << ' ' << fds->GetName() << " (";
+        llvm::outs() << "(FunDeclStmt: " << (fds->IsConst() ? "const " : "") << fds->GetRetType().ToString() << ' ' << fds->GetName() << " (";
         for (int i = 0; i < fds->GetArgs().size(); ++i) {
             llvm::outs() << fds->GetArgs()[i].GetType().ToString() << ' ' << fds->GetArgs()[i].GetName();
             if (i < fds->GetArgs().size() - 1) {
@@ -313,6 +313,25 @@ namespace marble {
         }
         llvm::outs() << "})";
     }
+
+    void
+    ASTPrinter::VisitArenaStmt(ArenaStmt *as) {
+        llvm::outs() << std::string(_spaces, ' ');
+        llvm::outs() << "(ArenaStmt: {";
+        if (as->GetBody().size() != 0) {
+            llvm::outs() << '\n';
+        }
+        _spaces += 2;
+        for (auto stmt : as->GetBody()) {
+            Visit(stmt);
+            llvm::outs() << '\n';
+        }
+        _spaces -= 2;
+        if (as->GetBody().size() != 0) {
+            llvm::outs() << std::string(_spaces, ' ');
+        }
+        llvm::outs() << "})";
+    }
     
     void
     ASTPrinter::VisitBinaryExpr(BinaryExpr *be) {
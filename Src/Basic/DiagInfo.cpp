@@ -5,6 +5,8 @@ namespace marble {
     DiagInfo
     GetDiagInfo(DiagKind kind) {
         #define ERR(msg) DiagInfo(llvm::SourceMgr::DiagKind::DK_Error, msg)
+        #define WARN(msg) DiagInfo(llvm::SourceMgr::DiagKind::DK_Warning, msg)
+        #define REMARK(msg) DiagInfo(llvm::SourceMgr::DiagKind::DK_Remark, msg)
         switch (kind) {
             case ErrIntegerSuffixForFloatingPoint:
                 return ERR("using the `%0` suffix for floating point numeric literal");
@@ -98,6 +100,8 @@ namespace marble {
                 return ERR("cannot imlement method `%0` from trait `%1: expected %2 argument(s), but received %3");
             case ErrCannotImplTraitMethod_ArgTypeMismatch:
                 return ERR("cannot imlement method `%0` from trait `%1: argument `%2` expected type `%3`, but received `%4`");
+            case ErrCannotImplTraitMethod_NotPure:
+                return ERR("cannot implement method `%0` from trait `%1`: the trait method is `@pure`, but the implementation is not");
             case ErrNotImplTraitMethod:
                 return ERR("method `%0` from trait `%1` does not implemented");
             case ErrExpectedDeclarationInTrait:
@@ -132,6 +136,34 @@ namespace marble {
                 return ERR("accessing of static method `%0` from non-type");
             case ErrAccessingNonStaticMethodFromType:
                 return ERR("accessing of non-static method `%0` from type");
+            case ErrArenaPtrEscapes:
+                return ERR("pointer allocated in an arena escapes it");
+            case ErrDelOfArenaPtr:
+                return ERR("deleting of a value allocated in an arena");
+            case ErrUnknownAttribute:
+                return ERR("unknown attribute `@%0`");
+            case ErrAttributesOnNonFunction:
+                return ERR("attributes can be applied only to functions and methods");
+            case ErrConflictingAttributes:
+                return ERR("attributes `@%0` and `@%1` cannot be used together");
+            case ErrImpureInPureFun:
+                return ERR("%0 is not allowed in a %1 function");
+            case ErrConstFunNonScalar:
+                return ERR("type `%0` cannot be used in a `const` function, only numbers, chars and bools are allowed");
+            case ErrConstEvalFailed:
+                return ERR("call of `%0` cannot be evaluated at compile time: %1");
+            case ErrNotSupportedByVM:
+                return ERR("%0 is not supported by the bytecode VM");
+            case ErrInvalidOptLevel:
+                return ERR("optimization level must be 0, 1, 2 or 3, but got `%0`");
+            case WarnConstEvalFailed:
+                return WARN("call of `%0` cannot be evaluated at compile time, so it is made at runtime: %1");
+            case RemarkOptPassed:
+                return REMARK("%1 [-Rpass=%0]");  // the message is the last argument, it may contain `%`
+            case RemarkOptMissed:
+                return REMARK("%1 [-Rpass-missed=%0]");
+            case RemarkOptAnalysis:
+                return REMARK("%1 [-Rpass-analysis=%0]");
         }
     }
 }
@@ -0,0 +1,213 @@
+#include <marble/Bytecode/Bytecode.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cstring>
+#include <type_traits>
+
+namespace marble {
+    static constexpr char FileMagic[4] = { 'M', 'R', 'B', 'C' };
+    static constexpr uint32_t FileVersion = 1;
+
+    // Every section starts at an offset aligned to 8 bytes, so it can be used right from the mapping
+    struct FileHeader {
+        char Magic[4];
+        uint32_t Version;
+        uint32_t Entry;
+        uint32_t SourceNameOffset;
+        uint32_t SourceNameSize;
+        uint32_t NumFunctions;
+        uint32_t NumConsts;
+        uint32_t NumGlobals;
+        uint32_t NumCode;
+        uint32_t StringsSize;
+        uint64_t FunctionsOffset;
+        uint64_t ConstsOffset;
+        uint64_t GlobalsOffset;
+        uint64_t CodeOffset;
+        uint64_t LocsOffset;
+        uint64_t StringsOffset;
+    };
+
+    static_assert(std::is_trivially_copyable<FileHeader>::value && sizeof(FileHeader) % 8 == 0);
+    static_assert(std::is_trivially_copyable<BCFunction>::value && std::is_trivially_copyable<Instr>::value &&
+                  std::is_trivially_copyable<BCLoc>::value && sizeof(Instr) == 4);
+
+    static uint64_t
+    alignTo8(uint64_t offset) {
+        return (offset + 7) & ~static_cast<uint64_t>(7);
+    }
+
+    // Checks everything the VM relies on, so a damaged file cannot make it read or jump out of bounds
+    static bool
+    verify(const BytecodeModule &mod, std::string &error) {
+        if (mod.Entry >= mod.Functions.size() || mod.Locs.size() != mod.Code.size() ||
+            static_cast<uint64_t>(mod.SourceNameOffset) + mod.SourceNameSize > mod.Strings.size()) {
+            error = "invalid header";
+            return false;
+        }
+        for (const BCFunction &fun : mod.Functions) {
+            if (static_cast<uint64_t>(fun.NameOffset) + fun.NameSize > mod.Strings.size() || fun.NumRegs > 256 ||
+                fun.NumArgs > fun.NumRegs || fun.CodeSize == 0 || static_cast<uint64_t>(fun.CodeOffset) + fun.CodeSize > mod.Code.size()) {
+                error = "invalid function";
+                return false;
+            }
+            for (uint32_t i = 0; i < fun.CodeSize; ++i) {
+                const Instr &in = mod.Code[fun.CodeOffset + i];
+                bool ok = in.Op < OpCount && in.A < fun.NumRegs;
+                switch (in.Op) {
+                    case OpLoadK:
+                        ok = ok && in.GetBx() < mod.Consts.size();
+                        break;
+                    case OpLoadG:
+                    case OpStoreG:
+                        ok = ok && in.GetBx() < mod.Globals.size();
+                        break;
+                    case OpJmp:
+                    case OpJmpF: {
+                        int64_t target = static_cast<int64_t>(i) + 1 + in.GetSBx();
+                        ok = ok && target >= 0 && target < fun.CodeSize;
+                        break;
+                    }
+                    case OpCall:
+                        ok = ok && in.GetBx() < mod.Functions.size() && in.A + mod.Functions[in.GetBx()].NumArgs <= fun.NumRegs;
+                        break;
+                    default:
+                        ok = ok && in.B < fun.NumRegs && in.C < fun.NumRegs;
+                        break;
+                }
+                if (!ok) {
+                    error = "invalid instruction in `" + mod.GetFunctionName(fun).str() + "`";
+                    return false;
+                }
+            }
+            Opcode last = static_cast<Opcode>(mod.Code[fun.CodeOffset + fun.CodeSize - 1].Op);
+            if (last != OpRet && last != OpRetN && last != OpJmp) {
+                error = "function `" + mod.GetFunctionName(fun).str() + "` does not end with a return";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void
+    BytecodeModule::Assign(std::vector<BCFunction> functions, std::vector<BCValue> consts, std::vector<BCValue> globals,
+                           std::vector<Instr> code, std::vector<BCLoc> locs, std::string strings) {
+        _functions = std::move(functions);
+        _consts = std::move(consts);
+        _globals = std::move(globals);
+        _code = std::move(code);
+        _locs = std::move(locs);
+        _strings = std::move(strings);
+        Functions = _functions;
+        Consts = _consts;
+        Globals = _globals;
+        Code = _code;
+        Locs = _locs;
+        Strings = _strings;
+    }
+
+    bool
+    BytecodeModule::Save(const std::string &path, std::string &error) const {
+        FileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.Magic, FileMagic, sizeof(FileMagic));
+        header.Version = FileVersion;
+        header.Entry = Entry;
+        header.SourceNameOffset = SourceNameOffset;
+        header.SourceNameSize = SourceNameSize;
+        header.NumFunctions = Functions.size();
+        header.NumConsts = Consts.size();
+        header.NumGlobals = Globals.size();
+        header.NumCode = Code.size();
+        header.StringsSize = Strings.size();
+        header.FunctionsOffset = sizeof(FileHeader);
+        header.ConstsOffset = alignTo8(header.FunctionsOffset + Functions.size() * sizeof(BCFunction));
+        header.GlobalsOffset = alignTo8(header.ConstsOffset + Consts.size() * sizeof(BCValue));
+        header.CodeOffset = alignTo8(header.GlobalsOffset + Globals.size() * sizeof(BCValue));
+        header.LocsOffset = alignTo8(header.CodeOffset + Code.size() * sizeof(Instr));
+        header.StringsOffset = alignTo8(header.LocsOffset + Locs.size() * sizeof(BCLoc));
+
+        std::error_code ec;
+        llvm::raw_fd_ostream os(path, ec);
+        if (ec) {
+            error = ec.message();
+            return false;
+        }
+        auto write = [&os](uint64_t offset, const void *data, size_t size) {
+            os.write_zeros(offset - os.tell());
+            os.write(static_cast<const char *>(data), size);
+        };
+        write(0, &header, sizeof(header));
+        write(header.FunctionsOffset, Functions.data(), Functions.size() * sizeof(BCFunction));
+        write(header.ConstsOffset, Consts.data(), Consts.size() * sizeof(BCValue));
+        write(header.GlobalsOffset, Globals.data(), Globals.size() * sizeof(BCValue));
+        write(header.CodeOffset, Code.data(), Code.size() * sizeof(Instr));
+        write(header.LocsOffset, Locs.data(), Locs.size() * sizeof(BCLoc));
+        write(header.StringsOffset, Strings.data(), Strings.size());
+        return true;
+    }
+
+    std::unique_ptr<BytecodeModule>
+    BytecodeModule::Load(const std::string &path, std::string &error) {
+        int fd;
+        if (std::error_code ec = llvm::sys::fs::openFileForRead(path, fd)) {
+            error = ec.message();
+            return nullptr;
+        }
+        uint64_t size = 0;
+        std::error_code ec = llvm::sys::fs::file_size(path, size);
+        if (!ec && size < sizeof(FileHeader)) {
+            ec = std::make_error_code(std::errc::invalid_argument);
+        }
+        std::unique_ptr<llvm::sys::fs::mapped_file_region> region;
+        if (!ec) {
+            region = std::make_unique<llvm::sys::fs::mapped_file_region>(llvm::sys::fs::convertFDToNativeFile(fd),
+                                                                         llvm::sys::fs::mapped_file_region::readonly, size, 0, ec);
+        }
+        llvm::sys::Process::SafelyCloseFileDescriptor(fd);   // the mapping stays valid without the descriptor
+        if (ec) {
+            error = size < sizeof(FileHeader) ? "not a bytecode file" : ec.message();
+            return nullptr;
+        }
+
+        const char *data = region->const_data();
+        FileHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.Magic, FileMagic, sizeof(FileMagic)) != 0) {
+            error = "not a bytecode file";
+            return nullptr;
+        }
+        if (header.Version != FileVersion) {
+            error = "unsupported bytecode version " + std::to_string(header.Version);
+            return nullptr;
+        }
+        auto section = [&](uint64_t offset, uint64_t count, uint64_t elemSize) {
+            return offset % 8 == 0 && offset <= size && count * elemSize <= size - offset;
+        };
+        if (!section(header.FunctionsOffset, header.NumFunctions, sizeof(BCFunction)) ||
+            !section(header.ConstsOffset, header.NumConsts, sizeof(BCValue)) ||
+            !section(header.GlobalsOffset, header.NumGlobals, sizeof(BCValue)) ||
+            !section(header.CodeOffset, header.NumCode, sizeof(Instr)) ||
+            !section(header.LocsOffset, header.NumCode, sizeof(BCLoc)) ||
+            !section(header.StringsOffset, header.StringsSize, 1)) {
+            error = "truncated bytecode file";
+            return nullptr;
+        }
+
+        std::unique_ptr<BytecodeModule> mod = std::make_unique<BytecodeModule>();
+        mod->Functions = llvm::ArrayRef<BCFunction>(reinterpret_cast<const BCFunction *>(data + header.FunctionsOffset), header.NumFunctions);
+        mod->Consts = llvm::ArrayRef<BCValue>(reinterpret_cast<const BCValue *>(data + header.ConstsOffset), header.NumConsts);
+        mod->Globals = llvm::ArrayRef<BCValue>(reinterpret_cast<const BCValue *>(data + header.GlobalsOffset), header.NumGlobals);
+        mod->Code = llvm::ArrayRef<Instr>(reinterpret_cast<const Instr *>(data + header.CodeOffset), header.NumCode);
+        mod->Locs = llvm::ArrayRef<BCLoc>(reinterpret_cast<const BCLoc *>(data + header.LocsOffset), header.NumCode);
+        mod->Strings = llvm::StringRef(data + header.StringsOffset, header.StringsSize);
+        mod->Entry = header.Entry;
+        mod->SourceNameOffset = header.SourceNameOffset;
+        mod->SourceNameSize = header.SourceNameSize;
+        mod->_region = std::move(region);
+        if (!verify(*mod, error)) {
+            return nullptr;
+        }
+        return mod;
+    }
+}
@@ -0,0 +1,896 @@
+#include <marble/Bytecode/BytecodeGen.h>
+#include <marble/Sema/ConstEvaluator.h>
+#include <algorithm>
+
+namespace marble {
+    static bool
+    isFloat(ASTTypeKind kind) {
+        return kind == ASTTypeKind::F32 || kind == ASTTypeKind::F64;
+    }
+
+    static ASTType
+    scalarType(ASTTypeKind kind) {
+        static const char *names[] = { "bool", "char", "i16", "i32", "i64", "f32", "f64" };
+        return ASTType(kind, names[static_cast<int>(kind)], false, 0);
+    }
+
+    static Opcode
+    sextFor(ASTTypeKind kind) {
+        switch (kind) {
+            case ASTTypeKind::Bool:
+                return OpSext1;
+            case ASTTypeKind::Char:
+                return OpSext8;
+            case ASTTypeKind::I16:
+                return OpSext16;
+            default:
+                return OpSext32;
+        }
+    }
+
+    // whether the instruction only writes register A, so its result can be redirected to another register
+    static bool
+    writesA(uint8_t op) {
+        switch (op) {
+            case OpStoreG:
+            case OpJmp:
+            case OpJmpF:
+            case OpCall:    // A is also the start of the callee frame
+            case OpRet:
+            case OpRetN:
+            case OpEchoI:
+            case OpEchoF:
+            case OpEchoB:
+            case OpEchoC:
+                return false;
+            default:
+                return true;
+        }
+    }
+
+    static BCValue
+    toBCValue(const ASTVal &val) {
+        BCValue res;
+        if (isFloat(val.GetType().GetTypeKind())) {
+            res.F = ConstEvaluator::Convert(val, scalarType(ASTTypeKind::F64))->GetData().f64Val;
+        }
+        else {
+            res.I = ConstEvaluator::Convert(val, scalarType(ASTTypeKind::I64))->GetData().i64Val;
+        }
+        return res;
+    }
+
+    std::unique_ptr<BytecodeModule>
+    BytecodeGen::Generate() {
+        declareMod(_rootMod);
+
+        auto main = _functions.find("main");
+        if (main == _functions.end()) {
+            llvm::errs() << llvm::errs().RED << "Error: " << llvm::errs().RESET << "function `main` is not declared\n";
+            return nullptr;
+        }
+        uint16_t entry = getFunction("main", main->second.Decl->GetStartLoc());
+        while (!_queue.empty() && !_failed) {
+            FunInfo *fun = _queue.front();
+            _queue.pop_front();
+            generateFunction(*fun);
+        }
+        if (_failed) {
+            return nullptr;
+        }
+
+        std::unique_ptr<BytecodeModule> mod = std::make_unique<BytecodeModule>();
+        mod->Entry = entry;
+        mod->SourceNameOffset = _strings.size();
+        mod->SourceNameSize = _rootMod->GetName().size();
+        _strings += _rootMod->GetName();
+        mod->Assign(std::move(_bcFunctions), std::move(_consts), std::move(_globals), std::move(_code), std::move(_locs),
+                    std::move(_strings));
+        return mod;
+    }
+
+    BCOperand
+    BytecodeGen::VisitVarDeclStmt(VarDeclStmt *vds) {
+        ASTType type = vds->GetType();
+        if (!ConstEvaluator::IsSupportedType(type)) {
+            return unsupported(vds, "variable of type `" + type.ToString() + "`");
+        }
+        if (vds->IsStatic()) {
+            auto it = _statics.find(vds);
+            if (it == _statics.end()) {
+                std::optional<BCValue> init = constantValue(vds->GetExpr(), type);
+                if (!init) {
+                    return unsupported(vds->GetExpr(), "static variable with a non-constant initializer");
+                }
+                it = _statics.emplace(vds, _globals.size()).first;
+                _globals.push_back(*init);
+            }
+            _scopes.back().insert_or_assign(vds->GetName(), Local { true, it->second, type });
+            return BCOperand { 0, ASTType::GetNothType() };
+        }
+
+        uint8_t reg = allocReg();
+        if (vds->GetExpr()) {
+            convert(Visit(vds->GetExpr()), type, reg);
+        }
+        else {
+            convert(loadConst(ASTVal::GetDefaultByType(type)), type, reg);
+        }
+        _localsTop = reg + 1;
+        _scopes.back().insert_or_assign(vds->GetName(), Local { false, reg, type });
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitVarAsgnStmt(VarAsgnStmt *vas) {
+        if (vas->GetDerefDepth() > 0) {
+            return unsupported(vas, "assignment through a pointer");
+        }
+        std::optional<Local> var = lookup(vas->GetName());
+        if (!var) {
+            return unsupported(vas, "variable `" + vas->GetName() + "`");
+        }
+        BCOperand val = Visit(vas->GetExpr());
+        if (var->IsGlobal) {
+            emit(Instr::MakeBx(OpStoreG, convert(val, var->Type), var->Index));
+        }
+        else {
+            convert(val, var->Type, var->Index);
+        }
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitFunDeclStmt(FunDeclStmt *fds) {
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitFunCallStmt(FunCallStmt *fcs) {
+        FunCallExpr *expr = new FunCallExpr(fcs->GetName(), fcs->GetArgs(), fcs->GetStartLoc(), fcs->GetEndLoc());
+        VisitFunCallExpr(expr);
+        delete expr;
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitRetStmt(RetStmt *rs) {
+        if (rs->GetExpr()) {
+            emit(Instr { OpRet, convert(Visit(rs->GetExpr()), _fun->GetRetType()), 0, 0 });
+        }
+        else {
+            emit(Instr { OpRetN, 0, 0, 0 });
+        }
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitIfElseStmt(IfElseStmt *ies) {
+        size_t toElse = emitJump(OpJmpF, condition(ies->GetCondition()));
+        _nextReg = _localsTop;
+        generateBlock(ies->GetThenBody());
+        if (ies->GetElseBody().empty()) {
+            patchJump(toElse, _code.size());
+            return BCOperand { 0, ASTType::GetNothType() };
+        }
+        size_t toEnd = emitJump(OpJmp);
+        patchJump(toElse, _code.size());
+        generateBlock(ies->GetElseBody());
+        patchJump(toEnd, _code.size());
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitForLoopStmt(ForLoopStmt *fls) {
+        unsigned localsTop = _localsTop;
+        _scopes.push_back({});
+        if (fls->GetIndexator()) {
+            Visit(fls->GetIndexator());
+            _nextReg = _localsTop;
+        }
+
+        size_t start = _code.size();
+        std::optional<size_t> toEnd;
+        if (fls->GetCondition()) {
+            toEnd = emitJump(OpJmpF, condition(fls->GetCondition()));
+            _nextReg = _localsTop;
+        }
+        _loops.push_back({});
+        generateBlock(fls->GetBody());
+        size_t iteration = _code.size();
+        if (fls->GetIteration()) {
+            Visit(fls->GetIteration());
+            _nextReg = _localsTop;
+        }
+        patchJump(emitJump(OpJmp), start);
+
+        size_t end = _code.size();
+        if (toEnd) {
+            patchJump(*toEnd, end);
+        }
+        for (size_t at : _loops.back().Breaks) {
+            patchJump(at, end);
+        }
+        for (size_t at : _loops.back().Continues) {
+            patchJump(at, iteration);
+        }
+        _loops.pop_back();
+        _scopes.pop_back();
+        _localsTop = localsTop;
+        _nextReg = localsTop;
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitBreakStmt(BreakStmt *bs) {
+        _loops.back().Breaks.push_back(emitJump(OpJmp));
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitContinueStmt(ContinueStmt *cs) {
+        _loops.back().Continues.push_back(emitJump(OpJmp));
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitStructStmt(StructStmt *ss) {
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitFieldAsgnStmt(FieldAsgnStmt *fas) {
+        if (fas->IsStaticAccessing() || fas->GetObjType().GetTypeKind() != ASTTypeKind::Mod) {
+            return unsupported(fas, "assignment to a field");
+        }
+        std::string mangled = getMangledName(getModulePath(fas->GetObject()), fas->GetName());
+        auto it = _globalDecls.find(mangled);
+        if (it == _globalDecls.end()) {
+            return unsupported(fas, "variable `" + mangled + "`");
+        }
+        ASTType type = it->second.Decl->GetType();
+        uint16_t index = getGlobal(mangled);
+        emit(Instr::MakeBx(OpStoreG, convert(Visit(fas->GetExpr()), type), index));
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitImplStmt(ImplStmt *is) {
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitMethodCallStmt(MethodCallStmt *mcs) {
+        MethodCallExpr *expr = new MethodCallExpr(mcs->GetObject(), mcs->GetName(), mcs->GetArgs(), mcs->GetStartLoc(), mcs->GetEndLoc());
+        expr->SetObjType(mcs->GetObjType());
+        expr->SetStaticAccessing(mcs->IsStaticAccessing());
+        VisitMethodCallExpr(expr);
+        delete expr;
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitTraitDeclStmt(TraitDeclStmt *tds) {
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitEchoStmt(EchoStmt *es) {
+        BCOperand val = Visit(es->GetRHS());
+        if (_failed) {
+            return BCOperand { 0, ASTType::GetNothType() };
+        }
+        if (!ConstEvaluator::IsSupportedType(val.Type)) {
+            return unsupported(es->GetRHS(), "`echo` of type `" + val.Type.ToString() + "`");
+        }
+        switch (val.Type.GetTypeKind()) {
+            case ASTTypeKind::Bool:
+                emit(Instr { OpEchoB, val.Reg, 0, 0 });
+                break;
+            case ASTTypeKind::Char:
+                emit(Instr { OpEchoC, val.Reg, 0, 0 });
+                break;
+            case ASTTypeKind::F32:
+            case ASTTypeKind::F64:
+                emit(Instr { OpEchoF, val.Reg, 0, 0 });
+                break;
+            default:
+                emit(Instr { OpEchoI, val.Reg, 0, 0 });
+                break;
+        }
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitDelStmt(DelStmt *ds) {
+        return unsupported(ds, "`del`");
+    }
+
+    BCOperand
+    BytecodeGen::VisitImportStmt(ImportStmt *is) {
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitModuleDeclStmt(ModuleDeclStmt *mds) {
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitArenaStmt(ArenaStmt *as) {
+        return unsupported(as, "`arena`");
+    }
+
+    BCOperand
+    BytecodeGen::VisitBinaryExpr(BinaryExpr *be) {
+        if (be->GetConstVal()) {
+            return loadConst(*be->GetConstVal());
+        }
+        BCOperand lhs = Visit(be->GetLHS());
+        BCOperand rhs = Visit(be->GetRHS());
+        if (_failed) {
+            return BCOperand { 0, ASTType::GetNothType() };
+        }
+        if (!ConstEvaluator::IsSupportedType(lhs.Type) || !ConstEvaluator::IsSupportedType(rhs.Type)) {
+            return unsupported(be, "operator on values of type `" + lhs.Type.ToString() + "`");
+        }
+        ASTTypeKind kind = std::max(lhs.Type.GetTypeKind(), rhs.Type.GetTypeKind());
+        ASTType common = scalarType(kind);
+        uint8_t l = convert(lhs, common);
+        uint8_t r = convert(rhs, common);
+        bool isFloatOp = isFloat(kind);
+
+        Opcode op;
+        bool isArith = false;
+        switch (be->GetOp().GetKind()) {
+            #define CASE(tk, intOp, floatOp, arith) case tk: op = isFloatOp ? floatOp : intOp; isArith = arith; break;
+            CASE(TkPlus, OpAdd, OpFAdd, true)
+            CASE(TkMinus, OpSub, OpFSub, true)
+            CASE(TkStar, OpMul, OpFMul, true)
+            CASE(TkSlash, OpDiv, OpFDiv, true)
+            CASE(TkPercent, OpMod, OpFMod, true)
+            CASE(TkGt, OpGt, OpFGt, false)
+            CASE(TkGtEq, OpGe, OpFGe, false)
+            CASE(TkLt, OpLt, OpFLt, false)
+            CASE(TkLtEq, OpLe, OpFLe, false)
+            CASE(TkEqEq, OpEq, OpFEq, false)
+            CASE(TkNotEq, OpNe, OpFNe, false)
+            #undef CASE
+            case TkLogAnd:
+            case TkLogOr:
+            case TkAnd:
+            case TkOr: {
+                if (isFloatOp) {
+                    return unsupported(be, "operator `" + be->GetOp().GetText() + "` for floating point values");
+                }
+                TokenKind tk = be->GetOp().GetKind();
+                op = tk == TkLogAnd ? OpLogAnd : tk == TkLogOr ? OpLogOr : tk == TkAnd ? OpAnd : OpOr;
+                isArith = tk == TkAnd || tk == TkOr;
+                break;
+            }
+            default:
+                return unsupported(be, "operator `" + be->GetOp().GetText() + "`");
+        }
+
+        uint8_t dest = allocReg();
+        setLoc(be->GetStartLoc());      // division by zero is reported at the expression
+        emit(Instr { op, dest, l, r });
+        if (!isArith) {
+            return BCOperand { dest, scalarType(ASTTypeKind::Bool) };
+        }
+        if (kind == ASTTypeKind::F32) {
+            emit(Instr { OpFToF32, dest, dest, 0 });
+        }
+        else if (!isFloatOp && kind != ASTTypeKind::I64 && op != OpAnd && op != OpOr) {
+            emit(Instr { sextFor(kind), dest, dest, 0 });
+        }
+        return BCOperand { dest, common };
+    }
+
+    BCOperand
+    BytecodeGen::VisitUnaryExpr(UnaryExpr *ue) {
+        if (ue->GetConstVal()) {
+            return loadConst(*ue->GetConstVal());
+        }
+        BCOperand rhs = Visit(ue->GetRHS());
+        if (_failed) {
+            return BCOperand { 0, ASTType::GetNothType() };
+        }
+        if (!ConstEvaluator::IsSupportedType(rhs.Type)) {
+            return unsupported(ue, "operator on values of type `" + rhs.Type.ToString() + "`");
+        }
+        ASTTypeKind kind = rhs.Type.GetTypeKind();
+        uint8_t dest = allocReg();
+        switch (ue->GetOp().GetKind()) {
+            case TkMinus:
+                if (isFloat(kind)) {
+                    emit(Instr { OpFNeg, dest, rhs.Reg, 0 });
+                }
+                else {
+                    emit(Instr { OpNeg, dest, rhs.Reg, 0 });
+                    if (kind != ASTTypeKind::I64) {
+                        emit(Instr { sextFor(kind), dest, dest, 0 });
+                    }
+                }
+                break;
+            case TkBang:
+                if (isFloat(kind)) {
+                    return unsupported(ue, "operator `!` for floating point values");
+                }
+                emit(Instr { OpNot, dest, rhs.Reg, 0 });
+                break;
+            default:
+                return unsupported(ue, "operator `" + ue->GetOp().GetText() + "`");
+        }
+        return BCOperand { dest, rhs.Type };
+    }
+
+    BCOperand
+    BytecodeGen::VisitVarExpr(VarExpr *ve) {
+        if (ve->GetConstVal()) {
+            return loadConst(*ve->GetConstVal());
+        }
+        std::optional<Local> var = lookup(ve->GetName());
+        if (!var) {
+            return unsupported(ve, "variable `" + ve->GetName() + "`");
+        }
+        if (!var->IsGlobal) {
+            return BCOperand { static_cast<uint8_t>(var->Index), var->Type };
+        }
+        uint8_t dest = allocReg();
+        emit(Instr::MakeBx(OpLoadG, dest, var->Index));
+        return BCOperand { dest, var->Type };
+    }
+
+    BCOperand
+    BytecodeGen::VisitLiteralExpr(LiteralExpr *le) {
+        if (!ConstEvaluator::IsSupportedType(le->GetVal().GetType())) {
+            return unsupported(le, "literal of type `" + le->GetVal().GetType().ToString() + "`");
+        }
+        return loadConst(le->GetVal());
+    }
+
+    BCOperand
+    BytecodeGen::VisitFunCallExpr(FunCallExpr *fce) {
+        if (fce->GetConstVal()) {   // `const fun` evaluated by Sema
+            return loadConst(*fce->GetConstVal());
+        }
+        auto it = _functions.find(getMangledName(_path, fce->GetName()));
+        if (it == _functions.end()) {
+            return unsupported(fce, "function `" + fce->GetName() + "`");
+        }
+        setLoc(fce->GetStartLoc());
+        return emitCall(it->second, fce->GetArgs());
+    }
+
+    BCOperand
+    BytecodeGen::VisitStructExpr(StructExpr *se) {
+        return unsupported(se, "structure");
+    }
+
+    BCOperand
+    BytecodeGen::VisitFieldAccessExpr(FieldAccessExpr *fae) {
+        if (fae->IsStaticAccessing() || fae->GetObjType().GetTypeKind() != ASTTypeKind::Mod) {
+            return unsupported(fae, "field access");
+        }
+        std::string mangled = getMangledName(getModulePath(fae->GetObject()), fae->GetName());
+        auto it = _globalDecls.find(mangled);
+        if (it == _globalDecls.end()) {
+            return unsupported(fae, "variable `" + mangled + "`");
+        }
+        uint16_t index = getGlobal(mangled);
+        uint8_t dest = allocReg();
+        emit(Instr::MakeBx(OpLoadG, dest, index));
+        return BCOperand { dest, it->second.Decl->GetType() };
+    }
+
+    BCOperand
+    BytecodeGen::VisitMethodCallExpr(MethodCallExpr *mce) {
+        if (mce->IsStaticAccessing() || mce->GetObjType().GetTypeKind() != ASTTypeKind::Mod) {
+            return unsupported(mce, "method call");
+        }
+        std::string mangled = getMangledName(getModulePath(mce->GetObject()), mce->GetName());
+        auto it = _functions.find(mangled);
+        if (it == _functions.end()) {
+            return unsupported(mce, "function `" + mangled + "`");
+        }
+        setLoc(mce->GetStartLoc());
+        return emitCall(it->second, mce->GetArgs());
+    }
+
+    BCOperand
+    BytecodeGen::VisitNilExpr(NilExpr *ne) {
+        return unsupported(ne, "`nil`");
+    }
+
+    BCOperand
+    BytecodeGen::VisitDerefExpr(DerefExpr *de) {
+        return unsupported(de, "dereference");
+    }
+
+    BCOperand
+    BytecodeGen::VisitRefExpr(RefExpr *re) {
+        return unsupported(re, "reference");
+    }
+
+    BCOperand
+    BytecodeGen::VisitNewExpr(NewExpr *ne) {
+        return unsupported(ne, "`new`");
+    }
+
+    void
+    BytecodeGen::declareMod(Module *mod) {
+        for (auto &[_, importedMod] : mod->Imports) {
+            declareMod(importedMod);
+        }
+
+        declareStatements(mod->AST);
+
+        for (auto &[name, submod] : mod->SubModules) {
+            _modulesPath.push_back(name);
+            _modules.insert(getMangledName(_modulesPath, ""));
+            declareMod(submod);
+            _modulesPath.pop_back();
+        }
+    }
+
+    void
+    BytecodeGen::declareStatements(const std::vector<Stmt *> &ast) {
+        // a module declared in a file is also a submodule of it, so the first declaration of a name wins
+        for (auto *stmt : ast) {
+            if (FunDeclStmt *fds = llvm::dyn_cast<FunDeclStmt>(stmt)) {
+                _functions.emplace(getMangledName(_modulesPath, fds->GetName()), FunInfo { fds, _modulesPath, 0, false });
+            }
+            else if (VarDeclStmt *vds = llvm::dyn_cast<VarDeclStmt>(stmt)) {
+                std::string mangled = getMangledName(_modulesPath, vds->GetName());
+                _globalDecls.emplace(mangled, GlobalInfo { vds, _modulesPath });
+                _globalsByName.emplace(vds->GetName(), mangled);
+            }
+            else if (ModuleDeclStmt *mds = llvm::dyn_cast<ModuleDeclStmt>(stmt)) {
+                _modulesPath.push_back(mds->GetName());
+                _modules.insert(getMangledName(_modulesPath, ""));
+                declareStatements(mds->GetBody());
+                _modulesPath.pop_back();
+            }
+        }
+    }
+
+    uint16_t
+    BytecodeGen::getGlobal(const std::string &mangled) {
+        if (auto it = _globalIndexes.find(mangled); it != _globalIndexes.end()) {
+            return it->second;
+        }
+        VarDeclStmt *vds = _globalDecls.at(mangled).Decl;
+        if (!ConstEvaluator::IsSupportedType(vds->GetType())) {
+            unsupported(vds, "global variable of type `" + vds->GetType().ToString() + "`");
+            return 0;
+        }
+        std::optional<BCValue> init = constantValue(vds->GetExpr(), vds->GetType());
+        if (!init) {
+            unsupported(vds->GetExpr(), "global variable with a non-constant initializer");
+            return 0;
+        }
+        if (_globals.size() > UINT16_MAX) {
+            unsupported(vds, "more than 65536 global variables");
+            return 0;
+        }
+        _globalIndexes.emplace(mangled, _globals.size());
+        _globals.push_back(*init);
+        return _globals.size() - 1;
+    }
+
+    std::optional<BCValue>
+    BytecodeGen::constantValue(Expr *expr, ASTType type) {
+        if (!expr) {
+            return toBCValue(ASTVal::GetDefaultByType(type));
+        }
+        std::optional<ASTVal> val = ConstEvaluator::Fold(expr);
+        if (!val) {
+            return std::nullopt;
+        }
+        std::optional<ASTVal> converted = ConstEvaluator::Convert(*val, type);
+        if (!converted) {
+            return std::nullopt;
+        }
+        return toBCValue(*converted);
+    }
+
+    uint16_t
+    BytecodeGen::getFunction(const std::string &mangled, llvm::SMLoc loc) {
+        FunInfo &fun = _functions.at(mangled);
+        if (fun.Queued) {
+            return fun.Index;
+        }
+        if (_bcFunctions.size() > UINT16_MAX) {
+            unsupported(fun.Decl, "more than 65536 functions");
+            return 0;
+        }
+        fun.Index = _bcFunctions.size();
+        fun.Queued = true;
+        _bcFunctions.push_back(BCFunction { static_cast<uint32_t>(_strings.size()), static_cast<uint32_t>(mangled.size()),
+                                            static_cast<uint32_t>(fun.Decl->GetArgs().size()), 0, 0, 0 });
+        _strings += mangled;
+        _queue.push_back(&fun);
+        return fun.Index;
+    }
+
+    void
+    BytecodeGen::generateFunction(FunInfo &fun) {
+        FunDeclStmt *fds = fun.Decl;
+        _fun = fds;
+        _path = fun.Path;
+        _scopes = { {} };
+        _loops.clear();
+        _nextReg = _localsTop = _maxReg = 0;
+        setLoc(fds->GetStartLoc());
+
+        ASTType retType = fds->GetRetType();
+        if (retType.GetTypeKind() != ASTTypeKind::Noth && !ConstEvaluator::IsSupportedType(retType)) {
+            unsupported(fds, "function returning `" + retType.ToString() + "`");
+            return;
+        }
+        bool isMain = fds->GetName() == "main" && fun.Path.empty();
+        for (auto &arg : fds->GetArgs()) {
+            // `argv` of `main` gets nil, it is reported only if the body uses it
+            if (!ConstEvaluator::IsSupportedType(arg.GetType()) && !isMain) {
+                unsupported(fds, "argument of type `" + arg.GetType().ToString() + "`");
+                return;
+            }
+            _scopes.back().emplace(arg.GetName(), Local { false, allocReg(), arg.GetType() });
+        }
+        _localsTop = _nextReg;
+
+        size_t codeOffset = _code.size();
+        generateBlock(fds->GetBody());
+        setLoc(fds->GetEndLoc());
+        emit(Instr { OpRetN, 0, 0, 0 });
+
+        BCFunction &bcFun = _bcFunctions[fun.Index];
+        bcFun.CodeOffset = codeOffset;
+        bcFun.CodeSize = _code.size() - codeOffset;
+        bcFun.NumRegs = std::max(_maxReg, 1u);
+    }
+
+    void
+    BytecodeGen::generateBlock(const std::vector<Stmt *> &body) {
+        unsigned localsTop = _localsTop;
+        _scopes.push_back({});
+        for (auto *stmt : body) {
+            setLoc(stmt->GetStartLoc());
+            Visit(stmt);
+            _nextReg = _localsTop;      // temporaries of a statement die with it
+            if (_failed) {
+                break;
+            }
+        }
+        _scopes.pop_back();
+        _localsTop = localsTop;
+        _nextReg = localsTop;
+    }
+
+    BCOperand
+    BytecodeGen::emitCall(FunInfo &fun, const std::vector<Expr *> &args) {
+        FunDeclStmt *fds = fun.Decl;
+        std::vector<Argument> funArgs = fds->GetArgs();
+        BCLoc loc = _loc;
+        uint16_t index = getFunction(getMangledName(fun.Path, fds->GetName()), fds->GetStartLoc());
+
+        // the arguments are evaluated right into the registers the callee frame starts with
+        unsigned base = _nextReg;
+        for (size_t i = 0; i < funArgs.size(); ++i) {
+            allocReg();
+        }
+        if (funArgs.empty()) {
+            allocReg();     // for the result
+        }
+        for (size_t i = 0; i < funArgs.size() && !_failed; ++i) {
+            unsigned top = _nextReg;
+            convert(Visit(args[i]), funArgs[i].GetType(), base + i);
+            _nextReg = top;
+        }
+        _loc = loc;
+        emit(Instr::MakeBx(OpCall, base, index));
+        _nextReg = base + 1;
+        return BCOperand { static_cast<uint8_t>(base), fds->GetRetType() };
+    }
+
+    uint8_t
+    BytecodeGen::convert(BCOperand src, ASTType type, int dest) {
+        if (_failed) {
+            return 0;
+        }
+        if (!ConstEvaluator::IsSupportedType(src.Type) || !ConstEvaluator::IsSupportedType(type)) {
+            unsupported(_fun, "value of type `" + src.Type.ToString() + "`");
+            return 0;
+        }
+        ASTTypeKind from = src.Type.GetTypeKind();
+        ASTTypeKind to = type.GetTypeKind();
+        auto move = [&]() -> uint8_t {
+            if (dest < 0 || dest == src.Reg) {
+                return src.Reg;
+            }
+            // a temporary computed by the last instruction is written to `dest` right away, expressions have no
+            // jumps inside, so the instruction is always executed before the move would be
+            if (src.Reg >= _localsTop && !_code.empty() && _code.back().A == src.Reg && writesA(_code.back().Op)) {
+                _code.back().A = dest;
+                return dest;
+            }
+            emit(Instr { OpMov, static_cast<uint8_t>(dest), src.Reg, 0 });
+            return dest;
+        };
+        auto target = [&]() -> uint8_t {
+            return dest >= 0 ? dest : allocReg();
+        };
+
+        if (from == to) {
+            return move();
+        }
+        if (!isFloat(from) && !isFloat(to)) {
+            if (to > from) {
+                return move();  // values are kept sign-extended
+            }
+            uint8_t res = target();
+            emit(Instr { sextFor(to), res, src.Reg, 0 });
+            return res;
+        }
+        if (!isFloat(from)) {
+            uint8_t res = target();
+            emit(Instr { OpIToF, res, src.Reg, 0 });
+            if (to == ASTTypeKind::F32) {
+                emit(Instr { OpFToF32, res, res, 0 });
+            }
+            return res;
+        }
+        if (isFloat(to)) {
+            if (to == ASTTypeKind::F64) {
+                return move();
+            }
+            uint8_t res = target();
+            emit(Instr { OpFToF32, res, src.Reg, 0 });
+            return res;
+        }
+        uint8_t res = target();
+        emit(Instr { OpFToI, res, src.Reg, 0 });
+        if (to != ASTTypeKind::I64) {
+            emit(Instr { sextFor(to), res, res, 0 });
+        }
+        return res;
+    }
+
+    uint8_t
+    BytecodeGen::condition(Expr *expr) {
+        BCOperand val = Visit(expr);
+        if (_failed) {
+            return 0;
+        }
+        if (!ConstEvaluator::IsSupportedType(val.Type)) {
+            unsupported(expr, "condition of type `" + val.Type.ToString() + "`");
+            return 0;
+        }
+        if (!isFloat(val.Type.GetTypeKind())) {
+            return val.Reg;
+        }
+        BCOperand zero = loadConst(ASTVal::GetDefaultByType(scalarType(ASTTypeKind::F64)));
+        emit(Instr { OpFNe, zero.Reg, val.Reg, zero.Reg });
+        return zero.Reg;
+    }
+
+    BCOperand
+    BytecodeGen::loadConst(const ASTVal &val) {
+        BCValue bits = toBCValue(val);
+        auto it = _constIndexes.find(bits.I);
+        if (it == _constIndexes.end()) {
+            if (_consts.size() > UINT16_MAX) {
+                unsupported(_fun, "more than 65536 constants");
+                return BCOperand { 0, ASTType::GetNothType() };
+            }
+            it = _constIndexes.emplace(bits.I, _consts.size()).first;
+            _consts.push_back(bits);
+        }
+        uint8_t dest = allocReg();
+        emit(Instr::MakeBx(OpLoadK, dest, it->second));
+        return BCOperand { dest, scalarType(val.GetType().GetTypeKind()) };
+    }
+
+    uint8_t
+    BytecodeGen::allocReg() {
+        if (_nextReg >= 256) {
+            unsupported(_fun, "function which needs more than 256 registers");
+            return 0;
+        }
+        _maxReg = std::max(_maxReg, _nextReg + 1);
+        return _nextReg++;
+    }
+
+    void
+    BytecodeGen::setLoc(llvm::SMLoc loc) {
+        auto [line, col] = _srcMgr.getLineAndColumn(loc);
+        _loc = BCLoc { line, col };
+    }
+
+    size_t
+    BytecodeGen::emit(Instr in) {
+        _code.push_back(in);
+        _locs.push_back(_loc);
+        return _code.size() - 1;
+    }
+
+    size_t
+    BytecodeGen::emitJump(Opcode op, uint8_t cond) {
+        return emit(Instr::MakeBx(op, cond, 0));
+    }
+
+    void
+    BytecodeGen::patchJump(size_t at, size_t target) {
+        int64_t offset = static_cast<int64_t>(target) - static_cast<int64_t>(at) - 1;
+        if (offset < INT16_MIN || offset > INT16_MAX) {
+            unsupported(_fun, "function with a jump over more than 32767 instructions");
+            return;
+        }
+        _code[at] = Instr::MakeBx(static_cast<Opcode>(_code[at].Op), _code[at].A, static_cast<uint16_t>(offset));
+    }
+
+    std::optional<BytecodeGen::Local>
+    BytecodeGen::lookup(const std::string &name) {
+        for (auto scope = _scopes.rbegin(); scope != _scopes.rend(); ++scope) {
+            if (auto it = scope->find(name); it != scope->end()) {
+                return it->second;
+            }
+        }
+        std::string mangled = getMangledName(_path, name);
+        if (!_globalDecls.count(mangled)) {
+            auto it = _globalsByName.find(name);
+            if (it == _globalsByName.end()) {
+                return std::nullopt;
+            }
+            mangled = it->second;
+        }
+        uint16_t index = getGlobal(mangled);
+        return Local { true, index, _globalDecls.at(mangled).Decl->GetType() };
+    }
+
+    std::vector<std::string>
+    BytecodeGen::getModulePath(Expr *expr) {
+        if (FieldAccessExpr *fae = llvm::dyn_cast<FieldAccessExpr>(expr)) {
+            std::vector<std::string> path = getModulePath(fae->GetObject());
+            path.push_back(fae->GetName());
+            return path;
+        }
+        std::vector<std::string> path = _path;
+        std::string name = llvm::cast<VarExpr>(expr)->GetName();
+        if (name == "self") {
+            return path;
+        }
+        if (name == "parent") {
+            if (!path.empty()) {
+                path.pop_back();
+            }
+            return path;
+        }
+        path.push_back(name);
+        if (_modules.count(getMangledName(path, ""))) {
+            return path;
+        }
+        return { name };
+    }
+
+    std::string
+    BytecodeGen::getMangledName(const std::vector<std::string> &path, const std::string &name) const {
+        std::string res;
+        for (const std::string &p : path) {
+            res += p + "#";
+        }
+        return res + name;
+    }
+
+    BCOperand
+    BytecodeGen::unsupported(Node *node, const std::string &what) {
+        if (!_failed) {     // the rest of the program is not lowered, so only the first reason is reported
+            _diag.Report(node->GetStartLoc(), ErrNotSupportedByVM)
+                << llvm::SMRange(node->GetStartLoc(), node->GetEndLoc())
+                << what;
+        }
+        _failed = true;
+        return BCOperand { 0, ASTType::GetNothType() };
+    }
+}
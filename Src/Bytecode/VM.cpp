@@ -0,0 +1,210 @@
+#include <marble/Bytecode/VM.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define MARBLE_VM_THREADED 1
+#else
+    #define MARBLE_VM_THREADED 0
+#endif
+
+namespace marble {
+    static int64_t
+    floatToInt(double val) {
+        // `fptosi` gives poison for values out of range, here they are saturated instead of being undefined behavior
+        if (std::isnan(val)) {
+            return 0;
+        }
+        if (val >= 9223372036854775807.0) {
+            return INT64_MAX;
+        }
+        if (val <= -9223372036854775808.0) {
+            return INT64_MIN;
+        }
+        return static_cast<int64_t>(val);
+    }
+
+    int
+    VM::Run() {
+        const Instr *code = _mod.Code.data();
+        const BCValue *consts = _mod.Consts.data();
+        const BCFunction *functions = _mod.Functions.data();
+        BCValue *globals = _globals.data();
+        BCValue *stackEnd = _stack.data() + _stack.size();
+
+        const BCFunction &main = functions[_mod.Entry];
+        if (main.NumRegs > _stack.size()) {
+            fatal("stack overflow", code + main.CodeOffset);
+        }
+        BCValue *r = _stack.data();
+        if (main.NumArgs > 0) {
+            r[0].I = 1;     // argc, the VM does not pass arguments to the program
+        }
+        const Instr *pc = code + main.CodeOffset;
+        _frames.push_back(Frame { nullptr, r });
+        BCValue res;
+        res.I = 0;
+        Instr in;
+
+        #define RA r[in.A]
+        #define RB r[in.B]
+        #define RC r[in.C]
+        #define INT_OP(name, expr) VM_CASE(name) { uint64_t b = RB.I, c = RC.I; RA.I = static_cast<int64_t>(expr); VM_NEXT(); }
+        #define CMP_OP(name, field, op) VM_CASE(name) { RA.I = -static_cast<int64_t>(RB.field op RC.field); VM_NEXT(); }
+        #define FLOAT_OP(name, expr) VM_CASE(name) { double b = RB.F, c = RC.F; RA.F = (expr); VM_NEXT(); }
+
+        #if MARBLE_VM_THREADED
+            #define VM_LABEL(name) &&L_##name,
+            static const void *labels[] = { MARBLE_OPCODES(VM_LABEL) };
+            #undef VM_LABEL
+            #define VM_CASE(name) L_##name:
+            #define VM_NEXT() do { in = *pc++; goto *labels[in.Op]; } while (0)
+            VM_NEXT();
+        #else
+            #define VM_CASE(name) case Op##name:
+            #define VM_NEXT() continue
+            for (;;) {
+            in = *pc++;
+            switch (in.Op) {
+        #endif
+
+        VM_CASE(Mov) { RA = RB; VM_NEXT(); }
+        VM_CASE(LoadK) { RA = consts[in.GetBx()]; VM_NEXT(); }
+        VM_CASE(LoadG) { RA = globals[in.GetBx()]; VM_NEXT(); }
+        VM_CASE(StoreG) { globals[in.GetBx()] = RA; VM_NEXT(); }
+
+        INT_OP(Add, b + c)
+        INT_OP(Sub, b - c)
+        INT_OP(Mul, b * c)
+        VM_CASE(Div) {
+            if (RC.I == 0) {
+                fatal("division by zero", pc - 1);
+            }
+            RA.I = RC.I == -1 ? static_cast<int64_t>(0 - static_cast<uint64_t>(RB.I)) : RB.I / RC.I;
+            VM_NEXT();
+        }
+        VM_CASE(Mod) {
+            if (RC.I == 0) {
+                fatal("division by zero", pc - 1);
+            }
+            RA.I = RC.I == -1 ? 0 : RB.I % RC.I;
+            VM_NEXT();
+        }
+        INT_OP(And, b & c)
+        INT_OP(Or, b | c)
+        INT_OP(LogAnd, -static_cast<int64_t>(b != 0 && c != 0))
+        INT_OP(LogOr, -static_cast<int64_t>(b != 0 || c != 0))
+
+        CMP_OP(Eq, I, ==)
+        CMP_OP(Ne, I, !=)
+        CMP_OP(Lt, I, <)
+        CMP_OP(Le, I, <=)
+        CMP_OP(Gt, I, >)
+        CMP_OP(Ge, I, >=)
+
+        FLOAT_OP(FAdd, b + c)
+        FLOAT_OP(FSub, b - c)
+        FLOAT_OP(FMul, b * c)
+        FLOAT_OP(FDiv, b / c)
+        FLOAT_OP(FMod, std::fmod(b, c))
+
+        CMP_OP(FEq, F, ==)
+        VM_CASE(FNe) { RA.I = -static_cast<int64_t>(RB.F < RC.F || RB.F > RC.F); VM_NEXT(); }   // ordered, as `fcmp one`
+        CMP_OP(FLt, F, <)
+        CMP_OP(FLe, F, <=)
+        CMP_OP(FGt, F, >)
+        CMP_OP(FGe, F, >=)
+
+        VM_CASE(Neg) { RA.I = static_cast<int64_t>(0 - static_cast<uint64_t>(RB.I)); VM_NEXT(); }
+        VM_CASE(Not) { RA.I = ~RB.I; VM_NEXT(); }
+        VM_CASE(FNeg) { RA.F = -RB.F; VM_NEXT(); }
+
+        VM_CASE(Sext1) { RA.I = -(RB.I & 1); VM_NEXT(); }
+        VM_CASE(Sext8) { RA.I = static_cast<int8_t>(RB.I); VM_NEXT(); }
+        VM_CASE(Sext16) { RA.I = static_cast<int16_t>(RB.I); VM_NEXT(); }
+        VM_CASE(Sext32) { RA.I = static_cast<int32_t>(RB.I); VM_NEXT(); }
+
+        VM_CASE(IToF) { RA.F = static_cast<double>(RB.I); VM_NEXT(); }
+        VM_CASE(FToI) { RA.I = floatToInt(RB.F); VM_NEXT(); }
+        VM_CASE(FToF32) { RA.F = static_cast<float>(RB.F); VM_NEXT(); }
+
+        VM_CASE(Jmp) { pc += in.GetSBx(); VM_NEXT(); }
+        VM_CASE(JmpF) {
+            if (RA.I == 0) {
+                pc += in.GetSBx();
+            }
+            VM_NEXT();
+        }
+        VM_CASE(Call) {
+            const BCFunction &callee = functions[in.GetBx()];
+            BCValue *base = r + in.A;
+            if (callee.NumRegs > static_cast<size_t>(stackEnd - base) || _frames.size() >= _stack.size()) {
+                fatal("stack overflow", pc - 1);
+            }
+            _frames.push_back(Frame { pc, base });
+            r = base;
+            pc = code + callee.CodeOffset;
+            VM_NEXT();
+        }
+        VM_CASE(Ret) {
+            res = RA;
+            goto ret;
+        }
+        VM_CASE(RetN) {
+            res.I = 0;
+            goto ret;
+        }
+
+        VM_CASE(EchoI) { llvm::outs() << RA.I; VM_NEXT(); }
+        VM_CASE(EchoF) {
+            // mirrors `__marble_echo_*` of the runtime
+            char buf[64];
+            std::snprintf(buf, sizeof(buf), "%g", RA.F);
+            llvm::outs() << buf;
+            VM_NEXT();
+        }
+        VM_CASE(EchoB) { llvm::outs() << (RA.I ? "true\n" : "false\n"); VM_NEXT(); }
+        VM_CASE(EchoC) { llvm::outs() << static_cast<char>(RA.I); VM_NEXT(); }
+
+    ret:
+        pc = _frames.back().RetPC;
+        _frames.pop_back();
+        if (_frames.empty()) {
+            goto done;
+        }
+        r = _frames.back().Base;
+        r[(pc - 1)->A] = res;   // the result goes to the register the callee frame started with
+        VM_NEXT();
+
+        #if !MARBLE_VM_THREADED
+                default:
+                    break;
+            }
+            }
+        #endif
+
+    done:
+        #undef RA
+        #undef RB
+        #undef RC
+        #undef INT_OP
+        #undef CMP_OP
+        #undef FLOAT_OP
+        #undef VM_CASE
+        #undef VM_NEXT
+
+        llvm::outs().flush();
+        return static_cast<int32_t>(res.I);
+    }
+
+    void
+    VM::fatal(const std::string &msg, const Instr *at) {
+        const BCLoc &loc = _mod.Locs[at - _mod.Code.data()];
+        llvm::outs() << "Error: " << msg << " at " << _mod.GetSourceName() << ":" << std::to_string(loc.Line) << ":"
+                     << std::to_string(loc.Col) << "!\n";
+        llvm::outs().flush();
+        std::abort();
+    }
+}
@@ -1,13 +1,171 @@
 #include <marble/CodeGen/CodeGen.h>
-#include <sstream>
+#include <marble/CodeGen/EscapeAnalysis.h>
+#include <marble/CodeGen/Reachability.h>
+#include <llvm/BinaryFormat/Dwarf.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/Path.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
 
 static bool createLoad = true;
 
 namespace marble {
+    // Inline `mod` blocks are generated with the AST of their file, which contains them
+    static bool
+    isInlineModule(Module *parent, Module *submod) {
+        return !submod->GetFullPath().empty() && submod->GetFullPath() == parent->GetFullPath();
+    }
+
+    static std::optional<llvm::StringRef>
+    findSource(llvm::SourceMgr &srcMgr, llvm::StringRef fullPath) {
+        for (unsigned i = 1; i <= srcMgr.getNumBuffers(); ++i) {
+            const llvm::MemoryBuffer *buffer = srcMgr.getMemoryBuffer(i);
+            if (buffer->getBufferIdentifier() == fullPath) {
+                return buffer->getBuffer();
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::vector<llvm::Module *>
+    CodeGen::GetLLVMModules() const {
+        std::vector<llvm::Module *> mods;
+        for (const std::unique_ptr<Unit> &unit : _units) {
+            mods.push_back(unit->Mod);
+        }
+        return mods;
+    }
+
+    CodeGen::Unit &
+    CodeGen::getUnit(Module *mod) {
+        auto it = _unitsByPath.find(mod->GetFullPath());
+        if (it != _unitsByPath.end()) {
+            return *it->second;
+        }
+        Unit *unit = _units.emplace_back(std::make_unique<Unit>()).get();
+        unit->Mod = new llvm::Module(mod->GetFullPath(), _context);
+        mod->Mod = unit->Mod;
+        _unitsByPath.emplace(mod->GetFullPath(), unit);
+
+        Unit *oldUnit = _unit;
+        _unit = unit;
+        declareRuntimeFunctions();
+        _unit = oldUnit;
+        unit->Library = loadLibrary(mod);
+        return *unit;
+    }
+
+    // Identifies the source of a library and the options which change the code generated for it
+    static std::string
+    getLibraryTag(llvm::StringRef source, const CodeGenOptions &opts) {
+        llvm::MD5 hash;
+        hash.update(source);
+        llvm::MD5::MD5Result digest;
+        hash.final(digest);
+        std::string tag;
+        llvm::raw_string_ostream os(tag);
+        os << "v1 " << digest.digest() << " alloc=" << opts.Allocator << " debug=" << opts.DebugInfo << " locs=" << opts.TrackLocations
+           << " lines=" << opts.LineTables << " fp=" << opts.FramePointers << " prof=" << opts.InstrumentFunctions
+           << " track=" << opts.TrackAllocs << " leaks=" << opts.ReportLeaks;
+        return os.str();
+    }
+
+    static std::optional<llvm::StringRef>
+    getLibraryMetadata(llvm::Module &lib, llvm::StringRef name) {
+        llvm::NamedMDNode *node = lib.getNamedMetadata(name);
+        if (!node || node->getNumOperands() != 1 || node->getOperand(0)->getNumOperands() != 1) {
+            return std::nullopt;
+        }
+        llvm::MDString *str = llvm::dyn_cast<llvm::MDString>(node->getOperand(0)->getOperand(0));
+        return str ? std::optional<llvm::StringRef>(str->getString()) : std::nullopt;
+    }
+
+    // The bitcode of a library is next to its source, e.g. `Libs/Std/Math/mod.bc`. It is used only if it was generated
+    // from the same source with the same options, otherwise the library is generated like any other module. Without
+    // `source` the tag is not checked, it was checked when the interface of the library was loaded.
+    static std::unique_ptr<llvm::Module>
+    openLibrary(const std::string &fullPath, std::optional<llvm::StringRef> source, const CodeGenOptions &opts, llvm::LLVMContext &context) {
+        if (opts.PrecompiledLibs.empty() || !llvm::StringRef(fullPath).starts_with(opts.PrecompiledLibs)) {
+            return nullptr;
+        }
+        llvm::SmallString<128> bitcodePath(fullPath);
+        llvm::sys::path::replace_extension(bitcodePath, "bc");
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> bufferOrErr = llvm::MemoryBuffer::getFile(bitcodePath);
+        if (!bufferOrErr) {
+            return nullptr;
+        }
+        // only the symbol table and the metadata are read here, the bodies are read by the linker when they are needed
+        llvm::Expected<std::unique_ptr<llvm::Module>> libOrErr = llvm::getOwningLazyBitcodeModule(std::move(*bufferOrErr), context);
+        if (!libOrErr) {
+            llvm::consumeError(libOrErr.takeError());
+            return nullptr;
+        }
+        std::unique_ptr<llvm::Module> lib = std::move(*libOrErr);
+        if (llvm::Error err = lib->materializeMetadata()) {
+            llvm::consumeError(std::move(err));
+            return nullptr;
+        }
+        if (source && getLibraryMetadata(*lib, "marble.library") != getLibraryTag(*source, opts)) {
+            return nullptr;
+        }
+        return lib;
+    }
+
+    std::unique_ptr<llvm::Module>
+    CodeGen::loadLibrary(Module *mod) {
+        std::string fullPath = mod->GetFullPath();
+        if (mod->FromInterface) {
+            return openLibrary(fullPath, std::nullopt, _opts, _context);
+        }
+        std::optional<llvm::StringRef> source = findSource(_srcMgr, fullPath);
+        return source ? openLibrary(fullPath, source, _opts, _context) : nullptr;
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer>
+    CodeGen::LoadLibraryInterface(const std::string &fullPath, llvm::StringRef source, const CodeGenOptions &opts) {
+        llvm::LLVMContext context;
+        std::unique_ptr<llvm::Module> lib = openLibrary(fullPath, source, opts, context);
+        std::optional<llvm::StringRef> interface = lib ? getLibraryMetadata(*lib, "marble.interface") : std::nullopt;
+        return interface ? llvm::MemoryBuffer::getMemBufferCopy(*interface, fullPath) : nullptr;
+    }
+
+    llvm::Module *
+    CodeGen::ExportLibrary(const std::string &fullPath, llvm::StringRef interface) {
+        auto it = _unitsByPath.find(fullPath);
+        std::optional<llvm::StringRef> source = findSource(_srcMgr, fullPath);
+        if (it == _unitsByPath.end() || !source) {
+            return nullptr;
+        }
+        llvm::Module *mod = it->second->Mod;
+        // the private symbols of a program may be used by any of its units, the mangled names keep them apart;
+        // string constants and the like have private linkage and stay in the library
+        for (llvm::GlobalValue &gv : mod->global_values()) {
+            if (gv.hasInternalLinkage()) {
+                gv.setLinkage(llvm::GlobalValue::ExternalLinkage);
+                gv.setVisibility(llvm::GlobalValue::HiddenVisibility);
+            }
+        }
+        llvm::NamedMDNode *tag = mod->getOrInsertNamedMetadata("marble.library");
+        tag->addOperand(llvm::MDNode::get(_context, llvm::MDString::get(_context, getLibraryTag(*source, _opts))));
+        llvm::NamedMDNode *interfaceNode = mod->getOrInsertNamedMetadata("marble.interface");
+        interfaceNode->addOperand(llvm::MDNode::get(_context, llvm::MDString::get(_context, interface)));
+        return mod;
+    }
+
     void
     CodeGen::DeclareMod(Module *mod) {
         Module* oldMod = _currentMod;
+        Unit *oldUnit = _unit;
         _currentMod = mod;
+        if (!mod->GetFullPath().empty()) {  // the modules of the path of an import have no file
+            _unit = &getUnit(mod);
+        }
         
         for (auto &[_, importedMod] : mod->Imports) {
             DeclareMod(importedMod);
@@ -16,12 +174,16 @@ namespace marble {
         DeclareStatements(mod->AST);
 
         for (auto &[name, submod] : mod->SubModules) {
-            _modulesPath.push_back(name);
+            if (isInlineModule(mod, submod)) {
+                continue;
+            }
+            pushModule(name);
             DeclareMod(submod);
-            _modulesPath.pop_back();
+            popModule();
         }
 
         _currentMod = oldMod;
+        _unit = oldUnit;
     }
 
     void
@@ -34,9 +196,13 @@ namespace marble {
                     args[i] = typeToLLVM(fds->GetArgs()[i].GetType());
                     argsAST[i] = fds->GetArgs()[i].GetType();
                 }
-                llvm::FunctionType *retType = llvm::FunctionType::get(typeToLLVM(fds->GetRetType()), args, false);
-                std::string mangled = getCurrentMangled(fds->GetName());
-                llvm::Function *fun = llvm::Function::Create(retType, llvm::GlobalValue::ExternalLinkage, mangled, *GetLLVMModule());
+                const std::string &mangled = getCurrentMangled(fds->GetName());
+                // the exit code of the program is 0 if `main` returns nothing
+                bool mainReturnsNoth = mangled == "main" && fds->GetRetType().GetTypeKind() == ASTTypeKind::Noth;
+                llvm::FunctionType *retType = llvm::FunctionType::get(mainReturnsNoth ? _builder.getInt32Ty() : typeToLLVM(fds->GetRetType()), args, false);
+                llvm::Function *fun = llvm::Function::Create(retType, getFunctionLinkage(fds, mangled), mangled, *GetLLVMModule());
+                fun->addFnAttr(llvm::Attribute::NoUnwind);
+                applyFunAttrs(fun, fds);
                 if (fds->GetRetType().GetTypeKind() == ASTTypeKind::Struct) {
                     llvm::MDNode *metadata = llvm::MDNode::get(_context, llvm::MDString::get(_context, fds->GetRetType().GetVal()));
                     fun->setMetadata("struct_name", metadata);
@@ -67,9 +233,10 @@ namespace marble {
                     }
                     llvm::FunctionType *retType = llvm::FunctionType::get(typeToLLVM(fds->GetRetType()), args, false);
                     std::string localKey = is->GetStructName() + "." + fds->GetName();
-                    std::string mangled = getCurrentMangled(localKey);
-                    llvm::Function *fun = llvm::Function::Create(retType, fds->IsStatic() ? llvm::GlobalValue::InternalLinkage : llvm::GlobalValue::ExternalLinkage,
-                                                                 mangled, *GetLLVMModule());
+                    const std::string &mangled = getCurrentMangled(localKey);
+                    llvm::Function *fun = llvm::Function::Create(retType, getFunctionLinkage(fds, mangled), mangled, *GetLLVMModule());
+                    fun->addFnAttr(llvm::Attribute::NoUnwind);
+                    applyFunAttrs(fun, fds);
                     
                     if (fds->GetRetType().GetTypeKind() == ASTTypeKind::Struct) {
                         llvm::MDNode *metadata = llvm::MDNode::get(_context, llvm::MDString::get(_context, fds->GetRetType().GetVal()));
@@ -84,7 +251,7 @@ namespace marble {
             else if (StructStmt *ss = llvm::dyn_cast<StructStmt>(stmt)) {
                 std::vector<llvm::Type *> fieldsTypes;
                 std::unordered_map<std::string, Field> fields;
-                std::string mangled = getCurrentMangled(ss->GetName());
+                const std::string &mangled = getCurrentMangled(ss->GetName());
                 llvm::StructType *structType = llvm::StructType::create(_context, mangled);
                 Struct s { .Name = ss->GetName(), .MangledName = mangled, .Type = structType, .Fields = fields, .TraitsImplements = {} };
                 _structs.emplace(mangled, s);
@@ -112,7 +279,7 @@ namespace marble {
                 structType->setBody(fieldsTypes);
             }
             else if (TraitDeclStmt *tds = llvm::dyn_cast<TraitDeclStmt>(stmt)) {
-                std::string mangled = getCurrentMangled(tds->GetName());
+                const std::string &mangled = getCurrentMangled(tds->GetName());
                 Trait t { .Name = tds->GetName(), .MangledName = mangled, .Methods = {} };
                 for (auto method : tds->GetBody()) {
                     if (FunDeclStmt *fds = llvm::dyn_cast<FunDeclStmt>(method)) {
@@ -126,17 +293,40 @@ namespace marble {
                 _traits.emplace(mangled, t);
             }
             else if (ModuleDeclStmt *mds = llvm::dyn_cast<ModuleDeclStmt>(stmt)) {
-                _modulesPath.push_back(mds->GetName());
+                pushModule(mds->GetName());
                 DeclareStatements(mds->GetBody());
-                _modulesPath.pop_back();
+                popModule();
             }
         }
     }
 
     void
-    CodeGen::DeclareRuntimeFunctions() {
-        llvm::FunctionType *printfType = llvm::FunctionType::get(llvm::Type::getInt32Ty(_context), { llvm::PointerType::get(_context, 0) }, true);
-        llvm::Function *printfFun = llvm::Function::Create(printfType, llvm::GlobalValue::ExternalLinkage, "printf", *GetLLVMModule());
+    CodeGen::declareRuntimeFunctions() {
+        // the output buffer of the runtime is inaccessible to Marble code, so echoing does not clobber the memory of the
+        // program, and a `@pure` function may fail a nil check with a message
+        llvm::FunctionType *echoStrType = llvm::FunctionType::get(_builder.getVoidTy(), { _builder.getPtrTy(), _builder.getInt64Ty() }, false);
+        llvm::Function *echoStrFun = llvm::Function::Create(echoStrType, llvm::GlobalValue::ExternalLinkage, "__marble_echo_str", *GetLLVMModule());
+        echoStrFun->setOnlyAccessesInaccessibleMemOrArgMem();
+        echoStrFun->addParamAttr(0, llvm::Attribute::ReadOnly);
+        echoStrFun->addParamAttr(0, llvm::Attribute::NoCapture);
+
+        llvm::FunctionType *echoCharType = llvm::FunctionType::get(_builder.getVoidTy(), { _builder.getInt8Ty() }, false);
+        llvm::Function::Create(echoCharType, llvm::GlobalValue::ExternalLinkage, "__marble_echo_char", *GetLLVMModule())->setOnlyAccessesInaccessibleMemory();
+
+        llvm::FunctionType *echoBoolType = llvm::FunctionType::get(_builder.getVoidTy(), { _builder.getInt1Ty() }, false);
+        llvm::Function::Create(echoBoolType, llvm::GlobalValue::ExternalLinkage, "__marble_echo_bool", *GetLLVMModule())->setOnlyAccessesInaccessibleMemory();
+
+        llvm::FunctionType *echoI64Type = llvm::FunctionType::get(_builder.getVoidTy(), { _builder.getInt64Ty() }, false);
+        llvm::Function::Create(echoI64Type, llvm::GlobalValue::ExternalLinkage, "__marble_echo_i64", *GetLLVMModule())->setOnlyAccessesInaccessibleMemory();
+
+        llvm::FunctionType *echoF64Type = llvm::FunctionType::get(_builder.getVoidTy(), { _builder.getDoubleTy() }, false);
+        llvm::Function::Create(echoF64Type, llvm::GlobalValue::ExternalLinkage, "__marble_echo_f64", *GetLLVMModule())->setOnlyAccessesInaccessibleMemory();
+
+        llvm::FunctionType *echoPtrType = llvm::FunctionType::get(_builder.getVoidTy(), { _builder.getPtrTy() }, false);
+        llvm::Function::Create(echoPtrType, llvm::GlobalValue::ExternalLinkage, "__marble_echo_ptr", *GetLLVMModule())->setOnlyAccessesInaccessibleMemory();
+
+        llvm::FunctionType *echoFlushType = llvm::FunctionType::get(_builder.getVoidTy(), false);
+        llvm::Function::Create(echoFlushType, llvm::GlobalValue::ExternalLinkage, "__marble_echo_flush", *GetLLVMModule())->setOnlyAccessesInaccessibleMemory();
 
         llvm::FunctionType *abortType = llvm::FunctionType::get(_builder.getVoidTy(), false);
         llvm::Function *abortFun = llvm::Function::Create(abortType, llvm::GlobalValue::ExternalLinkage, "abort", *GetLLVMModule());
@@ -146,6 +336,71 @@ namespace marble {
 
         llvm::FunctionType *freeType = llvm::FunctionType::get(_builder.getVoidTy(), { _builder.getPtrTy() }, false);
         llvm::Function *freeFun = llvm::Function::Create(freeType, llvm::GlobalValue::ExternalLinkage, "free", *GetLLVMModule());
+
+        // the attributes let LLVM treat the runtime allocator like `malloc`/`free` (e.g. remove unused allocations)
+        llvm::Function *allocFun = llvm::Function::Create(mallocType, llvm::GlobalValue::ExternalLinkage, "__marble_alloc", *GetLLVMModule());
+        allocFun->addFnAttr(llvm::Attribute::getWithAllocKind(_context, llvm::AllocFnKind::Alloc | llvm::AllocFnKind::Uninitialized));
+        allocFun->addFnAttr(llvm::Attribute::getWithAllocSizeArgs(_context, 0, std::nullopt));
+        allocFun->addFnAttr("alloc-family", "__marble_alloc");
+        allocFun->addFnAttr(llvm::Attribute::NoUnwind);
+        allocFun->addRetAttr(llvm::Attribute::NoAlias);
+
+        llvm::Function *slabFreeFun = llvm::Function::Create(freeType, llvm::GlobalValue::ExternalLinkage, "__marble_free", *GetLLVMModule());
+        slabFreeFun->addFnAttr(llvm::Attribute::getWithAllocKind(_context, llvm::AllocFnKind::Free));
+        slabFreeFun->addFnAttr("alloc-family", "__marble_alloc");
+        slabFreeFun->addFnAttr(llvm::Attribute::NoUnwind);
+        slabFreeFun->addParamAttr(0, llvm::Attribute::AllocatedPointer);
+
+        llvm::FunctionType *arenaCreateType = llvm::FunctionType::get(_builder.getPtrTy(), false);
+        llvm::Function::Create(arenaCreateType, llvm::GlobalValue::ExternalLinkage, "__marble_arena_create", *GetLLVMModule());
+
+        llvm::FunctionType *arenaAllocType = llvm::FunctionType::get(_builder.getPtrTy(), { _builder.getPtrTy(), _builder.getInt64Ty() }, false);
+        llvm::Function *arenaAllocFun = llvm::Function::Create(arenaAllocType, llvm::GlobalValue::ExternalLinkage, "__marble_arena_alloc", *GetLLVMModule());
+        arenaAllocFun->addFnAttr(llvm::Attribute::getWithAllocSizeArgs(_context, 1, std::nullopt));
+        arenaAllocFun->addFnAttr(llvm::Attribute::NoUnwind);
+        arenaAllocFun->addRetAttr(llvm::Attribute::NoAlias);
+
+        llvm::FunctionType *arenaDestroyType = llvm::FunctionType::get(_builder.getVoidTy(), { _builder.getPtrTy() }, false);
+        llvm::Function::Create(arenaDestroyType, llvm::GlobalValue::ExternalLinkage, "__marble_arena_destroy", *GetLLVMModule());
+
+        if (_opts.InstrumentFunctions) {
+            llvm::FunctionType *profRegisterType = llvm::FunctionType::get(_builder.getVoidTy(), { _builder.getPtrTy(), _builder.getInt32Ty(), _builder.getPtrTy() }, false);
+            llvm::Function::Create(profRegisterType, llvm::GlobalValue::ExternalLinkage, "__marble_prof_register", *GetLLVMModule());
+
+            // the counters are inaccessible to Marble code, so the hooks fit into `@pure` functions and keep the memory of the
+            // program intact around every call
+            llvm::FunctionType *profEnterType = llvm::FunctionType::get(_builder.getVoidTy(), { _builder.getInt32Ty() }, false);
+            llvm::Function::Create(profEnterType, llvm::GlobalValue::ExternalLinkage, "__marble_prof_enter", *GetLLVMModule())->setOnlyAccessesInaccessibleMemory();
+
+            llvm::FunctionType *profExitType = llvm::FunctionType::get(_builder.getVoidTy(), false);
+            llvm::Function::Create(profExitType, llvm::GlobalValue::ExternalLinkage, "__marble_prof_exit", *GetLLVMModule())->setOnlyAccessesInaccessibleMemory();
+
+            _unit->ProfBase = new llvm::GlobalVariable(*GetLLVMModule(), _builder.getInt32Ty(), false, llvm::GlobalValue::PrivateLinkage,
+                                                       _builder.getInt32(0), "__marble_prof_base");
+        }
+
+        if (_opts.TrackAllocs) {
+            llvm::FunctionType *trackRegisterType = llvm::FunctionType::get(_builder.getVoidTy(), { _builder.getPtrTy(), _builder.getInt32Ty(), _builder.getPtrTy(), _builder.getInt1Ty() }, false);
+            llvm::Function::Create(trackRegisterType, llvm::GlobalValue::ExternalLinkage, "__marble_track_register", *GetLLVMModule());
+
+            llvm::FunctionType *trackAllocType = llvm::FunctionType::get(_builder.getVoidTy(), { _builder.getPtrTy(), _builder.getInt64Ty(), _builder.getInt32Ty() }, false);
+            llvm::Function::Create(trackAllocType, llvm::GlobalValue::ExternalLinkage, "__marble_track_alloc", *GetLLVMModule());
+
+            llvm::FunctionType *trackFreeType = llvm::FunctionType::get(_builder.getVoidTy(), { _builder.getPtrTy(), _builder.getInt32Ty() }, false);
+            llvm::Function::Create(trackFreeType, llvm::GlobalValue::ExternalLinkage, "__marble_track_free", *GetLLVMModule());
+
+            llvm::FunctionType *trackArenaAllocType = llvm::FunctionType::get(_builder.getVoidTy(), { _builder.getInt64Ty(), _builder.getInt32Ty(), _builder.getInt32Ty() }, false);
+            llvm::Function::Create(trackArenaAllocType, llvm::GlobalValue::ExternalLinkage, "__marble_track_arena_alloc", *GetLLVMModule());
+
+            _unit->AllocSitesBase = new llvm::GlobalVariable(*GetLLVMModule(), _builder.getInt32Ty(), false, llvm::GlobalValue::PrivateLinkage,
+                                                             _builder.getInt32(0), "__marble_track_base");
+        }
+
+        abortFun->addFnAttr(llvm::Attribute::NoReturn);
+        // the runtime is written in C and never unwinds
+        for (llvm::Function &fun : *GetLLVMModule()) {
+            fun.addFnAttr(llvm::Attribute::NoUnwind);
+        }
     }
 
     void
@@ -154,22 +409,295 @@ namespace marble {
             return;
         }
 
+        if (mod == _module && _opts.PruneUnreachable) {
+            _reachable = Reachability().Analyze(mod);
+        }
+
         Module* oldMod = _currentMod;
+        Unit *oldUnit = _unit;
         _currentMod = mod;
+        if (!mod->GetFullPath().empty()) {
+            _unit = &getUnit(mod);
+        }
 
         for (auto &[_, importedMod] : mod->Imports) {
             GenerateBodies(importedMod);
         }
-        for (auto *stmt : mod->AST) {
-            Visit(stmt);
+        if (_unit->Library) {
+            generateGlobals(mod->AST);
+        }
+        else {
+            for (auto *stmt : mod->AST) {
+                Visit(stmt);
+            }
         }
         for (auto &[name, submod] : mod->SubModules) {
-            _modulesPath.push_back(name);
+            if (isInlineModule(mod, submod)) {
+                continue;
+            }
+            pushModule(name);
             GenerateBodies(submod);
-            _modulesPath.pop_back();
+            popModule();
         }
 
         _currentMod = oldMod;
+        _unit = oldUnit;
+    }
+
+    // Generates only the global variables of a precompiled library, so the other units can refer to them. They are
+    // replaced with the ones of its bitcode.
+    void
+    CodeGen::generateGlobals(const std::vector<Stmt *> &ast) {
+        for (Stmt *stmt : ast) {
+            if (llvm::isa<VarDeclStmt>(stmt)) {
+                Visit(stmt);
+            }
+            else if (ModuleDeclStmt *mds = llvm::dyn_cast<ModuleDeclStmt>(stmt)) {
+                pushModule(mds->GetName());
+                generateGlobals(mds->GetBody());
+                popModule();
+            }
+        }
+    }
+
+    void
+    CodeGen::Finalize() {
+        // the declarations of private functions are invalid without a body
+        for (llvm::Function *fun : _skippedFunctions) {
+            if (fun->use_empty()) {
+                _functions.erase(fun->getName().str());
+                fun->eraseFromParent();
+            }
+        }
+        _skippedFunctions.clear();
+        if (_opts.DebugInfo || _opts.TrackLocations) {
+            for (auto &[_, unit] : _debugUnits) {
+                unit.Builder->finalize();
+            }
+        }
+        Unit *oldUnit = _unit;
+        for (std::unique_ptr<Unit> &unit : _units) {
+            _unit = unit.get();
+            llvm::Module *mod = GetLLVMModule();
+            if (_opts.DebugInfo || _opts.TrackLocations) {
+                mod->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 5);
+                mod->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+            }
+            if (_opts.InstrumentFunctions && !_unit->ProfNames.empty()) {
+                llvm::ArrayType *namesType = llvm::ArrayType::get(_builder.getPtrTy(), _unit->ProfNames.size());
+                llvm::GlobalVariable *names = new llvm::GlobalVariable(*mod, namesType, true, llvm::GlobalValue::PrivateLinkage,
+                                                                       llvm::ConstantArray::get(namesType, _unit->ProfNames), "__marble_prof_names");
+                createRegistration("__marble_prof_register", { names, _builder.getInt32(_unit->ProfNames.size()), _unit->ProfBase });
+            }
+            if (_opts.TrackAllocs && !_unit->AllocSites.empty()) {
+                llvm::ArrayType *sitesType = llvm::ArrayType::get(_unit->AllocSites[0]->getType(), _unit->AllocSites.size());
+                llvm::GlobalVariable *sites = new llvm::GlobalVariable(*mod, sitesType, true, llvm::GlobalValue::PrivateLinkage,
+                                                                       llvm::ConstantArray::get(sitesType, _unit->AllocSites), "__marble_track_sites");
+                createRegistration("__marble_track_register", { sites, _builder.getInt32(_unit->AllocSites.size()), _unit->AllocSitesBase,
+                                                                 _builder.getInt1(_opts.ReportLeaks) });
+            }
+        }
+        for (std::unique_ptr<Unit> &unit : _units) {
+            localizeReferences(*unit);
+        }
+        std::unordered_map<Unit *, std::vector<llvm::GlobalValue *>> libraryDefs = collectLibraryDefinitions();
+        for (std::unique_ptr<Unit> &unit : _units) {
+            if (unit->Library) {
+                linkLibrary(*unit, libraryDefs[unit.get()]);
+            }
+        }
+        _unit = oldUnit;
+    }
+
+    // Finds the definitions which every precompiled library has to provide: the ones the other units use, and the ones
+    // of other libraries which those definitions use in turn. The bodies are read to find them until no more are needed,
+    // so the order of the libraries does not matter.
+    std::unordered_map<CodeGen::Unit *, std::vector<llvm::GlobalValue *>>
+    CodeGen::collectLibraryDefinitions() {
+        std::unordered_map<Unit *, std::vector<llvm::GlobalValue *>> defs;
+        std::unordered_map<const llvm::Module *, Unit *> libraries;
+        for (std::unique_ptr<Unit> &unit : _units) {
+            if (unit->Library) {
+                libraries.emplace(unit->Library.get(), unit.get());
+            }
+        }
+        llvm::SmallPtrSet<llvm::GlobalValue *, 32> reached;
+        std::vector<llvm::GlobalValue *> worklist;
+        // a declaration of `user` is defined by another library
+        auto need = [&](llvm::GlobalValue *decl, const Unit *user) {
+            for (auto &[lib, unit] : libraries) {
+                llvm::GlobalValue *def = unit != user ? unit->Library->getNamedValue(decl->getName()) : nullptr;
+                if (def && !def->isDeclaration() && reached.insert(def).second) {
+                    defs[unit].push_back(def);
+                    worklist.push_back(def);
+                }
+            }
+        };
+        for (std::unique_ptr<Unit> &unit : _units) {
+            for (llvm::GlobalValue &gv : unit->Mod->global_values()) {
+                if (gv.isDeclaration()) {
+                    need(&gv, unit.get());
+                }
+            }
+        }
+
+        llvm::SmallPtrSet<llvm::Constant *, 32> visited;
+        std::function<void(llvm::Value *, Unit *)> use = [&](llvm::Value *val, Unit *lib) {
+            if (llvm::GlobalValue *gv = llvm::dyn_cast<llvm::GlobalValue>(val)) {
+                if (gv->isDeclaration()) {
+                    need(gv, lib);
+                }
+                else if (reached.insert(gv).second) {
+                    worklist.push_back(gv);     // the linker takes it with the definitions which use it
+                }
+            }
+            else if (llvm::Constant *c = llvm::dyn_cast<llvm::Constant>(val); c && visited.insert(c).second) {
+                for (llvm::Value *op : c->operands()) {
+                    use(op, lib);
+                }
+            }
+        };
+        while (!worklist.empty()) {
+            llvm::GlobalValue *def = worklist.back();
+            worklist.pop_back();
+            Unit *lib = libraries.at(def->getParent());
+            if (llvm::Error err = def->materialize()) {
+                llvm::consumeError(std::move(err));     // reported by the linker
+                continue;
+            }
+            if (llvm::Function *fun = llvm::dyn_cast<llvm::Function>(def)) {
+                for (llvm::Instruction &inst : llvm::instructions(*fun)) {
+                    for (llvm::Value *op : inst.operands()) {
+                        use(op, lib);
+                    }
+                }
+            }
+            else if (llvm::GlobalVariable *var = llvm::dyn_cast<llvm::GlobalVariable>(def); var && var->hasInitializer()) {
+                use(var->getInitializer(), lib);
+            }
+        }
+        return defs;
+    }
+
+    // Replaces the module of a precompiled library with the definitions `defs` from its bitcode. The linker reads only
+    // their bodies and the ones of the functions they call.
+    void
+    CodeGen::linkLibrary(Unit &unit, const std::vector<llvm::GlobalValue *> &defs) {
+        llvm::Module *needed = new llvm::Module(unit.Mod->getName(), _context);
+        for (llvm::GlobalValue *def : defs) {
+            declareInModule(*needed, def);
+        }
+        if (llvm::Linker::linkModules(*needed, std::move(unit.Library), llvm::Linker::LinkOnlyNeeded)) {
+            llvm::errs() << llvm::errs().RED << "Could not link the precompiled library " << llvm::errs().RESET << '`'
+                         << unit.Mod->getName() << "`\n";
+        }
+        delete unit.Mod;
+        unit.Mod = needed;
+    }
+
+    // Replaces the uses of the functions and variables of other units in the instructions and initializers of `unit`
+    // with declarations of them
+    void
+    CodeGen::localizeReferences(Unit &unit) {
+        llvm::ValueToValueMapTy foreign;
+        llvm::SmallPtrSet<llvm::Constant *, 32> visited;
+        std::function<void(llvm::Value *)> collect = [&](llvm::Value *val) {
+            if (llvm::GlobalValue *gv = llvm::dyn_cast<llvm::GlobalValue>(val)) {
+                if (gv->getParent() != unit.Mod && !foreign.count(gv)) {
+                    foreign[gv] = declareInModule(*unit.Mod, gv);
+                }
+            }
+            else if (llvm::Constant *c = llvm::dyn_cast<llvm::Constant>(val); c && visited.insert(c).second) {
+                for (llvm::Value *op : c->operands()) {
+                    collect(op);
+                }
+            }
+        };
+        for (llvm::GlobalVariable &gv : unit.Mod->globals()) {
+            if (gv.hasInitializer()) {
+                collect(gv.getInitializer());
+            }
+        }
+        for (llvm::Function &fun : *unit.Mod) {
+            for (llvm::Instruction &inst : llvm::instructions(fun)) {
+                for (llvm::Value *op : inst.operands()) {
+                    collect(op);
+                }
+            }
+        }
+        if (foreign.empty()) {
+            return;
+        }
+
+        llvm::RemapFlags flags = llvm::RF_NoModuleLevelChanges | llvm::RF_IgnoreMissingLocals;
+        for (llvm::GlobalVariable &gv : unit.Mod->globals()) {
+            if (gv.hasInitializer()) {
+                gv.setInitializer(llvm::MapValue(gv.getInitializer(), foreign, flags));
+            }
+        }
+        for (llvm::Function &fun : *unit.Mod) {
+            for (llvm::Instruction &inst : llvm::instructions(fun)) {
+                llvm::RemapInstruction(&inst, foreign, flags);
+            }
+        }
+    }
+
+    llvm::GlobalValue *
+    CodeGen::declareInModule(llvm::Module &mod, llvm::GlobalValue *gv) {
+        if (gv->hasLocalLinkage()) {
+            // e.g. a private method in the vtable which another unit creates, it stays hidden outside of the program
+            if (mod.getNamedValue(gv->getName())) {
+                gv->setName(gv->getName() + ".promoted");
+            }
+            gv->setLinkage(llvm::GlobalValue::ExternalLinkage);
+            gv->setVisibility(llvm::GlobalValue::HiddenVisibility);
+        }
+        else if (llvm::GlobalValue *existing = mod.getNamedValue(gv->getName())) {
+            return existing;    // e.g. the runtime functions, which every unit declares
+        }
+
+        llvm::GlobalValue *decl;
+        if (llvm::Function *fun = llvm::dyn_cast<llvm::Function>(gv)) {
+            llvm::Function *funDecl = llvm::Function::Create(fun->getFunctionType(), llvm::GlobalValue::ExternalLinkage, fun->getName(), &mod);
+            funDecl->setAttributes(fun->getAttributes());
+            decl = funDecl;
+        }
+        else {
+            llvm::GlobalVariable *var = llvm::cast<llvm::GlobalVariable>(gv);
+            llvm::GlobalVariable *varDecl = new llvm::GlobalVariable(mod, var->getValueType(), var->isConstant(),
+                                                                     llvm::GlobalValue::ExternalLinkage, nullptr, var->getName());
+            varDecl->setAlignment(var->getAlign());
+            decl = varDecl;
+        }
+        decl->setVisibility(gv->getVisibility());
+        return decl;
+    }
+
+    void
+    CodeGen::createRegistration(llvm::StringRef registerFun, llvm::ArrayRef<llvm::Value *> args) {
+        // the tables are registered before `main` runs, the runtime gives the module its range of ids. Like the tables, the
+        // constructor is private, so it stays private in a library and every unit has its own one.
+        llvm::Module *mod = GetLLVMModule();
+        llvm::Function *ctor = llvm::Function::Create(llvm::FunctionType::get(_builder.getVoidTy(), false),
+                                                      llvm::GlobalValue::PrivateLinkage, registerFun + ".ctor", *mod);
+        ctor->addFnAttr(llvm::Attribute::NoUnwind);
+        _builder.SetInsertPoint(llvm::BasicBlock::Create(_context, "entry", ctor));
+        _builder.CreateCall(mod->getFunction(registerFun), args);
+        _builder.CreateRetVoid();
+        llvm::appendToGlobalCtors(*mod, ctor, 0);
+    }
+
+    llvm::Value *
+    CodeGen::createAllocSite(const std::string &type, llvm::SMLoc loc, AllocSiteKind kind) {
+        auto [line, col] = _srcMgr.getLineAndColumn(loc);
+        unsigned bufferID = _srcMgr.FindBufferContainingLoc(loc);
+        std::string location = llvm::sys::path::filename(_srcMgr.getMemoryBuffer(bufferID ? bufferID : _srcMgr.getMainFileID())->getBufferIdentifier()).str() +
+                               ":" + std::to_string(line) + ":" + std::to_string(col);
+        std::string typeName = type;
+        std::replace(typeName.begin(), typeName.end(), '#', '.');
+        // mirrors `MarbleAllocSite` of the runtime
+        _unit->AllocSites.push_back(llvm::ConstantStruct::getAnon({ getOrCreateString(typeName), getOrCreateString(location), _builder.getInt32(kind) }));
+        return _builder.CreateAdd(_builder.CreateLoad(_builder.getInt32Ty(), _unit->AllocSitesBase), _builder.getInt32(_unit->AllocSites.size() - 1));
     }
 
     llvm::Value *
@@ -207,7 +735,7 @@ namespace marble {
         }
         llvm::Value *var;
         if (_vars.size() == 1) {
-            std::string mangled = getCurrentMangled(vds->GetName());
+            const std::string &mangled = getCurrentMangled(vds->GetName());
             var = new llvm::GlobalVariable(*GetLLVMModule(), type, vds->IsConst(), vds->IsStatic() ? llvm::GlobalValue::InternalLinkage :
                                                                                                      llvm::GlobalValue::ExternalLinkage,
                                            llvm::cast<llvm::Constant>(initializer), mangled);
@@ -219,8 +747,12 @@ namespace marble {
                                                parent->getName() + "." + vds->GetName());
             }
             else {
-                var = _builder.CreateAlloca(type, nullptr, vds->GetName());
+                var = createEntryAlloca(type, vds->GetName());
+                if (_opts.LifetimeMarkers && _vars.size() > 2) {
+                    _builder.CreateLifetimeStart(var);
+                }
                 _builder.CreateStore(initializer, var);
+                declareDebugVar(var, vds->GetName(), vds->GetType(), vds->GetStartLoc(), 0, true);
             }
         }
         if (vds->GetType().GetTypeKind() == ASTTypeKind::Struct ||
@@ -233,83 +765,92 @@ namespace marble {
                 llvm::cast<llvm::AllocaInst>(var)->setMetadata("struct_name", metadata);
             }
         }
-        _vars.top().emplace(vds->GetName(), std::make_tuple(var, type, vds->GetType()));
+        _vars.back().emplace(vds->GetName(), std::make_tuple(var, type, vds->GetType()));
+        if (vds->GetSlot() >= 0) {
+            _locals[vds->GetSlot()] = std::make_tuple(var, type, vds->GetType());
+        }
         return nullptr;
     }
 
     llvm::Value *
     CodeGen::VisitVarAsgnStmt(VarAsgnStmt *vas) {
         llvm::Value *val = Visit(vas->GetExpr());
-        auto varsCopy = _vars;
-        while (!varsCopy.empty()) {
-            if (auto var = varsCopy.top().find(vas->GetName()); var != varsCopy.top().end()) {
-                auto &[varVal, llvmType, type] = var->second;
-                if (auto arg = llvm::dyn_cast<llvm::Argument>(varVal)) {
-                    if (arg->getType()->isPointerTy()) {
-                        _builder.CreateStore(val, arg);
-                        return nullptr;
-                    }
-                    llvm::AllocaInst *alloca = _builder.CreateAlloca(arg->getType(), nullptr, arg->getName());
-                    _builder.CreateStore(val, alloca);
-                    return nullptr;
-                }
-
-                llvm::Value *targetAddr = varVal;
-                ASTType currentASTType = type;
-                if (vas->GetDerefDepth() > 0) {
-                    if (llvm::isa<llvm::AllocaInst>(targetAddr) || llvm::isa<llvm::GlobalVariable>(targetAddr)) {
-                        targetAddr = _builder.CreateLoad(llvmType, targetAddr, vas->GetName() + ".addr");
-                    }
-                }
-                for (unsigned char dd = vas->GetDerefDepth(); dd > 1; --dd) {
-                    createCheckForNil(targetAddr, vas->GetStartLoc());
-                    targetAddr = _builder.CreateLoad(_builder.getPtrTy(), targetAddr, "deref");
-                    currentASTType = currentASTType.Deref();
-                }
-                if (vas->GetDerefDepth() > 0) {
-                    createCheckForNil(targetAddr, vas->GetStartLoc());
-                }
-                for (unsigned char dd = vas->GetDerefDepth(); dd > 0; --dd, type.Deref());
-
-                if (type.GetTypeKind() == ASTTypeKind::Trait) {
-                    std::string concreteStructName = resolveStructName(vas->GetExpr());
-                    llvm::Type *traitLLVMTy = llvmType;
-                    val = castToTrait(val, traitLLVMTy, concreteStructName);
-                }
-                
-                ASTType finalType = type;
-                val = implicitlyCast(val, typeToLLVM(finalType));
-                _builder.CreateStore(val, targetAddr);
+        VarInfo *var = findVar(vas->GetName(), vas->GetSlot());
+        if (!var) {
+            return nullptr;
+        }
+        auto [varVal, llvmType, type] = *var;
+        if (auto arg = llvm::dyn_cast<llvm::Argument>(varVal)) {
+            if (arg->getType()->isPointerTy()) {
+                _builder.CreateStore(val, arg);
                 return nullptr;
             }
-            varsCopy.pop();
+            llvm::AllocaInst *alloca = createEntryAlloca(arg->getType(), arg->getName());
+            _builder.CreateStore(val, alloca);
+            return nullptr;
+        }
+
+        llvm::Value *targetAddr = varVal;
+        ASTType currentASTType = type;
+        if (vas->GetDerefDepth() > 0) {
+            if (llvm::isa<llvm::AllocaInst>(targetAddr) || llvm::isa<llvm::GlobalVariable>(targetAddr)) {
+                targetAddr = _builder.CreateLoad(llvmType, targetAddr, vas->GetName() + ".addr");
+            }
+        }
+        for (unsigned char dd = vas->GetDerefDepth(); dd > 1; --dd) {
+            createCheckForNil(targetAddr, vas->GetStartLoc());
+            targetAddr = _builder.CreateLoad(_builder.getPtrTy(), targetAddr, "deref");
+            currentASTType = currentASTType.Deref();
+        }
+        if (vas->GetDerefDepth() > 0) {
+            createCheckForNil(targetAddr, vas->GetStartLoc());
         }
+        for (unsigned char dd = vas->GetDerefDepth(); dd > 0; --dd, type.Deref());
+
+        if (type.GetTypeKind() == ASTTypeKind::Trait) {
+            std::string concreteStructName = resolveStructName(vas->GetExpr());
+            llvm::Type *traitLLVMTy = llvmType;
+            val = castToTrait(val, traitLLVMTy, concreteStructName);
+        }
+        
+        ASTType finalType = type;
+        val = implicitlyCast(val, typeToLLVM(finalType));
+        _builder.CreateStore(val, targetAddr);
         return nullptr;
     }
 
     llvm::Value *
     CodeGen::VisitFunDeclStmt(FunDeclStmt *fds) {
         llvm::Function *fun = getFunction(fds->GetName());
-        llvm::BasicBlock *entry = llvm::BasicBlock::Create(_context, "entry", fun);
-        _builder.SetInsertPoint(entry);
-        _vars.push({});
+        if (!shouldGenerate(fds, fun)) {
+            return nullptr;
+        }
+        beginFunctionBody(fun);
+        beginDebugFunction(fun, fds, fds->GetName(), std::nullopt);
+        _vars.emplace_back();
+        _locals.assign(fds->GetNumSlots(), VarInfo());
         _funRetsTypes.push(fun->getReturnType());
         int index = 0;
         for (auto &arg : fun->args()) {
             arg.setName(fds->GetArgs()[index].GetName());
-            llvm::AllocaInst *alloca = _builder.CreateAlloca(arg.getType(), nullptr, arg.getName() + ".addr");
+            llvm::AllocaInst *alloca = createEntryAlloca(arg.getType(), arg.getName() + ".addr");
             _builder.CreateStore(&arg, alloca);
-            _vars.top().emplace(arg.getName(), std::make_tuple(alloca, arg.getType(), fds->GetArgs()[index].GetType()));
+            declareDebugVar(alloca, fds->GetArgs()[index].GetName(), fds->GetArgs()[index].GetType(), fds->GetStartLoc(), index + 1, true);
+            _locals[index] = std::make_tuple(alloca, arg.getType(), fds->GetArgs()[index].GetType());
+            _vars.back().emplace(arg.getName(), _locals[index]);
             ++index;
         }
-        for (auto &stmt : fds->GetBody()) {
-            Visit(stmt);
-        }
+        collectStackAllocs(fds, false);
+        generateBlock(fds->GetBody());
         if (fds->GetRetType().GetTypeKind() == ASTTypeKind::Noth) {
-            _builder.CreateRetVoid();
+            createRetVoid();
+        }
+        endFunctionBody();
+        if (fds->HasAttr(FunAttrFlatten)) {
+            flattenCalls(fun);
         }
         _funRetsTypes.pop();
-        _vars.pop();
+        _vars.pop_back();
         return nullptr;
     }
 
@@ -324,15 +865,31 @@ namespace marble {
     llvm::Value *
     CodeGen::VisitRetStmt(RetStmt *rs) {
         if (rs->GetExpr()) {
-            llvm::Value *val = Visit(rs->GetExpr());
-            return _builder.CreateRet(implicitlyCast(val, _funRetsTypes.top()));
-        }
-        return _builder.CreateRetVoid();
+            llvm::Value *val = implicitlyCast(Visit(rs->GetExpr()), _funRetsTypes.top());
+            endLifetimes(2);    // the variables of the nested blocks, the ones of the function body have no markers
+            destroyArenas(0);
+            return _builder.CreateRet(val);
+        }
+        endLifetimes(2);
+        destroyArenas(0);
+        return createRetVoid();
     }
 
     llvm::Value *
     CodeGen::VisitIfElseStmt(IfElseStmt *ies) {
         llvm::Function *parent = _builder.GetInsertBlock()->getParent();
+        std::optional<ASTVal> constCond = ies->GetCondition()->GetConstVal();
+        if (constCond && constCond->GetType().GetTypeKind() == ASTTypeKind::Bool) {
+            // only the branch which is taken is generated
+            _vars.emplace_back();
+            generateBlock(constCond->GetData().boolVal ? ies->GetThenBody() : ies->GetElseBody());
+            endLifetimes();
+            _vars.pop_back();
+            if (_builder.GetInsertBlock()->getTerminator()) {
+                _builder.SetInsertPoint(llvm::BasicBlock::Create(_context, "merge", parent));
+            }
+            return nullptr;
+        }
         llvm::Value *cond = Visit(ies->GetCondition());
         llvm::BasicBlock *thenBB = llvm::BasicBlock::Create(_context, "then", parent);
         llvm::BasicBlock *elseBB = llvm::BasicBlock::Create(_context, "else", parent);
@@ -340,21 +897,19 @@ namespace marble {
         _builder.CreateCondBr(cond, thenBB, elseBB);
 
         _builder.SetInsertPoint(thenBB);
-        _vars.push({});
-        for (auto &stmt : ies->GetThenBody()) {
-            Visit(stmt);
-        }
-        _vars.pop();
+        _vars.emplace_back();
+        generateBlock(ies->GetThenBody());
+        endLifetimes();
+        _vars.pop_back();
         if (!_builder.GetInsertBlock()->getTerminator()) {
             _builder.CreateBr(mergeBB);
         }
 
         _builder.SetInsertPoint(elseBB);
-        _vars.push({});
-        for (auto &stmt : ies->GetElseBody()) {
-            Visit(stmt);
-        }
-        _vars.pop();
+        _vars.emplace_back();
+        generateBlock(ies->GetElseBody());
+        endLifetimes();
+        _vars.pop_back();
         if (!_builder.GetInsertBlock()->getTerminator()) {
             _builder.CreateBr(mergeBB);
         }
@@ -374,7 +929,7 @@ namespace marble {
 
         _builder.CreateBr(indexatorBB);
         _builder.SetInsertPoint(indexatorBB);
-        _vars.push({});
+        _vars.emplace_back();
         if (fls->GetIndexator()) {
             Visit(fls->GetIndexator());
         }
@@ -386,31 +941,41 @@ namespace marble {
         _builder.CreateCondBr(cond, bodyBB, exitBB);
         _builder.SetInsertPoint(bodyBB);
         _loopDeth.push({ exitBB, iterationBB });
-        for (auto &stmt : fls->GetBody()) {
-            Visit(stmt);
-        }
+        _vars.emplace_back();
+        _loopScopes.push(_vars.size() - 1);
+        generateBlock(fls->GetBody());
+        endLifetimes();
+        _vars.pop_back();
+        _loopScopes.pop();
         _loopDeth.pop();
 
-        _builder.CreateBr(iterationBB);
+        if (!_builder.GetInsertBlock()->getTerminator()) {
+            _builder.CreateBr(iterationBB);
+        }
         _builder.SetInsertPoint(iterationBB);
         if (fls->GetIteration()) {
             Visit(fls->GetIteration());
         }
-        _vars.pop();
 
         _builder.CreateBr(condBB);
         _builder.SetInsertPoint(exitBB);
+        endLifetimes();
+        _vars.pop_back();
         return nullptr;
     }
 
     llvm::Value *
     CodeGen::VisitBreakStmt(BreakStmt *bs) {
+        endLifetimes(_loopScopes.top());
+        destroyArenas(_loopDeth.size());
         _builder.CreateBr(_loopDeth.top().first);
         return nullptr;
     }
 
     llvm::Value *
     CodeGen::VisitContinueStmt(ContinueStmt *cs) {
+        endLifetimes(_loopScopes.top());
+        destroyArenas(_loopDeth.size());
         _builder.CreateBr(_loopDeth.top().second);
         return nullptr;
     }
@@ -424,7 +989,7 @@ namespace marble {
     CodeGen::VisitFieldAsgnStmt(FieldAsgnStmt *fas) {
         if (fas->IsStaticAccessing()) {
             std::string name = getMangledForPath(fas->GetObjType().GetVal()) + "." + fas->GetName();
-            llvm::GlobalVariable *gv = GetLLVMModule()->getNamedGlobal(name);
+            llvm::GlobalVariable *gv = findGlobal(name);
 
             llvm::Value *val = Visit(fas->GetExpr());
             val = implicitlyCast(val, gv->getValueType());
@@ -439,8 +1004,8 @@ namespace marble {
 
         ASTType objType = fas->GetObjType();
         if (objType.GetTypeKind() == ASTTypeKind::Mod) {
-            std::string mangled = getCurrentMangled(fas->GetName());
-            llvm::GlobalVariable *gv = GetLLVMModule()->getGlobalVariable(mangled);
+            const std::string &mangled = getCurrentMangled(fas->GetName());
+            llvm::GlobalVariable *gv = findGlobal(mangled);
 
             if (!gv) {
                 return nullptr;
@@ -461,51 +1026,69 @@ namespace marble {
         }
         else if (objType.GetTypeKind() == ASTTypeKind::Struct) {
             if (!obj->getType()->isPointerTy()) {
-                llvm::AllocaInst *tmp = _builder.CreateAlloca(obj->getType());
+                llvm::AllocaInst *tmp = createEntryAlloca(obj->getType());
                 _builder.CreateStore(obj, tmp);
                 obj = tmp;
             }
         }
 
-        Struct s = _structs.at(resolveFullTypeName(fas->GetObjType()));
-        Field field = s.Fields.at(fas->GetName());
-        llvm::Value *gep = _builder.CreateStructGEP(s.Type, obj, field.Index);
+        llvm::StructType *structType = _structs.at(resolveFullTypeName(fas->GetObjType())).Type;
+        llvm::Value *gep = _builder.CreateStructGEP(structType, obj, fas->GetFieldIndex());
         llvm::Value *val = Visit(fas->GetExpr());
-        val = implicitlyCast(val, field.Type);
+        val = implicitlyCast(val, structType->getElementType(fas->GetFieldIndex()));
         _builder.CreateStore(val, gep);
         return nullptr;
     }
 
     llvm::Value *
     CodeGen::VisitImplStmt(ImplStmt *is) {
-        Struct s = _structs.at(getCurrentMangled(is->GetStructName()));
+        const Struct &s = _structs.at(getCurrentMangled(is->GetStructName()));
         for (auto &stmt : is->GetBody()) {
             FunDeclStmt *method = llvm::cast<FunDeclStmt>(stmt);
             llvm::Function *fun = getFunction(s.Name + "." + method->GetName());
-            llvm::BasicBlock *entry = llvm::BasicBlock::Create(_context, "entry", fun);
-            _builder.SetInsertPoint(entry);
-            _vars.push({});
-            _funRetsTypes.push(fun->getReturnType());
+            if (!shouldGenerate(method, fun)) {
+                continue;
+            }
+            beginFunctionBody(fun);
             ASTType thisType = ASTType(ASTTypeKind::Struct, getCurrentMangled(is->GetStructName()), false, 0);
+            beginDebugFunction(fun, method, s.Name + "." + method->GetName(),
+                               method->IsStatic() ? std::nullopt : std::optional<ASTType>(ASTType(thisType).Ref()));
+            _vars.emplace_back();
+            _locals.assign(method->GetNumSlots(), VarInfo());
+            _funRetsTypes.push(fun->getReturnType());
             int index = 0;
             for (auto &arg : fun->args()) {
+                ASTType argType;
                 if (!method->IsStatic()) {
                     arg.setName(index == 0 ? "this" : method->GetArgs()[index - 1].GetName());
+                    argType = index == 0 ? ASTType(thisType).Ref() : method->GetArgs()[index - 1].GetType();
                 }
                 else {
                     arg.setName(method->GetArgs()[index].GetName());
+                    argType = method->GetArgs()[index].GetType();
                 }
-                _vars.top().emplace(arg.getName(), std::make_tuple(&arg, arg.getType(), index > 0 ? method->GetArgs()[index - 1].GetType() : thisType));
+                _locals[index] = std::make_tuple(&arg, arg.getType(), index > 0 ? method->GetArgs()[index - 1].GetType() : thisType);
+                _vars.back().emplace(arg.getName(), _locals[index]);
+                declareDebugVar(&arg, arg.getName().str(), argType, method->GetStartLoc(), index + 1, false);
                 ++index;
             }
-            for (auto &stmt : method->GetBody()) {
-                Visit(stmt);
+            if (!method->IsStatic()) {
+                // `this` always points to an object: method calls through pointers and trait objects check them for nil first
+                fun->addParamAttr(0, llvm::Attribute::NonNull);
+                fun->addParamAttr(0, llvm::Attribute::NoUndef);
+                fun->addDereferenceableParamAttr(0, GetLLVMModule()->getDataLayout().getTypeAllocSize(s.Type));
             }
+            collectStackAllocs(method, !method->IsStatic());
+            generateBlock(method->GetBody());
             if (method->GetRetType().GetTypeKind() == ASTTypeKind::Noth) {
                 _builder.CreateRetVoid();
             }
+            endFunctionBody();
+            if (method->HasAttr(FunAttrFlatten)) {
+                flattenCalls(fun);
+            }
             _funRetsTypes.pop();
-            _vars.pop();
+            _vars.pop_back();
         }
         return nullptr;
     }
@@ -527,49 +1110,35 @@ namespace marble {
 
     llvm::Value *
     CodeGen::VisitEchoStmt(EchoStmt *es) {
-        std::string format;
+        if (auto text = getConstantEchoText(es->GetRHS())) {
+            createEchoStr(*text);
+            return nullptr;
+        }
         llvm::Value *val = Visit(es->GetRHS());
         llvm::Type *type = val->getType();
         if (type->isIntegerTy()) {
-            unsigned bitWidth = type->getIntegerBitWidth();
-
-            switch (bitWidth) {
-                case 1: {
-                    llvm::Constant *trueStr = _builder.CreateGlobalStringPtr("true\n", "str.true");
-                    llvm::Constant *falseStr = _builder.CreateGlobalStringPtr("false\n", "str.false");
-
-                    llvm::Value *selectedStr = _builder.CreateSelect(val, trueStr, falseStr, "bool.str");
-
-                    llvm::Constant *fmtStr = _builder.CreateGlobalStringPtr("%s", "printf.format");
-
-                    _builder.CreateCall(GetLLVMModule()->getFunction("printf"), { fmtStr, selectedStr });
-                    return nullptr;
-                }
-                case 8:
-                    format = "%c";
-                    break;
-                case 32:
-                    format = "%d";
+            switch (type->getIntegerBitWidth()) {
+                case 1:
+                    _builder.CreateCall(GetLLVMModule()->getFunction("__marble_echo_bool"), { val });
                     break;
-                case 64:
-                    format = "%lld";
+                case 8:
+                    _builder.CreateCall(GetLLVMModule()->getFunction("__marble_echo_char"), { val });
                     break;
                 default:
-                    val = implicitlyCast(val, _builder.getInt64Ty());
-                    format = "%lld";
+                    val = _builder.CreateSExtOrTrunc(val, _builder.getInt64Ty());
+                    _builder.CreateCall(GetLLVMModule()->getFunction("__marble_echo_i64"), { val });
                     break;
             }
         }
         else if (type->isFloatingPointTy()) {
-            format = "%g";
             if (type->isFloatTy()) {
-                val = _builder.CreateFPExt(val, llvm::Type::getDoubleTy(_context));
+                val = _builder.CreateFPExt(val, _builder.getDoubleTy());
             }
+            _builder.CreateCall(GetLLVMModule()->getFunction("__marble_echo_f64"), { val });
         }
         else if (type->isPointerTy()) {
-            format = "%p";
+            _builder.CreateCall(GetLLVMModule()->getFunction("__marble_echo_ptr"), { val });
         }
-        _builder.CreateCall(GetLLVMModule()->getFunction("printf"), { _builder.CreateGlobalString(format, "printf.format"), val });
         return nullptr;
     }
 
@@ -579,7 +1148,14 @@ namespace marble {
         createLoad = false;
         llvm::Value *ptr = Visit(ds->GetExpr());
         createLoad = oldLoad;
-        _builder.CreateCall(GetLLVMModule()->getFunction("free"), { _builder.CreateLoad(_builder.getPtrTy(), ptr) });
+        if (!_stackDels.count(ds)) {
+            llvm::Function *freeFun = GetLLVMModule()->getFunction(_opts.Allocator == CodeGenOptions::Slab ? "__marble_free" : "free");
+            llvm::Value *obj = _builder.CreateLoad(_builder.getPtrTy(), ptr);
+            if (_opts.TrackAllocs) {
+                _builder.CreateCall(GetLLVMModule()->getFunction("__marble_track_free"), { obj, createAllocSite("", ds->GetStartLoc(), SiteDel) });
+            }
+            _builder.CreateCall(freeFun, { obj });
+        }
         _builder.CreateStore(llvm::ConstantPointerNull::get(llvm::PointerType::get(_context, 0)), ptr);
         return nullptr;
     }
@@ -591,16 +1167,35 @@ namespace marble {
 
     llvm::Value *
     CodeGen::VisitModuleDeclStmt(ModuleDeclStmt *mds) {
-        _modulesPath.push_back(mds->GetName());
+        pushModule(mds->GetName());
         for (auto *stmt : mds->GetBody()) {
             Visit(stmt);
         }
-        _modulesPath.pop_back();
+        popModule();
+        return nullptr;
+    }
+
+    llvm::Value *
+    CodeGen::VisitArenaStmt(ArenaStmt *as) {
+        llvm::Value *arena = _builder.CreateCall(GetLLVMModule()->getFunction("__marble_arena_create"), {}, "arena");
+        llvm::Value *site = _opts.TrackAllocs ? createAllocSite("", as->GetStartLoc(), SiteArena) : nullptr;
+        _arenas.push_back(ActiveArena { .Handle = arena, .LoopDepth = _loopDeth.size(), .Site = site });
+        _vars.emplace_back();
+        generateBlock(as->GetBody());
+        endLifetimes();
+        _vars.pop_back();
+        _arenas.pop_back();
+        if (!_builder.GetInsertBlock()->getTerminator()) {
+            _builder.CreateCall(GetLLVMModule()->getFunction("__marble_arena_destroy"), { arena });
+        }
         return nullptr;
     }
 
     llvm::Value *
     CodeGen::VisitBinaryExpr(BinaryExpr *be) {
+        if (be->GetConstVal()) {
+            return getConstant(*be->GetConstVal());
+        }
         llvm::Value *lhs = Visit(be->GetLHS());
         llvm::Value *rhs = Visit(be->GetRHS());
         llvm::Type *lhsType = lhs->getType();
@@ -718,6 +1313,9 @@ namespace marble {
     
     llvm::Value *
     CodeGen::VisitUnaryExpr(UnaryExpr *ue) {
+        if (ue->GetConstVal()) {
+            return getConstant(*ue->GetConstVal());
+        }
         llvm::Value *rhs = Visit(ue->GetRHS());
         switch (ue->GetOp().GetKind()) {
             case TkMinus:
@@ -736,8 +1334,8 @@ namespace marble {
     CodeGen::VisitVarExpr(VarExpr *ve) {
         if (ve->GetName() == "self" || ve->GetName() == "parent") {
             if (_currentMod && _currentMod->Variables.count(ve->GetName())) {
-                std::string mangled = getCurrentMangled(ve->GetName());
-                if (auto *gv = GetLLVMModule()->getGlobalVariable(mangled)) {
+                const std::string &mangled = getCurrentMangled(ve->GetName());
+                if (auto *gv = findGlobal(mangled)) {
                     if (createLoad) {
                         return _builder.CreateLoad(gv->getValueType(), gv, ve->GetName() + ".load");
                     }
@@ -746,62 +1344,44 @@ namespace marble {
             }
         }
         
-        auto varsCopy = _vars;
-        while (!varsCopy.empty()) {
-            if (auto var = varsCopy.top().find(ve->GetName()); var != varsCopy.top().end()) {
-                auto &[varVal, llvmType, type] = var->second;
-                if (createLoad) {
-                    if (auto glob = llvm::dyn_cast<llvm::GlobalVariable>(varVal)) {
-                        if (_vars.size() == 1) {
-                            return glob->getInitializer();
-                        }
-                        return _builder.CreateLoad(glob->getValueType(), glob, var->first + ".load");
-                    }
-                    if (auto local = llvm::dyn_cast<llvm::AllocaInst>(varVal)) {
-                        return _builder.CreateLoad(local->getAllocatedType(), local, var->first + ".load");
-                    }
-                    if (auto arg = llvm::dyn_cast<llvm::Argument>(varVal)) {
-                        if (arg->getName() == "this") {
-                            std::string structName = resolveStructName(ve);
-                            return _builder.CreateLoad(_structs.at(structName).Type, arg, var->first + ".load");
-                        }
-                    }
+        if (createLoad && ve->GetConstVal()) {
+            return getConstant(*ve->GetConstVal());
+        }
+        VarInfo *var = findVar(ve->GetName(), ve->GetSlot());
+        if (!var) {
+            return nullptr;
+        }
+        llvm::Value *varVal = std::get<0>(*var);
+        if (createLoad) {
+            if (auto glob = llvm::dyn_cast<llvm::GlobalVariable>(varVal)) {
+                if (_vars.size() == 1) {
+                    return glob->getInitializer();
+                }
+                return _builder.CreateLoad(glob->getValueType(), glob, ve->GetName() + ".load");
+            }
+            if (auto local = llvm::dyn_cast<llvm::AllocaInst>(varVal)) {
+                return _builder.CreateLoad(local->getAllocatedType(), local, ve->GetName() + ".load");
+            }
+            if (auto arg = llvm::dyn_cast<llvm::Argument>(varVal)) {
+                if (arg->getName() == "this") {
+                    std::string structName = resolveStructName(ve);
+                    return _builder.CreateLoad(_structs.at(structName).Type, arg, ve->GetName() + ".load");
                 }
-                return varVal;
             }
-            varsCopy.pop();
         }
-        return nullptr;
+        return varVal;
     }
     
     llvm::Value *
     CodeGen::VisitLiteralExpr(LiteralExpr *le) {
-        switch (le->GetVal().GetType().GetTypeKind()) {
-            #define CONST_INT(func, field) llvm::ConstantInt::get(llvm::Type::func(_context), le->GetVal().GetData().field)
-            #define CONST_FP(func, field) llvm::ConstantFP::get(llvm::Type::func(_context), le->GetVal().GetData().field)
-            case ASTTypeKind::Bool:
-                return CONST_INT(getInt1Ty, boolVal);
-            case ASTTypeKind::Char:
-                return CONST_INT(getInt8Ty, charVal);
-            case ASTTypeKind::I16:
-                return CONST_INT(getInt16Ty, i16Val);
-            case ASTTypeKind::I32:
-                return CONST_INT(getInt32Ty, i32Val);
-            case ASTTypeKind::I64:
-                return CONST_INT(getInt64Ty, i64Val);
-            case ASTTypeKind::F32:
-                return CONST_FP(getFloatTy, f32Val);
-            case ASTTypeKind::F64:
-                return CONST_FP(getDoubleTy, f64Val);
-            default: {}
-            #undef CONST_FP
-            #undef CONST_INT
-        }
-        return nullptr;
+        return getConstant(le->GetVal());
     }
 
     llvm::Value *
     CodeGen::VisitFunCallExpr(FunCallExpr *fce) {
+        if (fce->GetConstVal()) {   // `const fun` evaluated by Sema
+            return getConstant(*fce->GetConstVal());
+        }
         llvm::Function *fun = getFunction(fce->GetName());
         std::vector<llvm::Value *> args(fce->GetArgs().size());
         for (int i = 0; i < fce->GetArgs().size(); ++i) {
@@ -820,7 +1400,7 @@ namespace marble {
                 llvm::Value *fatPtr = llvm::UndefValue::get(expectedType);
 
                 if (!val->getType()->isPointerTy()) {
-                    llvm::AllocaInst *tmp = _builder.CreateAlloca(val->getType());
+                    llvm::AllocaInst *tmp = createEntryAlloca(val->getType());
                     _builder.CreateStore(val, tmp);
                     val = tmp;
                 }
@@ -842,19 +1422,20 @@ namespace marble {
 
     llvm::Value *
     CodeGen::VisitStructExpr(StructExpr *se) {
-        Struct s = _structs.at(resolveFullTypeName(ASTType(ASTTypeKind::Struct, se->GetName(), false, 0)));
+        const Struct &s = _structs.at(resolveFullTypeName(ASTType(ASTTypeKind::Struct, se->GetName(), false, 0)));
+        std::vector<bool> initialized(s.Type->getNumElements());
         if (_vars.size() != 1) {
-            llvm::AllocaInst *alloca = _builder.CreateAlloca(s.Type, nullptr, s.Name + ".alloca");
+            llvm::AllocaInst *alloca = createEntryAlloca(s.Type, s.Name + ".alloca");
             for (int i = 0; i < se->GetInitializer().size(); ++i) {
-                std::string name = se->GetInitializer()[i].first;
-                llvm::Value *fieldPtr = _builder.CreateStructGEP(s.Type, alloca, s.Fields.at(name).Index, name + ".gep");
+                const Field &field = s.Fields.at(se->GetInitializer()[i].first);
+                llvm::Value *fieldPtr = _builder.CreateStructGEP(s.Type, alloca, field.Index, field.Name + ".gep");
                 llvm::Value *val = Visit(se->GetInitializer()[i].second);
-                val = implicitlyCast(val, s.Fields.at(se->GetInitializer()[i].first).Type);
+                val = implicitlyCast(val, field.Type);
                 _builder.CreateStore(val, fieldPtr);
-                s.Fields.at(name).ManualInitialized = true;
+                initialized[field.Index] = true;
             }
             for (auto &field : s.Fields) {
-                if (!field.second.ManualInitialized) {
+                if (!initialized[field.second.Index]) {
                     llvm::Value *fieldPtr = _builder.CreateStructGEP(s.Type, alloca, field.second.Index, field.second.Name + ".gep");
                     llvm::Value *val;
                     if (field.second.ASTType.GetTypeKind() == ASTTypeKind::Struct) {
@@ -874,20 +1455,21 @@ namespace marble {
             return _builder.CreateLoad(s.Type, alloca, s.Name + ".alloca.load");
         }
         else {
-            std::vector<llvm::Constant *> fields;
+            std::vector<llvm::Constant *> fields(s.Type->getNumElements());
             for (int i = 0; i < se->GetInitializer().size(); ++i) {
-                std::string name = se->GetInitializer()[i].first;
-                fields.push_back(llvm::dyn_cast<llvm::Constant>(Visit(se->GetInitializer()[i].second)));
-                s.Fields.at(name).ManualInitialized = true;
+                const Field &field = s.Fields.at(se->GetInitializer()[i].first);
+                fields[field.Index] = llvm::dyn_cast<llvm::Constant>(Visit(se->GetInitializer()[i].second));
+                initialized[field.Index] = true;
             }
             for (auto &field : s.Fields) {
-                if (!field.second.ManualInitialized) {
+                if (!initialized[field.second.Index]) {
                     if (field.second.ASTType.GetTypeKind() == ASTTypeKind::Struct) {
-                        fields.push_back(llvm::dyn_cast<llvm::Constant>(field.second.ASTType.IsPointer() ? llvm::ConstantPointerNull::get(_builder.getPtrTy())
-                                                                      : defaultStructConst(field.second.ASTType)));
+                        fields[field.second.Index] = llvm::dyn_cast<llvm::Constant>(field.second.ASTType.IsPointer()
+                                                                                    ? llvm::ConstantPointerNull::get(_builder.getPtrTy())
+                                                                                    : defaultStructConst(field.second.ASTType));
                     }
                     else {
-                        fields.push_back(llvm::Constant::getNullValue(field.second.Type));
+                        fields[field.second.Index] = llvm::Constant::getNullValue(field.second.Type);
                     }
                 }
             }
@@ -899,7 +1481,7 @@ namespace marble {
     CodeGen::VisitFieldAccessExpr(FieldAccessExpr *fae) {
         if (fae->IsStaticAccessing()) {
             std::string name = getMangledForPath(fae->GetObjType().GetVal()) + "." + fae->GetName();
-            llvm::GlobalVariable *gv = GetLLVMModule()->getNamedGlobal(name);
+            llvm::GlobalVariable *gv = findGlobal(name);
             if (createLoad) {
                 return _builder.CreateLoad(gv->getValueType(), gv, name + ".load");
             }
@@ -926,7 +1508,7 @@ namespace marble {
                 p.pop_back();
                 mangled = getMangledName(p, varName);
             }
-            if (auto *gv = GetLLVMModule()->getGlobalVariable(mangled)) {
+            if (auto *gv = findGlobal(mangled)) {
                 if (createLoad) {
                     return _builder.CreateLoad(gv->getValueType(), gv);
                 }
@@ -937,17 +1519,17 @@ namespace marble {
         ASTType objASTType = fae->GetObjType();
         
         if (objASTType.GetTypeKind() == ASTTypeKind::Mod) {
-            _modulesPath.push_back(objASTType.GetVal());
-            std::string mangled = getCurrentMangled(fae->GetName());
-            if (auto *gv = GetLLVMModule()->getGlobalVariable(mangled)) {
+            pushModule(objASTType.GetVal());
+            const std::string &mangled = getCurrentMangled(fae->GetName());
+            if (auto *gv = findGlobal(mangled)) {
                 if (createLoad) {
-                    _modulesPath.pop_back();
+                    popModule();
                     return _builder.CreateLoad(gv->getValueType(), gv);
                 }
-                _modulesPath.pop_back();
+                popModule();
                 return gv;
             }
-            _modulesPath.pop_back();
+            popModule();
             return nullptr;
         }
 
@@ -960,15 +1542,15 @@ namespace marble {
         }
         else if (objASTType.GetTypeKind() == ASTTypeKind::Struct) {
             if (!obj->getType()->isPointerTy()) {
-                llvm::AllocaInst *tempAlloca = _builder.CreateAlloca(obj->getType(), nullptr, "struct.tmp");
+                llvm::AllocaInst *tempAlloca = createEntryAlloca(obj->getType(), "struct.tmp");
                 _builder.CreateStore(obj, tempAlloca);
                 obj = tempAlloca;
             }
         }
 
-        Struct s = _structs.at(resolveFullTypeName(objASTType));
-        Field field = s.Fields.at(fae->GetName());
-        llvm::Value *gep = _builder.CreateStructGEP(s.Type, obj, field.Index);
+        llvm::StructType *structType = _structs.at(resolveFullTypeName(objASTType)).Type;
+        int index = fae->GetFieldIndex();
+        llvm::Value *gep = _builder.CreateStructGEP(structType, obj, index);
         if (_vars.size() == 1) {
             if (auto *globalVar = llvm::dyn_cast<llvm::GlobalVariable>(obj)) {
                 if (globalVar->hasInitializer()) {
@@ -979,12 +1561,12 @@ namespace marble {
                 }
             }
             if (auto *constantVal = llvm::dyn_cast<llvm::Constant>(obj)) {
-                return constantVal->getAggregateElement(field.Index);
+                return constantVal->getAggregateElement(index);
             }
             return nullptr;
         }
         if (createLoad) {
-            return _builder.CreateLoad(s.Type->getTypeAtIndex(field.Index), gep, fae->GetName() + ".load");
+            return _builder.CreateLoad(structType->getElementType(index), gep, fae->GetName() + ".load");
         }
         return gep;
     }
@@ -993,7 +1575,7 @@ namespace marble {
     CodeGen::VisitMethodCallExpr(MethodCallExpr *mce) {
         if (mce->IsStaticAccessing()) {
             std::string name = getMangledForPath(mce->GetObjType().GetVal()) + "." + mce->GetName();
-            llvm::Function *fun = GetLLVMModule()->getFunction(name);
+            llvm::Function *fun = findFunction(name);
             if (!fun) {
                 return nullptr;
             }
@@ -1030,7 +1612,7 @@ namespace marble {
                 p.pop_back();
                 mangled = getMangledName(p, funName);
             }
-            llvm::Function* fun = GetLLVMModule()->getFunction(mangled);
+            llvm::Function* fun = findFunction(mangled);
             if (!fun) {
                 return nullptr;
             }
@@ -1045,15 +1627,15 @@ namespace marble {
         ASTType objType = mce->GetObjType();
 
         if (objType.GetTypeKind() == ASTTypeKind::Mod) {
-            _modulesPath.push_back(objType.GetVal());
+            pushModule(objType.GetVal());
             std::string fullPath = getModulePathFromExpr(mce->GetObject());
             std::string mangled = fullPath;
             if (!fullPath.empty() && fullPath.back() != '#') {
                 mangled += "#";
             }
             mangled += mce->GetName();
-            _modulesPath.pop_back();
-            llvm::Function *fun = GetLLVMModule()->getFunction(mangled);
+            popModule();
+            llvm::Function *fun = findFunction(mangled);
             if (!fun) {
                 return nullptr;
             }
@@ -1074,7 +1656,7 @@ namespace marble {
         }
         else if (objType.GetTypeKind() == ASTTypeKind::Struct) {
             if (!obj->getType()->isPointerTy()) {
-                llvm::AllocaInst *tmp = _builder.CreateAlloca(obj->getType());
+                llvm::AllocaInst *tmp = createEntryAlloca(obj->getType());
                 _builder.CreateStore(obj, tmp);
                 obj = tmp;
             }
@@ -1087,6 +1669,7 @@ namespace marble {
             }
 
             llvm::Value *thisPtr = _builder.CreateExtractValue(fatPtr, 0, "trait.this");
+            createCheckForNil(thisPtr, mce->GetStartLoc());     // a nil pointer to a structure casts to a trait
             llvm::Value *vtablePtr = _builder.CreateExtractValue(fatPtr, 1, "trait.vtable");
 
             Trait &t = _traits.at(typeName);
@@ -1108,7 +1691,9 @@ namespace marble {
             }
 
             auto &m = t.Methods[methodIdx].second;
-            llvm::FunctionType *FTy = llvm::FunctionType::get(m.RetType, m.Args, false);
+            std::vector<llvm::Type *> paramTypes = { ptrTy };  // `this`
+            paramTypes.insert(paramTypes.end(), m.Args.begin(), m.Args.end());
+            llvm::FunctionType *FTy = llvm::FunctionType::get(m.RetType, paramTypes, false);
             return _builder.CreateCall(FTy, funcPtr, args);
         }
         
@@ -1123,6 +1708,7 @@ namespace marble {
 
         if (_traits.count(structName)) {
             llvm::Value *thisPtr = _builder.CreateExtractValue(obj, 0, "trait.this");
+            createCheckForNil(thisPtr, mce->GetStartLoc());
             llvm::Value *vtablePtr = _builder.CreateExtractValue(obj, 1, "trait.vtable");
 
             Trait &t = _traits.at(structName);
@@ -1153,7 +1739,9 @@ namespace marble {
                 args[i + 1] = implicitlyCast(Visit(mce->GetArgs()[i]), t.Methods[methodIndex].second.Args[i]);
             }
             createLoad = oldLoad;
-            llvm::FunctionType *method = llvm::FunctionType::get(retType, t.Methods[methodIndex].second.Args, false);
+            std::vector<llvm::Type *> paramTypes = { voidPtrTy };  // `this`
+            paramTypes.insert(paramTypes.end(), t.Methods[methodIndex].second.Args.begin(), t.Methods[methodIndex].second.Args.end());
+            llvm::FunctionType *method = llvm::FunctionType::get(retType, paramTypes, false);
 
             return _builder.CreateCall(method, funRaw, args);
         }
@@ -1167,7 +1755,7 @@ namespace marble {
         std::vector<llvm::Value *> args(fun->getFunctionType()->getNumParams());
 
         if (!obj->getType()->isPointerTy()) {
-            llvm::AllocaInst *alloca = _builder.CreateAlloca(obj->getType());
+            llvm::AllocaInst *alloca = createEntryAlloca(obj->getType());
             _builder.CreateStore(obj, alloca);
             obj = alloca;
         }
@@ -1188,7 +1776,7 @@ namespace marble {
                 llvm::Value *fatPtr = llvm::UndefValue::get(expectedType);
 
                 if (!val->getType()->isPointerTy()) {
-                    llvm::AllocaInst *tmp = _builder.CreateAlloca(val->getType());
+                    llvm::AllocaInst *tmp = createEntryAlloca(val->getType());
                     _builder.CreateStore(val, tmp);
                     val = tmp;
                 }
@@ -1242,8 +1830,27 @@ namespace marble {
 
     llvm::Value *
     CodeGen::VisitNewExpr(NewExpr *ne) {
-        llvm::Value *size = _builder.getInt64(GetLLVMModule()->getDataLayout().getTypeAllocSize(typeToLLVM(ne->GetType())));
-        llvm::Value *ptr = _builder.CreateCall(GetLLVMModule()->getFunction("malloc"), { size });
+        llvm::Type *type = typeToLLVM(ne->GetType());
+        llvm::Value *size = _builder.getInt64(GetLLVMModule()->getDataLayout().getTypeAllocSize(type));
+        llvm::Value *ptr;
+        if (_stackAllocs.count(ne)) {
+            ptr = createEntryAlloca(type, "new.stack");
+        }
+        else if (!_arenas.empty()) {
+            ptr = _builder.CreateCall(GetLLVMModule()->getFunction("__marble_arena_alloc"), { _arenas.back().Handle, size });
+            if (_opts.TrackAllocs) {
+                _builder.CreateCall(GetLLVMModule()->getFunction("__marble_track_arena_alloc"),
+                                    { size, createAllocSite(ne->GetType().ToString(), ne->GetStartLoc(), SiteNew), _arenas.back().Site });
+            }
+        }
+        else {
+            llvm::Function *allocFun = GetLLVMModule()->getFunction(_opts.Allocator == CodeGenOptions::Slab ? "__marble_alloc" : "malloc");
+            ptr = _builder.CreateCall(allocFun, { size });
+            if (_opts.TrackAllocs) {
+                _builder.CreateCall(GetLLVMModule()->getFunction("__marble_track_alloc"),
+                                    { ptr, size, createAllocSite(ne->GetType().ToString(), ne->GetStartLoc(), SiteNew) });
+            }
+        }
         if (ne->GetStructExpr()) {
             llvm::Value *se = VisitStructExpr(ne->GetStructExpr());
             _builder.CreateStore(se, ptr);
@@ -1301,7 +1908,7 @@ namespace marble {
                     dataPtr = _builder.CreateBitCast(src, llvm::PointerType::get(_context, 0));
                 }
                 else {
-                    llvm::AllocaInst *tmp = _builder.CreateAlloca(src->getType());
+                    llvm::AllocaInst *tmp = createEntryAlloca(src->getType());
                     _builder.CreateStore(src, tmp);
                     dataPtr = _builder.CreateBitCast(tmp, llvm::PointerType::get(_context, 0));
                 }
@@ -1368,24 +1975,34 @@ namespace marble {
             case ASTTypeKind::F64:
                 base = TYPE(getDoubleTy);
                 break;
-            case ASTTypeKind::Struct:
-                if (auto it = _structs.find(resolveFullTypeName(type)); it != _structs.end()) {
-                    base = it->second.Type;
-                }
-                else {
-                    base = _structs.at(type.GetVal()).Type;
+            case ASTTypeKind::Struct: {
+                llvm::Type *&cached = _scopeCache->LoweredTypes[type.GetVal()];
+                if (!cached) {
+                    if (auto it = _structs.find(resolveFullTypeName(type)); it != _structs.end()) {
+                        cached = it->second.Type;
+                    }
+                    else {
+                        cached = _structs.at(type.GetVal()).Type;
+                    }
                 }
+                base = cached;
                 break;
+            }
             case ASTTypeKind::Trait: {
-                std::string mangled = resolveFullTypeName(type);
+                llvm::Type *&cached = _scopeCache->LoweredTypes[type.GetVal()];
+                if (cached) {
+                    base = cached;
+                    break;
+                }
+                const std::string &mangled = getMangledForPath(type.GetVal());
                 llvm::StructType *existingType = llvm::StructType::getTypeByName(_context, mangled);
                 if (existingType) {
-                    base = existingType;
+                    base = cached = existingType;
                     break;
                 }
                 llvm::Type *voidPtrTy = llvm::PointerType::get(_context, 0);
                 llvm::Type *vtablePtrTy = llvm::PointerType::get(voidPtrTy, 0);
-                base = llvm::StructType::create(_context, { voidPtrTy, vtablePtrTy }, mangled);
+                base = cached = llvm::StructType::create(_context, { voidPtrTy, vtablePtrTy }, mangled);
                 break;
             }
             case ASTTypeKind::Noth:
@@ -1399,10 +2016,10 @@ namespace marble {
 
     llvm::Value *
     CodeGen::defaultStructConst(ASTType type) {
-        Struct s = _structs.at(resolveFullTypeName(type));
+        const Struct &s = _structs.at(resolveFullTypeName(type));
         std::vector<llvm::Constant *> fields(s.Fields.size());
-        int i = 0;
         for (auto &field : s.Fields) {
+            int i = field.second.Index;
             if (field.second.Val) {
                 fields[i] = llvm::cast<llvm::Constant>(field.second.Val);
             }
@@ -1419,6 +2036,32 @@ namespace marble {
         return llvm::ConstantStruct::get(s.Type, fields);
     }
 
+    llvm::Constant *
+    CodeGen::getConstant(const ASTVal &val) {
+        switch (val.GetType().GetTypeKind()) {
+            #define CONST_INT(func, field) llvm::ConstantInt::get(llvm::Type::func(_context), val.GetData().field)
+            #define CONST_FP(func, field) llvm::ConstantFP::get(llvm::Type::func(_context), val.GetData().field)
+            case ASTTypeKind::Bool:
+                return CONST_INT(getInt1Ty, boolVal);
+            case ASTTypeKind::Char:
+                return CONST_INT(getInt8Ty, charVal);
+            case ASTTypeKind::I16:
+                return CONST_INT(getInt16Ty, i16Val);
+            case ASTTypeKind::I32:
+                return CONST_INT(getInt32Ty, i32Val);
+            case ASTTypeKind::I64:
+                return CONST_INT(getInt64Ty, i64Val);
+            case ASTTypeKind::F32:
+                return CONST_FP(getFloatTy, f32Val);
+            case ASTTypeKind::F64:
+                return CONST_FP(getDoubleTy, f64Val);
+            default: {}
+            #undef CONST_FP
+            #undef CONST_INT
+        }
+        return nullptr;
+    }
+
     
     std::string
     CodeGen::resolveStructName(Expr *expr) {
@@ -1428,43 +2071,39 @@ namespace marble {
                 if (_currentMod && name == "self" || name == "parent") {
                     return _currentMod->GetName();
                 }
-                auto varsCopy = _vars;
-                while (!varsCopy.empty()) {
-                    for (auto var : varsCopy.top()) {
-                        if (var.first == name) {
-                            auto &[varVal, llvmType, type] = var.second;
-                            if (auto *glob = llvm::dyn_cast<llvm::GlobalVariable>(varVal)) {
-                                if (auto *metadata = glob->getMetadata("struct_name")) {
-                                    if (auto *mdStr = llvm::dyn_cast<llvm::MDString>(metadata->getOperand(0))) {
-                                        return mdStr->getString().str();
-                                    }
-                                }
-                            } 
-                            else if (auto *local = llvm::dyn_cast<llvm::AllocaInst>(varVal)) {
-                                if (auto *metadata = local->getMetadata("struct_name")) {
-                                    if (auto *mdStr = llvm::dyn_cast<llvm::MDString>(metadata->getOperand(0))) {
-                                        return mdStr->getString().str();
-                                    }
-                                }
-                            }
-                            else if (auto *arg = llvm::dyn_cast<llvm::Argument>(varVal)) {
-                                llvm::Function *parent = arg->getParent();
-                                if (parent->getFunctionType()->getParamType(0) == arg->getType()) {
-                                    if (auto *metadata = parent->getMetadata("this_struct_name")) {
-                                        if (auto *mdStr = llvm::dyn_cast<llvm::MDString>(metadata->getOperand(0))) {
-                                            return mdStr->getString().str();
-                                        }
-                                    }
-                                }
-                                else {
-                                    if (arg->getType()->isStructTy()) {
-                                        return arg->getType()->getStructName().str();
-                                    }
-                                }
+                VarInfo *var = findVar(name, llvm::cast<VarExpr>(expr)->GetSlot());
+                if (!var) {
+                    return "";
+                }
+                llvm::Value *varVal = std::get<0>(*var);
+                if (auto *glob = llvm::dyn_cast<llvm::GlobalVariable>(varVal)) {
+                    if (auto *metadata = glob->getMetadata("struct_name")) {
+                        if (auto *mdStr = llvm::dyn_cast<llvm::MDString>(metadata->getOperand(0))) {
+                            return mdStr->getString().str();
+                        }
+                    }
+                } 
+                else if (auto *local = llvm::dyn_cast<llvm::AllocaInst>(varVal)) {
+                    if (auto *metadata = local->getMetadata("struct_name")) {
+                        if (auto *mdStr = llvm::dyn_cast<llvm::MDString>(metadata->getOperand(0))) {
+                            return mdStr->getString().str();
+                        }
+                    }
+                }
+                else if (auto *arg = llvm::dyn_cast<llvm::Argument>(varVal)) {
+                    llvm::Function *parent = arg->getParent();
+                    if (parent->getFunctionType()->getParamType(0) == arg->getType()) {
+                        if (auto *metadata = parent->getMetadata("this_struct_name")) {
+                            if (auto *mdStr = llvm::dyn_cast<llvm::MDString>(metadata->getOperand(0))) {
+                                return mdStr->getString().str();
                             }
                         }
                     }
-                    varsCopy.pop();
+                    else {
+                        if (arg->getType()->isStructTy()) {
+                            return arg->getType()->getStructName().str();
+                        }
+                    }
                 }
                 return "";
             }
@@ -1519,6 +2158,20 @@ namespace marble {
         }
     }
 
+    // A local variable is found by the slot which Sema resolved its name to, a global one (-1) by its name
+    CodeGen::VarInfo *
+    CodeGen::findVar(const std::string &name, int slot) {
+        if (slot >= 0 && slot < _locals.size() && std::get<0>(_locals[slot])) {
+            return &_locals[slot];
+        }
+        for (auto scope = _vars.rbegin(); scope != _vars.rend(); ++scope) {
+            if (auto var = scope->find(name); var != scope->end()) {
+                return &var->second;
+            }
+        }
+        return nullptr;
+    }
+
     void
     CodeGen::createCheckForNil(llvm::Value *ptr, llvm::SMLoc loc) {
         auto [line, col] = _srcMgr.getLineAndColumn(loc);
@@ -1537,21 +2190,424 @@ namespace marble {
         _builder.CreateCondBr(isNull, nullBB, notNullBB);
         _builder.SetInsertPoint(nullBB);
 
-        llvm::Constant *errMsg = llvm::ConstantDataArray::getString(_context, msgStr, true);
-        llvm::GlobalVariable *errMsgGlobal = new llvm::GlobalVariable(*GetLLVMModule(), errMsg->getType(), true, llvm::GlobalValue::PrivateLinkage, errMsg, "null_err_msg");
-        errMsgGlobal->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
-        errMsgGlobal->setAlignment(llvm::MaybeAlign(1));
-
-        llvm::Value *errMsgPtr = _builder.CreateGEP(errMsgGlobal->getValueType(), errMsgGlobal, { _builder.getInt64(0), _builder.getInt32(0) }, "err_msg_ptr");
-
-        _builder.CreateCall(GetLLVMModule()->getFunction("printf"), { errMsgPtr }, "printf_call");
-
+        createEchoStr(msgStr);
+        _builder.CreateCall(GetLLVMModule()->getFunction("__marble_echo_flush"));
         _builder.CreateCall(GetLLVMModule()->getFunction("abort"));
         _builder.CreateUnreachable();
 
         _builder.SetInsertPoint(notNullBB);
     }
 
+    llvm::GlobalValue::LinkageTypes
+    CodeGen::getFunctionLinkage(FunDeclStmt *fds, const std::string &mangled) const {
+        // only `main` and the public API are used outside of the unit, `Finalize` promotes the private functions which
+        // other units refer to anyway (e.g. through a vtable)
+        if (fds->GetAccess() == AccessPub || mangled == "main") {
+            return llvm::GlobalValue::ExternalLinkage;
+        }
+        return llvm::GlobalValue::InternalLinkage;
+    }
+
+    void
+    CodeGen::applyFunAttrs(llvm::Function *fun, FunDeclStmt *fds) {
+        if (fds->HasAttr(FunAttrInline)) {
+            fun->addFnAttr(llvm::Attribute::AlwaysInline);
+        }
+        if (fds->HasAttr(FunAttrNoInline)) {
+            fun->addFnAttr(llvm::Attribute::NoInline);
+        }
+        // on ELF the section prefix places the function into `.text.unlikely.*` or `.text.hot.*`
+        if (fds->HasAttr(FunAttrCold)) {
+            fun->addFnAttr(llvm::Attribute::Cold);
+            if (fds->GetOptLevel() != 0) {
+                fun->addFnAttr(llvm::Attribute::OptimizeForSize);
+            }
+            fun->setSectionPrefix("unlikely");
+        }
+        if (fds->HasAttr(FunAttrHot)) {
+            fun->addFnAttr(llvm::Attribute::Hot);
+            fun->setSectionPrefix("hot");
+        }
+        // Sema guarantees that a `@pure` function does not write memory which is visible to the caller, only the runtime
+        // state behind a failing nil check or `-finstrument=functions` is written
+        if (fds->HasAttr(FunAttrPure)) {
+            fun->setMemoryEffects(llvm::MemoryEffects::readOnly() | llvm::MemoryEffects::inaccessibleMemOnly());
+        }
+        // `Optimizer` runs the pipeline of this level on the function instead of the one of the whole program
+        if (fds->GetOptLevel() == 0) {
+            fun->addFnAttr(llvm::Attribute::OptimizeNone);
+            fun->addFnAttr(llvm::Attribute::NoInline);
+        }
+        else if (fds->GetOptLevel() > 0) {
+            fun->addFnAttr("marble-opt-level", std::to_string(fds->GetOptLevel()));
+        }
+    }
+
+    void
+    CodeGen::flattenCalls(llvm::Function *fun) {
+        for (llvm::BasicBlock &bb : *fun) {
+            for (llvm::Instruction &inst : bb) {
+                llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(&inst);
+                if (!call) {
+                    continue;
+                }
+                llvm::Function *callee = call->getCalledFunction();
+                // only Marble functions can be inlined, the runtime is linked in later
+                if (callee && _functions.count(callee->getName().str()) && !callee->hasFnAttribute(llvm::Attribute::NoInline)) {
+                    call->addFnAttr(llvm::Attribute::AlwaysInline);
+                }
+            }
+        }
+    }
+
+    void
+    CodeGen::beginFunctionBody(llvm::Function *fun) {
+        if (_opts.FramePointers) {
+            fun->addFnAttr("frame-pointer", "all");
+        }
+        llvm::BasicBlock *entry = llvm::BasicBlock::Create(_context, "entry", fun);
+        _builder.SetInsertPoint(entry);
+        // placeholder which is never used; allocas are inserted before it so they all stay at the top of the entry block
+        llvm::Value *undef = llvm::PoisonValue::get(_builder.getInt32Ty());
+        _allocaInsertPt = new llvm::BitCastInst(undef, _builder.getInt32Ty(), "allocapt", entry);
+        if (_opts.InstrumentFunctions) {
+            std::string name = fun->getName().str();
+            std::replace(name.begin(), name.end(), '#', '.');
+            llvm::Value *id = _builder.CreateAdd(_builder.CreateLoad(_builder.getInt32Ty(), _unit->ProfBase), _builder.getInt32(_unit->ProfNames.size()));
+            _builder.CreateCall(GetLLVMModule()->getFunction("__marble_prof_enter"), { id });
+            _unit->ProfNames.push_back(getOrCreateString(name));
+        }
+    }
+
+    void
+    CodeGen::endFunctionBody() {
+        llvm::Function *fun = _allocaInsertPt->getFunction();
+        _allocaInsertPt->eraseFromParent();
+        _allocaInsertPt = nullptr;
+        if (_opts.InstrumentFunctions) {
+            for (llvm::BasicBlock &bb : *fun) {
+                if (llvm::ReturnInst *ret = llvm::dyn_cast_or_null<llvm::ReturnInst>(bb.getTerminator())) {
+                    llvm::CallInst::Create(GetLLVMModule()->getFunction("__marble_prof_exit"), "", ret)->setDebugLoc(ret->getDebugLoc());
+                }
+            }
+        }
+        if (_debugScope) {
+            _debugUnit->Builder->finalizeSubprogram(_debugScope);
+            _debugScope = nullptr;
+            _debugUnit = nullptr;
+            _builder.SetCurrentDebugLocation(llvm::DebugLoc());
+        }
+    }
+
+    CodeGen::DebugUnit &
+    CodeGen::getDebugUnit(llvm::SMLoc loc) {
+        unsigned bufferID = _srcMgr.FindBufferContainingLoc(loc);
+        if (!bufferID) {
+            bufferID = _srcMgr.getMainFileID();
+        }
+        auto it = _debugUnits.find(bufferID);
+        if (it != _debugUnits.end()) {
+            return it->second;
+        }
+        llvm::StringRef path = _srcMgr.getMemoryBuffer(bufferID)->getBufferIdentifier();
+        llvm::StringRef dir = llvm::sys::path::parent_path(path);
+        std::unique_ptr<llvm::DIBuilder> builder = std::make_unique<llvm::DIBuilder>(*GetLLVMModule());
+        llvm::DIFile *file = builder->createFile(llvm::sys::path::filename(path), dir.empty() ? "." : dir);
+        llvm::DICompileUnit::DebugEmissionKind kind = _opts.DebugInfo ? llvm::DICompileUnit::FullDebug
+                                                    : _opts.LineTables ? llvm::DICompileUnit::LineTablesOnly
+                                                                       : llvm::DICompileUnit::NoDebug;
+        llvm::DICompileUnit *cu = builder->createCompileUnit(llvm::dwarf::DW_LANG_C, file, "marblec", _opts.Optimized, "", 0, "", kind);
+        return _debugUnits.emplace(bufferID, DebugUnit { std::move(builder), cu, file }).first->second;
+    }
+
+    void
+    CodeGen::beginDebugFunction(llvm::Function *fun, FunDeclStmt *fds, const std::string &name, std::optional<ASTType> thisType) {
+        if (!_opts.DebugInfo && !_opts.TrackLocations) {
+            return;
+        }
+        _debugUnit = &getDebugUnit(fds->GetStartLoc());
+        llvm::DIBuilder &dib = *_debugUnit->Builder;
+        std::vector<llvm::Metadata *> types;
+        if (_opts.DebugInfo) {
+            types.push_back(getDebugType(fds->GetRetType()));   // the first one is the result, nullptr for `noth`
+            if (thisType) {
+                types.push_back(getDebugType(*thisType));
+            }
+            for (auto &arg : fds->GetArgs()) {
+                types.push_back(getDebugType(arg.GetType()));
+            }
+        }
+        unsigned line = _srcMgr.getLineAndColumn(fds->GetStartLoc()).first;
+        llvm::DISubprogram::DISPFlags flags = llvm::DISubprogram::SPFlagDefinition;
+        if (fun->hasLocalLinkage()) {
+            flags |= llvm::DISubprogram::SPFlagLocalToUnit;
+        }
+        if (_opts.Optimized) {
+            flags |= llvm::DISubprogram::SPFlagOptimized;
+        }
+        _debugScope = dib.createFunction(_debugUnit->File, name, fun->getName(), _debugUnit->File, line,
+                                         dib.createSubroutineType(dib.getOrCreateTypeArray(types)), line,
+                                         llvm::DINode::FlagPrototyped, flags);
+        fun->setSubprogram(_debugScope);
+        setDebugLoc(fds->GetStartLoc());
+    }
+
+    void
+    CodeGen::setDebugLoc(llvm::SMLoc loc) {
+        if (!_debugScope) {
+            return;
+        }
+        auto [line, col] = _srcMgr.getLineAndColumn(loc);
+        _builder.SetCurrentDebugLocation(llvm::DILocation::get(_context, line, col, _debugScope));
+    }
+
+    void
+    CodeGen::declareDebugVar(llvm::Value *storage, const std::string &name, ASTType type, llvm::SMLoc loc, unsigned argNo, bool isAddress) {
+        if (!_debugScope || !_opts.DebugInfo) {
+            return;
+        }
+        llvm::DIBuilder &dib = *_debugUnit->Builder;
+        unsigned line = _srcMgr.getLineAndColumn(loc).first;
+        llvm::DILocalVariable *var = argNo ? dib.createParameterVariable(_debugScope, name, argNo, _debugUnit->File, line, getDebugType(type), true)
+                                           : dib.createAutoVariable(_debugScope, name, _debugUnit->File, line, getDebugType(type), true);
+        llvm::DILocation *diLoc = llvm::DILocation::get(_context, line, 0, _debugScope);
+        if (isAddress) {
+            dib.insertDeclare(storage, var, dib.createExpression(), diLoc, _builder.GetInsertBlock());
+        }
+        else {
+            dib.insertDbgValueIntrinsic(storage, var, dib.createExpression(), diLoc, _builder.GetInsertBlock());
+        }
+    }
+
+    llvm::DIType *
+    CodeGen::getDebugType(ASTType type) {
+        if (type.GetTypeKind() == ASTTypeKind::Noth && !type.IsPointer()) {
+            return nullptr;
+        }
+        llvm::Type *llvmType = typeToLLVM(type);
+        std::string key = type.IsPointer() ? "" : type.GetVal();
+        if (llvm::StructType *st = llvm::dyn_cast<llvm::StructType>(llvmType)) {
+            key = st->getName().str();  // mangled, so the same structure is described once
+        }
+        if (!key.empty()) {
+            if (auto it = _debugTypes.find(key); it != _debugTypes.end()) {
+                return it->second;
+            }
+        }
+
+        llvm::DIBuilder &dib = *_debugUnit->Builder;
+        const llvm::DataLayout &layout = GetLLVMModule()->getDataLayout();
+        llvm::DIType *res = nullptr;
+        if (type.IsPointer()) {
+            ASTType pointee = type;
+            pointee.Deref();
+            return dib.createPointerType(getDebugType(pointee), layout.getPointerSizeInBits());
+        }
+        switch (type.GetTypeKind()) {
+            case ASTTypeKind::Bool:
+                res = dib.createBasicType("bool", 8, llvm::dwarf::DW_ATE_boolean);
+                break;
+            case ASTTypeKind::Char:
+                res = dib.createBasicType("char", 8, llvm::dwarf::DW_ATE_signed_char);
+                break;
+            case ASTTypeKind::I16:
+            case ASTTypeKind::I32:
+            case ASTTypeKind::I64:
+                res = dib.createBasicType(type.GetVal(), llvmType->getPrimitiveSizeInBits(), llvm::dwarf::DW_ATE_signed);
+                break;
+            case ASTTypeKind::F32:
+            case ASTTypeKind::F64:
+                res = dib.createBasicType(type.GetVal(), llvmType->getPrimitiveSizeInBits(), llvm::dwarf::DW_ATE_float);
+                break;
+            case ASTTypeKind::Struct:
+            case ASTTypeKind::Trait: {
+                llvm::StructType *st = llvm::cast<llvm::StructType>(llvmType);
+                llvm::DIFile *file = _debugUnit->File;
+                // a placeholder breaks the cycle of structures which point to themselves
+                llvm::DICompositeType *placeholder = dib.createReplaceableCompositeType(llvm::dwarf::DW_TAG_structure_type, type.GetVal(), file, file, 0);
+                _debugTypes[key] = placeholder;
+
+                const llvm::StructLayout *structLayout = layout.getStructLayout(st);
+                std::vector<llvm::Metadata *> members;
+                auto addMember = [&](const std::string &name, llvm::DIType *memberType, unsigned index) {
+                    llvm::Type *fieldType = st->getElementType(index);
+                    members.push_back(dib.createMemberType(placeholder, name, file, 0, layout.getTypeSizeInBits(fieldType),
+                                                           0,
+                                                           structLayout->getElementOffsetInBits(index), llvm::DINode::FlagZero, memberType));
+                };
+                if (type.GetTypeKind() == ASTTypeKind::Struct) {
+                    std::vector<const Field *> fields;
+                    for (auto &[_, field] : _structs.at(key).Fields) {
+                        fields.push_back(&field);
+                    }
+                    std::sort(fields.begin(), fields.end(), [](const Field *lhs, const Field *rhs) { return lhs->Index < rhs->Index; });
+                    for (const Field *field : fields) {
+                        addMember(field->Name, getDebugType(field->ASTType), field->Index);
+                    }
+                }
+                else {
+                    // a trait object is a pointer to the object and a pointer to the vtable of its structure
+                    llvm::DIType *voidPtr = dib.createPointerType(nullptr, layout.getPointerSizeInBits());
+                    addMember("data", voidPtr, 0);
+                    addMember("vtable", dib.createPointerType(voidPtr, layout.getPointerSizeInBits()), 1);
+                }
+                res = dib.createStructType(file, type.GetVal(), file, 0, layout.getTypeSizeInBits(st),
+                                           0, llvm::DINode::FlagZero, nullptr,
+                                           dib.getOrCreateArray(members));
+                dib.replaceTemporary(llvm::TempDIType(placeholder), res);
+                break;
+            }
+            default:
+                return nullptr;
+        }
+        _debugTypes[key] = res;
+        return res;
+    }
+
+    llvm::AllocaInst *
+    CodeGen::createEntryAlloca(llvm::Type *type, const llvm::Twine &name) {
+        if (!_allocaInsertPt) {
+            return _builder.CreateAlloca(type, nullptr, name);
+        }
+        llvm::IRBuilder<> allocaBuilder(_allocaInsertPt);
+        return allocaBuilder.CreateAlloca(type, nullptr, name);
+    }
+
+    void
+    CodeGen::endLifetimes() {
+        endLifetimes(_vars.size() - 1);
+    }
+
+    // Ends the lifetimes of the variables of the scopes from `firstScope` to the innermost one, which are left by the
+    // code following the insertion point
+    void
+    CodeGen::endLifetimes(size_t firstScope) {
+        if (!_opts.LifetimeMarkers || _builder.GetInsertBlock()->getTerminator()) {
+            return;
+        }
+        for (size_t scope = _vars.size(); scope-- > firstScope;) {
+            for (auto &[name, var] : _vars[scope]) {
+                if (llvm::AllocaInst *alloca = llvm::dyn_cast<llvm::AllocaInst>(std::get<0>(var))) {
+                    _builder.CreateLifetimeEnd(alloca);
+                }
+            }
+        }
+    }
+
+    void
+    CodeGen::collectStackAllocs(FunDeclStmt *fds, bool hasThis) {
+        _stackAllocs.clear();
+        _stackDels.clear();
+        if (!_opts.PromoteAllocs) {
+            return;
+        }
+        std::vector<std::string> args;
+        if (hasThis) {
+            args.push_back("this");
+        }
+        for (auto &arg : fds->GetArgs()) {
+            args.push_back(arg.GetName());
+        }
+        EscapeAnalysis analysis;
+        for (auto &alloc : analysis.Analyze(fds->GetBody(), args)) {
+            uint64_t size = GetLLVMModule()->getDataLayout().getTypeAllocSize(typeToLLVM(alloc.New->GetType()));
+            if (size > MaxStackPromotedSize) {
+                continue;
+            }
+            _stackAllocs.insert(alloc.New);
+            _stackDels.insert(alloc.Dels.begin(), alloc.Dels.end());
+        }
+    }
+
+    void
+    CodeGen::destroyArenas(size_t loopDepth) {
+        for (auto it = _arenas.rbegin(); it != _arenas.rend() && it->LoopDepth >= loopDepth; ++it) {
+            _builder.CreateCall(GetLLVMModule()->getFunction("__marble_arena_destroy"), { it->Handle });
+        }
+    }
+
+    // Returns from a function which returns nothing, `main` returns 0 then
+    llvm::ReturnInst *
+    CodeGen::createRetVoid() {
+        if (_funRetsTypes.top()->isVoidTy()) {
+            return _builder.CreateRetVoid();
+        }
+        return _builder.CreateRet(_builder.getInt32(0));
+    }
+
+    void
+    CodeGen::generateBlock(const std::vector<Stmt *> &body) {
+        std::string pendingEcho;    // text of consecutive constant `echo`s which is written by a single runtime call
+        for (auto &stmt : body) {
+            if (EchoStmt *es = llvm::dyn_cast<EchoStmt>(stmt)) {
+                if (auto text = getConstantEchoText(es->GetRHS())) {
+                    pendingEcho += *text;
+                    continue;
+                }
+            }
+            if (!pendingEcho.empty()) {
+                createEchoStr(pendingEcho);
+                pendingEcho.clear();
+            }
+            setDebugLoc(stmt->GetStartLoc());
+            Visit(stmt);
+        }
+        if (!pendingEcho.empty()) {
+            createEchoStr(pendingEcho);
+        }
+    }
+
+    std::optional<std::string>
+    CodeGen::getConstantEchoText(Expr *expr) {
+        std::optional<ASTVal> val = expr->GetConstVal();
+        if (LiteralExpr *le = llvm::dyn_cast<LiteralExpr>(expr)) {
+            val = le->GetVal();
+        }
+        if (!val) {
+            return std::nullopt;
+        }
+        ASTValData data = val->GetData();
+        switch (val->GetType().GetTypeKind()) {
+            case ASTTypeKind::Bool:
+                return data.boolVal ? "true\n" : "false\n";
+            case ASTTypeKind::Char:
+                return std::string(1, data.charVal);
+            case ASTTypeKind::I16:
+                return std::to_string(data.i16Val);
+            case ASTTypeKind::I32:
+                return std::to_string(data.i32Val);
+            case ASTTypeKind::I64:
+                return std::to_string(data.i64Val);
+            case ASTTypeKind::F32:
+            case ASTTypeKind::F64: {
+                char buf[32];
+                double fpVal = val->GetType().GetTypeKind() == ASTTypeKind::F32 ? data.f32Val : data.f64Val;
+                std::snprintf(buf, sizeof(buf), "%g", fpVal);   // must match the runtime formatting
+                return std::string(buf);
+            }
+            default:
+                return std::nullopt;
+        }
+    }
+
+    void
+    CodeGen::createEchoStr(const std::string &str) {
+        _builder.CreateCall(GetLLVMModule()->getFunction("__marble_echo_str"), { getOrCreateString(str), _builder.getInt64(str.size()) });
+    }
+
+    llvm::Constant *
+    CodeGen::getOrCreateString(const std::string &str) {
+        if (auto it = _unit->Strings.find(str); it != _unit->Strings.end()) {
+            return it->second;
+        }
+        llvm::Constant *init = llvm::ConstantDataArray::getString(_context, str, true);
+        llvm::GlobalVariable *global = new llvm::GlobalVariable(*GetLLVMModule(), init->getType(), true, llvm::GlobalValue::PrivateLinkage, init, "str");
+        global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        global->setAlignment(llvm::MaybeAlign(1));
+        _unit->Strings.emplace(str, global);
+        return global;
+    }
+
     llvm::Value *
     CodeGen::getOrCreateVTable(const std::string &structName, const std::string &traitName) {
         std::string vtableName = "vtable." + _structs.at(structName).MangledName + ".as." + _traits.at(traitName).MangledName;
@@ -1586,7 +2642,7 @@ namespace marble {
             dataPtr = _builder.CreateBitCast(src, _builder.getPtrTy());
         }
         else {
-            llvm::AllocaInst *tmp = _builder.CreateAlloca(src->getType());
+            llvm::AllocaInst *tmp = createEntryAlloca(src->getType());
             _builder.CreateStore(src, tmp);
             dataPtr = _builder.CreateBitCast(tmp, _builder.getPtrTy());
         }
@@ -1599,9 +2655,41 @@ namespace marble {
         return fatPtr;
     }
 
+    bool
+    CodeGen::shouldGenerate(FunDeclStmt *fds, llvm::Function *fun) {
+        if (fds->IsUnchecked() || (_reachable && !_reachable->count(fds))) {
+            _skippedFunctions.push_back(fun);
+            ++_skippedBodies;
+            return false;
+        }
+        ++_generatedBodies;
+        return true;
+    }
+
     llvm::Function *
     CodeGen::getFunction(std::string name) {
-        return GetLLVMModule()->getFunction(getCurrentMangled(name));
+        return findFunction(getCurrentMangled(name));
+    }
+
+    // The functions and variables are searched in all units, `Finalize` declares the ones of other units
+    llvm::Function *
+    CodeGen::findFunction(const std::string &mangled) {
+        auto it = _functions.find(mangled);
+        return it != _functions.end() ? it->second : GetLLVMModule()->getFunction(mangled);
+    }
+
+    llvm::GlobalVariable *
+    CodeGen::findGlobal(const std::string &name) {
+        if (llvm::GlobalVariable *gv = GetLLVMModule()->getNamedGlobal(name)) {
+            return gv;
+        }
+        for (std::unique_ptr<Unit> &unit : _units) {
+            llvm::GlobalVariable *gv = unit->Mod->getNamedGlobal(name);
+            if (gv && !gv->isDeclaration()) {
+                return gv;
+            }
+        }
+        return nullptr;
     }
 
     std::string
@@ -1613,33 +2701,40 @@ namespace marble {
         return res + name;
     }
 
-    std::string
-    CodeGen::getCurrentMangled(const std::string &name) const {
-        return getMangledName(_modulesPath, name);
+    const std::string &
+    CodeGen::getCurrentMangled(const std::string &name) {
+        std::string &mangled = _scopeCache->Mangled[name];
+        if (mangled.empty()) {
+            mangled = _modulePrefix + name;
+        }
+        return mangled;
     }
 
     std::vector<std::string>
     CodeGen::splitPath(const std::string &path) {
         std::vector<std::string> result;
-        std::stringstream ss(path);
-        std::string item;
-        while (std::getline(ss, item, '/')) {
-            if (!item.empty()) {
-                result.push_back(item);
+        size_t start = 0;
+        while (start <= path.size()) {
+            size_t end = std::min(path.find('/', start), path.size());
+            if (end > start) {
+                result.push_back(path.substr(start, end - start));
             }
+            start = end + 1;
         }
         return result;
     }
 
-    std::string
+    const std::string &
     CodeGen::getMangledForPath(const std::string &path) {
-        if (path.empty()) {
-            return "";
+        std::unordered_map<std::string, std::string> &cache = _scopeCache->MangledPaths;
+        if (auto it = cache.find(path); it != cache.end()) {
+            return it->second;
         }
+        std::string &res = cache[path];
 
         std::vector<std::string> parts = splitPath(path);
         if (parts.empty()) {
-            return "";
+            return res;
         }
 
         std::vector<std::string> normalized;
@@ -1660,16 +2755,30 @@ namespace marble {
         }
 
         if (normalized.empty()) {
-            return "";
+            return res;
         }
 
-        std::string res = normalized[0];
+        res = normalized[0];
         for (int i = 1; i < normalized.size(); ++i) {
             res += "#" + normalized[i];
         }
         return res;
     }
 
+    void
+    CodeGen::pushModule(const std::string &name) {
+        _modulesPath.push_back(name);
+        _modulePrefix += name + "#";
+        _scopeCache = &_scopeCaches[_modulePrefix];
+    }
+
+    void
+    CodeGen::popModule() {
+        _modulePrefix.resize(_modulePrefix.size() - _modulesPath.back().size() - 1);
+        _modulesPath.pop_back();
+        _scopeCache = &_scopeCaches[_modulePrefix];
+    }
+
     std::string
     CodeGen::getModulePathFromExpr(Expr *expr) {
         std::string path;
@@ -1691,7 +2800,7 @@ namespace marble {
         return path;
     }
 
-    std::string
+    const std::string &
     CodeGen::resolveFullTypeName(const ASTType& type) {
         if (type.GetTypeKind() != ASTTypeKind::Struct && type.GetTypeKind() != ASTTypeKind::Trait) {
             return type.GetVal();
@@ -0,0 +1,268 @@
+#include <marble/CodeGen/EscapeAnalysis.h>
+
+namespace marble {
+    std::vector<EscapeAnalysis::PromotedAlloc>
+    EscapeAnalysis::Analyze(const std::vector<Stmt *> &body, const std::vector<std::string> &args) {
+        _scopes.clear();
+        _escaped.clear();
+        _candidates.clear();
+        _dels.clear();
+
+        _scopes.push_back({});
+        for (auto &arg : args) {
+            _scopes.back().emplace(arg, nullptr);
+        }
+        visitBlock(body);
+        _scopes.pop_back();
+
+        std::vector<PromotedAlloc> promoted;
+        for (auto *vds : _candidates) {
+            if (_escaped.find(vds) == _escaped.end()) {
+                promoted.push_back(PromotedAlloc { llvm::cast<NewExpr>(vds->GetExpr()), _dels[vds] });
+            }
+        }
+        return promoted;
+    }
+
+    void
+    EscapeAnalysis::VisitVarDeclStmt(VarDeclStmt *vds) {
+        if (vds->GetExpr()) {
+            Visit(vds->GetExpr());
+        }
+        VarDeclStmt *candidate = nullptr;
+        if (!vds->IsStatic() && vds->GetType().IsPointer() && vds->GetType().GetTypeKind() == ASTTypeKind::Struct &&
+            vds->GetExpr() && llvm::isa<NewExpr>(vds->GetExpr())) {
+            candidate = vds;
+            _candidates.push_back(vds);
+        }
+        _scopes.back()[vds->GetName()] = candidate;
+    }
+
+    void
+    EscapeAnalysis::VisitVarAsgnStmt(VarAsgnStmt *vas) {
+        Visit(vas->GetExpr());
+        if (vas->GetDerefDepth() == 0) {
+            if (VarDeclStmt *vds = lookup(vas->GetName())) {
+                _escaped.insert(vds);
+            }
+        }
+    }
+
+    void
+    EscapeAnalysis::VisitFunDeclStmt(FunDeclStmt *fds) {}
+
+    void
+    EscapeAnalysis::VisitFunCallStmt(FunCallStmt *fcs) {
+        for (auto *arg : fcs->GetArgs()) {
+            Visit(arg);
+        }
+    }
+
+    void
+    EscapeAnalysis::VisitRetStmt(RetStmt *rs) {
+        if (rs->GetExpr()) {
+            Visit(rs->GetExpr());
+        }
+    }
+
+    void
+    EscapeAnalysis::VisitIfElseStmt(IfElseStmt *ies) {
+        Visit(ies->GetCondition());
+        _scopes.push_back({});
+        visitBlock(ies->GetThenBody());
+        _scopes.pop_back();
+        _scopes.push_back({});
+        visitBlock(ies->GetElseBody());
+        _scopes.pop_back();
+    }
+
+    void
+    EscapeAnalysis::VisitForLoopStmt(ForLoopStmt *fls) {
+        _scopes.push_back({});
+        if (fls->GetIndexator()) {
+            Visit(fls->GetIndexator());
+        }
+        Visit(fls->GetCondition());
+        if (fls->GetIteration()) {
+            Visit(fls->GetIteration());
+        }
+        visitBlock(fls->GetBody());
+        _scopes.pop_back();
+    }
+
+    void
+    EscapeAnalysis::VisitBreakStmt(BreakStmt *bs) {}
+
+    void
+    EscapeAnalysis::VisitContinueStmt(ContinueStmt *cs) {}
+
+    void
+    EscapeAnalysis::VisitStructStmt(StructStmt *ss) {}
+
+    void
+    EscapeAnalysis::VisitFieldAsgnStmt(FieldAsgnStmt *fas) {
+        visitPointerUse(fas->GetObject());
+        Visit(fas->GetExpr());
+    }
+
+    void
+    EscapeAnalysis::VisitImplStmt(ImplStmt *is) {}
+
+    void
+    EscapeAnalysis::VisitMethodCallStmt(MethodCallStmt *mcs) {
+        visitExposedObject(mcs->GetObject());   // `this` may be stored by the method
+        for (auto *arg : mcs->GetArgs()) {
+            Visit(arg);
+        }
+    }
+
+    void
+    EscapeAnalysis::VisitTraitDeclStmt(TraitDeclStmt *tds) {}
+
+    void
+    EscapeAnalysis::VisitEchoStmt(EchoStmt *es) {
+        visitPointerUse(es->GetRHS());
+    }
+
+    void
+    EscapeAnalysis::VisitDelStmt(DelStmt *ds) {
+        if (VarExpr *ve = llvm::dyn_cast<VarExpr>(ds->GetExpr())) {
+            if (VarDeclStmt *vds = lookup(ve->GetName())) {
+                _dels[vds].push_back(ds);
+            }
+            return;
+        }
+        Visit(ds->GetExpr());
+    }
+
+    void
+    EscapeAnalysis::VisitImportStmt(ImportStmt *is) {}
+
+    void
+    EscapeAnalysis::VisitModuleDeclStmt(ModuleDeclStmt *mds) {}
+
+    void
+    EscapeAnalysis::VisitArenaStmt(ArenaStmt *as) {
+        _scopes.push_back({});
+        visitBlock(as->GetBody());
+        _scopes.pop_back();
+    }
+
+    void
+    EscapeAnalysis::VisitBinaryExpr(BinaryExpr *be) {
+        if (be->GetOp().GetKind() == TkEqEq || be->GetOp().GetKind() == TkNotEq) {
+            visitPointerUse(be->GetLHS());
+            visitPointerUse(be->GetRHS());
+            return;
+        }
+        Visit(be->GetLHS());
+        Visit(be->GetRHS());
+    }
+
+    void
+    EscapeAnalysis::VisitUnaryExpr(UnaryExpr *ue) {
+        Visit(ue->GetRHS());
+    }
+
+    void
+    EscapeAnalysis::VisitVarExpr(VarExpr *ve) {
+        if (VarDeclStmt *vds = lookup(ve->GetName())) {
+            _escaped.insert(vds);
+        }
+    }
+
+    void
+    EscapeAnalysis::VisitLiteralExpr(LiteralExpr *le) {}
+
+    void
+    EscapeAnalysis::VisitFunCallExpr(FunCallExpr *fce) {
+        for (auto *arg : fce->GetArgs()) {
+            Visit(arg);
+        }
+    }
+
+    void
+    EscapeAnalysis::VisitStructExpr(StructExpr *se) {
+        for (auto &[_, expr] : se->GetInitializer()) {
+            if (expr) {
+                Visit(expr);
+            }
+        }
+    }
+
+    void
+    EscapeAnalysis::VisitFieldAccessExpr(FieldAccessExpr *fae) {
+        visitPointerUse(fae->GetObject());
+    }
+
+    void
+    EscapeAnalysis::VisitMethodCallExpr(MethodCallExpr *mce) {
+        visitExposedObject(mce->GetObject());   // `this` may be stored by the method
+        for (auto *arg : mce->GetArgs()) {
+            Visit(arg);
+        }
+    }
+
+    void
+    EscapeAnalysis::VisitNilExpr(NilExpr *ne) {}
+
+    void
+    EscapeAnalysis::VisitDerefExpr(DerefExpr *de) {
+        visitPointerUse(de->GetExpr());
+    }
+
+    void
+    EscapeAnalysis::VisitRefExpr(RefExpr *re) {
+        visitExposedObject(re->GetExpr());
+    }
+
+    void
+    EscapeAnalysis::VisitNewExpr(NewExpr *ne) {
+        if (ne->GetStructExpr()) {
+            VisitStructExpr(ne->GetStructExpr());
+        }
+    }
+
+    void
+    EscapeAnalysis::visitBlock(const std::vector<Stmt *> &body) {
+        for (auto *stmt : body) {
+            Visit(stmt);
+        }
+    }
+
+    void
+    EscapeAnalysis::visitExposedObject(Expr *expr) {
+        // `&p`, `&p.field` and `&*p` all expose the object, as does a method called on `p.field` through its `this`
+        Expr *root = expr;
+        while (true) {
+            if (FieldAccessExpr *fae = llvm::dyn_cast<FieldAccessExpr>(root)) {
+                root = fae->GetObject();
+            }
+            else if (DerefExpr *de = llvm::dyn_cast<DerefExpr>(root)) {
+                root = de->GetExpr();
+            }
+            else {
+                break;
+            }
+        }
+        Visit(root);
+    }
+
+    void
+    EscapeAnalysis::visitPointerUse(Expr *expr) {
+        if (llvm::isa<VarExpr>(expr)) {
+            return;
+        }
+        Visit(expr);
+    }
+
+    VarDeclStmt *
+    EscapeAnalysis::lookup(const std::string &name) const {
+        for (auto scope = _scopes.rbegin(); scope != _scopes.rend(); ++scope) {
+            if (auto it = scope->find(name); it != scope->end()) {
+                return it->second;
+            }
+        }
+        return nullptr;
+    }
+}
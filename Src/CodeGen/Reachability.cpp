@@ -0,0 +1,258 @@
+#include <marble/CodeGen/Reachability.h>
+
+namespace marble {
+    std::unordered_set<FunDeclStmt *>
+    Reachability::Analyze(Module *root) {
+        _byName.clear();
+        _reachable.clear();
+        _worklist.clear();
+        _visitedFiles.clear();
+        _initializers.clear();
+
+        collectModule(root, true);
+        visitBlock(_initializers);
+        while (!_worklist.empty()) {
+            FunDeclStmt *fds = _worklist.back();
+            _worklist.pop_back();
+            visitBlock(fds->GetBody());
+        }
+        return std::move(_reachable);
+    }
+
+    void
+    Reachability::VisitVarDeclStmt(VarDeclStmt *vds) {
+        if (vds->GetExpr()) {
+            Visit(vds->GetExpr());
+        }
+    }
+
+    void
+    Reachability::VisitVarAsgnStmt(VarAsgnStmt *vas) {
+        Visit(vas->GetExpr());
+    }
+
+    void
+    Reachability::VisitFunDeclStmt(FunDeclStmt *fds) {}
+
+    void
+    Reachability::VisitFunCallStmt(FunCallStmt *fcs) {
+        reachName(fcs->GetName());
+        for (auto *arg : fcs->GetArgs()) {
+            Visit(arg);
+        }
+    }
+
+    void
+    Reachability::VisitRetStmt(RetStmt *rs) {
+        if (rs->GetExpr()) {
+            Visit(rs->GetExpr());
+        }
+    }
+
+    void
+    Reachability::VisitIfElseStmt(IfElseStmt *ies) {
+        Visit(ies->GetCondition());
+        visitBlock(ies->GetThenBody());
+        visitBlock(ies->GetElseBody());
+    }
+
+    void
+    Reachability::VisitForLoopStmt(ForLoopStmt *fls) {
+        if (fls->GetIndexator()) {
+            Visit(fls->GetIndexator());
+        }
+        Visit(fls->GetCondition());
+        if (fls->GetIteration()) {
+            Visit(fls->GetIteration());
+        }
+        visitBlock(fls->GetBody());
+    }
+
+    void
+    Reachability::VisitBreakStmt(BreakStmt *bs) {}
+
+    void
+    Reachability::VisitContinueStmt(ContinueStmt *cs) {}
+
+    void
+    Reachability::VisitStructStmt(StructStmt *ss) {
+        visitBlock(ss->GetBody());  // initializers of the fields
+    }
+
+    void
+    Reachability::VisitFieldAsgnStmt(FieldAsgnStmt *fas) {
+        Visit(fas->GetObject());
+        Visit(fas->GetExpr());
+    }
+
+    void
+    Reachability::VisitImplStmt(ImplStmt *is) {}
+
+    void
+    Reachability::VisitMethodCallStmt(MethodCallStmt *mcs) {
+        reachName(mcs->GetName());
+        Visit(mcs->GetObject());
+        for (auto *arg : mcs->GetArgs()) {
+            Visit(arg);
+        }
+    }
+
+    void
+    Reachability::VisitTraitDeclStmt(TraitDeclStmt *tds) {}
+
+    void
+    Reachability::VisitEchoStmt(EchoStmt *es) {
+        Visit(es->GetRHS());
+    }
+
+    void
+    Reachability::VisitDelStmt(DelStmt *ds) {
+        Visit(ds->GetExpr());
+    }
+
+    void
+    Reachability::VisitImportStmt(ImportStmt *is) {}
+
+    void
+    Reachability::VisitModuleDeclStmt(ModuleDeclStmt *mds) {}
+
+    void
+    Reachability::VisitArenaStmt(ArenaStmt *as) {
+        visitBlock(as->GetBody());
+    }
+
+    void
+    Reachability::VisitBinaryExpr(BinaryExpr *be) {
+        Visit(be->GetLHS());
+        Visit(be->GetRHS());
+    }
+
+    void
+    Reachability::VisitUnaryExpr(UnaryExpr *ue) {
+        Visit(ue->GetRHS());
+    }
+
+    void
+    Reachability::VisitVarExpr(VarExpr *ve) {}
+
+    void
+    Reachability::VisitLiteralExpr(LiteralExpr *le) {}
+
+    void
+    Reachability::VisitFunCallExpr(FunCallExpr *fce) {
+        reachName(fce->GetName());
+        for (auto *arg : fce->GetArgs()) {
+            Visit(arg);
+        }
+    }
+
+    void
+    Reachability::VisitStructExpr(StructExpr *se) {
+        for (auto &[_, expr] : se->GetInitializer()) {
+            if (expr) {
+                Visit(expr);
+            }
+        }
+    }
+
+    void
+    Reachability::VisitFieldAccessExpr(FieldAccessExpr *fae) {
+        Visit(fae->GetObject());
+    }
+
+    void
+    Reachability::VisitMethodCallExpr(MethodCallExpr *mce) {
+        reachName(mce->GetName());  // also the calls of module functions, e.g. `Std.Math.Abs(x)`
+        Visit(mce->GetObject());
+        for (auto *arg : mce->GetArgs()) {
+            Visit(arg);
+        }
+    }
+
+    void
+    Reachability::VisitNilExpr(NilExpr *ne) {}
+
+    void
+    Reachability::VisitDerefExpr(DerefExpr *de) {
+        Visit(de->GetExpr());
+    }
+
+    void
+    Reachability::VisitRefExpr(RefExpr *re) {
+        Visit(re->GetExpr());
+    }
+
+    void
+    Reachability::VisitNewExpr(NewExpr *ne) {
+        if (ne->GetStructExpr()) {
+            VisitStructExpr(ne->GetStructExpr());
+        }
+    }
+
+    // The modules of the paths of imports have no file and inline `mod` blocks are found in the AST of their file, so
+    // every file is collected once
+    void
+    Reachability::collectModule(Module *mod, bool isRoot) {
+        if (!mod->GetFullPath().empty()) {
+            if (!_visitedFiles.insert(mod->GetFullPath()).second) {
+                return;
+            }
+            collectStatements(mod->AST, isRoot);
+        }
+        for (auto &[_, submod] : mod->SubModules) {
+            collectModule(submod, false);
+        }
+    }
+
+    void
+    Reachability::collectStatements(const std::vector<Stmt *> &ast, bool isRoot) {
+        for (auto *stmt : ast) {
+            if (FunDeclStmt *fds = llvm::dyn_cast<FunDeclStmt>(stmt)) {
+                _byName[fds->GetName()].push_back(fds);
+                if (isRoot && (fds->GetName() == "main" || fds->GetAccess() == AccessPub)) {
+                    reach(fds);
+                }
+            }
+            else if (ImplStmt *is = llvm::dyn_cast<ImplStmt>(stmt)) {
+                for (auto *method : is->GetBody()) {
+                    FunDeclStmt *fds = llvm::cast<FunDeclStmt>(method);
+                    _byName[fds->GetName()].push_back(fds);
+                    if (!is->GetTraitName().empty() || (isRoot && fds->GetAccess() == AccessPub)) {
+                        reach(fds);
+                    }
+                }
+            }
+            else if (ModuleDeclStmt *mds = llvm::dyn_cast<ModuleDeclStmt>(stmt)) {
+                collectStatements(mds->GetBody(), isRoot);
+            }
+            else if (llvm::isa<VarDeclStmt>(stmt) || llvm::isa<StructStmt>(stmt)) {
+                _initializers.push_back(stmt);  // global variables and fields are generated with their module
+            }
+        }
+    }
+
+    void
+    Reachability::reach(FunDeclStmt *fds) {
+        if (_reachable.insert(fds).second) {
+            _worklist.push_back(fds);
+        }
+    }
+
+    void
+    Reachability::reachName(const std::string &name) {
+        auto it = _byName.find(name);
+        if (it == _byName.end()) {
+            return;
+        }
+        for (FunDeclStmt *fds : it->second) {
+            reach(fds);
+        }
+    }
+
+    void
+    Reachability::visitBlock(const std::vector<Stmt *> &body) {
+        for (auto *stmt : body) {
+            Visit(stmt);
+        }
+    }
+}
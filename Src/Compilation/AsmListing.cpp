@@ -0,0 +1,281 @@
+#include <marble/Compilation/AsmListing.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/MC/MCAsmInfo.h>
+#include <llvm/MC/MCContext.h>
+#include <llvm/MC/MCInst.h>
+#include <llvm/MC/MCObjectFileInfo.h>
+#include <llvm/MC/MCParser/MCAsmParser.h>
+#include <llvm/MC/MCParser/MCTargetAsmParser.h>
+#include <llvm/MC/MCSchedule.h>
+#include <llvm/MC/MCStreamer.h>
+#include <llvm/MC/MCSubtargetInfo.h>
+#include <llvm/MC/MCSymbol.h>
+#include <llvm/MC/MCTargetOptions.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <algorithm>
+#include <optional>
+
+namespace marble {
+    namespace {
+        struct InstrCost {
+            unsigned Latency = 0;
+            double Throughput = 0;      // reciprocal throughput, cycles until the next independent instruction can issue
+        };
+
+        struct FunctionCost {
+            std::string Name;
+            unsigned Instrs = 0;
+            uint64_t Latency = 0;
+            double Throughput = 0;
+        };
+
+        // Receives the instructions of the parsed assembly and prices them with the scheduling model, nothing is emitted
+        class CostStreamer : public llvm::MCStreamer {
+            const llvm::SourceMgr &_asmMgr;
+            const llvm::MCInstrInfo &_instrInfo;
+            llvm::DenseMap<unsigned, InstrCost> _lineCosts;       // by line of the assembly
+            llvm::DenseMap<unsigned, unsigned> _functionLines;    // line of the label of a function -> index in `_functions`
+            std::vector<FunctionCost> _functions;
+
+        public:
+            CostStreamer(llvm::MCContext &ctx, const llvm::SourceMgr &asmMgr, const llvm::MCInstrInfo &instrInfo)
+                       : llvm::MCStreamer(ctx), _asmMgr(asmMgr), _instrInfo(instrInfo) {}
+
+            void
+            emitLabel(llvm::MCSymbol *symbol, llvm::SMLoc loc) override {
+                llvm::MCStreamer::emitLabel(symbol, loc);
+                // the labels of blocks and of the compiler's own data are temporary, so this is a function
+                if (!symbol->isTemporary() && getCurrentSectionOnly()->getKind().isText()) {
+                    if (loc.isValid()) {
+                        _functionLines[_asmMgr.getLineAndColumn(loc).first] = _functions.size();
+                    }
+                    _functions.push_back(FunctionCost { symbol->getName().str() });
+                }
+            }
+
+            void
+            emitInstruction(const llvm::MCInst &inst, const llvm::MCSubtargetInfo &sti) override {
+                const llvm::MCSchedModel &model = sti.getSchedModel();
+                InstrCost cost;
+                if (model.hasInstrSchedModel()) {
+                    cost.Latency = std::max(model.computeInstrLatency(sti, _instrInfo, inst), 0);
+                    cost.Throughput = model.getReciprocalThroughput(sti, _instrInfo, inst);
+                }
+                if (inst.getLoc().isValid()) {
+                    _lineCosts[_asmMgr.getLineAndColumn(inst.getLoc()).first] = cost;
+                }
+                if (!_functions.empty()) {
+                    FunctionCost &fun = _functions.back();
+                    ++fun.Instrs;
+                    fun.Latency += cost.Latency;
+                    fun.Throughput += cost.Throughput;
+                }
+            }
+
+            bool
+            emitSymbolAttribute(llvm::MCSymbol *symbol, llvm::MCSymbolAttr attribute) override {
+                return true;
+            }
+
+            void
+            emitCommonSymbol(llvm::MCSymbol *symbol, uint64_t size, llvm::Align byteAlignment) override {}
+
+            void
+            emitZerofill(llvm::MCSection *section, llvm::MCSymbol *symbol, uint64_t size, llvm::Align byteAlignment,
+                         llvm::SMLoc loc) override {}
+
+            const InstrCost *
+            GetLineCost(unsigned line) const {
+                auto it = _lineCosts.find(line);
+                return it == _lineCosts.end() ? nullptr : &it->second;
+            }
+
+            const FunctionCost *
+            GetFunctionAt(unsigned line) const {
+                auto it = _functionLines.find(line);
+                return it == _functionLines.end() ? nullptr : &_functions[it->second];
+            }
+
+            const std::vector<FunctionCost> &
+            GetFunctions() const {
+                return _functions;
+            }
+        };
+
+        struct SourceFile {
+            std::string Name;
+            unsigned BufferID = 0;      // 0 if the file is not one of the sources
+        };
+    }
+
+    // Parses the assembly again to get the `MCInst` of every instruction, which the scheduling model works on
+    static bool
+    priceInstructions(CostStreamer &streamer, llvm::SourceMgr &asmMgr, llvm::MCContext &ctx, const llvm::TargetMachine &targetMachine) {
+        llvm::MCTargetOptions options;
+        std::unique_ptr<llvm::MCAsmParser> parser(llvm::createMCAsmParser(asmMgr, ctx, streamer, *targetMachine.getMCAsmInfo()));
+        std::unique_ptr<llvm::MCTargetAsmParser> targetParser(
+            targetMachine.getTarget().createMCAsmParser(*targetMachine.getMCSubtargetInfo(), *parser, *targetMachine.getMCInstrInfo(),
+                                                        options));
+        if (!targetParser) {
+            return false;
+        }
+        parser->setTargetParser(*targetParser);
+        return !parser->Run(false, true);
+    }
+
+    // Finds the buffer of `srcMgr` which CodeGen described as `dir`/`name` in the line tables
+    static unsigned
+    findSourceBuffer(llvm::SourceMgr &srcMgr, llvm::StringRef dir, llvm::StringRef name) {
+        llvm::SmallString<256> path(dir);
+        llvm::sys::path::append(path, name);
+        for (unsigned id = 1; id <= srcMgr.getNumBuffers(); ++id) {
+            llvm::StringRef bufferPath = srcMgr.getMemoryBuffer(id)->getBufferIdentifier();
+            llvm::StringRef bufferDir = llvm::sys::path::parent_path(bufferPath);
+            llvm::SmallString<256> filePath(bufferDir.empty() ? "." : bufferDir);
+            llvm::sys::path::append(filePath, llvm::sys::path::filename(bufferPath));
+            if (llvm::sys::path::remove_leading_dotslash(filePath) == llvm::sys::path::remove_leading_dotslash(path)) {
+                return id;
+            }
+        }
+        return 0;
+    }
+
+    static llvm::StringRef
+    getSourceLine(llvm::SourceMgr &srcMgr, unsigned bufferID, unsigned line) {
+        const llvm::MemoryBuffer *buffer = srcMgr.getMemoryBuffer(bufferID);
+        llvm::SMLoc loc = srcMgr.FindLocForLineAndColumn(bufferID, line, 1);
+        if (!loc.isValid()) {
+            return "";
+        }
+        llvm::StringRef rest(loc.getPointer(), buffer->getBufferEnd() - loc.getPointer());
+        return rest.substr(0, rest.find_first_of("\r\n")).trim();
+    }
+
+    // Parses the quoted strings of a `.file` directive, the directory is optional
+    static bool
+    parseFileDirective(llvm::StringRef args, llvm::StringRef &dir, llvm::StringRef &name) {
+        llvm::SmallVector<llvm::StringRef, 2> strings;
+        while (strings.size() < 2) {
+            size_t begin = args.find('"');
+            size_t end = begin == llvm::StringRef::npos ? begin : args.find('"', begin + 1);
+            if (end == llvm::StringRef::npos) {
+                break;
+            }
+            strings.push_back(args.slice(begin + 1, end));
+            args = args.drop_front(end + 1).ltrim();
+            if (!args.starts_with("\"")) {
+                break;      // `md5` and `source` follow the names
+            }
+        }
+        if (strings.empty()) {
+            return false;
+        }
+        dir = strings.size() == 2 ? strings[0] : "";
+        name = strings.back();
+        return true;
+    }
+
+    static unsigned
+    getColumn(llvm::StringRef line) {
+        unsigned column = 0;
+        for (char c : line) {
+            column = c == '\t' ? (column / 8 + 1) * 8 : column + 1;
+        }
+        return column;
+    }
+
+    void
+    WriteAsmListing(llvm::StringRef asmText, const llvm::TargetMachine &targetMachine, llvm::SourceMgr &srcMgr,
+                    llvm::raw_ostream &os) {
+        constexpr unsigned CostColumn = 56;
+        llvm::StringRef comment = targetMachine.getMCAsmInfo()->getCommentString();
+        const llvm::MCSubtargetInfo &sti = *targetMachine.getMCSubtargetInfo();
+
+        llvm::SourceMgr asmMgr;
+        asmMgr.AddNewSourceBuffer(llvm::MemoryBuffer::getMemBuffer(asmText, "<asm>", false), llvm::SMLoc());
+        asmMgr.setDiagHandler([](const llvm::SMDiagnostic &, void *) {});   // only the costs would be missing
+        llvm::MCContext ctx(targetMachine.getTargetTriple(), targetMachine.getMCAsmInfo(), targetMachine.getMCRegisterInfo(), &sti, &asmMgr);
+        std::unique_ptr<llvm::MCObjectFileInfo> objectFileInfo(targetMachine.getTarget().createMCObjectFileInfo(ctx, true));
+        ctx.setObjectFileInfo(objectFileInfo.get());
+        CostStreamer costs(ctx, asmMgr, *targetMachine.getMCInstrInfo());
+        bool priced = priceInstructions(costs, asmMgr, ctx, targetMachine) && sti.getSchedModel().hasInstrSchedModel();
+
+        os << comment << " Scheduling model: " << (priced ? sti.getCPU() : "none, costs are not available") << '\n';
+        llvm::DenseMap<unsigned, SourceFile> files;
+        std::optional<std::pair<unsigned, unsigned>> lastLoc;     // file number and line of the last annotation
+        bool inDebugSection = false;
+        unsigned lineNo = 0;
+        for (llvm::StringRef rest = asmText; !rest.empty();) {
+            auto [line, next] = rest.split('\n');
+            rest = next;
+            ++lineNo;
+            llvm::SmallVector<llvm::StringRef, 8> words;
+            llvm::SplitString(line, words);
+            llvm::StringRef directive = words.empty() ? "" : words[0];
+
+            if (directive.starts_with(".section") || directive == ".text" || directive == ".data" || directive == ".bss") {
+                inDebugSection = words.size() > 1 && (words[1].starts_with(".debug_") || words[1].starts_with("__DWARF"));
+            }
+            if (inDebugSection || directive == ".cfi_sections") {
+                continue;
+            }
+            unsigned number, srcLine;
+            if (directive == ".file" && words.size() > 2 && !words[1].getAsInteger(10, number)) {
+                llvm::StringRef dir, name;
+                if (parseFileDirective(llvm::StringRef(words[1].end(), line.end() - words[1].end()), dir, name)) {
+                    files[number] = SourceFile { llvm::sys::path::remove_leading_dotslash(name).str(), findSourceBuffer(srcMgr, dir, name) };
+                }
+                continue;
+            }
+            if (directive == ".loc") {
+                if (words.size() < 3 || words[1].getAsInteger(10, number) || words[2].getAsInteger(10, srcLine) || !srcLine ||
+                    lastLoc == std::make_pair(number, srcLine)) {
+                    continue;
+                }
+                auto it = files.find(number);
+                if (it == files.end()) {
+                    continue;
+                }
+                lastLoc = std::make_pair(number, srcLine);
+                os << comment << ' ' << it->second.Name << ':' << srcLine << ":  ";
+                if (it->second.BufferID) {
+                    os << getSourceLine(srcMgr, it->second.BufferID, srcLine);
+                }
+                os << '\n';
+                continue;
+            }
+
+            if (const FunctionCost *fun = costs.GetFunctionAt(lineNo)) {
+                os << '\n' << comment << ' ' << fun->Name << ": " << fun->Instrs << " instructions";
+                if (priced) {
+                    os << ", " << fun->Latency << " cycles of latency, " << llvm::format("%.2f", fun->Throughput)
+                       << " cycles of throughput";
+                }
+                os << '\n';
+                lastLoc.reset();
+            }
+            os << line;
+            const InstrCost *cost = priced ? costs.GetLineCost(lineNo) : nullptr;
+            if (cost) {
+                unsigned column = getColumn(line);
+                os.indent(column < CostColumn ? CostColumn - column : 1);
+                os << comment << " lat " << cost->Latency << ", rthru " << llvm::format("%.2f", cost->Throughput);
+            }
+            os << '\n';
+        }
+
+        std::vector<FunctionCost> functions = costs.GetFunctions();
+        std::stable_sort(functions.begin(), functions.end(), [](const FunctionCost &lhs, const FunctionCost &rhs) {
+            return lhs.Latency > rhs.Latency;
+        });
+        os << '\n' << comment << "   instrs    latency      rthru  function\n";
+        for (const FunctionCost &fun : functions) {
+            os << comment << llvm::format(" %8u %10llu %10.2f  ", fun.Instrs, static_cast<unsigned long long>(fun.Latency), fun.Throughput)
+               << fun.Name << '\n';
+        }
+    }
+}
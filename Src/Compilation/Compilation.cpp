@@ -1,14 +1,23 @@
+#include <marble/Compilation/AsmListing.h>
 #include <marble/Compilation/Compilation.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Support/CodeGen.h>
 #include <llvm/Support/Path.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Linker/Linker.h>
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
 #include <llvm/TargetParser/Host.h>
 
+#ifndef MARBLE_RUNTIME_LIB
+#define MARBLE_RUNTIME_LIB "libMarbleRuntime.a"
+#endif
+
 namespace marble {
     void
     InitializeLLVMTargets() {
@@ -19,8 +28,9 @@ namespace marble {
         llvm::InitializeAllAsmPrinters();
     }
 
-    bool
-    EmitObjectFile(llvm::Module *mod, const std::string &fileName, std::string targetTripleStr) {
+    // Sets the triple and the data layout of `mod`, returns nullptr if there is no such target
+    static std::unique_ptr<llvm::TargetMachine>
+    createTargetMachine(llvm::Module *mod, std::string targetTripleStr) {
         if (targetTripleStr.empty()) {
             targetTripleStr = llvm::sys::getDefaultTargetTriple();
         }
@@ -34,7 +44,7 @@ namespace marble {
 
         if (!target) {
             llvm::errs() << llvm::errs().RED << "Error looking up target: " << llvm::errs().RESET << error << '\n';
-            return false;
+            return nullptr;
         }
 
         std::string cpu = "generic";
@@ -43,9 +53,89 @@ namespace marble {
         llvm::TargetOptions opt;
         std::optional<llvm::Reloc::Model> rm = llvm::Reloc::Model::PIC_;
         
-        auto *targetMachine = target->createTargetMachine(triple.getTriple(), cpu, features, opt, rm);
+        std::unique_ptr<llvm::TargetMachine> targetMachine(target->createTargetMachine(triple.getTriple(), cpu, features, opt, rm));
 
         mod->setDataLayout(targetMachine->createDataLayout());
+        return targetMachine;
+    }
+
+    static bool
+    emitFile(llvm::Module *mod, llvm::TargetMachine &targetMachine, llvm::raw_pwrite_stream &dest, llvm::CodeGenFileType fileType) {
+        llvm::legacy::PassManager pass;
+
+        if (targetMachine.addPassesToEmitFile(pass, dest, nullptr, fileType)) {
+            llvm::errs() << llvm::errs().RED << "TargetMachine can't emit a file of this type\n" << llvm::errs().RESET;
+            return false;
+        }
+
+        pass.run(*mod);
+        return true;
+    }
+
+    static bool
+    emitFile(llvm::Module *mod, const std::string &fileName, std::string targetTripleStr, llvm::CodeGenFileType fileType) {
+        std::unique_ptr<llvm::TargetMachine> targetMachine = createTargetMachine(mod, targetTripleStr);
+        if (!targetMachine) {
+            return false;
+        }
+
+        std::error_code ec;
+        llvm::raw_fd_ostream dest(fileName, ec, fileType == llvm::CodeGenFileType::AssemblyFile ? llvm::sys::fs::OF_Text
+                                                                                                : llvm::sys::fs::OF_None);
+
+        if (ec) {
+            llvm::errs() << llvm::errs().RED << "Could not open file: " << ec.message() << '\n' << llvm::errs().RESET;
+            return false;
+        }
+
+        if (!emitFile(mod, *targetMachine, dest, fileType)) {
+            return false;
+        }
+        dest.flush();
+
+        return true;
+    }
+
+    bool
+    EmitObjectFile(llvm::Module *mod, const std::string &fileName, std::string targetTripleStr) {
+        return emitFile(mod, fileName, targetTripleStr, llvm::CodeGenFileType::ObjectFile);
+    }
+
+    bool
+    EmitAssemblyFile(llvm::Module *mod, const std::string &fileName, std::string targetTripleStr) {
+        return emitFile(mod, fileName, targetTripleStr, llvm::CodeGenFileType::AssemblyFile);
+    }
+
+    bool
+    EmitAnnotatedAssemblyFile(llvm::Module *mod, const std::string &fileName, llvm::SourceMgr &srcMgr, std::string targetTripleStr) {
+        std::unique_ptr<llvm::TargetMachine> targetMachine = createTargetMachine(mod, targetTripleStr);
+        if (!targetMachine) {
+            return false;
+        }
+
+        llvm::SmallString<0> asmText;
+        llvm::raw_svector_ostream asmStream(asmText);
+        if (!emitFile(mod, *targetMachine, asmStream, llvm::CodeGenFileType::AssemblyFile)) {
+            return false;
+        }
+
+        std::error_code ec;
+        llvm::raw_fd_ostream dest(fileName, ec, llvm::sys::fs::OF_Text);
+
+        if (ec) {
+            llvm::errs() << llvm::errs().RED << "Could not open file: " << ec.message() << '\n' << llvm::errs().RESET;
+            return false;
+        }
+
+        WriteAsmListing(asmText, *targetMachine, srcMgr, dest);
+        return true;
+    }
+
+    bool
+    EmitThinLTOBitcode(llvm::Module *mod, const std::string &fileName, std::string targetTripleStr) {
+        if (!createTargetMachine(mod, targetTripleStr)) {
+            return false;
+        }
 
         std::error_code ec;
         llvm::raw_fd_ostream dest(fileName, ec, llvm::sys::fs::OF_None);
@@ -55,24 +145,51 @@ namespace marble {
             return false;
         }
 
-        llvm::legacy::PassManager pass;
-        auto fileType = llvm::CodeGenFileType::ObjectFile;
+        llvm::ProfileSummaryInfo psi(*mod);
+        llvm::ModuleSummaryIndex index = llvm::buildModuleSummaryIndex(*mod, nullptr, &psi);
+        llvm::WriteBitcodeToFile(*mod, dest, false, &index);
+        return true;
+    }
 
-        if (targetMachine->addPassesToEmitFile(pass, dest, nullptr, fileType)) {
-            llvm::errs() << llvm::errs().RED << "TargetMachine can't emit a file of this type\n" << llvm::errs().RESET;
+    bool
+    EmitBitcodeFile(llvm::Module *mod, const std::string &fileName) {
+        std::error_code ec;
+        llvm::raw_fd_ostream dest(fileName, ec, llvm::sys::fs::OF_None);
+
+        if (ec) {
+            llvm::errs() << llvm::errs().RED << "Could not open file: " << ec.message() << '\n' << llvm::errs().RESET;
             return false;
         }
 
-        pass.run(*mod);
-        dest.flush();
+        llvm::WriteBitcodeToFile(*mod, dest);
+        return true;
+    }
 
+    bool
+    LinkModules(llvm::Module &dest, llvm::ArrayRef<llvm::Module *> srcs) {
+        for (llvm::Module *src : srcs) {
+            if (llvm::Linker::linkModules(dest, std::unique_ptr<llvm::Module>(src))) {
+                return false;
+            }
+        }
         return true;
     }
 
-    void
-    LinkObjectFile(const std::string &objFile, const std::string &exeFile) {
-        std::string cmd = "clang " + objFile + " -o " + exeFile;
-        system(cmd.c_str());
+    bool
+    LinkObjectFiles(const std::vector<std::string> &objFiles, const std::string &exeFile, bool thinLTO) {
+        std::string cmd = "clang";
+        if (thinLTO) {
+            cmd += " -flto=thin -fuse-ld=lld";
+        }
+        for (const std::string &objFile : objFiles) {
+            cmd += " " + objFile;
+        }
+        cmd += std::string(" ") + MARBLE_RUNTIME_LIB + " -o " + exeFile;
+        if (system(cmd.c_str()) != 0) {
+            llvm::errs() << llvm::errs().RED << "Could not link " << llvm::errs().RESET << '`' << exeFile << "`: `" << cmd << "` failed\n";
+            return false;
+        }
+        return true;
     }
 
     std::string
@@ -1,10 +1,100 @@
 #include <marble/Compilation/Optimizer.h>
+#include <llvm/Passes/StandardInstrumentations.h>
+#include <llvm/Support/raw_ostream.h>
+#include <map>
+#include <set>
+#include <vector>
 
 namespace marble {
-    void
-    Optimizer::Optimize(llvm::Module &mod, Level level) {
-        if (level == Level::O0) {
-            return;
+    static llvm::OptimizationLevel
+    toLLVMLevel(int level) {
+        switch (level) {
+            case Optimizer::O1:
+                return llvm::OptimizationLevel::O1;
+            case Optimizer::O2:
+                return llvm::OptimizationLevel::O2;
+            case Optimizer::O3:
+                return llvm::OptimizationLevel::O3;
+            default:
+                return llvm::OptimizationLevel::O0;
+        }
+    }
+
+    // Functions with `@opt(N)` are made `optnone` for the time the pipeline of the program runs. `optnone` is
+    // incompatible with these attributes, so they are taken away and restored afterwards. Functions are kept by their
+    // names, as a pipeline may delete the ones which are not used anymore.
+    static const llvm::Attribute::AttrKind hiddenAttrs[] = {
+        llvm::Attribute::AlwaysInline,
+        llvm::Attribute::OptimizeForSize,
+        llvm::Attribute::MinSize,
+        llvm::Attribute::OptimizeNone,
+        llvm::Attribute::NoInline,
+    };
+
+    struct HiddenFunction {
+        std::string Name;
+        std::vector<llvm::Attribute> Attrs;     // the ones of `hiddenAttrs` the function had
+    };
+
+    static std::vector<HiddenFunction>
+    hideFunctions(llvm::Module &mod, const std::set<std::string> &visible) {
+        std::vector<HiddenFunction> hidden;
+        for (llvm::Function &fun : mod) {
+            if (fun.isDeclaration() || fun.hasOptNone() || visible.count(fun.getName().str())) {
+                continue;
+            }
+            HiddenFunction hf { fun.getName().str(), {} };
+            for (llvm::Attribute::AttrKind kind : hiddenAttrs) {
+                if (fun.hasFnAttribute(kind)) {
+                    hf.Attrs.push_back(fun.getFnAttribute(kind));
+                    fun.removeFnAttr(kind);
+                }
+            }
+            fun.addFnAttr(llvm::Attribute::OptimizeNone);
+            fun.addFnAttr(llvm::Attribute::NoInline);
+            hidden.push_back(std::move(hf));
+        }
+        return hidden;
+    }
+
+    static void
+    restoreFunctions(llvm::Module &mod, const std::vector<HiddenFunction> &hidden) {
+        for (const HiddenFunction &hf : hidden) {
+            llvm::Function *fun = mod.getFunction(hf.Name);
+            if (!fun) {
+                continue;
+            }
+            fun->removeFnAttr(llvm::Attribute::OptimizeNone);
+            fun->removeFnAttr(llvm::Attribute::NoInline);
+            for (const llvm::Attribute &attr : hf.Attrs) {
+                fun->addFnAttr(attr);
+            }
+        }
+    }
+
+    bool
+    Optimizer::Optimize(llvm::Module &mod, Level level, const std::string &passes, bool printPipeline, bool thinLTOPreLink) {
+        // functions with `@opt(N)` by their level, the other ones are optimized by the pipeline of the whole program
+        std::map<int, std::set<std::string>> groups;
+        std::set<std::string> program;
+        for (llvm::Function &fun : mod) {
+            if (fun.isDeclaration() || fun.hasOptNone()) {
+                continue;
+            }
+            int funLevel = -1;
+            if (fun.hasFnAttribute("marble-opt-level")) {
+                fun.getFnAttribute("marble-opt-level").getValueAsString().getAsInteger(10, funLevel);
+            }
+            if (funLevel > 0 && (funLevel != level || !passes.empty())) {
+                groups[funLevel].insert(fun.getName().str());
+            }
+            else {
+                program.insert(fun.getName().str());
+            }
+        }
+        bool optimizeProgram = !passes.empty() || level != Level::O0;
+        if (!optimizeProgram && groups.empty()) {
+            return true;
         }
 
         llvm::LoopAnalysisManager LAM;
@@ -12,7 +102,11 @@ namespace marble {
         llvm::CGSCCAnalysisManager CGAM;
         llvm::ModuleAnalysisManager MAM;
 
-        llvm::PassBuilder PB;
+        // the standard instrumentations make the passes skip `optnone` functions
+        llvm::PassInstrumentationCallbacks PIC;
+        llvm::StandardInstrumentations SI(mod.getContext(), false);
+        SI.registerCallbacks(PIC, &MAM);
+        llvm::PassBuilder PB(nullptr, llvm::PipelineTuningOptions(), std::nullopt, &PIC);
 
         PB.registerModuleAnalyses(MAM);
         PB.registerCGSCCAnalyses(CGAM);
@@ -20,26 +114,59 @@ namespace marble {
         PB.registerLoopAnalyses(LAM);
         PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
 
-        llvm::OptimizationLevel LLVMLvl;
-        switch (level) {
-            case Level::O1:
-                LLVMLvl = llvm::OptimizationLevel::O1;
-                break;
-            case Level::O2:
-                LLVMLvl = llvm::OptimizationLevel::O2;
-                break;
-            case Level::O3:
-                LLVMLvl = llvm::OptimizationLevel::O3;
-                break;
-            default:
-                LLVMLvl = llvm::OptimizationLevel::O0;
-                break;
-        }
+        auto printPassName = [&PIC](llvm::StringRef className) {
+            llvm::StringRef passName = PIC.getPassNameForClassName(className);
+            return passName.empty() ? className : passName;
+        };
 
-        llvm::ModulePassManager MPM;
+        if (optimizeProgram) {
+            llvm::ModulePassManager MPM;
+            if (!passes.empty()) {
+                if (llvm::Error err = PB.parsePassPipeline(MPM, passes)) {
+                    llvm::errs() << llvm::errs().RED << "Invalid pass pipeline: " << llvm::toString(std::move(err)) << llvm::errs().RESET << "\n";
+                    return false;
+                }
+            }
+            else {
+                MPM = thinLTOPreLink ? PB.buildThinLTOPreLinkDefaultPipeline(toLLVMLevel(level))
+                                     : PB.buildPerModuleDefaultPipeline(toLLVMLevel(level));
+            }
+            if (printPipeline) {
+                if (!groups.empty()) {
+                    llvm::outs() << "; program\n";
+                }
+                MPM.printPipeline(llvm::outs(), printPassName);
+                llvm::outs() << "\n";
+            }
 
-        MPM = PB.buildPerModuleDefaultPipeline(LLVMLvl);
+            std::vector<HiddenFunction> hidden;
+            if (!groups.empty()) {
+                hidden = hideFunctions(mod, program);
+            }
+            MPM.run(mod, MAM);
+            restoreFunctions(mod, hidden);
+        }
 
-        MPM.run(mod, MAM);
+        // the functions of a level are simplified one by one, what needs the whole program (e.g. inlining into them) is
+        // left to the pipeline of the program
+        llvm::ThinOrFullLTOPhase phase = thinLTOPreLink ? llvm::ThinOrFullLTOPhase::ThinLTOPreLink : llvm::ThinOrFullLTOPhase::None;
+        for (auto &[groupLevel, funs] : groups) {
+            llvm::FunctionPassManager FPM = PB.buildFunctionSimplificationPipeline(toLLVMLevel(groupLevel), phase);
+            if (printPipeline) {
+                llvm::outs() << "; @opt(" << groupLevel << "):";
+                for (const std::string &name : funs) {
+                    llvm::outs() << " " << name;
+                }
+                llvm::outs() << "\n";
+                FPM.printPipeline(llvm::outs(), printPassName);
+                llvm::outs() << "\n";
+            }
+            for (const std::string &name : funs) {
+                if (llvm::Function *fun = mod.getFunction(name)) {
+                    FPM.run(*fun, FAM);
+                }
+            }
+        }
+        return true;
     }
 }
@@ -0,0 +1,108 @@
+#include <marble/Compilation/Remarks.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/Function.h>
+#include <llvm/Support/Path.h>
+
+namespace marble {
+    std::unique_ptr<RemarkHandler>
+    RemarkHandler::Create(llvm::SourceMgr &srcMgr, DiagnosticEngine &diag, const std::string &passed, const std::string &missed,
+                          const std::string &analysis, std::string &error) {
+        std::unique_ptr<RemarkHandler> handler = std::make_unique<RemarkHandler>(srcMgr, diag);
+        auto compile = [&error](const std::string &pattern, std::optional<llvm::Regex> &regex) {
+            if (pattern.empty()) {
+                return true;
+            }
+            regex.emplace(pattern);
+            return regex->isValid(error);
+        };
+        if (!compile(passed, handler->_passed) || !compile(missed, handler->_missed) || !compile(analysis, handler->_analysis)) {
+            return nullptr;
+        }
+        return handler;
+    }
+
+    bool
+    RemarkHandler::handleDiagnostics(const llvm::DiagnosticInfo &di) {
+        const llvm::DiagnosticInfoOptimizationBase *remark = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&di);
+        if (!remark) {
+            return false;   // everything else is printed by LLVM
+        }
+        if (!remark->isEnabled()) {
+            return true;
+        }
+        DiagKind kind;
+        switch (remark->getKind()) {
+            case llvm::DK_OptimizationRemark:
+            case llvm::DK_MachineOptimizationRemark:
+                kind = RemarkOptPassed;
+                break;
+            case llvm::DK_OptimizationRemarkMissed:
+            case llvm::DK_MachineOptimizationRemarkMissed:
+            case llvm::DK_OptimizationFailure:
+                kind = RemarkOptMissed;
+                break;
+            default:
+                kind = RemarkOptAnalysis;
+                break;
+        }
+
+        std::string msg = remark->getMsg();
+        llvm::SMLoc loc;
+        if (remark->isLocationAvailable()) {
+            llvm::DiagnosticLocation diLoc = remark->getLocation();
+            loc = findLoc(diLoc.getAbsolutePath(), diLoc.getLine(), diLoc.getColumn());
+        }
+        if (!loc.isValid()) {
+            msg = "in function `" + remark->getFunction().getName().str() + "`: " + msg;
+        }
+        // remarks point at the start of a statement, the range covers its first word
+        llvm::SMRange range(loc, loc);
+        if (loc.isValid()) {
+            const char *end = loc.getPointer();
+            while (std::isalnum(static_cast<unsigned char>(*end)) || *end == '_') {
+                ++end;
+            }
+            range = llvm::SMRange(loc, llvm::SMLoc::getFromPointer(end));
+        }
+        _diag.Report(loc, kind)
+            << range
+            << std::string(remark->getPassName())
+            << msg;
+        return true;
+    }
+
+    bool
+    RemarkHandler::isAnalysisRemarkEnabled(llvm::StringRef passName) const {
+        return _analysis && _analysis->match(passName);
+    }
+
+    bool
+    RemarkHandler::isMissedOptRemarkEnabled(llvm::StringRef passName) const {
+        return _missed && _missed->match(passName);
+    }
+
+    bool
+    RemarkHandler::isPassedOptRemarkEnabled(llvm::StringRef passName) const {
+        return _passed && _passed->match(passName);
+    }
+
+    bool
+    RemarkHandler::isAnyRemarkEnabled() const {
+        return _passed || _missed || _analysis;
+    }
+
+    llvm::SMLoc
+    RemarkHandler::findLoc(llvm::StringRef path, unsigned line, unsigned col) const {
+        for (unsigned id = 1; id <= _srcMgr.getNumBuffers(); ++id) {
+            // the same path as the `DIFile` CodeGen creates for the buffer
+            llvm::StringRef bufferPath = _srcMgr.getMemoryBuffer(id)->getBufferIdentifier();
+            llvm::StringRef dir = llvm::sys::path::parent_path(bufferPath);
+            llvm::SmallString<256> filePath(dir.empty() ? "." : dir);
+            llvm::sys::path::append(filePath, llvm::sys::path::filename(bufferPath));
+            if (llvm::sys::path::remove_leading_dotslash(filePath) == llvm::sys::path::remove_leading_dotslash(path)) {
+                return _srcMgr.FindLocForLineAndColumn(id, line, col ? col : 1);
+            }
+        }
+        return llvm::SMLoc();
+    }
+}
@@ -0,0 +1,830 @@
+#include <marble/Interp/Interpreter.h>
+#include <marble/Sema/ConstEvaluator.h>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace marble {
+    static ASTVal
+    makePointer(ASTType type, ASTVal *target) {
+        ASTValData data;
+        data.ptrVal = target;
+        return ASTVal(type, data, target == nullptr, false);
+    }
+
+    static bool
+    isPointerLike(const ASTVal &val) {
+        return val.GetType().IsPointer() || val.GetType().GetTypeKind() == ASTTypeKind::Nil;
+    }
+
+    Interpreter::~Interpreter() {
+        for (ASTVal *obj : _heap) {
+            delete obj;
+        }
+    }
+
+    int
+    Interpreter::Run() {
+        declareMod(_rootMod);
+        initGlobals();
+
+        auto main = _functions.find("main");
+        if (main == _functions.end()) {
+            llvm::errs() << llvm::errs().RED << "Error: " << llvm::errs().RESET << "function `main` is not declared\n";
+            return 1;
+        }
+        std::vector<ASTVal> args;
+        std::vector<Argument> mainArgs = main->second.Decl->GetArgs();
+        for (int i = 0; i < mainArgs.size(); ++i) {
+            ASTType type = mainArgs[i].GetType();
+            if (i == 0 && !type.IsPointer() && type.GetTypeKind() >= ASTTypeKind::Char && type.GetTypeKind() <= ASTTypeKind::I64) {
+                ASTValData data;
+                data.i32Val = 1;    // argc, the interpreter does not pass arguments to the program
+                args.push_back(ASTVal(ASTType(ASTTypeKind::I32, "i32", false, 0), data, false, false));
+            }
+            else {
+                args.push_back(defaultValue(type, {}, false));
+            }
+        }
+        ASTVal res = call(main->second, nullptr, args);
+        llvm::outs().flush();
+
+        ASTType resType = res.GetType();
+        if (resType.IsPointer() || resType.GetTypeKind() < ASTTypeKind::Char || resType.GetTypeKind() > ASTTypeKind::I64) {
+            return 0;
+        }
+        return ConstEvaluator::Convert(res, ASTType(ASTTypeKind::I32, "i32", false, 0))->GetData().i32Val;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitVarDeclStmt(VarDeclStmt *vds) {
+        if (vds->IsStatic()) {
+            auto it = _statics.find(vds);
+            if (it == _statics.end()) {
+                ASTVal val = vds->GetExpr() ? convert(eval(vds->GetExpr()), vds->GetType())
+                                            : defaultValue(vds->GetType(), _frames.back().Path, true);
+                it = _statics.emplace(vds, val).first;
+            }
+            _frames.back().Statics[vds->GetName()] = &it->second;
+            return std::nullopt;
+        }
+        ASTVal val = vds->GetExpr() ? convert(eval(vds->GetExpr()), vds->GetType())
+                                    : defaultValue(vds->GetType(), _frames.back().Path, true);
+        _frames.back().Scopes.back().insert_or_assign(vds->GetName(), val);
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitVarAsgnStmt(VarAsgnStmt *vas) {
+        ASTVal val = eval(vas->GetExpr());
+        ASTVal *dest = lookupVar(vas->GetName());
+        if (!dest) {
+            fatal("unknown variable `" + vas->GetName() + "`", vas->GetStartLoc());
+        }
+        for (unsigned char dd = vas->GetDerefDepth(); dd > 0; --dd) {
+            if (!dest->GetData().ptrVal) {
+                fatal("Null pointer dereference", vas->GetStartLoc());
+            }
+            dest = dest->GetData().ptrVal;
+        }
+        store(dest, val);
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitFunDeclStmt(FunDeclStmt *fds) {
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitFunCallStmt(FunCallStmt *fcs) {
+        callFunction(fcs->GetName(), fcs->GetArgs(), fcs->GetStartLoc());
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitRetStmt(RetStmt *rs) {
+        _retVal = rs->GetExpr() ? std::optional<ASTVal>(eval(rs->GetExpr())) : std::nullopt;
+        _flow = Flow::Return;
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitIfElseStmt(IfElseStmt *ies) {
+        if (ConstEvaluator::IsTrue(eval(ies->GetCondition()))) {
+            execBlock(ies->GetThenBody());
+        }
+        else {
+            execBlock(ies->GetElseBody());
+        }
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitForLoopStmt(ForLoopStmt *fls) {
+        _frames.back().Scopes.push_back({});
+        if (fls->GetIndexator()) {
+            Visit(fls->GetIndexator());
+        }
+        std::vector<Stmt *> body = fls->GetBody();
+        while (!fls->GetCondition() || ConstEvaluator::IsTrue(eval(fls->GetCondition()))) {
+            execBlock(body);
+            if (_flow == Flow::Return) {
+                break;
+            }
+            if (_flow == Flow::Break) {
+                _flow = Flow::Normal;
+                break;
+            }
+            _flow = Flow::Normal;
+            if (fls->GetIteration()) {
+                Visit(fls->GetIteration());
+            }
+        }
+        _frames.back().Scopes.pop_back();
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitBreakStmt(BreakStmt *bs) {
+        _flow = Flow::Break;
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitContinueStmt(ContinueStmt *cs) {
+        _flow = Flow::Continue;
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitStructStmt(StructStmt *ss) {
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitFieldAsgnStmt(FieldAsgnStmt *fas) {
+        ASTVal val = eval(fas->GetExpr());
+        ASTVal *dest;
+        if (fas->IsStaticAccessing()) {
+            dest = &_globals.at(resolveStruct(fas->GetObjType().GetVal(), _frames.back().Path) + "." + fas->GetName());
+        }
+        else if (fas->GetObjType().GetTypeKind() == ASTTypeKind::Mod) {
+            dest = getModuleVar(fas->GetObject(), fas->GetName());
+        }
+        else {
+            dest = getField(getObject(fas->GetObject(), fas->GetObjType(), fas->GetStartLoc()), fas->GetName());
+        }
+        store(dest, val);
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitImplStmt(ImplStmt *is) {
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitMethodCallStmt(MethodCallStmt *mcs) {
+        callMethod(mcs->GetObject(), mcs->GetObjType(), mcs->IsStaticAccessing(), mcs->GetName(), mcs->GetArgs(), mcs->GetStartLoc());
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitTraitDeclStmt(TraitDeclStmt *tds) {
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitEchoStmt(EchoStmt *es) {
+        echo(eval(es->GetRHS()));
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitDelStmt(DelStmt *ds) {
+        ASTVal *ptr = getAddress(ds->GetExpr());
+        ASTVal *obj = ptr->GetData().ptrVal;
+        if (obj && _heap.erase(obj)) {  // objects of arenas are freed with their arena
+            delete obj;
+        }
+        *ptr = makePointer(ptr->GetType(), nullptr);
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitImportStmt(ImportStmt *is) {
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitModuleDeclStmt(ModuleDeclStmt *mds) {
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitArenaStmt(ArenaStmt *as) {
+        _arenas.push_back({});
+        execBlock(as->GetBody());
+        _arenas.pop_back();
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitBinaryExpr(BinaryExpr *be) {
+        if (be->GetConstVal()) {
+            return *be->GetConstVal();
+        }
+        ASTVal lhs = eval(be->GetLHS());
+        ASTVal rhs = eval(be->GetRHS());
+        TokenKind op = be->GetOp().GetKind();
+        if (isPointerLike(lhs) || isPointerLike(rhs)) {
+            if (op != TkEqEq && op != TkNotEq) {
+                fatal("pointer arithmetic is not supported by the interpreter", be->GetStartLoc());
+            }
+            ASTVal *lhsPtr = isPointerLike(lhs) ? lhs.GetData().ptrVal : nullptr;
+            ASTVal *rhsPtr = isPointerLike(rhs) ? rhs.GetData().ptrVal : nullptr;
+            ASTValData data;
+            data.boolVal = (lhsPtr == rhsPtr) == (op == TkEqEq);
+            return ASTVal(ASTType(ASTTypeKind::Bool, "bool", false, 0), data, false, false);
+        }
+        std::string error;
+        std::optional<ASTVal> res = ConstEvaluator::BinaryOp(op, lhs, rhs, error);
+        if (!res) {
+            fatal(error, be->GetStartLoc());
+        }
+        return res;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitUnaryExpr(UnaryExpr *ue) {
+        if (ue->GetConstVal()) {
+            return *ue->GetConstVal();
+        }
+        std::string error;
+        std::optional<ASTVal> res = ConstEvaluator::UnaryOp(ue->GetOp().GetKind(), eval(ue->GetRHS()), error);
+        if (!res) {
+            fatal(error, ue->GetStartLoc());
+        }
+        return res;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitVarExpr(VarExpr *ve) {
+        if (ve->GetConstVal()) {
+            return *ve->GetConstVal();
+        }
+        ASTVal *var = lookupVar(ve->GetName());
+        if (!var) {
+            fatal("unknown variable `" + ve->GetName() + "`", ve->GetStartLoc());
+        }
+        return *var;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitLiteralExpr(LiteralExpr *le) {
+        return le->GetVal();
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitFunCallExpr(FunCallExpr *fce) {
+        if (fce->GetConstVal()) {   // `const fun` evaluated by Sema
+            return *fce->GetConstVal();
+        }
+        return callFunction(fce->GetName(), fce->GetArgs(), fce->GetStartLoc());
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitStructExpr(StructExpr *se) {
+        std::string mangled = resolveStruct(se->GetName(), _frames.back().Path);
+        const StructInfo &info = getStruct(mangled, se->GetStartLoc());
+        ASTVal val = defaultValue(ASTType(ASTTypeKind::Struct, se->GetName(), false, 0), _frames.back().Path, false);
+        for (auto &[name, expr] : se->GetInitializer()) {
+            size_t index = info.Indexes.at(name);
+            val.GetFields()[index] = convert(eval(expr), info.Fields[index]->GetType());
+        }
+        return val;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitFieldAccessExpr(FieldAccessExpr *fae) {
+        if (fae->IsStaticAccessing()) {
+            return _globals.at(resolveStruct(fae->GetObjType().GetVal(), _frames.back().Path) + "." + fae->GetName());
+        }
+        if (fae->GetObjType().GetTypeKind() == ASTTypeKind::Mod) {
+            return *getModuleVar(fae->GetObject(), fae->GetName());
+        }
+        size_t temps = _frames.back().Temps.size();
+        ASTVal val = *getField(getObject(fae->GetObject(), fae->GetObjType(), fae->GetStartLoc()), fae->GetName());
+        if (val.GetType().GetTypeKind() != ASTTypeKind::Trait) {
+            _frames.back().Temps.resize(temps);     // frees the copy of an rvalue object
+        }
+        return val;
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitMethodCallExpr(MethodCallExpr *mce) {
+        return callMethod(mce->GetObject(), mce->GetObjType(), mce->IsStaticAccessing(), mce->GetName(), mce->GetArgs(), mce->GetStartLoc());
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitNilExpr(NilExpr *ne) {
+        return makePointer(ASTType(ASTTypeKind::Nil, "nil", false, 0), nullptr);
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitDerefExpr(DerefExpr *de) {
+        ASTVal ptr = eval(de->GetExpr());
+        if (!ptr.GetType().IsPointer()) {
+            return ptr;
+        }
+        return deref(ptr, de->GetStartLoc());
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitRefExpr(RefExpr *re) {
+        ASTVal *target = getAddress(re->GetExpr());
+        return makePointer(target->GetType().Ref(), target);
+    }
+
+    std::optional<ASTVal>
+    Interpreter::VisitNewExpr(NewExpr *ne) {
+        ASTVal val = ne->GetStructExpr() ? *VisitStructExpr(ne->GetStructExpr())
+                                         : defaultValue(ne->GetType(), _frames.back().Path, false);
+        ASTVal *obj = new ASTVal(val);
+        if (!_arenas.empty()) {
+            _arenas.back().emplace_back(obj);
+        }
+        else {
+            _heap.insert(obj);
+        }
+        return makePointer(ne->GetType().Ref(), obj);
+    }
+
+    void
+    Interpreter::declareMod(Module *mod) {
+        for (auto &[_, importedMod] : mod->Imports) {
+            declareMod(importedMod);
+        }
+
+        declareStatements(mod->AST);
+
+        for (auto &[name, submod] : mod->SubModules) {
+            _modulesPath.push_back(name);
+            _modules.insert(getMangledName(_modulesPath, ""));
+            declareMod(submod);
+            _modulesPath.pop_back();
+        }
+    }
+
+    void
+    Interpreter::declareStatements(const std::vector<Stmt *> &ast) {
+        // a module declared in a file is also a submodule of it, so the first declaration of a name wins
+        for (auto *stmt : ast) {
+            if (FunDeclStmt *fds = llvm::dyn_cast<FunDeclStmt>(stmt)) {
+                _functions.emplace(getMangledName(_modulesPath, fds->GetName()), FunInfo { fds, _modulesPath });
+            }
+            else if (ImplStmt *is = llvm::dyn_cast<ImplStmt>(stmt)) {
+                std::string structName = getMangledName(_modulesPath, is->GetStructName());
+                for (auto *method : is->GetBody()) {
+                    FunDeclStmt *fds = llvm::cast<FunDeclStmt>(method);
+                    _functions.emplace(structName + "." + fds->GetName(), FunInfo { fds, _modulesPath });
+                }
+            }
+            else if (StructStmt *ss = llvm::dyn_cast<StructStmt>(stmt)) {
+                std::string mangled = getMangledName(_modulesPath, ss->GetName());
+                if (_structs.count(mangled)) {
+                    continue;
+                }
+                StructInfo info { .Fields = {}, .Indexes = {}, .Path = _modulesPath };
+                for (auto *field : ss->GetBody()) {
+                    VarDeclStmt *vds = llvm::cast<VarDeclStmt>(field);
+                    if (vds->IsStatic()) {
+                        _globalDecls.push_back(GlobalInfo { vds, mangled + "." + vds->GetName(), _modulesPath, true });
+                    }
+                    else {
+                        info.Indexes.emplace(vds->GetName(), info.Fields.size());
+                        info.Fields.push_back(vds);
+                    }
+                }
+                _structs.emplace(mangled, info);
+            }
+            else if (VarDeclStmt *vds = llvm::dyn_cast<VarDeclStmt>(stmt)) {
+                _globalDecls.push_back(GlobalInfo { vds, getMangledName(_modulesPath, vds->GetName()), _modulesPath, false });
+            }
+            else if (ModuleDeclStmt *mds = llvm::dyn_cast<ModuleDeclStmt>(stmt)) {
+                _modulesPath.push_back(mds->GetName());
+                _modules.insert(getMangledName(_modulesPath, ""));
+                declareStatements(mds->GetBody());
+                _modulesPath.pop_back();
+            }
+        }
+    }
+
+    void
+    Interpreter::initGlobals() {
+        for (auto &global : _globalDecls) {
+            if (_globals.count(global.Mangled)) {
+                continue;
+            }
+            _frames.push_back(Frame { .Path = global.Path, .This = nullptr, .Scopes = { {} }, .Statics = {}, .Temps = {} });
+            VarDeclStmt *vds = global.Decl;
+            ASTVal val = vds->GetExpr() ? convert(eval(vds->GetExpr()), vds->GetType())
+                                        : defaultValue(vds->GetType(), global.Path, true);
+            _frames.pop_back();
+            ASTVal *var = &_globals.emplace(global.Mangled, val).first->second;
+            if (!global.IsStaticField) {
+                _globalsByName.emplace(vds->GetName(), var);
+            }
+        }
+    }
+
+    ASTVal
+    Interpreter::eval(Expr *expr) {
+        return *Visit(expr);
+    }
+
+    void
+    Interpreter::execBlock(const std::vector<Stmt *> &body) {
+        _frames.back().Scopes.push_back({});
+        for (auto *stmt : body) {
+            Visit(stmt);
+            if (_flow != Flow::Normal) {
+                break;
+            }
+        }
+        _frames.back().Scopes.pop_back();
+    }
+
+    std::vector<ASTVal>
+    Interpreter::evalArgs(const std::vector<Expr *> &args) {
+        std::vector<ASTVal> vals;
+        vals.reserve(args.size());
+        for (auto *arg : args) {
+            vals.push_back(eval(arg));
+        }
+        return vals;
+    }
+
+    ASTVal
+    Interpreter::call(const FunInfo &fun, ASTVal *thisVal, std::vector<ASTVal> args) {
+        FunDeclStmt *fds = fun.Decl;
+        _frames.push_back(Frame { .Path = fun.Path, .This = thisVal, .Scopes = { {} }, .Statics = {}, .Temps = {} });
+        const std::vector<Argument> &funArgs = fds->GetArgs();
+        for (int i = 0; i < funArgs.size(); ++i) {
+            _frames.back().Scopes.back().insert_or_assign(funArgs[i].GetName(), convert(args[i], funArgs[i].GetType()));
+        }
+
+        execBlock(fds->GetBody());
+        ASTVal res = ASTVal::GetDefaultByType(ASTType::GetNothType());
+        if (_flow == Flow::Return && _retVal) {
+            res = convert(*_retVal, fds->GetRetType());
+        }
+        _flow = Flow::Normal;
+        _retVal = std::nullopt;
+
+        Frame &frame = _frames.back();
+        if (res.GetType().GetTypeKind() == ASTTypeKind::Trait && _frames.size() > 1) {
+            // a returned trait object may refer to a temporary of the callee
+            Frame &caller = _frames[_frames.size() - 2];
+            for (auto &temp : frame.Temps) {
+                if (temp.get() == res.GetData().ptrVal) {
+                    caller.Temps.push_back(std::move(temp));
+                }
+            }
+        }
+        _frames.pop_back();
+        return res;
+    }
+
+    // The statement and the expression forms of a call share these, so a call statement needs no temporary node
+    ASTVal
+    Interpreter::callFunction(const std::string &name, const std::vector<Expr *> &args, llvm::SMLoc loc) {
+        const FunInfo &fun = getFunction(getCurrentMangled(name), loc);
+        return call(fun, nullptr, evalArgs(args));
+    }
+
+    ASTVal
+    Interpreter::callMethod(Expr *obj, ASTType objType, bool staticAccessing, const std::string &name, const std::vector<Expr *> &args, llvm::SMLoc loc) {
+        if (staticAccessing) {
+            const FunInfo &fun = getFunction(resolveStruct(objType.GetVal(), _frames.back().Path) + "." + name, loc);
+            return call(fun, nullptr, evalArgs(args));
+        }
+        if (objType.GetTypeKind() == ASTTypeKind::Mod) {
+            const FunInfo &fun = getFunction(getMangledName(getModulePath(obj), name), loc);
+            return call(fun, nullptr, evalArgs(args));
+        }
+
+        size_t temps = _frames.back().Temps.size();
+        ASTVal *self = getObject(obj, objType, loc);
+        // `self` is the concrete structure also for trait objects, so the method is dispatched by its type
+        const FunInfo &fun = getFunction(self->GetType().GetVal() + "." + name, loc);
+        ASTVal res = call(fun, self, evalArgs(args));
+        if (res.GetType().GetTypeKind() != ASTTypeKind::Trait) {
+            _frames.back().Temps.resize(temps);
+        }
+        return res;
+    }
+
+    const Interpreter::FunInfo &
+    Interpreter::getFunction(const std::string &mangled, llvm::SMLoc loc) {
+        auto it = _functions.find(mangled);
+        if (it == _functions.end()) {
+            fatal("unknown function `" + mangled + "`", loc);
+        }
+        return it->second;
+    }
+
+    ASTVal *
+    Interpreter::getAddress(Expr *expr) {
+        if (VarExpr *ve = llvm::dyn_cast<VarExpr>(expr)) {
+            ASTVal *var = lookupVar(ve->GetName());
+            if (!var) {
+                fatal("unknown variable `" + ve->GetName() + "`", ve->GetStartLoc());
+            }
+            return var;
+        }
+        if (FieldAccessExpr *fae = llvm::dyn_cast<FieldAccessExpr>(expr)) {
+            if (fae->IsStaticAccessing()) {
+                return &_globals.at(resolveStruct(fae->GetObjType().GetVal(), _frames.back().Path) + "." + fae->GetName());
+            }
+            if (fae->GetObjType().GetTypeKind() == ASTTypeKind::Mod) {
+                return getModuleVar(fae->GetObject(), fae->GetName());
+            }
+            return getField(getObject(fae->GetObject(), fae->GetObjType(), fae->GetStartLoc()), fae->GetName());
+        }
+        if (DerefExpr *de = llvm::dyn_cast<DerefExpr>(expr)) {
+            ASTVal ptr = eval(de->GetExpr());
+            if (!ptr.GetData().ptrVal) {
+                fatal("Null pointer dereference", de->GetStartLoc());
+            }
+            return ptr.GetData().ptrVal;
+        }
+        return createTemp(eval(expr));
+    }
+
+    ASTVal *
+    Interpreter::getObject(Expr *obj, ASTType objType, llvm::SMLoc loc) {
+        ASTVal *cell = getAddress(obj);
+        for (int i = 0; i < objType.GetPointerDepth(); ++i) {
+            if (!cell->GetData().ptrVal) {
+                fatal("Null pointer dereference", loc);
+            }
+            cell = cell->GetData().ptrVal;
+        }
+        if (cell->GetType().GetTypeKind() == ASTTypeKind::Trait && !cell->GetType().IsPointer()) {
+            if (!cell->GetData().ptrVal) {
+                fatal("Null pointer dereference", loc);
+            }
+            cell = cell->GetData().ptrVal;
+        }
+        return cell;
+    }
+
+    ASTVal *
+    Interpreter::getField(ASTVal *obj, const std::string &name) {
+        const StructInfo &info = _structs.at(obj->GetType().GetVal());
+        return &obj->GetFields()[info.Indexes.at(name)];
+    }
+
+    ASTVal *
+    Interpreter::getModuleVar(Expr *obj, const std::string &name) {
+        std::string mangled = getMangledName(getModulePath(obj), name);
+        auto it = _globals.find(mangled);
+        if (it == _globals.end()) {
+            fatal("unknown variable `" + mangled + "`", obj->GetStartLoc());
+        }
+        return &it->second;
+    }
+
+    ASTVal *
+    Interpreter::lookupVar(const std::string &name) {
+        Frame &frame = _frames.back();
+        for (auto scope = frame.Scopes.rbegin(); scope != frame.Scopes.rend(); ++scope) {
+            if (auto it = scope->find(name); it != scope->end()) {
+                return &it->second;
+            }
+        }
+        if (auto it = frame.Statics.find(name); it != frame.Statics.end()) {
+            return it->second;
+        }
+        if (name == "this" && frame.This) {
+            return frame.This;
+        }
+        if (auto it = _globals.find(getCurrentMangled(name)); it != _globals.end()) {
+            return &it->second;
+        }
+        if (auto it = _globalsByName.find(name); it != _globalsByName.end()) {
+            return it->second;
+        }
+        return nullptr;
+    }
+
+    ASTVal *
+    Interpreter::createTemp(ASTVal val) {
+        _frames.back().Temps.push_back(std::make_unique<ASTVal>(val));
+        return _frames.back().Temps.back().get();
+    }
+
+    void
+    Interpreter::store(ASTVal *dest, ASTVal val) {
+        *dest = convert(val, dest->GetType());
+    }
+
+    ASTVal
+    Interpreter::convert(ASTVal val, ASTType type) {
+        if (type.IsPointer()) {
+            return makePointer(type, isPointerLike(val) ? val.GetData().ptrVal : nullptr);
+        }
+        switch (type.GetTypeKind()) {
+            case ASTTypeKind::Trait: {
+                if (val.GetType().GetTypeKind() == ASTTypeKind::Trait && !val.GetType().IsPointer()) {
+                    return makePointer(type, val.GetData().ptrVal);
+                }
+                if (val.GetType().IsPointer()) {
+                    return makePointer(type, val.GetData().ptrVal);
+                }
+                return makePointer(type, createTemp(val));  // a structure value is copied as CodeGen does
+            }
+            case ASTTypeKind::Struct:
+            case ASTTypeKind::Noth:
+            case ASTTypeKind::Unknown:
+                return val;
+            default: {
+                if (std::optional<ASTVal> res = ConstEvaluator::Convert(val, type)) {
+                    return *res;
+                }
+                return val;
+            }
+        }
+    }
+
+    ASTVal
+    Interpreter::defaultValue(ASTType type, std::vector<std::string> path, bool withFieldInits) {
+        if (type.IsPointer() || type.GetTypeKind() == ASTTypeKind::Trait) {
+            return makePointer(type, nullptr);
+        }
+        if (type.GetTypeKind() != ASTTypeKind::Struct) {
+            ASTValData data;
+            data.i64Val = 0;
+            return ASTVal(type, data, false, false);
+        }
+        std::string mangled = resolveStruct(type.GetVal(), path);
+        const StructInfo &info = _structs.at(mangled);
+        ASTValData data;
+        data.i64Val = 0;
+        ASTVal val(ASTType(ASTTypeKind::Struct, mangled, false, 0), data, false, false);
+        for (auto *field : info.Fields) {
+            if (withFieldInits && field->GetExpr()) {
+                _frames.push_back(Frame { .Path = info.Path, .This = nullptr, .Scopes = { {} }, .Statics = {}, .Temps = {} });
+                val.GetFields().push_back(convert(eval(field->GetExpr()), field->GetType()));
+                _frames.pop_back();
+            }
+            else {
+                val.GetFields().push_back(defaultValue(field->GetType(), info.Path, withFieldInits));
+            }
+        }
+        return val;
+    }
+
+    ASTVal
+    Interpreter::deref(const ASTVal &ptr, llvm::SMLoc loc) {
+        if (!ptr.GetData().ptrVal) {
+            fatal("Null pointer dereference", loc);
+        }
+        return *ptr.GetData().ptrVal;
+    }
+
+    void
+    Interpreter::echo(const ASTVal &val) {
+        // mirrors `__marble_echo_*` of the runtime
+        ASTType type = val.GetType();
+        char buf[64];
+        if (type.IsPointer() || type.GetTypeKind() == ASTTypeKind::Nil) {
+            if (!val.GetData().ptrVal) {
+                llvm::outs() << "(nil)";
+                return;
+            }
+            std::snprintf(buf, sizeof(buf), "%p", static_cast<void *>(val.GetData().ptrVal));
+            llvm::outs() << buf;
+            return;
+        }
+        switch (type.GetTypeKind()) {
+            case ASTTypeKind::Bool:
+                llvm::outs() << (val.GetData().boolVal ? "true\n" : "false\n");
+                break;
+            case ASTTypeKind::Char:
+                llvm::outs() << val.GetData().charVal;
+                break;
+            case ASTTypeKind::I16:
+            case ASTTypeKind::I32:
+            case ASTTypeKind::I64:
+                llvm::outs() << ConstEvaluator::Convert(val, ASTType(ASTTypeKind::I64, "i64", false, 0))->GetData().i64Val;
+                break;
+            case ASTTypeKind::F32:
+            case ASTTypeKind::F64:
+                std::snprintf(buf, sizeof(buf), "%g", ConstEvaluator::Convert(val, ASTType(ASTTypeKind::F64, "f64", false, 0))->GetData().f64Val);
+                llvm::outs() << buf;
+                break;
+            default:
+                break;
+        }
+    }
+
+    const Interpreter::StructInfo &
+    Interpreter::getStruct(const std::string &mangled, llvm::SMLoc loc) {
+        auto it = _structs.find(mangled);
+        if (it == _structs.end()) {
+            fatal("unknown structure `" + mangled + "`", loc);
+        }
+        return it->second;
+    }
+
+    std::string
+    Interpreter::resolveStruct(const std::string &typePath, const std::vector<std::string> &path) {
+        // same as `getMangledForPath` in CodeGen, except that a plain name is looked up in the current module first
+        if (typePath.find('/') == std::string::npos) {
+            std::string local = getMangledName(path, typePath);
+            return _structs.count(local) ? local : typePath;
+        }
+        std::vector<std::string> parts;
+        std::stringstream ss(typePath);
+        std::string item;
+        while (std::getline(ss, item, '/')) {
+            if (!item.empty()) {
+                parts.push_back(item);
+            }
+        }
+
+        std::vector<std::string> normalized;
+        std::vector<std::string> currentPath = path;
+        for (const std::string &part : parts) {
+            if (part == "parent") {
+                if (!currentPath.empty()) {
+                    currentPath.pop_back();
+                }
+            }
+            else if (part == "self") {
+                normalized.insert(normalized.end(), currentPath.begin(), currentPath.end());
+            }
+            else {
+                normalized.push_back(part);
+                currentPath.push_back(part);
+            }
+        }
+        if (normalized.empty()) {
+            return typePath;
+        }
+        std::string name = normalized.back();
+        normalized.pop_back();
+        return getMangledName(normalized, name);
+    }
+
+    std::vector<std::string>
+    Interpreter::getModulePath(Expr *expr) {
+        if (FieldAccessExpr *fae = llvm::dyn_cast<FieldAccessExpr>(expr)) {
+            std::vector<std::string> path = getModulePath(fae->GetObject());
+            path.push_back(fae->GetName());
+            return path;
+        }
+        std::vector<std::string> path = _frames.back().Path;
+        std::string name = llvm::cast<VarExpr>(expr)->GetName();
+        if (name == "self") {
+            return path;
+        }
+        if (name == "parent") {
+            if (!path.empty()) {
+                path.pop_back();
+            }
+            return path;
+        }
+        path.push_back(name);
+        if (_modules.count(getMangledName(path, ""))) {
+            return path;
+        }
+        return { name };
+    }
+
+    std::string
+    Interpreter::getMangledName(const std::vector<std::string> &path, const std::string &name) const {
+        std::string res;
+        for (const std::string &p : path) {
+            res += p + "#";
+        }
+        return res + name;
+    }
+
+    std::string
+    Interpreter::getCurrentMangled(const std::string &name) const {
+        return getMangledName(_frames.back().Path, name);
+    }
+
+    void
+    Interpreter::fatal(const std::string &msg, llvm::SMLoc loc) {
+        auto [line, col] = _srcMgr.getLineAndColumn(loc);
+        llvm::outs() << "Error: " << msg << " at " << _rootMod->GetName() << ":" << std::to_string(line) << ":"
+                     << std::to_string(col) << "!\n";
+        llvm::outs().flush();
+        std::abort();
+    }
+}
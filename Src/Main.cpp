@@ -1,18 +1,38 @@
 #include <marble/Basic/ModuleManager.h>
 #include <marble/AST/Printer.h>
+#include <marble/Bytecode/BytecodeGen.h>
+#include <marble/Bytecode/VM.h>
 #include <marble/CodeGen/CodeGen.h>
 #include <marble/Compilation/Compilation.h>
 #include <marble/Compilation/Optimizer.h>
 #include <marble/Compilation/Options.h>
+#include <marble/Compilation/Remarks.h>
+#include <marble/Interp/Interpreter.h>
 #include <marble/Lexer/Lexer.h>
 #include <marble/Parser/Parser.h>
 #include <marble/Sema/Semantic.h>
+#include <llvm/IR/LLVMRemarkStreamer.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/ToolOutputFile.h>
 #include <llvm/Support/Path.h>
 #include <llvm/TargetParser/Host.h>
+#include <algorithm>
 
 std::string libsPath = "Libs/";
 
+// The import of a library file, e.g. `Std.Math` for `Libs/Std/Math/mod.mr`
+static std::optional<std::string>
+getLibraryImport(llvm::StringRef fileName) {
+    llvm::StringRef path = fileName;
+    if (!path.consume_front(libsPath) || !path.consume_back(".mr")) {
+        return std::nullopt;
+    }
+    path.consume_back("/mod");
+    std::string import = path.str();
+    std::replace(import.begin(), import.end(), '/', '.');
+    return import;
+}
+
 int
 main(int argc, char **argv) {
     if (argc < 2) {
@@ -22,27 +42,91 @@ main(int argc, char **argv) {
     
     llvm::cl::HideUnrelatedOptions(marble::MarbleCat);
     llvm::cl::ParseCommandLineOptions(argc, argv, "Marble Compiler\n");
-    llvm::outs().SetUnbuffered();
 
     llvm::SourceMgr srcMgr;
     std::string fileName = marble::InputFilename;
 
+    if (llvm::sys::path::extension(fileName) == ".mrbc") {
+        std::string error;
+        std::unique_ptr<marble::BytecodeModule> bytecode = marble::BytecodeModule::Load(fileName, error);
+        if (!bytecode) {
+            llvm::errs() << llvm::errs().RED << "Could not load bytecode " << llvm::errs().RESET << '`' << fileName << "`: " << error << '\n';
+            return 1;
+        }
+        marble::VM vm(*bytecode);
+        return vm.Run();
+    }
+
     auto bufferOrErr = llvm::MemoryBuffer::getFile(fileName);
     
     if (std::error_code ec = bufferOrErr.getError()) {
         llvm::errs() << llvm::errs().RED << "Could not open file " << llvm::errs().RESET << '`' << fileName << "`: " << ec.message() << '\n';
         return 1;
     }
-    srcMgr.AddNewSourceBuffer(std::move(*bufferOrErr), llvm::SMLoc());
+
+    marble::CodeGenOptions codegenOpts;
+    codegenOpts.Allocator = marble::Allocator == marble::AllocSystem ? marble::CodeGenOptions::System
+                                                                     : marble::CodeGenOptions::Slab;
+    bool optimizedCode = marble::OptimizationLevel > marble::O0 || marble::EmitAction == marble::EmitLibrary;    // a library serves every level
+    codegenOpts.PromoteAllocs = optimizedCode;
+    codegenOpts.LifetimeMarkers = optimizedCode;
+    codegenOpts.DebugInfo = marble::DebugInfo;
+    codegenOpts.FramePointers = marble::NoOmitFramePointer;
+    codegenOpts.InstrumentFunctions = marble::Instrument == marble::InstrumentFunctions;
+    codegenOpts.TrackAllocs = marble::TrackAllocs;
+    codegenOpts.ReportLeaks = marble::ReportLeaks;
+    codegenOpts.Optimized = marble::OptimizationLevel > marble::O0;
+    bool saveOptRecord = marble::SaveOptRecord || !marble::OptRecordFile.empty();
+    codegenOpts.LineTables = marble::EmitAction == marble::EmitAsmAnnotated;
+    codegenOpts.TrackLocations = saveOptRecord || !marble::Rpass.empty() || !marble::RpassMissed.empty() ||
+                                 !marble::RpassAnalysis.empty() || codegenOpts.LineTables;
+    if (!marble::NoPrecompiledLibs && marble::EmitAction != marble::EmitLibrary) {
+        codegenOpts.PrecompiledLibs = libsPath;
+    }
+    codegenOpts.PruneUnreachable = !marble::NoPruneUnreachable && marble::EmitAction != marble::EmitLibrary;   // a library keeps everything
 
     marble::DiagnosticEngine diag(srcMgr);
     marble::ModuleManager modManager(diag);
-    marble::Module *mainMod = modManager.LoadModule(fileName, marble::AccessPriv, srcMgr);
+    // the bodies of a precompiled library are neither analyzed nor generated, so only its interface is parsed
+    if (!codegenOpts.PrecompiledLibs.empty() && !marble::Interpret && !marble::RunVM && marble::EmitAction != marble::EmitBytecode &&
+        !marble::CheckAll) {
+        modManager.SetInterfaceLoader([&codegenOpts](const std::string &fullPath, llvm::StringRef source) {
+            return marble::CodeGen::LoadLibraryInterface(fullPath, source, codegenOpts);
+        });
+    }
+    marble::Module *mainMod;
+    if (marble::EmitAction == marble::EmitLibrary) {
+        srcMgr.AddNewSourceBuffer(std::move(*bufferOrErr), llvm::SMLoc());   // the main file of the locations without a module
+        // the library is generated as a program imports it, so its symbols get the same names
+        fileName = llvm::sys::path::remove_leading_dotslash(fileName).str();
+        std::optional<std::string> import = getLibraryImport(fileName);
+        if (!import) {
+            llvm::errs() << llvm::errs().RED << "Not a module of " << libsPath << ": " << llvm::errs().RESET << '`' << fileName << "`\n";
+            return 1;
+        }
+        mainMod = modManager.LoadModule("<library>", llvm::MemoryBuffer::getMemBufferCopy("import " + *import + ";", "<library>"),
+                                        marble::AccessPriv, srcMgr);
+    }
+    else {
+        mainMod = modManager.LoadModule(fileName, std::move(*bufferOrErr), marble::AccessPriv, srcMgr);
+    }
     if (diag.HasErrors()) {
         return 1;
     }
     diag.ResetErrors();
 
+    if (marble::PrintModuleGraph) {
+        for (marble::Module *mod : modManager.GetModulesInImportOrder()) {
+            llvm::outs() << "; " << mod->GetFullPath() << (mod->FromInterface ? " (interface)" : "");
+            const char *sep = " imports ";
+            for (marble::Module *imported : modManager.GetImports(mod)) {
+                llvm::outs() << sep << imported->GetFullPath();
+                sep = ", ";
+            }
+            llvm::outs() << '\n';
+        }
+    }
+
     if (marble::EmitAction == marble::EmitAST) {
         marble::ASTPrinter printer;
         for (auto stmt : mainMod->AST) {
@@ -52,19 +136,76 @@ main(int argc, char **argv) {
         return 0; 
     }
 
-    marble::SemanticAnalyzer sema(diag, srcMgr, libsPath, modManager);
+    marble::ConstEvalLimits constEvalLimits;
+    constEvalLimits.MaxSteps = marble::ConstEvalSteps;
+    constEvalLimits.MaxMemory = marble::ConstEvalMemory;
+    marble::SemanticAnalyzer sema(diag, srcMgr, libsPath, modManager, constEvalLimits);
+    sema.SetCheckAll(marble::CheckAll || marble::NoPruneUnreachable || marble::EmitAction == marble::EmitLibrary);
     sema.Analyze(mainMod);
     if (diag.HasErrors()) {
         return 1;
     }
     diag.ResetErrors();
 
-    marble::CodeGen codegen(mainMod, srcMgr);
-    codegen.DeclareRuntimeFunctions();
+    if (marble::Interpret) {
+        marble::Interpreter interp(mainMod, srcMgr);
+        return interp.Run();
+    }
+
+    if (marble::RunVM || marble::EmitAction == marble::EmitBytecode) {
+        marble::BytecodeGen bcGen(mainMod, srcMgr, diag);
+        std::unique_ptr<marble::BytecodeModule> bytecode = bcGen.Generate();
+        if (!bytecode) {
+            return 1;
+        }
+        if (marble::RunVM) {
+            marble::VM vm(*bytecode);
+            return vm.Run();
+        }
+        std::string outputName = marble::OutputFilename.empty() ? (llvm::sys::path::stem(fileName) + ".mrbc").str()
+                                                                : marble::OutputFilename.getValue();
+        std::string error;
+        if (!bytecode->Save(outputName, error)) {
+            llvm::errs() << error;
+            return 1;
+        }
+        return 0;
+    }
+
+    marble::CodeGen codegen(mainMod, srcMgr, codegenOpts);
     codegen.DeclareMod(mainMod);
     codegen.GenerateBodies(mainMod);
+    codegen.Finalize();
+    if (marble::PrintPruned) {
+        llvm::outs() << "; skipped " << codegen.GetSkippedBodies() << " of " << codegen.GetSkippedBodies() + codegen.GetGeneratedBodies()
+                     << " function bodies, which are never called\n";
+    }
+
+    if (marble::EmitAction == marble::EmitLibrary) {
+        llvm::SmallString<128> outputName(fileName);
+        llvm::sys::path::replace_extension(outputName, "bc");
+        auto libMod = modManager.GetLoadedModules().find(modManager.GetRealPath(fileName));
+        llvm::Module *lib = libMod != modManager.GetLoadedModules().end() ? codegen.ExportLibrary(fileName, sema.GetLibraryInterface(libMod->second))
+                                                                         : nullptr;
+        if (!lib) {
+            llvm::errs() << llvm::errs().RED << "Could not generate library " << llvm::errs().RESET << '`' << fileName << "`\n";
+            return 1;
+        }
+        return marble::EmitBitcodeFile(lib, marble::OutputFilename.empty() ? outputName.str().str() : marble::OutputFilename.getValue()) ? 0 : 1;
+    }
 
-    llvm::Module *mod = codegen.GetLLVMModule();
+    // an optimized program is linked before it is optimized by default, so functions are inlined across its modules
+    marble::LTOKind lto = marble::LTO.getNumOccurrences() ? marble::LTO.getValue()
+                                                          : marble::OptimizationLevel > marble::O0 ? marble::LTOFull : marble::LTONone;
+    // every other output is a single file, so the modules are compiled separately only for executables
+    std::vector<llvm::Module *> mods = codegen.GetLLVMModules();
+    if (marble::EmitAction != marble::EmitBinary || lto == marble::LTOFull) {
+        if (!marble::LinkModules(*mods[0], llvm::ArrayRef<llvm::Module *>(mods).drop_front())) {
+            return 1;
+        }
+        mods.resize(1);
+    }
+    llvm::Module *mod = mods[0];
     marble::InitializeLLVMTargets();
     
     std::string tripleStr = llvm::sys::getDefaultTargetTriple();
@@ -85,15 +226,43 @@ main(int argc, char **argv) {
             case marble::EmitObj:
                 outputName = (stem + ".o").str();
                 break;
+            case marble::EmitAsm:
+            case marble::EmitAsmAnnotated:
+                outputName = (stem + ".s").str();
+                break;
             case marble::EmitBinary: 
                 outputName = stem.str();
                 if (triple.isOSWindows()) {
                     outputName += ".exe";
                 }
                 break;
+            case marble::EmitBytecode:
+            case marble::EmitLibrary:
+                break;
         }
     }
 
+    std::string remarksError;
+    std::unique_ptr<marble::RemarkHandler> remarks = marble::RemarkHandler::Create(srcMgr, diag, marble::Rpass, marble::RpassMissed,
+                                                                                   marble::RpassAnalysis, remarksError);
+    if (!remarks) {
+        llvm::errs() << llvm::errs().RED << "Invalid remark pattern: " << llvm::errs().RESET << remarksError << '\n';
+        return 1;
+    }
+    mod->getContext().setDiagnosticHandler(std::move(remarks));
+    std::unique_ptr<llvm::ToolOutputFile> optRecord;
+    if (saveOptRecord) {
+        std::string recordName = marble::OptRecordFile.empty() ? (stem + ".opt.yaml").str() : marble::OptRecordFile.getValue();
+        llvm::Expected<std::unique_ptr<llvm::ToolOutputFile>> recordOrErr =
+            llvm::setupLLVMOptimizationRemarks(mod->getContext(), recordName, "", "yaml", false);
+        if (!recordOrErr) {
+            llvm::errs() << llvm::errs().RED << "Could not open optimization record " << llvm::errs().RESET << '`' << recordName
+                         << "`: " << llvm::toString(recordOrErr.takeError()) << '\n';
+            return 1;
+        }
+        optRecord = std::move(*recordOrErr);
+    }
+
     marble::Optimizer::Level optLvl;
     switch (marble::OptimizationLevel) {
         case marble::O1:
@@ -109,9 +278,11 @@ main(int argc, char **argv) {
             optLvl = marble::Optimizer::O0;
             break;
     }
-    if (marble::OptimizationLevel > marble::O0) {
-        marble::Optimizer optimizer;
-        optimizer.Optimize(*mod, optLvl);
+    bool thinLTO = marble::EmitAction == marble::EmitBinary && lto == marble::LTOThin;
+    for (llvm::Module *unit : mods) {
+        if (!marble::Optimizer::Optimize(*unit, optLvl, marble::Passes, marble::PrintPipeline, thinLTO)) {
+            return 1;
+        }
     }
 
     if (marble::EmitAction == marble::EmitLLVM) {
@@ -122,18 +293,64 @@ main(int argc, char **argv) {
             return 1;
         }
         mod->print(os, nullptr);
+        if (optRecord) {
+            optRecord->keep();
+        }
         return 0;
     }
     
-    std::string objFile = (marble::EmitAction == marble::EmitObj) ? outputName : (stem + ".o").str();
-    if (!marble::EmitObjectFile(&*mod, objFile, tripleStr)) {
-        return 1;
+    if (marble::EmitAction == marble::EmitAsm || marble::EmitAction == marble::EmitAsmAnnotated) {
+        bool emitted = marble::EmitAction == marble::EmitAsm ? marble::EmitAssemblyFile(&*mod, outputName, tripleStr)
+                                                             : marble::EmitAnnotatedAssemblyFile(&*mod, outputName, srcMgr, tripleStr);
+        if (!emitted) {
+            return 1;
+        }
+        if (optRecord) {
+            optRecord->keep();
+        }
+        return 0;
+    }
+
+    if (marble::EmitAction == marble::EmitObj) {
+        if (!marble::EmitObjectFile(&*mod, outputName, tripleStr)) {
+            return 1;
+        }
+        if (optRecord) {
+            optRecord->keep();   // after codegen, which adds the remarks of the machine passes
+        }
+        return 0;
+    }
+
+    // the object of the root module is placed next to the executable, the ones of the other modules are temporary
+    std::vector<std::string> objFiles;
+    auto removeObjFiles = [&objFiles]() {
+        for (const std::string &objFile : objFiles) {
+            llvm::sys::fs::remove(objFile); // NOLINT
+        }
+    };
+    for (llvm::Module *unit : mods) {
+        const char *ext = thinLTO ? "bc" : "o";
+        llvm::SmallString<128> objFile;
+        if (objFiles.empty()) {
+            objFile = (stem + "." + ext).str();
+        }
+        else if (std::error_code ec = llvm::sys::fs::createTemporaryFile(llvm::sys::path::stem(unit->getName()), ext, objFile)) {
+            llvm::errs() << llvm::errs().RED << "Could not create temporary file: " << llvm::errs().RESET << ec.message() << '\n';
+            removeObjFiles();
+            return 1;
+        }
+        objFiles.push_back(objFile.str().str());
+        if (thinLTO ? !marble::EmitThinLTOBitcode(unit, objFiles.back(), tripleStr) : !marble::EmitObjectFile(unit, objFiles.back(), tripleStr)) {
+            removeObjFiles();
+            return 1;
+        }
     }
-    if (marble::EmitAction == marble::EmitBinary) {
-        marble::LinkObjectFile(objFile, marble::GetOutputName(fileName, triple));
-        llvm::sys::fs::remove(objFile); // NOLINT
+    if (optRecord) {
+        optRecord->keep();
     }
+    bool linked = marble::LinkObjectFiles(objFiles, marble::GetOutputName(fileName, triple), thinLTO);
+    removeObjFiles();
     llvm::outs().flush();   // explicitly flushing the buffer
     
-    return 0;
+    return linked ? 0 : 1;
 }
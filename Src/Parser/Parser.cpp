@@ -2,8 +2,11 @@
 #include <marble/Parser/Parser.h>
 #include <marble/Parser/Precedence.h>
 #include <llvm/Support/Path.h>
+#include <unordered_map>
 
 static marble::AccessModifier access;
+static unsigned funAttrs;
+static int funOptLevel;
 static llvm::BumpPtrAllocator allocator;
 
 extern std::string libsPath;
@@ -25,11 +28,19 @@ namespace marble {
         if (_curTok.Is(TkEof)) {
             return nullptr;
         }
+        llvm::SMLoc attrsLoc = _curTok.GetLoc();
+        funAttrs = parseFunAttributes();
         access = AccessPriv;
         if (expect(TkPub)) {
             access = AccessPub;
         }
         bool isStatic = expect(TkStatic);
+        if ((funAttrs || funOptLevel >= 0) && !_curTok.Is(TkFun) && !(_curTok.Is(TkConst) && _nextTok.Is(TkFun))) {
+            _diag.Report(attrsLoc, ErrAttributesOnNonFunction)
+                << llvm::SMRange(attrsLoc, _curTok.GetLoc());
+            funAttrs = 0;
+            funOptLevel = -1;
+        }
         if (isStatic) {
             Stmt *stmt;
             if (_curTok.Is(TkVar)) {
@@ -49,6 +60,9 @@ namespace marble {
         switch (_curTok.GetKind()) {
             case TkVar:
             case TkConst: {
+                if (_nextTok.Is(TkFun)) {
+                    return parseFunDeclStmt();
+                }
                 Stmt *stmt = parseVarDeclStmt();
                 if (consumeSemi && !expect(TkSemi)) {
                     _diag.Report(_curTok.GetLoc(), ErrExpectedToken)
@@ -164,6 +178,9 @@ namespace marble {
             case TkMod: {
                 return parseModuleDeclStmt();
             }
+            case TkArena: {
+                return parseArenaStmt();
+            }
             default:
                 _diag.Report(_curTok.GetLoc(), ErrExpectedStmt)
                     << getRangeFromTok(_curTok)
@@ -273,6 +290,9 @@ namespace marble {
         if (isStatic) {
             firstTok = _lastTok;
         }
+        bool isConst = expect(TkConst);
+        unsigned attrsCopy = funAttrs;
+        int optLevelCopy = funOptLevel;
         consume();
         std::string name = _curTok.GetText();
         if (!expect(TkId)) {
@@ -305,8 +325,12 @@ namespace marble {
         }
 
         if (expect(TkSemi)) {
-            return createNode<FunDeclStmt>(name, retType, args, std::vector<Stmt *> {}, true, isStatic, access, firstTok.GetLoc(), _curTok.GetLoc());
+            FunDeclStmt *fds = createNode<FunDeclStmt>(name, retType, args, std::vector<Stmt *> {}, true, isStatic, access, firstTok.GetLoc(), _curTok.GetLoc());
+            fds->SetConst(isConst);
+            fds->SetAttrs(attrsCopy);
+            return fds;
         }
+        llvm::SMLoc bodyLoc = _curTok.GetLoc();
         if (!expect(TkLBrace)) {
             _diag.Report(_curTok.GetLoc(), ErrExpectedToken)
                 << getRangeFromTok(_curTok)
@@ -318,7 +342,78 @@ namespace marble {
         while (!expect(TkRBrace)) {
             block.push_back(ParseStmt());
         }
-        return createNode<FunDeclStmt>(name, retType, args, block, false, isStatic, accessCopy, firstTok.GetLoc(), _curTok.GetLoc());
+        FunDeclStmt *fds = createNode<FunDeclStmt>(name, retType, args, block, false, isStatic, accessCopy, firstTok.GetLoc(), _curTok.GetLoc());
+        fds->SetConst(isConst);
+        fds->SetAttrs(attrsCopy);
+        fds->SetOptLevel(optLevelCopy);
+        fds->SetBodyRange(llvm::SMRange(bodyLoc, _lastTok.GetLoc()));
+        return fds;
+    }
+
+    unsigned
+    Parser::parseFunAttributes() {
+        unsigned attrs = 0;
+        funOptLevel = -1;
+        while (expect(TkAt)) {
+            Token nameTok = _curTok;
+            if (!expect(TkId)) {
+                _diag.Report(_curTok.GetLoc(), ErrExpectedId)
+                    << getRangeFromTok(_curTok)
+                    << _curTok.GetText();
+                continue;
+            }
+            if (nameTok.GetText() == "opt") {
+                parseOptLevel();
+                continue;
+            }
+            static const std::unordered_map<std::string, FunAttribute> names = {
+                { "inline", FunAttrInline },
+                { "noinline", FunAttrNoInline },
+                { "cold", FunAttrCold },
+                { "hot", FunAttrHot },
+                { "flatten", FunAttrFlatten },
+                { "pure", FunAttrPure },
+            };
+            if (auto it = names.find(nameTok.GetText()); it != names.end()) {
+                attrs |= it->second;
+            }
+            else {
+                _diag.Report(nameTok.GetLoc(), ErrUnknownAttribute)
+                    << getRangeFromTok(nameTok)
+                    << nameTok.GetText();
+            }
+        }
+        return attrs;
+    }
+
+    void
+    Parser::parseOptLevel() {
+        if (!expect(TkLParen)) {
+            _diag.Report(_curTok.GetLoc(), ErrExpectedToken)
+                << getRangeFromTok(_curTok)
+                << "("                  // expected
+                << _curTok.GetText();   // got
+            return;
+        }
+        Token levelTok = _curTok;
+        std::string level = levelTok.GetText();
+        if (levelTok.Is(TkI32Lit) && level.size() == 1 && level[0] >= '0' && level[0] <= '3') {
+            funOptLevel = level[0] - '0';
+        }
+        else {
+            _diag.Report(levelTok.GetLoc(), ErrInvalidOptLevel)
+                << getRangeFromTok(levelTok)
+                << level;
+        }
+        if (!levelTok.Is(TkRParen)) {
+            consume();
+        }
+        if (!expect(TkRParen)) {
+            _diag.Report(_curTok.GetLoc(), ErrExpectedToken)
+                << getRangeFromTok(_curTok)
+                << ")"                  // expected
+                << _curTok.GetText();   // got
+        }
     }
 
     Stmt *
@@ -535,6 +630,25 @@ namespace marble {
         return createNode<ModuleDeclStmt>(name, body, accessCopy, firstTok.GetLoc(), _curTok.GetLoc());
     }
 
+    Stmt *
+    Parser::parseArenaStmt() {
+        AccessModifier accessCopy = access;
+        Token firstTok = consume();
+        std::vector<Stmt *> body;
+        if (!expect(TkLBrace)) {
+            _diag.Report(_curTok.GetLoc(), ErrExpectedToken)
+                << getRangeFromTok(_curTok)
+                << "{"                  // expected
+                << _curTok.GetText();   // got
+        }
+        else {
+            while (!expect(TkRBrace)) {
+                body.push_back(ParseStmt());
+            }
+        }
+        return createNode<ArenaStmt>(body, accessCopy, firstTok.GetLoc(), _curTok.GetLoc());
+    }
+
     Argument
     Parser::parseArgument() {
         std::string name = _curTok.GetText();
@@ -869,10 +983,7 @@ namespace marble {
         else {
             path = libsPath + path;
         }
-        auto bufferOrErr = llvm::MemoryBuffer::getFile(path + ".mr");
-        if (std::error_code ec = bufferOrErr.getError()) {
-            path += "/mod";
-        }
+        path = _modManager.FindModuleFile(path);
         Module *mod = _modManager.LoadModule(path + ".mr", AccessPub, _srcMgr);
         if (mod) {
             registerTypes(mod);
@@ -0,0 +1,173 @@
+#include <marble/Runtime/Runtime.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+// Objects up to `MAX_SMALL_SIZE` bytes are carved out of 64 KiB spans, each of which holds objects of a single size
+// class. A two-level page map translates an address to the size class of its span, so `del` does not need to know the
+// size of the object. Bigger objects and addresses which are not in any span go to the system allocator.
+
+#define SPAN_SHIFT 16
+#define SPAN_SIZE ((size_t)1 << SPAN_SHIFT)
+#define SPANS_PER_BATCH 32
+
+#define ADDRESS_BITS 48
+#define LEAF_BITS 16
+#define ROOT_BITS (ADDRESS_BITS - SPAN_SHIFT - LEAF_BITS)
+#define LEAF_MASK (((uintptr_t)1 << LEAF_BITS) - 1)
+
+#define NUM_SIZE_CLASSES 16
+#define MAX_SMALL_SIZE 512
+
+static const uint32_t sizeClasses[NUM_SIZE_CLASSES] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256,
+    320, 384, 448, 512
+};
+
+typedef struct FreeObject {
+    struct FreeObject *Next;
+} FreeObject;
+
+// Per-thread state of one size class. Freed objects go to the free list of the thread which frees them and are reused
+// only by that thread.
+typedef struct {
+    FreeObject *Free;
+    char *Bump;
+    char *End;
+} SizeClassCache;
+
+static _Thread_local SizeClassCache caches[NUM_SIZE_CLASSES];
+
+static _Atomic(uint8_t *) pageMap[(size_t)1 << ROOT_BITS];     // size class + 1 of every span, 0 for foreign memory
+
+static pthread_mutex_t spanLock = PTHREAD_MUTEX_INITIALIZER;
+static char *spanPoolNext;
+static char *spanPoolEnd;
+
+static inline int
+sizeClassOf(size_t size) {
+    if (size <= 128) {
+        return size == 0 ? 0 : (int)((size - 1) >> 4);
+    }
+    if (size <= 256) {
+        return 8 + (int)((size - 129) >> 5);
+    }
+    return 12 + (int)((size - 257) >> 6);
+}
+
+static inline int
+spanClassOf(const void *ptr) {
+    uintptr_t addr = (uintptr_t)ptr;
+    if (addr >> ADDRESS_BITS) {
+        return -1;
+    }
+    uint8_t *leaf = atomic_load_explicit(&pageMap[addr >> (SPAN_SHIFT + LEAF_BITS)], memory_order_acquire);
+    if (!leaf) {
+        return -1;
+    }
+    return (int)leaf[(addr >> SPAN_SHIFT) & LEAF_MASK] - 1;
+}
+
+// must be called with `spanLock` held
+static bool
+refillSpanPool(void) {
+    size_t len = SPAN_SIZE * (SPANS_PER_BATCH + 1);
+    char *mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+    char *aligned = (char *)(((uintptr_t)mem + SPAN_SIZE - 1) & ~(uintptr_t)(SPAN_SIZE - 1));
+    if (aligned != mem) {
+        munmap(mem, (size_t)(aligned - mem));
+    }
+    char *end = aligned + SPAN_SIZE * SPANS_PER_BATCH;
+    if (end != mem + len) {
+        munmap(end, (size_t)(mem + len - end));
+    }
+    spanPoolNext = aligned;
+    spanPoolEnd = end;
+    return true;
+}
+
+// must be called with `spanLock` held
+static bool
+registerSpan(char *span, int cls) {
+    uintptr_t addr = (uintptr_t)span;
+    if (addr >> ADDRESS_BITS) {
+        return false;
+    }
+    _Atomic(uint8_t *) *root = &pageMap[addr >> (SPAN_SHIFT + LEAF_BITS)];
+    uint8_t *leaf = atomic_load_explicit(root, memory_order_relaxed);
+    if (!leaf) {
+        leaf = calloc((size_t)1 << LEAF_BITS, 1);
+        if (!leaf) {
+            return false;
+        }
+        atomic_store_explicit(root, leaf, memory_order_release);
+    }
+    leaf[(addr >> SPAN_SHIFT) & LEAF_MASK] = (uint8_t)(cls + 1);
+    return true;
+}
+
+static char *
+allocSpan(int cls) {
+    pthread_mutex_lock(&spanLock);
+    char *span = NULL;
+    if (spanPoolNext != spanPoolEnd || refillSpanPool()) {
+        span = spanPoolNext;
+        if (registerSpan(span, cls)) {
+            spanPoolNext += SPAN_SIZE;
+        }
+        else {
+            span = NULL;
+        }
+    }
+    pthread_mutex_unlock(&spanLock);
+    return span;
+}
+
+static void *
+allocSlow(SizeClassCache *cache, int cls, size_t size) {
+    char *span = allocSpan(cls);
+    if (!span) {
+        return malloc(size);
+    }
+    size_t objSize = sizeClasses[cls];
+    cache->Bump = span + objSize;
+    cache->End = span + SPAN_SIZE / objSize * objSize;
+    return span;
+}
+
+void *
+__marble_alloc(int64_t size) {
+    if ((uint64_t)size > MAX_SMALL_SIZE) {
+        return malloc((size_t)size);
+    }
+    int cls = sizeClassOf((size_t)size);
+    SizeClassCache *cache = &caches[cls];
+    FreeObject *obj = cache->Free;
+    if (obj) {
+        cache->Free = obj->Next;
+        return obj;
+    }
+    if (cache->Bump != cache->End) {
+        void *ptr = cache->Bump;
+        cache->Bump += sizeClasses[cls];
+        return ptr;
+    }
+    return allocSlow(cache, cls, (size_t)size);
+}
+
+void
+__marble_free(void *ptr) {
+    int cls = spanClassOf(ptr);
+    if (cls < 0) {
+        free(ptr);
+        return;
+    }
+    FreeObject *obj = (FreeObject *)ptr;
+    obj->Next = caches[cls].Free;
+    caches[cls].Free = obj;
+}
@@ -0,0 +1,102 @@
+#include <marble/Runtime/Runtime.h>
+#include <stdlib.h>
+
+// Arenas back `new` inside `arena { ... }` blocks. Allocation bumps a pointer through a list of chunks which are all
+// released when the block ends. The first chunk is stored inline after the arena header and one destroyed arena per
+// thread is kept for reuse, so entering an arena in a loop does not touch the system allocator.
+
+#define ARENA_ALIGN 16
+#define ARENA_INITIAL_SIZE 4096
+#define ARENA_MAX_CHUNK_SIZE (1024 * 1024)
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *Prev;
+    size_t Size;
+} ArenaChunk;
+
+typedef struct {
+    char *Bump;
+    char *End;
+    ArenaChunk *Chunks;     // chunks allocated after the inline one, newest first
+    size_t NextSize;
+} Arena;
+
+static _Thread_local Arena *cachedArena;
+
+static inline char *
+inlineData(Arena *arena) {
+    return (char *)(arena + 1);
+}
+
+static inline void
+resetArena(Arena *arena) {
+    arena->Bump = inlineData(arena);
+    arena->End = arena->Bump + ARENA_INITIAL_SIZE;
+    arena->Chunks = NULL;
+    arena->NextSize = ARENA_INITIAL_SIZE * 2;
+}
+
+void *
+__marble_arena_create(void) {
+    Arena *arena = cachedArena;
+    if (arena) {
+        cachedArena = NULL;
+        return arena;
+    }
+    arena = malloc(sizeof(Arena) + ARENA_INITIAL_SIZE);
+    if (!arena) {
+        abort();
+    }
+    resetArena(arena);
+    return arena;
+}
+
+static void *
+allocSlow(Arena *arena, size_t size) {
+    size_t chunkSize = arena->NextSize;
+    if (chunkSize < size) {
+        chunkSize = size;
+    }
+    if (arena->NextSize < ARENA_MAX_CHUNK_SIZE) {
+        arena->NextSize *= 2;
+    }
+    ArenaChunk *chunk = malloc(sizeof(ArenaChunk) + chunkSize);
+    if (!chunk) {
+        abort();
+    }
+    chunk->Prev = arena->Chunks;
+    chunk->Size = chunkSize;
+    arena->Chunks = chunk;
+    char *data = (char *)(chunk + 1);
+    arena->Bump = data + size;
+    arena->End = data + chunkSize;
+    return data;
+}
+
+void *
+__marble_arena_alloc(void *handle, int64_t size) {
+    Arena *arena = handle;
+    size_t alignedSize = ((size_t)size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if ((size_t)(arena->End - arena->Bump) >= alignedSize) {
+        void *ptr = arena->Bump;
+        arena->Bump += alignedSize;
+        return ptr;
+    }
+    return allocSlow(arena, alignedSize);
+}
+
+void
+__marble_arena_destroy(void *handle) {
+    Arena *arena = handle;
+    for (ArenaChunk *chunk = arena->Chunks; chunk;) {
+        ArenaChunk *prev = chunk->Prev;
+        free(chunk);
+        chunk = prev;
+    }
+    if (cachedArena) {
+        free(arena);
+        return;
+    }
+    resetArena(arena);
+    cachedArena = arena;
+}
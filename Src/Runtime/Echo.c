@@ -0,0 +1,206 @@
+#include <marble/Runtime/Runtime.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ECHO_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+    char Data[ECHO_BUFFER_SIZE];
+    size_t Size;
+    bool Registered;
+} EchoBuffer;
+
+static _Thread_local EchoBuffer buffer;
+static pthread_key_t bufferKey;
+static pthread_once_t bufferKeyOnce = PTHREAD_ONCE_INIT;
+
+static const char digitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static void
+writeAll(const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(STDOUT_FILENO, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+}
+
+static void
+flushBuffer(EchoBuffer *buf) {
+    writeAll(buf->Data, buf->Size);
+    buf->Size = 0;
+}
+
+static void
+flushAtThreadExit(void *buf) {
+    flushBuffer((EchoBuffer *)buf);
+}
+
+static void
+flushAtExit(void) {
+    flushBuffer(&buffer);
+}
+
+static void
+createBufferKey(void) {
+    pthread_key_create(&bufferKey, flushAtThreadExit);
+    atexit(flushAtExit);
+}
+
+static inline EchoBuffer *
+getBuffer(void) {
+    if (!buffer.Registered) {
+        pthread_once(&bufferKeyOnce, createBufferKey);
+        pthread_setspecific(bufferKey, &buffer);
+        buffer.Registered = true;
+    }
+    return &buffer;
+}
+
+// returns a pointer to at least `len` free bytes; `len` must not exceed `ECHO_BUFFER_SIZE`
+static inline char *
+reserve(EchoBuffer *buf, size_t len) {
+    if (buf->Size + len > ECHO_BUFFER_SIZE) {
+        flushBuffer(buf);
+    }
+    return buf->Data + buf->Size;
+}
+
+static inline size_t
+formatU64(uint64_t val, char *out) {
+    char tmp[20];
+    char *p = tmp + sizeof(tmp);
+    while (val >= 100) {
+        unsigned idx = (unsigned)(val % 100) * 2;
+        val /= 100;
+        p -= 2;
+        memcpy(p, digitPairs + idx, 2);
+    }
+    if (val >= 10) {
+        p -= 2;
+        memcpy(p, digitPairs + val * 2, 2);
+    }
+    else {
+        *--p = (char)('0' + val);
+    }
+    size_t len = (size_t)(tmp + sizeof(tmp) - p);
+    memcpy(out, p, len);
+    return len;
+}
+
+void
+__marble_echo_str(const char *str, int64_t len) {
+    EchoBuffer *buf = getBuffer();
+    if (len >= ECHO_BUFFER_SIZE) {
+        flushBuffer(buf);
+        writeAll(str, (size_t)len);
+        return;
+    }
+    char *out = reserve(buf, (size_t)len);
+    memcpy(out, str, (size_t)len);
+    buf->Size += (size_t)len;
+}
+
+void
+__marble_echo_char(char val) {
+    EchoBuffer *buf = getBuffer();
+    *reserve(buf, 1) = val;
+    ++buf->Size;
+}
+
+void
+__marble_echo_bool(bool val) {
+    if (val) {
+        __marble_echo_str("true\n", 5);
+    }
+    else {
+        __marble_echo_str("false\n", 6);
+    }
+}
+
+void
+__marble_echo_i64(int64_t val) {
+    EchoBuffer *buf = getBuffer();
+    char *out = reserve(buf, 21);
+    size_t len = 0;
+    uint64_t mag = (uint64_t)val;
+    if (val < 0) {
+        out[len++] = '-';
+        mag = 0 - mag;
+    }
+    len += formatU64(mag, out + len);
+    buf->Size += len;
+}
+
+void
+__marble_echo_f64(double val) {
+    EchoBuffer *buf = getBuffer();
+    char *out = reserve(buf, 32);
+    // `%g` prints integral values below 1e6 exactly like integers, so the common case skips the generic formatter
+    if (val > -1e6 && val < 1e6) {
+        int64_t integral = (int64_t)val;
+        if ((double)integral == val && !(integral == 0 && signbit(val))) {
+            size_t len = 0;
+            uint64_t mag = (uint64_t)integral;
+            if (integral < 0) {
+                out[len++] = '-';
+                mag = 0 - mag;
+            }
+            len += formatU64(mag, out + len);
+            buf->Size += len;
+            return;
+        }
+    }
+    int len = snprintf(out, 32, "%g", val);
+    if (len > 0) {
+        buf->Size += (size_t)(len < 32 ? len : 31);
+    }
+}
+
+void
+__marble_echo_ptr(const void *val) {
+    if (!val) {
+        __marble_echo_str("(nil)", 5);
+        return;
+    }
+    EchoBuffer *buf = getBuffer();
+    char *out = reserve(buf, 2 + sizeof(uintptr_t) * 2);
+    char tmp[sizeof(uintptr_t) * 2];
+    char *p = tmp + sizeof(tmp);
+    uintptr_t addr = (uintptr_t)val;
+    while (addr) {
+        *--p = "0123456789abcdef"[addr & 0xf];
+        addr >>= 4;
+    }
+    size_t len = (size_t)(tmp + sizeof(tmp) - p);
+    out[0] = '0';
+    out[1] = 'x';
+    memcpy(out + 2, p, len);
+    buf->Size += len + 2;
+}
+
+void
+__marble_echo_flush(void) {
+    flushBuffer(getBuffer());
+}
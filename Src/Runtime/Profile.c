@@ -0,0 +1,330 @@
+#include <marble/Runtime/Runtime.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+// Self time of a function is the time between its entry and exit minus the time spent in the functions it calls. Total
+// time includes the callees and is counted only for the outermost activation of a recursive function, so it is never
+// counted twice.
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define CLOCK_UNIT "cycles"
+
+static inline uint64_t
+readClock(void) {
+    return __rdtsc();
+}
+#else
+    #define CLOCK_UNIT "ns"
+
+static inline uint64_t
+readClock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#define ROOT_ID UINT32_MAX      // caller of the functions entered with an empty call stack
+
+typedef struct {
+    uint64_t Calls;
+    uint64_t Self;
+    uint64_t Total;
+    uint32_t Active;            // activations on the call stack
+} FunProfile;
+
+typedef struct {
+    uint32_t Caller;
+    uint32_t Callee;
+    uint64_t Count;             // 0 for a free slot
+} CallEdge;
+
+typedef struct {
+    FunProfile *Funs;
+    uint32_t NumFuns;
+    CallEdge *Edges;            // open addressing, the capacity is a power of two
+    uint32_t EdgesCap;
+    uint32_t NumEdges;
+} Profile;
+
+typedef struct {
+    uint32_t Fun;
+    uint64_t Start;
+    uint64_t Children;
+} ProfFrame;
+
+typedef struct {
+    Profile Data;
+    ProfFrame *Stack;
+    uint32_t Depth;
+    uint32_t StackCap;
+    bool Registered;
+} ThreadProfile;
+
+static _Thread_local ThreadProfile current;
+static pthread_key_t profileKey;
+static pthread_once_t profileKeyOnce = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t profileLock = PTHREAD_MUTEX_INITIALIZER;
+static const char **funNames;
+static uint32_t numFuns;
+static Profile merged;          // profiles of the threads which have exited
+
+static void *
+checkedRealloc(void *ptr, size_t size) {
+    void *res = realloc(ptr, size);
+    if (!res) {
+        fputs("Error: out of memory in the profiler!\n", stderr);
+        abort();
+    }
+    return res;
+}
+
+static void
+growFuns(Profile *prof, uint32_t count) {
+    prof->Funs = checkedRealloc(prof->Funs, count * sizeof(FunProfile));
+    memset(prof->Funs + prof->NumFuns, 0, (count - prof->NumFuns) * sizeof(FunProfile));
+    prof->NumFuns = count;
+}
+
+static CallEdge *
+findEdge(CallEdge *edges, uint32_t cap, uint32_t caller, uint32_t callee) {
+    uint32_t mask = cap - 1;
+    uint32_t idx = ((caller * 0x9e3779b1u) ^ callee) & mask;
+    while (edges[idx].Count && (edges[idx].Caller != caller || edges[idx].Callee != callee)) {
+        idx = (idx + 1) & mask;
+    }
+    return &edges[idx];
+}
+
+static void
+addEdge(Profile *prof, uint32_t caller, uint32_t callee, uint64_t count) {
+    if ((prof->NumEdges + 1) * 4 > prof->EdgesCap * 3) {
+        uint32_t cap = prof->EdgesCap ? prof->EdgesCap * 2 : 64;
+        CallEdge *edges = checkedRealloc(NULL, cap * sizeof(CallEdge));
+        memset(edges, 0, cap * sizeof(CallEdge));
+        for (uint32_t i = 0; i < prof->EdgesCap; ++i) {
+            if (prof->Edges[i].Count) {
+                *findEdge(edges, cap, prof->Edges[i].Caller, prof->Edges[i].Callee) = prof->Edges[i];
+            }
+        }
+        free(prof->Edges);
+        prof->Edges = edges;
+        prof->EdgesCap = cap;
+    }
+    CallEdge *edge = findEdge(prof->Edges, prof->EdgesCap, caller, callee);
+    if (!edge->Count) {
+        edge->Caller = caller;
+        edge->Callee = callee;
+        ++prof->NumEdges;
+    }
+    edge->Count += count;
+}
+
+// must be called with `profileLock` held
+static void
+mergeProfile(Profile *prof) {
+    if (merged.NumFuns < prof->NumFuns) {
+        growFuns(&merged, prof->NumFuns);
+    }
+    for (uint32_t i = 0; i < prof->NumFuns; ++i) {
+        merged.Funs[i].Calls += prof->Funs[i].Calls;
+        merged.Funs[i].Self += prof->Funs[i].Self;
+        merged.Funs[i].Total += prof->Funs[i].Total;
+    }
+    for (uint32_t i = 0; i < prof->EdgesCap; ++i) {
+        if (prof->Edges[i].Count) {
+            addEdge(&merged, prof->Edges[i].Caller, prof->Edges[i].Callee, prof->Edges[i].Count);
+        }
+    }
+    free(prof->Funs);
+    free(prof->Edges);
+    memset(prof, 0, sizeof(*prof));
+}
+
+static void
+mergeAtThreadExit(void *ptr) {
+    ThreadProfile *tp = (ThreadProfile *)ptr;
+    pthread_mutex_lock(&profileLock);
+    mergeProfile(&tp->Data);
+    pthread_mutex_unlock(&profileLock);
+    free(tp->Stack);
+    tp->Stack = NULL;
+    tp->StackCap = tp->Depth = 0;
+}
+
+static int
+compareBySelf(const void *lhs, const void *rhs) {
+    const FunProfile *a = &merged.Funs[*(const uint32_t *)lhs];
+    const FunProfile *b = &merged.Funs[*(const uint32_t *)rhs];
+    return a->Self < b->Self ? 1 : a->Self > b->Self ? -1 : 0;
+}
+
+static int
+compareByCount(const void *lhs, const void *rhs) {
+    const CallEdge *a = (const CallEdge *)lhs;
+    const CallEdge *b = (const CallEdge *)rhs;
+    return a->Count < b->Count ? 1 : a->Count > b->Count ? -1 : 0;
+}
+
+static void
+writeJsonString(FILE *out, const char *str) {
+    fputc('"', out);
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\') {
+            fputc('\\', out);
+        }
+        fputc(*str, out);
+    }
+    fputc('"', out);
+}
+
+static void
+writeProfile(const uint32_t *order, uint32_t numCalled, const CallEdge *edges, uint32_t numEdges) {
+    uint64_t selfSum = 0;
+    for (uint32_t i = 0; i < numCalled; ++i) {
+        selfSum += merged.Funs[order[i]].Self;
+    }
+    fprintf(stderr, "\nFlat profile (times in " CLOCK_UNIT "):\n");
+    fprintf(stderr, "%7s %16s %16s %12s  %s\n", "%self", "self", "total", "calls", "function");
+    for (uint32_t i = 0; i < numCalled; ++i) {
+        const FunProfile *fp = &merged.Funs[order[i]];
+        fprintf(stderr, "%7.2f %16" PRIu64 " %16" PRIu64 " %12" PRIu64 "  %s\n", selfSum ? 100.0 * (double)fp->Self / (double)selfSum : 0.0,
+                fp->Self, fp->Total, fp->Calls, funNames[order[i]]);
+    }
+    fprintf(stderr, "\nCall counts:\n");
+    fprintf(stderr, "%12s  %s\n", "calls", "caller -> callee");
+    for (uint32_t i = 0; i < numEdges; ++i) {
+        fprintf(stderr, "%12" PRIu64 "  %s -> %s\n", edges[i].Count, edges[i].Caller == ROOT_ID ? "<root>" : funNames[edges[i].Caller],
+                funNames[edges[i].Callee]);
+    }
+
+    const char *path = getenv("MARBLE_PROFILE");
+    if (!path || !*path) {
+        path = "marble-profile.json";
+    }
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "Error: can't write the profile to %s!\n", path);
+        return;
+    }
+    fprintf(out, "{\n  \"unit\": \"" CLOCK_UNIT "\",\n  \"functions\": [");
+    for (uint32_t i = 0; i < numCalled; ++i) {
+        const FunProfile *fp = &merged.Funs[order[i]];
+        fprintf(out, "%s\n    { \"name\": ", i ? "," : "");
+        writeJsonString(out, funNames[order[i]]);
+        fprintf(out, ", \"calls\": %" PRIu64 ", \"self\": %" PRIu64 ", \"total\": %" PRIu64 " }", fp->Calls, fp->Self, fp->Total);
+    }
+    fprintf(out, "\n  ],\n  \"calls\": [");
+    for (uint32_t i = 0; i < numEdges; ++i) {
+        fprintf(out, "%s\n    { \"caller\": ", i ? "," : "");
+        if (edges[i].Caller == ROOT_ID) {
+            fputs("null", out);
+        }
+        else {
+            writeJsonString(out, funNames[edges[i].Caller]);
+        }
+        fputs(", \"callee\": ", out);
+        writeJsonString(out, funNames[edges[i].Callee]);
+        fprintf(out, ", \"count\": %" PRIu64 " }", edges[i].Count);
+    }
+    fprintf(out, "\n  ]\n}\n");
+    fclose(out);
+}
+
+static void
+dumpAtExit(void) {
+    pthread_mutex_lock(&profileLock);
+    mergeProfile(&current.Data);
+
+    uint32_t *order = checkedRealloc(NULL, (merged.NumFuns + 1) * sizeof(uint32_t));
+    uint32_t numCalled = 0;
+    for (uint32_t i = 0; i < merged.NumFuns; ++i) {
+        if (merged.Funs[i].Calls) {
+            order[numCalled++] = i;
+        }
+    }
+    qsort(order, numCalled, sizeof(uint32_t), compareBySelf);
+
+    CallEdge *edges = checkedRealloc(NULL, (merged.NumEdges + 1) * sizeof(CallEdge));
+    uint32_t numEdges = 0;
+    for (uint32_t i = 0; i < merged.EdgesCap; ++i) {
+        if (merged.Edges[i].Count) {
+            edges[numEdges++] = merged.Edges[i];
+        }
+    }
+    qsort(edges, numEdges, sizeof(CallEdge), compareByCount);
+
+    writeProfile(order, numCalled, edges, numEdges);
+    free(order);
+    free(edges);
+    pthread_mutex_unlock(&profileLock);
+}
+
+static void
+createProfileKey(void) {
+    pthread_key_create(&profileKey, mergeAtThreadExit);
+    atexit(dumpAtExit);
+}
+
+void
+__marble_prof_register(const char *const *names, uint32_t count, uint32_t *base) {
+    pthread_once(&profileKeyOnce, createProfileKey);
+    pthread_mutex_lock(&profileLock);
+    funNames = checkedRealloc(funNames, (numFuns + count) * sizeof(const char *));
+    memcpy(funNames + numFuns, names, count * sizeof(const char *));
+    *base = numFuns;
+    numFuns += count;
+    pthread_mutex_unlock(&profileLock);
+}
+
+void
+__marble_prof_enter(uint32_t id) {
+    ThreadProfile *tp = &current;
+    if (!tp->Registered) {
+        pthread_setspecific(profileKey, tp);
+        tp->Registered = true;
+    }
+    if (id >= tp->Data.NumFuns) {
+        // every module registers its functions before `main`, so all the ids are known by now
+        growFuns(&tp->Data, numFuns);
+    }
+    if (tp->Depth == tp->StackCap) {
+        tp->StackCap = tp->StackCap ? tp->StackCap * 2 : 256;
+        tp->Stack = checkedRealloc(tp->Stack, tp->StackCap * sizeof(ProfFrame));
+    }
+    addEdge(&tp->Data, tp->Depth ? tp->Stack[tp->Depth - 1].Fun : ROOT_ID, id, 1);
+    FunProfile *fp = &tp->Data.Funs[id];
+    ++fp->Calls;
+    ++fp->Active;
+    ProfFrame *frame = &tp->Stack[tp->Depth++];
+    frame->Fun = id;
+    frame->Children = 0;
+    frame->Start = readClock();     // read last, so the bookkeeping above is not counted to the function
+}
+
+void
+__marble_prof_exit(void) {
+    uint64_t end = readClock();
+    ThreadProfile *tp = &current;
+    if (!tp->Depth) {
+        return;
+    }
+    ProfFrame *frame = &tp->Stack[--tp->Depth];
+    uint64_t elapsed = end - frame->Start;
+    FunProfile *fp = &tp->Data.Funs[frame->Fun];
+    fp->Self += elapsed > frame->Children ? elapsed - frame->Children : 0;
+    if (--fp->Active == 0) {
+        fp->Total += elapsed;
+    }
+    if (tp->Depth) {
+        tp->Stack[tp->Depth - 1].Children += elapsed;
+    }
+}
@@ -0,0 +1,307 @@
+#include <marble/Runtime/Runtime.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Live objects are kept in an open-addressing table keyed by their address. Removing an object shifts the following
+// entries of its cluster back, so the table never fills up with tombstones. Everything is updated under one lock,
+// because an object may be deleted by another thread than the one which created it.
+
+#define TOP_SITES 20
+
+typedef struct {
+    uint64_t Count;         // allocations of a `new` site, deletions of a `del` site, objects of an `arena` site
+    uint64_t Bytes;         // allocated by a `new` or `arena` site, released by a `del` site
+    uint64_t Frees;
+    uint64_t Live;
+    uint64_t LiveObjects;
+    uint64_t Peak;
+    uint32_t Type;          // index in `types`
+} SiteStats;
+
+typedef struct {
+    const char *Name;
+    uint64_t Count;
+    uint64_t Bytes;
+    uint64_t Live;
+    uint64_t Peak;
+} TypeStats;
+
+typedef struct {
+    uintptr_t Addr;         // 0 for a free slot
+    uint64_t Size;
+    uint32_t Site;
+} LiveObject;
+
+static pthread_mutex_t trackLock = PTHREAD_MUTEX_INITIALIZER;
+static const MarbleAllocSite **sites;
+static SiteStats *siteStats;
+static uint32_t numSites;
+static TypeStats *types;
+static uint32_t numTypes;
+static LiveObject *objects;
+static uint64_t objectsCap;
+static uint64_t numObjects;
+static uint64_t liveBytes;
+static uint64_t peakBytes;
+static uint64_t untrackedFrees;
+static bool reportLeaksAtExit;
+static bool reportRegistered;
+
+static void *
+checkedRealloc(void *ptr, size_t size) {
+    void *res = realloc(ptr, size);
+    if (!res) {
+        fputs("Error: out of memory in the allocation tracker!\n", stderr);
+        abort();
+    }
+    return res;
+}
+
+static inline uint64_t
+slotOf(uintptr_t addr) {
+    return ((uint64_t)(addr >> 4) * 0x9e3779b97f4a7c15ull) & (objectsCap - 1);
+}
+
+static LiveObject *
+findObject(uintptr_t addr) {
+    uint64_t mask = objectsCap - 1;
+    for (uint64_t idx = slotOf(addr); objects[idx].Addr; idx = (idx + 1) & mask) {
+        if (objects[idx].Addr == addr) {
+            return &objects[idx];
+        }
+    }
+    return NULL;
+}
+
+static void
+insertObject(LiveObject obj) {
+    if ((numObjects + 1) * 4 > objectsCap * 3) {
+        LiveObject *old = objects;
+        uint64_t oldCap = objectsCap;
+        objectsCap = objectsCap ? objectsCap * 2 : 1024;
+        objects = checkedRealloc(NULL, objectsCap * sizeof(LiveObject));
+        memset(objects, 0, objectsCap * sizeof(LiveObject));
+        numObjects = 0;
+        for (uint64_t i = 0; i < oldCap; ++i) {
+            if (old[i].Addr) {
+                insertObject(old[i]);
+            }
+        }
+        free(old);
+    }
+    uint64_t mask = objectsCap - 1;
+    uint64_t idx = slotOf(obj.Addr);
+    while (objects[idx].Addr) {
+        idx = (idx + 1) & mask;
+    }
+    objects[idx] = obj;
+    ++numObjects;
+}
+
+static void
+removeObject(LiveObject *obj) {
+    uint64_t mask = objectsCap - 1;
+    uint64_t hole = (uint64_t)(obj - objects);
+    for (uint64_t idx = (hole + 1) & mask; objects[idx].Addr; idx = (idx + 1) & mask) {
+        // an entry may fill the hole only if the hole lies between its home slot and its current slot
+        uint64_t home = slotOf(objects[idx].Addr);
+        if (((idx - home) & mask) >= ((idx - hole) & mask)) {
+            objects[hole] = objects[idx];
+            hole = idx;
+        }
+    }
+    objects[hole].Addr = 0;
+    --numObjects;
+}
+
+static uint32_t
+getType(const char *name) {
+    for (uint32_t i = 0; i < numTypes; ++i) {
+        if (strcmp(types[i].Name, name) == 0) {
+            return i;
+        }
+    }
+    types = checkedRealloc(types, (numTypes + 1) * sizeof(TypeStats));
+    memset(&types[numTypes], 0, sizeof(TypeStats));
+    types[numTypes].Name = name;
+    return numTypes++;
+}
+
+static int
+compareSitesByBytes(const void *lhs, const void *rhs) {
+    const SiteStats *a = &siteStats[*(const uint32_t *)lhs];
+    const SiteStats *b = &siteStats[*(const uint32_t *)rhs];
+    return a->Bytes < b->Bytes ? 1 : a->Bytes > b->Bytes ? -1 : 0;
+}
+
+static int
+compareSitesByLive(const void *lhs, const void *rhs) {
+    const SiteStats *a = &siteStats[*(const uint32_t *)lhs];
+    const SiteStats *b = &siteStats[*(const uint32_t *)rhs];
+    return a->Live < b->Live ? 1 : a->Live > b->Live ? -1 : 0;
+}
+
+static int
+compareTypesByBytes(const void *lhs, const void *rhs) {
+    const TypeStats *a = (const TypeStats *)lhs;
+    const TypeStats *b = (const TypeStats *)rhs;
+    return a->Bytes < b->Bytes ? 1 : a->Bytes > b->Bytes ? -1 : 0;
+}
+
+// collects the used sites of one kind into `order` (only the ones with live objects if `liveOnly`), sorted with `compare`
+static uint32_t
+sortSites(uint32_t *order, MarbleSiteKind kind, bool liveOnly, int (*compare)(const void *, const void *)) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < numSites; ++i) {
+        if (sites[i]->Kind == kind && siteStats[i].Count && (!liveOnly || siteStats[i].LiveObjects)) {
+            order[count++] = i;
+        }
+    }
+    qsort(order, count, sizeof(uint32_t), compare);
+    return count;
+}
+
+static void
+report(void) {
+    pthread_mutex_lock(&trackLock);
+    uint32_t *order = checkedRealloc(NULL, (numSites + 1) * sizeof(uint32_t));
+
+    uint32_t count = sortSites(order, MarbleSiteNew, false, compareSitesByBytes);
+    fprintf(stderr, "\nAllocation sites (peak %" PRIu64 " bytes live, %" PRIu64 " bytes live at exit):\n", peakBytes, liveBytes);
+    fprintf(stderr, "%12s %12s %14s %14s %14s  %s\n", "allocs", "frees", "bytes", "live bytes", "peak bytes", "type at site");
+    for (uint32_t i = 0; i < count && i < TOP_SITES; ++i) {
+        const SiteStats *s = &siteStats[order[i]];
+        fprintf(stderr, "%12" PRIu64 " %12" PRIu64 " %14" PRIu64 " %14" PRIu64 " %14" PRIu64 "  %s at %s\n", s->Count, s->Frees, s->Bytes,
+                s->Live, s->Peak, sites[order[i]]->Type, sites[order[i]]->Location);
+    }
+    if (count > TOP_SITES) {
+        fprintf(stderr, "  ... %" PRIu32 " more sites\n", count - TOP_SITES);
+    }
+
+    qsort(types, numTypes, sizeof(TypeStats), compareTypesByBytes);   // invalidates `SiteStats::Type`, which is not needed anymore
+    fprintf(stderr, "\nTypes:\n");
+    fprintf(stderr, "%12s %14s %14s %14s  %s\n", "allocs", "bytes", "live bytes", "peak bytes", "type");
+    for (uint32_t i = 0; i < numTypes && types[i].Count; ++i) {
+        fprintf(stderr, "%12" PRIu64 " %14" PRIu64 " %14" PRIu64 " %14" PRIu64 "  %s\n", types[i].Count, types[i].Bytes, types[i].Live,
+                types[i].Peak, types[i].Name);
+    }
+
+    count = sortSites(order, MarbleSiteDel, false, compareSitesByBytes);
+    if (count) {
+        fprintf(stderr, "\nDeletion sites:\n");
+        fprintf(stderr, "%12s %14s  %s\n", "deletes", "bytes", "site");
+        for (uint32_t i = 0; i < count && i < TOP_SITES; ++i) {
+            fprintf(stderr, "%12" PRIu64 " %14" PRIu64 "  %s\n", siteStats[order[i]].Count, siteStats[order[i]].Bytes, sites[order[i]]->Location);
+        }
+    }
+
+    count = sortSites(order, MarbleSiteArena, false, compareSitesByBytes);
+    if (count) {
+        fprintf(stderr, "\nArenas (their allocations are counted above and released with the arena):\n");
+        fprintf(stderr, "%12s %14s  %s\n", "allocs", "bytes", "arena at");
+        for (uint32_t i = 0; i < count && i < TOP_SITES; ++i) {
+            fprintf(stderr, "%12" PRIu64 " %14" PRIu64 "  %s\n", siteStats[order[i]].Count, siteStats[order[i]].Bytes, sites[order[i]]->Location);
+        }
+    }
+    if (untrackedFrees) {
+        fprintf(stderr, "%" PRIu64 " deletions of objects which were not allocated by a tracked `new`\n", untrackedFrees);
+    }
+
+    if (reportLeaksAtExit) {
+        count = sortSites(order, MarbleSiteNew, true, compareSitesByLive);
+        fprintf(stderr, "\nLeaks: %" PRIu64 " objects, %" PRIu64 " bytes were not deleted\n", numObjects, liveBytes);
+        if (count) {
+            fprintf(stderr, "%12s %14s  %s\n", "objects", "bytes", "type at site");
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            const SiteStats *s = &siteStats[order[i]];
+            fprintf(stderr, "%12" PRIu64 " %14" PRIu64 "  %s at %s\n", s->LiveObjects, s->Live, sites[order[i]]->Type, sites[order[i]]->Location);
+        }
+    }
+    free(order);
+    pthread_mutex_unlock(&trackLock);
+}
+
+void
+__marble_track_register(const MarbleAllocSite *table, uint32_t count, uint32_t *base, bool reportLeaks) {
+    pthread_mutex_lock(&trackLock);
+    sites = checkedRealloc(sites, (numSites + count) * sizeof(const MarbleAllocSite *));
+    siteStats = checkedRealloc(siteStats, (numSites + count) * sizeof(SiteStats));
+    memset(siteStats + numSites, 0, count * sizeof(SiteStats));
+    for (uint32_t i = 0; i < count; ++i) {
+        sites[numSites + i] = &table[i];
+        if (table[i].Kind == MarbleSiteNew) {
+            siteStats[numSites + i].Type = getType(table[i].Type);
+        }
+    }
+    *base = numSites;
+    numSites += count;
+    reportLeaksAtExit = reportLeaksAtExit || reportLeaks;
+    if (!reportRegistered) {
+        atexit(report);
+        reportRegistered = true;
+    }
+    pthread_mutex_unlock(&trackLock);
+}
+
+void
+__marble_track_alloc(void *ptr, int64_t size, uint32_t site) {
+    if (!ptr) {
+        return;
+    }
+    pthread_mutex_lock(&trackLock);
+    insertObject((LiveObject) { (uintptr_t)ptr, (uint64_t)size, site });
+    SiteStats *s = &siteStats[site];
+    TypeStats *t = &types[s->Type];
+    ++s->Count;
+    ++s->LiveObjects;
+    s->Bytes += (uint64_t)size;
+    s->Live += (uint64_t)size;
+    s->Peak = s->Live > s->Peak ? s->Live : s->Peak;
+    ++t->Count;
+    t->Bytes += (uint64_t)size;
+    t->Live += (uint64_t)size;
+    t->Peak = t->Live > t->Peak ? t->Live : t->Peak;
+    liveBytes += (uint64_t)size;
+    peakBytes = liveBytes > peakBytes ? liveBytes : peakBytes;
+    pthread_mutex_unlock(&trackLock);
+}
+
+void
+__marble_track_free(void *ptr, uint32_t site) {
+    if (!ptr) {
+        return;
+    }
+    pthread_mutex_lock(&trackLock);
+    LiveObject *obj = objectsCap ? findObject((uintptr_t)ptr) : NULL;
+    if (!obj) {
+        ++untrackedFrees;
+        pthread_mutex_unlock(&trackLock);
+        return;
+    }
+    SiteStats *from = &siteStats[obj->Site];
+    ++from->Frees;
+    --from->LiveObjects;
+    from->Live -= obj->Size;
+    types[from->Type].Live -= obj->Size;
+    liveBytes -= obj->Size;
+    ++siteStats[site].Count;
+    siteStats[site].Bytes += obj->Size;
+    removeObject(obj);
+    pthread_mutex_unlock(&trackLock);
+}
+
+void
+__marble_track_arena_alloc(int64_t size, uint32_t site, uint32_t arenaSite) {
+    pthread_mutex_lock(&trackLock);
+    ++siteStats[site].Count;
+    siteStats[site].Bytes += (uint64_t)size;
+    ++types[siteStats[site].Type].Count;
+    types[siteStats[site].Type].Bytes += (uint64_t)size;
+    ++siteStats[arenaSite].Count;
+    siteStats[arenaSite].Bytes += (uint64_t)size;
+    pthread_mutex_unlock(&trackLock);
+}
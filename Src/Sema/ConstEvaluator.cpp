@@ -0,0 +1,738 @@
+#include <marble/Sema/ConstEvaluator.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace marble {
+    static bool
+    isInt(ASTTypeKind kind) {
+        return kind >= ASTTypeKind::Bool && kind <= ASTTypeKind::I64;
+    }
+
+    static bool
+    isFloat(ASTTypeKind kind) {
+        return kind == ASTTypeKind::F32 || kind == ASTTypeKind::F64;
+    }
+
+    static unsigned
+    bitWidth(ASTTypeKind kind) {
+        switch (kind) {
+            case ASTTypeKind::Bool:
+                return 1;
+            case ASTTypeKind::Char:
+                return 8;
+            case ASTTypeKind::I16:
+                return 16;
+            case ASTTypeKind::I32:
+                return 32;
+            default:
+                return 64;
+        }
+    }
+
+    static ASTType
+    scalarType(ASTTypeKind kind) {
+        static const char *names[] = { "bool", "char", "i16", "i32", "i64", "f32", "f64" };
+        return ASTType(kind, names[static_cast<int>(kind)], false, 0);
+    }
+
+    // integers are sign-extended to 64 bits, so `true` is -1 as after `sext i1` in CodeGen
+    static int64_t
+    toInt(const ASTVal &val) {
+        switch (val.GetType().GetTypeKind()) {
+            case ASTTypeKind::Bool:
+                return val.GetData().boolVal ? -1 : 0;
+            case ASTTypeKind::Char:
+                return static_cast<int8_t>(val.GetData().charVal);
+            case ASTTypeKind::I16:
+                return val.GetData().i16Val;
+            case ASTTypeKind::I32:
+                return val.GetData().i32Val;
+            default:
+                return val.GetData().i64Val;
+        }
+    }
+
+    static ASTVal
+    fromInt(uint64_t val, ASTTypeKind kind) {
+        switch (kind) {
+            #define VAL(field, cast_type) ASTVal(scalarType(kind), ASTValData { .field = static_cast<cast_type>(val) }, false, false)
+            case ASTTypeKind::Bool:
+                return ASTVal(scalarType(kind), ASTValData { .boolVal = (val & 1) != 0 }, false, false);
+            case ASTTypeKind::Char:
+                return VAL(charVal, int8_t);
+            case ASTTypeKind::I16:
+                return VAL(i16Val, int16_t);
+            case ASTTypeKind::I32:
+                return VAL(i32Val, int32_t);
+            default:
+                return VAL(i64Val, int64_t);
+            #undef VAL
+        }
+    }
+
+    static ASTVal
+    fromBool(bool val) {
+        return ASTVal(scalarType(ASTTypeKind::Bool), ASTValData { .boolVal = val }, false, false);
+    }
+
+    bool
+    ConstEvaluator::IsTrue(const ASTVal &val) {
+        switch (val.GetType().GetTypeKind()) {
+            case ASTTypeKind::F32:
+                return val.GetData().f32Val != 0;
+            case ASTTypeKind::F64:
+                return val.GetData().f64Val != 0;
+            default:
+                return toInt(val) != 0;
+        }
+    }
+
+    template<typename T>
+    static std::optional<ASTVal>
+    floatOp(TokenKind op, T lhs, T rhs, ASTTypeKind kind, std::string &error) {
+        auto make = [kind](T val) {
+            if (kind == ASTTypeKind::F32) {
+                return ASTVal(scalarType(kind), ASTValData { .f32Val = static_cast<float>(val) }, false, false);
+            }
+            return ASTVal(scalarType(kind), ASTValData { .f64Val = static_cast<double>(val) }, false, false);
+        };
+        switch (op) {
+            case TkPlus:
+                return make(lhs + rhs);
+            case TkMinus:
+                return make(lhs - rhs);
+            case TkStar:
+                return make(lhs * rhs);
+            case TkSlash:
+                return make(lhs / rhs);
+            case TkPercent:
+                return make(std::fmod(lhs, rhs));
+            case TkGt:
+                return fromBool(lhs > rhs);
+            case TkGtEq:
+                return fromBool(lhs >= rhs);
+            case TkLt:
+                return fromBool(lhs < rhs);
+            case TkLtEq:
+                return fromBool(lhs <= rhs);
+            case TkEqEq:
+                return fromBool(lhs == rhs);
+            case TkNotEq:
+                return fromBool(lhs < rhs || lhs > rhs);    // ordered, as `fcmp one`
+            default:
+                error = "operator is not supported for floating point values";
+                return std::nullopt;
+        }
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::BinaryOp(TokenKind op, ASTVal lhs, ASTVal rhs, std::string &error) {
+        if (!IsSupportedType(lhs.GetType()) || !IsSupportedType(rhs.GetType())) {
+            error = "only numbers, chars and bools are supported";
+            return std::nullopt;
+        }
+        ASTType common = scalarType(std::max(lhs.GetType().GetTypeKind(), rhs.GetType().GetTypeKind()));
+        lhs = Convert(lhs, common).value();
+        rhs = Convert(rhs, common).value();
+        ASTTypeKind kind = common.GetTypeKind();
+        if (kind == ASTTypeKind::F32) {
+            return floatOp(op, lhs.GetData().f32Val, rhs.GetData().f32Val, kind, error);
+        }
+        if (kind == ASTTypeKind::F64) {
+            return floatOp(op, lhs.GetData().f64Val, rhs.GetData().f64Val, kind, error);
+        }
+
+        int64_t l = toInt(lhs);
+        int64_t r = toInt(rhs);
+        uint64_t ul = static_cast<uint64_t>(l);
+        uint64_t ur = static_cast<uint64_t>(r);
+        switch (op) {
+            case TkPlus:
+                return fromInt(ul + ur, kind);
+            case TkMinus:
+                return fromInt(ul - ur, kind);
+            case TkStar:
+                return fromInt(ul * ur, kind);
+            case TkSlash:
+            case TkPercent: {
+                if (r == 0) {
+                    error = "division by zero";
+                    return std::nullopt;
+                }
+                unsigned width = bitWidth(kind);
+                int64_t min = width == 64 ? INT64_MIN : -(static_cast<int64_t>(1) << (width - 1));
+                if (l == min && r == -1) {
+                    error = "signed overflow in division";
+                    return std::nullopt;
+                }
+                return fromInt(static_cast<uint64_t>(op == TkSlash ? l / r : l % r), kind);
+            }
+            case TkLogAnd:
+                return fromBool(l != 0 && r != 0);
+            case TkLogOr:
+                return fromBool(l != 0 || r != 0);
+            case TkAnd:
+                return fromInt(ul & ur, kind);
+            case TkOr:
+                return fromInt(ul | ur, kind);
+            case TkGt:
+                return fromBool(l > r);
+            case TkGtEq:
+                return fromBool(l >= r);
+            case TkLt:
+                return fromBool(l < r);
+            case TkLtEq:
+                return fromBool(l <= r);
+            case TkEqEq:
+                return fromBool(l == r);
+            case TkNotEq:
+                return fromBool(l != r);
+            default:
+                error = "operator is not supported";
+                return std::nullopt;
+        }
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::UnaryOp(TokenKind op, ASTVal rhs, std::string &error) {
+        if (!IsSupportedType(rhs.GetType())) {
+            error = "only numbers, chars and bools are supported";
+            return std::nullopt;
+        }
+        ASTTypeKind kind = rhs.GetType().GetTypeKind();
+        switch (op) {
+            case TkMinus:
+                if (kind == ASTTypeKind::F32) {
+                    return ASTVal(scalarType(kind), ASTValData { .f32Val = -rhs.GetData().f32Val }, false, false);
+                }
+                if (kind == ASTTypeKind::F64) {
+                    return ASTVal(scalarType(kind), ASTValData { .f64Val = -rhs.GetData().f64Val }, false, false);
+                }
+                return fromInt(0 - static_cast<uint64_t>(toInt(rhs)), kind);
+            case TkBang:
+                if (isInt(kind)) {
+                    return fromInt(~static_cast<uint64_t>(toInt(rhs)), kind);
+                }
+                error = "operator `!` is not supported for floating point values";
+                return std::nullopt;
+            default:
+                error = "operator is not supported";
+                return std::nullopt;
+        }
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::Call(Function *fun, Module *mod, const std::vector<ASTVal> &args) {
+        if (fun->IsDeclaration) {
+            return fail("function `" + fun->Name + "` has no body");
+        }
+        if (args.size() != fun->Args.size()) {
+            return fail("wrong number of arguments for `" + fun->Name + "`");
+        }
+        _frames.push_back(Frame { .Mod = mod, .RetType = fun->RetType, .Scopes = { {} } });
+        reserve(FrameCost);
+        for (size_t i = 0; i < args.size() && !failed(); ++i) {
+            std::optional<ASTVal> arg = Convert(args[i], fun->Args[i].GetType());
+            if (!arg) {
+                fail("argument `" + fun->Args[i].GetName() + "` of type `" + fun->Args[i].GetType().ToString() + "` is not supported");
+                break;
+            }
+            declareVar(fun->Args[i].GetName(), *arg);
+        }
+        if (!failed()) {
+            execBlock(fun->Body);
+        }
+        _memory -= _frames.back().Memory;
+        _frames.pop_back();
+        if (failed()) {
+            return std::nullopt;
+        }
+
+        std::optional<ASTVal> ret = _retVal;
+        bool returned = _flow == Flow::Return;
+        _flow = Flow::Normal;
+        _retVal.reset();
+        if (!returned) {
+            if (fun->RetType.GetTypeKind() == ASTTypeKind::Noth) {
+                return ASTVal::GetDefaultByType(ASTType::GetNothType());
+            }
+            return fail("function `" + fun->Name + "` finished without returning a value");
+        }
+        return ret;
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::Fold(Expr *expr, const std::function<std::optional<ASTVal>(const std::string &)> &lookup) {
+        if (expr->GetConstVal()) {
+            return expr->GetConstVal();
+        }
+        std::string error;
+        switch (expr->GetKind()) {
+            case NkLiteralExpr: {
+                ASTVal val = llvm::cast<LiteralExpr>(expr)->GetVal();
+                if (IsSupportedType(val.GetType())) {
+                    return val;
+                }
+                return std::nullopt;
+            }
+            case NkVarExpr:
+                if (!lookup) {
+                    return std::nullopt;
+                }
+                return lookup(llvm::cast<VarExpr>(expr)->GetName());
+            case NkUnaryExpr: {
+                UnaryExpr *ue = llvm::cast<UnaryExpr>(expr);
+                std::optional<ASTVal> rhs = Fold(ue->GetRHS(), lookup);
+                if (!rhs) {
+                    return std::nullopt;
+                }
+                return UnaryOp(ue->GetOp().GetKind(), *rhs, error);
+            }
+            case NkBinaryExpr: {
+                BinaryExpr *be = llvm::cast<BinaryExpr>(expr);
+                std::optional<ASTVal> lhs = Fold(be->GetLHS(), lookup);
+                if (!lhs) {
+                    return std::nullopt;
+                }
+                std::optional<ASTVal> rhs = Fold(be->GetRHS(), lookup);
+                if (!rhs) {
+                    return std::nullopt;
+                }
+                return BinaryOp(be->GetOp().GetKind(), *lhs, *rhs, error);
+            }
+            default:
+                return std::nullopt;
+        }
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::Convert(ASTVal val, ASTType type) {
+        if (!IsSupportedType(val.GetType()) || !IsSupportedType(type)) {
+            return std::nullopt;
+        }
+        ASTTypeKind from = val.GetType().GetTypeKind();
+        ASTTypeKind to = type.GetTypeKind();
+        ASTType dest = scalarType(to);
+        if (from == to) {
+            return ASTVal(dest, val.GetData(), false, false);
+        }
+        if (isInt(from) && isInt(to)) {
+            return fromInt(static_cast<uint64_t>(toInt(val)), to);
+        }
+        if (isInt(from)) {
+            if (to == ASTTypeKind::F32) {
+                return ASTVal(dest, ASTValData { .f32Val = static_cast<float>(toInt(val)) }, false, false);
+            }
+            return ASTVal(dest, ASTValData { .f64Val = static_cast<double>(toInt(val)) }, false, false);
+        }
+        if (isFloat(to)) {
+            if (to == ASTTypeKind::F32) {
+                return ASTVal(dest, ASTValData { .f32Val = static_cast<float>(val.GetData().f64Val) }, false, false);
+            }
+            return ASTVal(dest, ASTValData { .f64Val = static_cast<double>(val.GetData().f32Val) }, false, false);
+        }
+        return std::nullopt;    // floating point values are never implicitly converted to integers
+    }
+
+    bool
+    ConstEvaluator::IsSupportedType(ASTType type) {
+        return !type.IsPointer() && (isInt(type.GetTypeKind()) || isFloat(type.GetTypeKind()));
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitVarDeclStmt(VarDeclStmt *vds) {
+        if (!step()) {
+            return std::nullopt;
+        }
+        if (vds->IsStatic()) {
+            return unsupported("static variable");
+        }
+        ASTVal val = ASTVal::GetDefaultByType(vds->GetType());
+        if (vds->GetExpr()) {
+            std::optional<ASTVal> init = Visit(vds->GetExpr());
+            if (!init) {
+                return std::nullopt;
+            }
+            val = *init;
+        }
+        std::optional<ASTVal> converted = Convert(val, vds->GetType());
+        if (!converted) {
+            return fail("variable `" + vds->GetName() + "` of type `" + vds->GetType().ToString() + "` is not supported");
+        }
+        declareVar(vds->GetName(), *converted);
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitVarAsgnStmt(VarAsgnStmt *vas) {
+        if (!step()) {
+            return std::nullopt;
+        }
+        if (vas->GetDerefDepth() != 0) {
+            return unsupported("assignment through a pointer");
+        }
+        std::optional<ASTVal> val = Visit(vas->GetExpr());
+        if (!val) {
+            return std::nullopt;
+        }
+        auto &scopes = _frames.back().Scopes;
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+            if (auto var = scope->find(vas->GetName()); var != scope->end()) {
+                std::optional<ASTVal> converted = Convert(*val, var->second.GetType());
+                if (!converted) {
+                    return fail("cannot assign a value of type `" + val->GetType().ToString() + "` to `" + vas->GetName() + "`");
+                }
+                var->second = *converted;
+                return std::nullopt;
+            }
+        }
+        return unsupported("assignment to a global variable");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitFunDeclStmt(FunDeclStmt *fds) {
+        return unsupported("function declaration");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitFunCallStmt(FunCallStmt *fcs) {
+        if (!step()) {
+            return std::nullopt;
+        }
+        callFunction(fcs->GetName(), fcs->GetArgs());
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitRetStmt(RetStmt *rs) {
+        if (!step()) {
+            return std::nullopt;
+        }
+        ASTType retType = _frames.back().RetType;
+        if (!rs->GetExpr()) {
+            _retVal = ASTVal::GetDefaultByType(ASTType::GetNothType());
+            _flow = Flow::Return;
+            return std::nullopt;
+        }
+        std::optional<ASTVal> val = Visit(rs->GetExpr());
+        if (!val) {
+            return std::nullopt;
+        }
+        _retVal = Convert(*val, retType);
+        if (!_retVal) {
+            return fail("cannot return a value of type `" + val->GetType().ToString() + "` as `" + retType.ToString() + "`");
+        }
+        _flow = Flow::Return;
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitIfElseStmt(IfElseStmt *ies) {
+        if (!step()) {
+            return std::nullopt;
+        }
+        std::optional<ASTVal> cond = Visit(ies->GetCondition());
+        if (!cond) {
+            return std::nullopt;
+        }
+        execBlock(IsTrue(*cond) ? ies->GetThenBody() : ies->GetElseBody());
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitForLoopStmt(ForLoopStmt *fls) {
+        if (!step()) {
+            return std::nullopt;
+        }
+        _frames.back().Scopes.push_back({});
+        if (fls->GetIndexator()) {
+            Visit(fls->GetIndexator());
+        }
+        while (!failed()) {
+            std::optional<ASTVal> cond = Visit(fls->GetCondition());
+            if (!cond || !IsTrue(*cond)) {
+                break;
+            }
+            execBlock(fls->GetBody());
+            if (failed() || _flow == Flow::Return) {
+                break;
+            }
+            if (_flow == Flow::Break) {
+                _flow = Flow::Normal;
+                break;
+            }
+            _flow = Flow::Normal;
+            if (fls->GetIteration()) {
+                Visit(fls->GetIteration());
+            }
+        }
+        popScope();
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitBreakStmt(BreakStmt *bs) {
+        if (step()) {
+            _flow = Flow::Break;
+        }
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitContinueStmt(ContinueStmt *cs) {
+        if (step()) {
+            _flow = Flow::Continue;
+        }
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitStructStmt(StructStmt *ss) {
+        return unsupported("structure declaration");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitFieldAsgnStmt(FieldAsgnStmt *fas) {
+        return unsupported("field assignment");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitImplStmt(ImplStmt *is) {
+        return unsupported("implementation");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitMethodCallStmt(MethodCallStmt *mcs) {
+        return unsupported("method call");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitTraitDeclStmt(TraitDeclStmt *tds) {
+        return unsupported("trait declaration");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitEchoStmt(EchoStmt *es) {
+        return unsupported("`echo`");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitDelStmt(DelStmt *ds) {
+        return unsupported("`del`");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitImportStmt(ImportStmt *is) {
+        return unsupported("`import`");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitModuleDeclStmt(ModuleDeclStmt *mds) {
+        return unsupported("module declaration");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitArenaStmt(ArenaStmt *as) {
+        return unsupported("`arena`");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitBinaryExpr(BinaryExpr *be) {
+        if (!step()) {
+            return std::nullopt;
+        }
+        std::optional<ASTVal> lhs = Visit(be->GetLHS());
+        if (!lhs) {
+            return std::nullopt;
+        }
+        std::optional<ASTVal> rhs = Visit(be->GetRHS());
+        if (!rhs) {
+            return std::nullopt;
+        }
+        std::string error;
+        std::optional<ASTVal> res = BinaryOp(be->GetOp().GetKind(), *lhs, *rhs, error);
+        if (!res) {
+            return fail(error);
+        }
+        return res;
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitUnaryExpr(UnaryExpr *ue) {
+        if (!step()) {
+            return std::nullopt;
+        }
+        std::optional<ASTVal> rhs = Visit(ue->GetRHS());
+        if (!rhs) {
+            return std::nullopt;
+        }
+        std::string error;
+        std::optional<ASTVal> res = UnaryOp(ue->GetOp().GetKind(), *rhs, error);
+        if (!res) {
+            return fail(error);
+        }
+        return res;
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitVarExpr(VarExpr *ve) {
+        if (!step()) {
+            return std::nullopt;
+        }
+        Frame &frame = _frames.back();
+        for (auto scope = frame.Scopes.rbegin(); scope != frame.Scopes.rend(); ++scope) {
+            if (auto var = scope->find(ve->GetName()); var != scope->end()) {
+                return var->second;
+            }
+        }
+        if (auto var = frame.Mod->Variables.find(ve->GetName()); var != frame.Mod->Variables.end()) {
+            if (var->second.IsConst && var->second.ConstVal) {
+                return var->second.ConstVal;
+            }
+        }
+        return fail("value of `" + ve->GetName() + "` is not known at compile time");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitLiteralExpr(LiteralExpr *le) {
+        if (!step()) {
+            return std::nullopt;
+        }
+        if (!IsSupportedType(le->GetVal().GetType())) {
+            return fail("literal of type `" + le->GetVal().GetType().ToString() + "` is not supported");
+        }
+        return le->GetVal();
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitFunCallExpr(FunCallExpr *fce) {
+        if (!step()) {
+            return std::nullopt;
+        }
+        return callFunction(fce->GetName(), fce->GetArgs());
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitStructExpr(StructExpr *se) {
+        return unsupported("structure literal");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitFieldAccessExpr(FieldAccessExpr *fae) {
+        return unsupported("field access");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitMethodCallExpr(MethodCallExpr *mce) {
+        return unsupported("method call");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitNilExpr(NilExpr *ne) {
+        return unsupported("`nil`");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitDerefExpr(DerefExpr *de) {
+        return unsupported("dereference");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitRefExpr(RefExpr *re) {
+        return unsupported("taking an address");
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::VisitNewExpr(NewExpr *ne) {
+        return unsupported("`new`");
+    }
+
+    void
+    ConstEvaluator::execBlock(const std::vector<Stmt *> &body) {
+        _frames.back().Scopes.push_back({});
+        for (auto *stmt : body) {
+            Visit(stmt);
+            if (failed() || _flow != Flow::Normal) {
+                break;
+            }
+        }
+        popScope();
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::callFunction(const std::string &name, const std::vector<Expr *> &args) {
+        Module *mod = _frames.back().Mod;
+        auto fun = mod->Functions.find(name);
+        if (fun == mod->Functions.end()) {
+            return fail("function `" + name + "` is undeclared");
+        }
+        if (!fun->second.IsConst) {
+            return fail("function `" + name + "` is not `const`");
+        }
+        std::vector<ASTVal> vals;
+        for (auto *arg : args) {
+            std::optional<ASTVal> val = Visit(arg);
+            if (!val) {
+                return std::nullopt;
+            }
+            vals.push_back(*val);
+        }
+        return Call(&fun->second, mod, vals);
+    }
+
+    void
+    ConstEvaluator::declareVar(const std::string &name, ASTVal val) {
+        if (reserve(VarCost)) {
+            _frames.back().Scopes.back().insert_or_assign(name, val);
+        }
+    }
+
+    void
+    ConstEvaluator::popScope() {
+        Frame &frame = _frames.back();
+        unsigned long size = frame.Scopes.back().size() * VarCost;
+        frame.Memory -= size;
+        _memory -= size;
+        frame.Scopes.pop_back();
+    }
+
+    bool
+    ConstEvaluator::step() {
+        if (failed()) {
+            return false;
+        }
+        if (++_steps > _limits.MaxSteps) {
+            fail("evaluation exceeded the limit of " + std::to_string(_limits.MaxSteps) + " steps");
+            return false;
+        }
+        return true;
+    }
+
+    bool
+    ConstEvaluator::reserve(unsigned long bytes) {
+        if (failed()) {
+            return false;
+        }
+        if (_memory + bytes > _limits.MaxMemory) {
+            fail("evaluation exceeded the limit of " + std::to_string(_limits.MaxMemory) + " bytes of memory");
+            return false;
+        }
+        _memory += bytes;
+        _frames.back().Memory += bytes;
+        return true;
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::fail(const std::string &msg) {
+        if (!failed()) {
+            _error = msg;
+        }
+        return std::nullopt;
+    }
+
+    std::optional<ASTVal>
+    ConstEvaluator::unsupported(const std::string &what) {
+        return fail(what + " is not allowed at compile time");
+    }
+}
@@ -1,12 +1,18 @@
 #include <marble/Sema/Semantic.h>
 #include <llvm/Support/Path.h>
+#include <algorithm>
 #include <cmath>
-#include <sstream>
 
 static bool isMemberAccessing = false;
 static bool inModule = false;
 
 namespace marble {
+    // the parameters past the last bit share it
+    static uint64_t
+    paramMask(unsigned idx) {
+        return 1ull << std::min(idx, 63u);
+    }
+
     static std::unordered_map<ASTTypeKind, std::vector<ASTTypeKind>> implicitlyCastAllowed {
         { ASTTypeKind::Char, { ASTTypeKind::I16, ASTTypeKind::I32, ASTTypeKind::I64, ASTTypeKind::F32, ASTTypeKind::F64 } },
         { ASTTypeKind::I16,  { ASTTypeKind::I32, ASTTypeKind::I64, ASTTypeKind::F32, ASTTypeKind::F64                   } },
@@ -34,6 +40,8 @@ namespace marble {
                 Visit(stmt);
             }
         }
+        analyzeReachedBodies();
+        checkArenaCalls();
     }
 
     std::optional<ASTVal>
@@ -42,7 +50,7 @@ namespace marble {
             _diag.Report(vds->GetStartLoc(), ErrCannotHaveAccessBeHere)
                 << llvm::SMRange(vds->GetStartLoc(), vds->GetEndLoc());
         }
-        if (_vars.top().find(vds->GetName()) != _vars.top().end()) {
+        if (_vars.back().find(vds->GetName()) != _vars.back().end()) {
             _diag.Report(vds->GetStartLoc(), ErrRedefinitionVar)
                 << llvm::SMRange(vds->GetStartLoc(), vds->GetEndLoc())
                 << vds->GetName();
@@ -73,15 +81,41 @@ namespace marble {
                     return std::nullopt;
                 }
             }
+            bool inConstInit = _inConstInit;
+            _inConstInit = vds->IsConst();
             std::optional<ASTVal> val = vds->GetExpr() != nullptr ? Visit(vds->GetExpr()) : ASTVal::GetDefaultByType(vds->GetType());
+            _inConstInit = inConstInit;
             if (vds->GetType().GetTypeKind() == ASTTypeKind::Struct && vds->GetExpr() == nullptr) {
                 val = ASTVal(ASTType(ASTTypeKind::Struct, vds->GetType().GetVal(), false, 0), ASTValData { .i32Val = 0 }, false, false);
             }
+            if (vds->IsStatic()) {
+                checkPurity("static variable", vds->GetStartLoc(), vds->GetEndLoc());
+            }
+            if (_inConstFun) {
+                checkConstFunType(vds->GetType(), vds->GetStartLoc(), vds->GetEndLoc());
+            }
             Variable var { .Name = vds->GetName(), .Type = vds->GetType(), .Val = val, .IsConst = vds->IsConst() };
+            var.ArenaDepth = vds->IsStatic() ? 0 : _arenaDepth;
+            if (_vars.size() != 1) {
+                var.Slot = _nextSlot++;
+                vds->SetSlot(var.Slot);
+            }
             if (vds->GetExpr()) {
                 implicitlyCast(var.Val.value(), var.Type, vds->GetExpr()->GetStartLoc(), vds->GetExpr()->GetEndLoc());
+                checkArenaEscape(var.Val.value(), ArenaStorage { .Depth = var.ArenaDepth, .Local = _vars.size() != 1 && !vds->IsStatic() },
+                                 vds->GetStartLoc(), vds->GetEndLoc());
+                if (vds->IsConst()) {
+                    if (std::optional<ASTVal> constVal = ConstEvaluator::Fold(vds->GetExpr())) {
+                        var.ConstVal = ConstEvaluator::Convert(*constVal, var.Type);
+                    }
+                    if (_vars.size() == 1) {
+                        if (Variable *global = findVar(vds->GetName())) {
+                            global->ConstVal = var.ConstVal;
+                        }
+                    }
+                }
             }
-            _vars.top().emplace(vds->GetName(), var);
+            _vars.back().emplace(vds->GetName(), var);
         }
         return std::nullopt;
     }
@@ -96,36 +130,50 @@ namespace marble {
             _diag.Report(vas->GetStartLoc(), ErrCannotHaveAccessBeHere)
                 << llvm::SMRange(vas->GetStartLoc(), vas->GetEndLoc());
         }
-        auto varsCopy = _vars;
-        while (!varsCopy.empty()) {
-            if (auto var = varsCopy.top().find(vas->GetName()); var != varsCopy.top().end()) {
-                if (var->second.IsConst) {
-                    _diag.Report(vas->GetStartLoc(), ErrAssignmentConst)
-                        << llvm::SMRange(vas->GetStartLoc(), vas->GetEndLoc());
-                    return std::nullopt;
-                }
-                ASTVal val = Visit(vas->GetExpr()).value_or(ASTVal::GetDefaultByType(ASTType::GetNothType()));
-                ASTType type = var->second.Type;
-                if (var->second.Type.IsPointer()) {
-                    for (unsigned char dd = vas->GetDerefDepth(); dd > 0; type.Deref(), --dd) {
-                        if (!type.IsPointer()) {
-                            _diag.Report(vas->GetStartLoc(), ErrDerefFromNonPtr)
-                                << llvm::SMRange(vas->GetStartLoc(),
-                                                 llvm::SMLoc::getFromPointer(vas->GetStartLoc().getPointer() + vas->GetDerefDepth() + vas->GetName().length()));
-                            break;
-                        }
-                        if (val.IsNil()) {
-                            _diag.Report(vas->GetExpr()->GetStartLoc(), ErrDerefFromNil)
-                                << llvm::SMRange(vas->GetStartLoc(), vas->GetEndLoc());
-                            break;
-                        }
+        size_t scope;
+        if (Variable *var = lookupVar(vas->GetName(), scope)) {
+            vas->SetSlot(var->Slot);
+            if (var->IsConst) {
+                _diag.Report(vas->GetStartLoc(), ErrAssignmentConst)
+                    << llvm::SMRange(vas->GetStartLoc(), vas->GetEndLoc());
+                return std::nullopt;
+            }
+            ASTVal val = Visit(vas->GetExpr()).value_or(ASTVal::GetDefaultByType(ASTType::GetNothType()));
+            ASTType type = var->Type;
+            if (var->Type.IsPointer()) {
+                for (unsigned char dd = vas->GetDerefDepth(); dd > 0; type.Deref(), --dd) {
+                    if (!type.IsPointer()) {
+                        _diag.Report(vas->GetStartLoc(), ErrDerefFromNonPtr)
+                            << llvm::SMRange(vas->GetStartLoc(),
+                                             llvm::SMLoc::getFromPointer(vas->GetStartLoc().getPointer() + vas->GetDerefDepth() + vas->GetName().length()));
+                        break;
+                    }
+                    if (val.IsNil()) {
+                        _diag.Report(vas->GetExpr()->GetStartLoc(), ErrDerefFromNil)
+                            << llvm::SMRange(vas->GetStartLoc(), vas->GetEndLoc());
+                        break;
                     }
                 }
-                val = implicitlyCast(val, type, vas->GetExpr()->GetStartLoc(), vas->GetExpr()->GetEndLoc());
-                var->second.Val = val;
-                return std::nullopt;
             }
-            varsCopy.pop();
+            if (vas->GetDerefDepth() == 0) {
+                checkArenaEscape(val, ArenaStorage { .Depth = var->ArenaDepth, .Local = scope != 0 }, vas->GetStartLoc(), vas->GetEndLoc());
+                // only the arena is kept, the variable may still hold any of the values assigned to it; a value that escapes is
+                // reported once, not again where the variable is read
+                if (var->Val && val.GetArenaDepth() <= var->ArenaDepth) {
+                    setArena(*var->Val, mergeArenas(getArena(*var->Val), getArena(val)));
+                }
+                if (scope == 0) {
+                    checkPurity("assignment to a global variable", vas->GetStartLoc(), vas->GetEndLoc());
+                }
+            }
+            else {
+                // the pointee of a pointer from an arena lives in that arena, other storage is outside of any arena
+                ArenaStorage storage = vas->GetDerefDepth() == 1 ? getVarArena(vas->GetName(), true) : ArenaStorage {};
+                checkArenaEscape(val, storage, vas->GetStartLoc(), vas->GetEndLoc());
+                checkPurity("assignment through a pointer", vas->GetStartLoc(), vas->GetEndLoc());
+            }
+            implicitlyCast(val, type, vas->GetExpr()->GetStartLoc(), vas->GetExpr()->GetEndLoc());
+            return std::nullopt;
         }
         _diag.Report(vas->GetStartLoc(), ErrUndeclaredVariable)
             << getRange(vas->GetStartLoc(), vas->GetName().size())
@@ -150,9 +198,10 @@ namespace marble {
                 << fds->GetRetType().GetVal();
             return std::nullopt;
         }
-        _vars.push({});
+        _vars.emplace_back();
+        _nextSlot = 0;
         for (auto arg : fds->GetArgs()) {
-            if (_vars.top().find(arg.GetName()) != _vars.top().end()) {
+            if (_vars.back().find(arg.GetName()) != _vars.back().end()) {
                 _diag.Report(fds->GetStartLoc(), ErrRedefinitionVar)
                     << llvm::SMRange(fds->GetStartLoc(), fds->GetEndLoc())
                     << arg.GetName();
@@ -164,12 +213,20 @@ namespace marble {
                     << arg.GetType().GetVal();
                 return std::nullopt;
             }
-            _vars.top().emplace(arg.GetName(), Variable { .Name = arg.GetName(), .Type = arg.GetType(),
-                                                          .Val = arg.GetType().IsPointer() ? ASTVal(arg.GetType(), ASTValData { .i32Val = 0 }, false, false)
-                                                                                           : ASTVal::GetDefaultByType(arg.GetType()),
-                                                          .IsConst = arg.GetType().IsConst(), .Access = AccessPriv });
+            _vars.back().emplace(arg.GetName(), Variable { .Name = arg.GetName(), .Type = arg.GetType(), .Val = getParamVal(arg.GetType(), _nextSlot),
+                                                          .IsConst = arg.GetType().IsConst(), .Access = AccessPriv, .Slot = _nextSlot++ });
+        }
+        checkFunAttrs(fds);
+        if (fds->IsConst()) {
+            checkConstFunType(fds->GetRetType(), fds->GetStartLoc(), fds->GetEndLoc());
+            for (auto &arg : fds->GetArgs()) {
+                checkConstFunType(arg.GetType(), fds->GetStartLoc(), fds->GetEndLoc());
+            }
         }
         _funRetsTypes.push(fds->GetRetType());
+        _inPureFun = fds->HasAttr(FunAttrPure) || fds->IsConst();
+        _inConstFun = fds->IsConst();
+        _currentFun = fds;
         bool hasRet = false;
         for (auto stmt : fds->GetBody()) {
             if (stmt->GetKind() == NkRetStmt) {
@@ -177,8 +234,12 @@ namespace marble {
             }
             Visit(stmt);
         }
+        _currentFun = nullptr;
+        _inPureFun = false;
+        _inConstFun = false;
         _funRetsTypes.pop();
-        _vars.pop();
+        _vars.pop_back();
+        fds->SetNumSlots(_nextSlot);
 
         if (!hasRet && fds->GetRetType().GetTypeKind() != ASTTypeKind::Noth) {
             _diag.Report(fds->GetStartLoc(), ErrNotAllPathsReturnsValue)
@@ -209,6 +270,7 @@ namespace marble {
         if (rs->GetExpr()) {
             val = Visit(rs->GetExpr()).value_or(ASTVal::GetDefaultByType(ASTType::GetNothType()));
         }
+        checkArenaEscape(val, ArenaStorage { .Local = true }, rs->GetStartLoc(), rs->GetEndLoc());
         implicitlyCast(val, _funRetsTypes.top(), rs->GetStartLoc(), rs->GetEndLoc());
         return std::nullopt;
     }
@@ -229,16 +291,16 @@ namespace marble {
         }
         std::optional<ASTVal> cond = Visit(ies->GetCondition());
         implicitlyCast(cond.value(), ASTType(ASTTypeKind::Bool, "bool", false, 0), ies->GetCondition()->GetStartLoc(), ies->GetCondition()->GetEndLoc());
-        _vars.push({});
+        _vars.emplace_back();
         for (auto &stmt : ies->GetThenBody()) {
             Visit(stmt);
         }
-        _vars.pop();
-        _vars.push({});
+        _vars.pop_back();
+        _vars.emplace_back();
         for (auto &stmt : ies->GetElseBody()) {
             Visit(stmt);
         }
-        _vars.pop();
+        _vars.pop_back();
         return std::nullopt;
     }
 
@@ -256,7 +318,7 @@ namespace marble {
             _diag.Report(fls->GetStartLoc(), ErrCannotBeHere)
                 << llvm::SMRange(fls->GetStartLoc(), fls->GetEndLoc());
         }
-        _vars.push({});
+        _vars.emplace_back();
         ++_loopDeth;
         if (fls->GetIndexator()) {
             Visit(fls->GetIndexator());
@@ -270,7 +332,7 @@ namespace marble {
             Visit(stmt);
         }
         --_loopDeth;
-        _vars.pop();
+        _vars.pop_back();
         return std::nullopt;
     }
 
@@ -316,8 +378,10 @@ namespace marble {
         else {
             _currentMod->Structs[ss->GetName()] = Struct { .Name = ss->GetName(), .Fields = {}, .Methods = {}, .TraitsImplements = {}, .Access = ss->GetAccess() };
             s = &_currentMod->Structs[ss->GetName()];
+            invalidatePathCache();
         }
 
+        int index = 0;
         for (int i = 0; i < ss->GetBody().size(); ++i) {
             if (ss->GetBody()[i]->GetKind() != NkVarDeclStmt) {
                 _diag.Report(ss->GetStartLoc(), ErrCannotBeHere)
@@ -349,7 +413,7 @@ namespace marble {
                 implicitlyCast(val.value(), vds->GetType(), vds->GetExpr()->GetStartLoc(), vds->GetExpr()->GetEndLoc());
             }
             s->Fields.emplace(vds->GetName(), Field { .Name = vds->GetName(), .Val = val, .Type = vds->GetType(), .IsConst = vds->IsConst(), .Access = vds->GetAccess(),
-                             .ManualInitialized = false, .IsStatic = vds->IsStatic() });
+                             .ManualInitialized = false, .IsStatic = vds->IsStatic(), .Index = vds->IsStatic() ? -1 : index++ });
         }
 
         return std::nullopt;
@@ -394,6 +458,7 @@ namespace marble {
             }
             else {
                 fas->SetStaticAccessing(obj->IsType());
+                fas->SetFieldIndex(field->second.Index);
                 if (field->second.Access == AccessPriv && !objIsThis) {
                     _diag.Report(fas->GetStartLoc(), ErrFieldIsPrivate)
                         << llvm::SMRange(fas->GetStartLoc(), fas->GetEndLoc())
@@ -412,7 +477,13 @@ namespace marble {
                         << field->second.Type.GetVal();
                     return std::nullopt;
                 }
-                implicitlyCast(Visit(fas->GetExpr()).value(), s->Fields.at(fas->GetName()).Type, fas->GetStartLoc(), fas->GetEndLoc());
+                if (obj->IsType() || !isLocalStorage(fas->GetObject())) {
+                    checkPurity("assignment to a field outside of the function", fas->GetStartLoc(), fas->GetEndLoc());
+                }
+                ASTVal val = Visit(fas->GetExpr()).value();
+                checkArenaEscape(val, getStorageArena(fas->GetObject(), obj.value()), fas->GetStartLoc(), fas->GetEndLoc());
+                mergeIntoLocalVar(fas->GetObject(), val);
+                implicitlyCast(val, s->Fields.at(fas->GetName()).Type, fas->GetStartLoc(), fas->GetEndLoc());
             }
         }
         else {
@@ -437,7 +508,10 @@ namespace marble {
                         << it->second.Type.GetVal();
                     return std::nullopt;
                 }
-                implicitlyCast(Visit(fas->GetExpr()).value(), it->second.Type, fas->GetStartLoc(), fas->GetEndLoc());
+                checkPurity("assignment to a global variable", fas->GetStartLoc(), fas->GetEndLoc());
+                ASTVal val = Visit(fas->GetExpr()).value();
+                checkArenaEscape(val, ArenaStorage {}, fas->GetStartLoc(), fas->GetEndLoc());
+                implicitlyCast(val, it->second.Type, fas->GetStartLoc(), fas->GetEndLoc());
             }
             else {
                 _diag.Report(fas->GetStartLoc(), ErrDoesNotHaveVarInMod)
@@ -562,11 +636,19 @@ namespace marble {
                     }
                 }
 
+                // trait calls are trusted to be pure by the declaration, so every implementation must be pure too
+                if ((traitFun.Attrs & FunAttrPure) && !method->HasAttr(FunAttrPure)) {
+                    _diag.Report(method->GetStartLoc(), ErrCannotImplTraitMethod_NotPure)
+                        << llvm::SMRange(method->GetStartLoc(), method->GetEndLoc())
+                        << method->GetName()
+                        << traitDef->Name;
+                }
+
                 implementedTraitMethods[method->GetName()] = true;
             }
             methods.push_back(method);
-            Function fun { .Name = method->GetName(), .RetType = method->GetRetType(), .Args = method->GetArgs(), .Body = method->GetBody(),
-                           .IsDeclaration = method->IsDeclaration() };
+            Function fun { .Name = method->GetName(), .RetType = resolveType(method->GetRetType(), _currentMod), .Args = method->GetArgs(), .Body = method->GetBody(),
+                           .IsDeclaration = method->IsDeclaration(), .Attrs = method->GetAttrs(), .Decl = method };
             s->Methods.emplace(method->GetName(), Method { .Fun = fun, .Access = method->GetAccess(), .IsStatic = method->IsStatic() });
         }
 
@@ -590,13 +672,15 @@ namespace marble {
                     << method->GetRetType().GetVal();
                 return std::nullopt;
             }
-            _vars.push({});
+            _vars.emplace_back();
+            _nextSlot = 0;
             if (!method->IsStatic()) {
                 ASTType thisType = ASTType(ASTTypeKind::Struct, s->Name, false, 0);
-                _vars.top().emplace("this", Variable { .Name = "this", .Type = thisType, .Val = ASTVal::GetDefaultByType(thisType), .IsConst = false, .Access = AccessPriv });
+                _vars.back().emplace("this", Variable { .Name = "this", .Type = thisType, .Val = getParamVal(thisType, _nextSlot), .IsConst = false,
+                                                       .Access = AccessPriv, .Slot = _nextSlot++ });
             }
             for (auto arg : method->GetArgs()) {
-                if (_vars.top().find(arg.GetName()) != _vars.top().end()) {
+                if (_vars.back().find(arg.GetName()) != _vars.back().end()) {
                     _diag.Report(method->GetStartLoc(), ErrRedefinitionVar)
                         << llvm::SMRange(method->GetStartLoc(), method->GetEndLoc())
                         << arg.GetName();
@@ -608,12 +692,17 @@ namespace marble {
                         << arg.GetType().GetVal();
                     return std::nullopt;
                 }
-                _vars.top().emplace(arg.GetName(), Variable { .Name = arg.GetName(), .Type = arg.GetType(),
-                                                              .Val = arg.GetType().IsPointer() ? ASTVal(arg.GetType(), ASTValData { .i32Val = 0 }, false, false)
-                                                                                               : ASTVal::GetDefaultByType(arg.GetType()),
-                                                              .IsConst = arg.GetType().IsConst(), .Access = AccessPriv });
+                _vars.back().emplace(arg.GetName(), Variable { .Name = arg.GetName(), .Type = arg.GetType(), .Val = getParamVal(arg.GetType(), _nextSlot),
+                                                              .IsConst = arg.GetType().IsConst(), .Access = AccessPriv, .Slot = _nextSlot++ });
+            }
+            checkFunAttrs(method);
+            if (method->IsConst()) {
+                _diag.Report(method->GetStartLoc(), ErrCannotBeHere)
+                    << llvm::SMRange(method->GetStartLoc(), method->GetEndLoc());
             }
             _funRetsTypes.push(method->GetRetType());
+            _inPureFun = method->HasAttr(FunAttrPure);
+            _currentFun = method;
             bool hasRet;
             for (auto stmt : method->GetBody()) {
                 if (stmt->GetKind() == NkRetStmt) {
@@ -621,8 +710,11 @@ namespace marble {
                 }
                 Visit(stmt);
             }
+            _currentFun = nullptr;
+            _inPureFun = false;
             _funRetsTypes.pop();
-            _vars.pop();
+            _vars.pop_back();
+            method->SetNumSlots(_nextSlot);
 
             if (!hasRet && method->GetRetType().GetTypeKind() != ASTTypeKind::Noth) {
                 _diag.Report(method->GetStartLoc(), ErrNotAllPathsReturnsValue)
@@ -670,6 +762,7 @@ namespace marble {
         else {
             _currentMod->Traits[tds->GetName()] = Trait { .Name = tds->GetName(), .Methods = {}, .Access = tds->GetAccess() };
             t = &_currentMod->Traits[tds->GetName()];
+            invalidatePathCache();
         }
         for (auto stmt : tds->GetBody()) {
             if (FunDeclStmt *method = llvm::dyn_cast<FunDeclStmt>(stmt)) {
@@ -679,8 +772,8 @@ namespace marble {
                         << method->GetName()
                         << tds->GetName();
                 }
-                Function fun { .Name = method->GetName(), .RetType = method->GetRetType(), .Args = method->GetArgs(), .Body = method->GetBody(),
-                               .IsDeclaration = method->IsDeclaration() };
+                Function fun { .Name = method->GetName(), .RetType = resolveType(method->GetRetType(), _currentMod), .Args = method->GetArgs(), .Body = method->GetBody(),
+                               .IsDeclaration = method->IsDeclaration(), .Attrs = method->GetAttrs() };
                 t->Methods.emplace(method->GetName(), Method { .Fun = fun, .Access = method->GetAccess(), .IsStatic = method->IsStatic() });
             }
             else {
@@ -702,6 +795,7 @@ namespace marble {
             _diag.Report(es->GetStartLoc(), ErrCannotHaveAccessBeHere)
                 << llvm::SMRange(es->GetStartLoc(), es->GetEndLoc());
         }
+        checkPurity("`echo`", es->GetStartLoc(), es->GetEndLoc());
         return Visit(es->GetRHS());
     }
 
@@ -711,6 +805,7 @@ namespace marble {
             _diag.Report(ds->GetStartLoc(), ErrCannotBeHere)
                 << llvm::SMRange(ds->GetStartLoc(), ds->GetEndLoc());
         }
+        checkPurity("`del`", ds->GetStartLoc(), ds->GetEndLoc());
         std::optional<ASTVal> val = Visit(ds->GetExpr());
         if (!val->GetType().IsPointer()) {
             _diag.Report(ds->GetStartLoc(), ErrDelOfNonPtr)
@@ -722,6 +817,11 @@ namespace marble {
                 << llvm::SMRange(ds->GetStartLoc(), ds->GetEndLoc());
             return std::nullopt;
         }
+        if (val->GetArenaDepth() != 0) {
+            _diag.Report(ds->GetStartLoc(), ErrDelOfArenaPtr)
+                << llvm::SMRange(ds->GetStartLoc(), ds->GetEndLoc());
+        }
+        addParamFlow(_currentFun, val->GetArenaParams(), ArenaStorage {});     // a parameter may be from an arena of the caller
         return std::nullopt;
     }
 
@@ -748,10 +848,7 @@ namespace marble {
         else {
             path = _libsPath + path;
         }
-        auto bufferOrErr = llvm::MemoryBuffer::getFile(path + ".mr");
-        if (std::error_code ec = bufferOrErr.getError()) {
-            path += "/mod";
-        }
+        path = _modManager.FindModuleFile(path);
 
         std::vector<std::string> parts(1);
         std::string modPath = is->GetPath();
@@ -788,6 +885,7 @@ namespace marble {
                 }
 
                 current->SubModules[name] = newMod;
+                invalidatePathCache();
             }
             current = current->SubModules[name];
         }
@@ -819,12 +917,14 @@ namespace marble {
         }
         Module *mod = new Module(mds->GetName(), buffer->getBufferIdentifier().str(), mds->GetAccess());
         mod->Parent = _currentMod;
+        mod->FromInterface = _currentMod->FromInterface;
 
         ASTType selfType = ASTType(ASTTypeKind::Mod, _currentMod == _rootMod ? "self" : mod->GetName(), false, 0);
         ASTVal selfVal = ASTVal(selfType, ASTValData { .i32Val = 0 }, false, false);
         selfVal.SetModule(mod);
         mod->Variables["self"] = Variable { .Name = "self", .Type = selfType, .Val = selfVal, .IsConst = true, .Access = AccessPub };
         _currentMod->SubModules[mds->GetName()] = mod;
+        invalidatePathCache();
         
         ASTType parentType = ASTType(ASTTypeKind::Mod, _currentMod == _rootMod ? "parent" : _currentMod->GetName(), false, 0);
         ASTVal parentVal = ASTVal(parentType, ASTValData { .i32Val = 0 }, false, false);
@@ -847,6 +947,27 @@ namespace marble {
         return std::nullopt;
     }
 
+    std::optional<ASTVal>
+    SemanticAnalyzer::VisitArenaStmt(ArenaStmt *as) {
+        if (_vars.size() == 1) {
+            _diag.Report(as->GetStartLoc(), ErrCannotBeHere)
+                << llvm::SMRange(as->GetStartLoc(), as->GetEndLoc());
+        }
+        if (as->GetAccess() == AccessPub) {
+            _diag.Report(as->GetStartLoc(), ErrCannotHaveAccessBeHere)
+                << llvm::SMRange(as->GetStartLoc(), as->GetEndLoc());
+        }
+        checkPurity("`arena`", as->GetStartLoc(), as->GetEndLoc());
+        ++_arenaDepth;
+        _vars.emplace_back();
+        for (auto &stmt : as->GetBody()) {
+            Visit(stmt);
+        }
+        _vars.pop_back();
+        --_arenaDepth;
+        return std::nullopt;
+    }
+
     std::optional<ASTVal>
     SemanticAnalyzer::VisitBinaryExpr(BinaryExpr *be) {
         checkBinaryExpr(be);
@@ -869,6 +990,9 @@ namespace marble {
             }
             return lhs;
         }
+        if (std::optional<ASTVal> folded = ConstEvaluator::Fold(be)) {
+            be->SetConstVal(*folded);
+        }
         double lhsVal = lhs->AsDouble();
         double rhsVal = rhs->AsDouble();
         double res;
@@ -943,6 +1067,9 @@ namespace marble {
         if (rhs == std::nullopt) {
             return rhs;
         }
+        if (std::optional<ASTVal> folded = ConstEvaluator::Fold(ue)) {
+            ue->SetConstVal(*folded);
+        }
         double val = rhs->AsDouble();
         bool returnBool = false;
         switch (ue->GetOp().GetKind()) {
@@ -970,15 +1097,20 @@ namespace marble {
     
     std::optional<ASTVal>
     SemanticAnalyzer::VisitVarExpr(VarExpr *ve) {
-        auto varsCopy = _vars;
-        while (!varsCopy.empty()) {
-            if (auto var = varsCopy.top().find(ve->GetName()); var != varsCopy.top().end()) {
-                if (var->second.Type.GetTypeKind() == ASTTypeKind::Trait) {
-                    return ASTVal(var->second.Type, ASTValData { .i32Val = 0 }, var->second.Val->IsNil(), var->second.Val->CreatedByNew());
-                }
-                return ASTVal(var->second.Type, var->second.Val->GetData(), var->second.Val->IsNil(), var->second.Val->CreatedByNew());
-            }
-            varsCopy.pop();
+        size_t scope;
+        if (Variable *var = lookupVar(ve->GetName(), scope)) {
+            ve->SetSlot(var->Slot);
+            if (scope == 0 && !var->IsConst) {
+                checkConstFun("access to a global variable which is not `const`", ve->GetStartLoc(), ve->GetEndLoc());
+            }
+            if (var->IsConst && var->ConstVal) {
+                ve->SetConstVal(*var->ConstVal);
+            }
+            ASTVal val = var->Type.GetTypeKind() == ASTTypeKind::Trait
+                       ? ASTVal(var->Type, ASTValData { .i32Val = 0 }, var->Val->IsNil(), var->Val->CreatedByNew())
+                       : ASTVal(var->Type, var->Val->GetData(), var->Val->IsNil(), var->Val->CreatedByNew());
+            setArena(val, getArena(*var->Val));
+            return val;
         }
         if (isMemberAccessing) {
             if (auto it = _rootMod->SubModules.find(ve->GetName()); it != _rootMod->SubModules.end()) {
@@ -1017,6 +1149,15 @@ namespace marble {
     SemanticAnalyzer::VisitFunCallExpr(FunCallExpr *fce) {
         Function *fun = findFunction(fce->GetName());
         if (fun) {
+            requireBody(fun);
+            if (_inConstFun) {
+                if (!fun->IsConst) {
+                    checkConstFun("call of a function which is not `const`", fce->GetStartLoc(), fce->GetEndLoc());
+                }
+            }
+            else if (!(fun->Attrs & FunAttrPure) && !fun->IsConst) {
+                checkPurity("call of a function which is not `@pure`", fce->GetStartLoc(), fce->GetEndLoc());
+            }
             if (fun->Args.size() != fce->GetArgs().size()) {
                 _diag.Report(fce->GetStartLoc(), ErrFewArgs)
                     << llvm::SMRange(fce->GetStartLoc(), fce->GetEndLoc())
@@ -1025,12 +1166,26 @@ namespace marble {
                     << fce->GetArgs().size();
                 return ASTVal(ASTType(ASTTypeKind::I32, "i32", false, 0), ASTValData { .i32Val = 0 }, false, false);
             }
+            std::vector<ArenaStorage> args;
             for (int i = 0; i < fun->Args.size(); ++i) {
                 fun->Args[i].SetType(resolveType(fun->Args[i].GetType(), _currentMod));
-                implicitlyCast(Visit(fce->GetArgs()[i]).value(), fun->Args[i].GetType(), fce->GetArgs()[i]->GetStartLoc(), fce->GetArgs()[i]->GetEndLoc());
+                ASTVal arg = Visit(fce->GetArgs()[i]).value();
+                implicitlyCast(arg, fun->Args[i].GetType(), fce->GetArgs()[i]->GetStartLoc(), fce->GetArgs()[i]->GetEndLoc());
+                args.push_back(getArena(arg));
+            }
+            if (fun->IsConst) {
+                evalConstCall(fce, fun);
             }
+            deferArenaCall(fun->IsDeclaration ? nullptr : fun->Decl, args, fce->GetStartLoc(), fce->GetEndLoc());
             if (fun->RetType.GetTypeKind() != ASTTypeKind::Noth) {
-                return ASTVal::GetDefaultByType(fun->RetType);
+                // the result may lead to anything the arguments lead to
+                ASTVal ret = ASTVal::GetDefaultByType(fun->RetType);
+                if (hasPointers(fun->RetType)) {
+                    for (auto &arg : args) {
+                        setArena(ret, mergeArenas(getArena(ret), arg));
+                    }
+                }
+                return ret;
             }
             return ASTVal::GetDefaultByType(ASTType::GetNothType());
         }
@@ -1050,6 +1205,7 @@ namespace marble {
             return ASTVal(ASTType(ASTTypeKind::I32, "i32", false, 0), ASTValData { .i32Val = 0 }, false, false);
         }
         Struct s = *sDecl;
+        ArenaStorage arena;     // of the values of the fields
         for (int i = 0; i < se->GetInitializer().size(); ++i) {
             std::string name = se->GetInitializer()[i].first;
             if (s.Fields.find(name) != s.Fields.end()) {
@@ -1061,6 +1217,7 @@ namespace marble {
                 else {
                     s.Fields.at(name).Val = Visit(se->GetInitializer()[i].second);
                     s.Fields.at(name).ManualInitialized = true;
+                    arena = mergeArenas(arena, getArena(*s.Fields.at(name).Val));
                 }
             }
             else {
@@ -1070,12 +1227,15 @@ namespace marble {
                     << s.Name;
             }
         }
-        return ASTVal(ASTType(ASTTypeKind::Struct, se->GetName(), false, 0), ASTValData { .i32Val = 0 }, false, false);
+        ASTVal val = ASTVal(ASTType(ASTTypeKind::Struct, se->GetName(), false, 0), ASTValData { .i32Val = 0 }, false, false);
+        setArena(val, arena);
+        return val;
     }
 
 
     std::optional<ASTVal>
     SemanticAnalyzer::VisitFieldAccessExpr(FieldAccessExpr *fae) {
+        checkConstFun("field access", fae->GetStartLoc(), fae->GetEndLoc());
         bool oldMemberAccessing = isMemberAccessing;
         isMemberAccessing = true;
         std::optional<ASTVal> obj = Visit(fae->GetObject());
@@ -1113,6 +1273,7 @@ namespace marble {
             }
             else {
                 fae->SetStaticAccessing(obj->IsType());
+                fae->SetFieldIndex(field->second.Index);
                 if (field->second.Access == AccessPriv && !objIsThis) {
                     _diag.Report(fae->GetStartLoc(), ErrFieldIsPrivate)
                         << llvm::SMRange(fae->GetStartLoc(), fae->GetEndLoc())
@@ -1137,7 +1298,10 @@ namespace marble {
                         << field->second.Type.GetVal();
                     return std::nullopt;
                 }
-                return s->Fields.at(fae->GetName()).Val;
+                // the memory of the object is where a pointer read from it may lead
+                ASTVal val = *field->second.Val;
+                setArena(val, hasPointers(field->second.Type) ? getArena(*obj) : ArenaStorage {});
+                return val;
             }
         }
         else {
@@ -1252,6 +1416,7 @@ namespace marble {
                     << contextName;
             }
             else {
+                requireBody(&method->second.Fun);
                 mce->SetStaticAccessing(obj->IsType());
                 if (method->second.Access == AccessPriv && !objIsThis) {
                     _diag.Report(mce->GetStartLoc(), ErrMethodIsPrivate)
@@ -1269,6 +1434,12 @@ namespace marble {
                         << mce->GetName();
                 }
 
+                if (_inConstFun) {
+                    checkConstFun("method call", mce->GetStartLoc(), mce->GetEndLoc());
+                }
+                else if (!(method->second.Fun.Attrs & FunAttrPure)) {
+                    checkPurity("call of a method which is not `@pure`", mce->GetStartLoc(), mce->GetEndLoc());
+                }
                 if (method->second.Fun.Args.size() != mce->GetArgs().size()) {
                     _diag.Report(mce->GetStartLoc(), ErrFewArgs)
                         << llvm::SMRange(mce->GetStartLoc(), mce->GetEndLoc())
@@ -1278,12 +1449,31 @@ namespace marble {
                     isMemberAccessing = oldMemberAccessing;
                     return ASTVal(ASTType(ASTTypeKind::I32, "i32", false, 0), ASTValData { .i32Val = 0 }, false, false);
                 }
-                for (int i = 0; i < method->second.Fun.Args.size(); ++i) {
-                    implicitlyCast(Visit(mce->GetArgs()[i]).value(), method->second.Fun.Args[i].GetType(), mce->GetArgs()[i]->GetStartLoc(), mce->GetArgs()[i]->GetEndLoc());
+                // the object is passed as `this`, so the method may store into it and keep what it leads to
+                std::vector<ArenaStorage> args;
+                if (!method->second.IsStatic) {
+                    ArenaStorage storage = getStorageArena(mce->GetObject(), *obj);
+                    args.push_back(mergeArenas(storage, getArena(*obj)));
+                    args.back().Local = storage.Local;
                 }
+                for (int i = 0; i < method->second.Fun.Args.size(); ++i) {
+                    method->second.Fun.Args[i].SetType(resolveType(method->second.Fun.Args[i].GetType(), _currentMod));
+                    ASTVal arg = Visit(mce->GetArgs()[i]).value();
+                    implicitlyCast(arg, method->second.Fun.Args[i].GetType(), mce->GetArgs()[i]->GetStartLoc(), mce->GetArgs()[i]->GetEndLoc());
+                    mergeIntoLocalVar(mce->GetObject(), arg);
+                    args.push_back(getArena(arg));
+                }
+                Function &fun = method->second.Fun;
+                deferArenaCall(fun.IsDeclaration ? nullptr : fun.Decl, args, mce->GetStartLoc(), mce->GetEndLoc());
                 if (method->second.Fun.RetType.GetTypeKind() != ASTTypeKind::Noth) {
                     isMemberAccessing = oldMemberAccessing;
-                    return ASTVal::GetDefaultByType(method->second.Fun.RetType);
+                    ASTVal ret = ASTVal::GetDefaultByType(method->second.Fun.RetType);
+                    if (hasPointers(ret.GetType())) {
+                        for (auto &arg : args) {
+                            setArena(ret, mergeArenas(getArena(ret), arg));
+                        }
+                    }
+                    return ret;
                 }
                 isMemberAccessing = oldMemberAccessing;
                 return ASTVal::GetDefaultByType(ASTType::GetNothType());
@@ -1293,7 +1483,14 @@ namespace marble {
             mce->SetObjType(obj->GetType());
             Module *mod = obj->GetModule();
             if (auto it = mod->Functions.find(mce->GetName()); it != mod->Functions.end()) {
+                requireBody(&it->second);
                 Function fun = it->second;
+                if (_inConstFun) {
+                    checkConstFun("call of a function from another module", mce->GetStartLoc(), mce->GetEndLoc());
+                }
+                else if (!(fun.Attrs & FunAttrPure) && !fun.IsConst) {
+                    checkPurity("call of a function which is not `@pure`", mce->GetStartLoc(), mce->GetEndLoc());
+                }
                 if (fun.Args.size() != mce->GetArgs().size()) {
                     _diag.Report(mce->GetStartLoc(), ErrFewArgs)
                         << llvm::SMRange(mce->GetStartLoc(), mce->GetEndLoc())
@@ -1303,12 +1500,22 @@ namespace marble {
                     isMemberAccessing = oldMemberAccessing;
                     return ASTVal(ASTType(ASTTypeKind::I32, "i32", false, 0), ASTValData { .i32Val = 0 }, false, false);
                 }
+                std::vector<ArenaStorage> args;
                 for (int i = 0; i < fun.Args.size(); ++i) {
-                    implicitlyCast(Visit(mce->GetArgs()[i]).value(), fun.Args[i].GetType(), mce->GetArgs()[i]->GetStartLoc(), mce->GetArgs()[i]->GetEndLoc());
+                    ASTVal arg = Visit(mce->GetArgs()[i]).value();
+                    implicitlyCast(arg, fun.Args[i].GetType(), mce->GetArgs()[i]->GetStartLoc(), mce->GetArgs()[i]->GetEndLoc());
+                    args.push_back(getArena(arg));
                 }
+                deferArenaCall(fun.IsDeclaration ? nullptr : fun.Decl, args, mce->GetStartLoc(), mce->GetEndLoc());
                 if (fun.RetType.GetTypeKind() != ASTTypeKind::Noth) {
                     isMemberAccessing = oldMemberAccessing;
-                    return ASTVal::GetDefaultByType(fun.RetType);
+                    ASTVal ret = ASTVal::GetDefaultByType(fun.RetType);
+                    if (hasPointers(ret.GetType())) {
+                        for (auto &arg : args) {
+                            setArena(ret, mergeArenas(getArena(ret), arg));
+                        }
+                    }
+                    return ret;
                 }
                 isMemberAccessing = oldMemberAccessing;
                 return ASTVal::GetDefaultByType(ASTType::GetNothType());
@@ -1341,18 +1548,27 @@ namespace marble {
             return val;
         }
         de->SetExprType(val->GetType());
-        return ASTVal(val->GetType().Deref(), val->GetData(), false, val->CreatedByNew());
+        ASTVal pointee = ASTVal(val->GetType().Deref(), val->GetData(), false, val->CreatedByNew());
+        if (hasPointers(pointee.GetType())) {
+            setArena(pointee, getArena(*val));
+        }
+        return pointee;
     }
 
     std::optional<ASTVal>
     SemanticAnalyzer::VisitRefExpr(RefExpr *re) {
+        checkConstFun("taking an address", re->GetStartLoc(), re->GetEndLoc());
         std::optional<ASTVal> val = Visit(re->GetExpr());
         if (re->GetExpr()->GetKind() == NkVarExpr) {
-            return ASTVal(val->GetType().Ref(), val->GetData(), false, val->CreatedByNew());
+            ASTVal ref(val->GetType().Ref(), val->GetData(), false, val->CreatedByNew());
+            setArena(ref, getVarArena(llvm::cast<VarExpr>(re->GetExpr())->GetName(), false));
+            return ref;
         }
         if (FieldAccessExpr *fae = llvm::dyn_cast<FieldAccessExpr>(re->GetExpr())) {
             if (fae->GetObject()->GetKind() == NkVarExpr) {
-                return ASTVal(val->GetType().Ref(), val->GetData(), false, val->CreatedByNew());
+                ASTVal ref(val->GetType().Ref(), val->GetData(), false, val->CreatedByNew());
+                setArena(ref, getVarArena(llvm::cast<VarExpr>(fae->GetObject())->GetName(), true));
+                return ref;
             }
         }
         _diag.Report(re->GetExpr()->GetStartLoc(), ErrRefFromRVal)
@@ -1362,8 +1578,10 @@ namespace marble {
 
     std::optional<ASTVal>
     SemanticAnalyzer::VisitNewExpr(NewExpr *ne) {
+        checkPurity("`new`", ne->GetStartLoc(), ne->GetEndLoc());
         if (ne->GetStructExpr()) {
-            VisitStructExpr(ne->GetStructExpr());
+            ASTVal init = VisitStructExpr(ne->GetStructExpr()).value();
+            checkArenaEscape(init, ArenaStorage { .Depth = _arenaDepth }, ne->GetStartLoc(), ne->GetEndLoc());
         }
         ne->SetType(resolveType(ne->GetType(), _currentMod));
         if (ne->GetType().IsUnknown()) {
@@ -1372,7 +1590,9 @@ namespace marble {
                 << ne->GetType().GetVal();
             return ASTVal(ASTType(ASTTypeKind::I32, "i32", false, 0), ASTValData { .i32Val = 0 }, false, false);
         }
-        return ASTVal(ne->GetType().Ref(), ASTValData { .i32Val = 0 }, false, true);
+        ASTVal val = ASTVal(ne->GetType().Ref(), ASTValData { .i32Val = 0 }, false, true);
+        val.SetArenaDepth(_arenaDepth);
+        return val;
     }
 
     void
@@ -1472,14 +1692,16 @@ namespace marble {
                             << vds->GetName();
                         continue;
                     }
+                    _inConstInit = vds->IsConst();
                     mod->Variables[vds->GetName()] = Variable { .Name = vds->GetName(), .Type = vds->GetType(), .Val = vds->GetExpr() ? Visit(vds->GetExpr()) :
                                                                                                                        ASTVal::GetDefaultByType(vds->GetType()),
                                                                 .IsConst = vds->IsConst(), .Access = vds->GetAccess() };
+                    _inConstInit = false;
                     break;
                 }
                 case NkFunDeclStmt: {
                     auto *fds = llvm::dyn_cast<FunDeclStmt>(stmt);
-                    if (fds->IsDeclaration()) {
+                    if (fds->IsDeclaration() && !mod->FromInterface) {
                         _diag.Report(fds->GetStartLoc(), ErrCannotDeclareHere)
                             << llvm::SMRange(fds->GetStartLoc(), fds->GetEndLoc());
                         continue;
@@ -1493,8 +1715,13 @@ namespace marble {
                     for (auto &arg : fds->GetArgs()) {
                         arg.SetType(resolveType(arg.GetType(), mod));
                     }
-                    mod->Functions[fds->GetName()] = Function { .Name = fds->GetName(), .RetType = fds->GetRetType(), .Args = fds->GetArgs(), .Body = fds->GetBody(),
-                                                                .IsDeclaration = fds->IsDeclaration(), .Access = fds->GetAccess() };
+                    // the body of a declaration in an interface is in the bitcode of the library
+                    mod->Functions[fds->GetName()] = Function { .Name = fds->GetName(), .RetType = resolveType(fds->GetRetType(), mod), .Args = fds->GetArgs(), .Body = fds->GetBody(),
+                                                                .IsDeclaration = false, .Access = fds->GetAccess(), .Attrs = fds->GetAttrs(),
+                                                                .IsConst = fds->IsConst(), .Decl = fds };
+                    if (!inRootMod(mod) && !fds->IsDeclaration()) {
+                        deferBody(&mod->Functions.at(fds->GetName()), fds, mod, nullptr, false);
+                    }
                     break;
                 }
                 case NkStructStmt: {
@@ -1504,6 +1731,8 @@ namespace marble {
                         mod->Structs[ss->GetName()] = Struct { .Name = ss->GetName(), .Fields = {}, .Methods = {},
                                                                .TraitsImplements = {}, .Access = ss->GetAccess() };
                         Struct &s = mod->Structs.at(ss->GetName());
+                        invalidatePathCache();
+                        int index = 0;
                         for (int i = 0; i < ss->GetBody().size(); ++i) {
                             if (ss->GetBody()[i]->GetKind() != NkVarDeclStmt) {
                                 _diag.Report(ss->GetStartLoc(), ErrCannotBeHere)
@@ -1528,7 +1757,8 @@ namespace marble {
                                 implicitlyCast(val.value(), vds->GetType(), vds->GetExpr()->GetStartLoc(), vds->GetExpr()->GetEndLoc());
                             }
                             s.Fields.emplace(vds->GetName(), Field { .Name = vds->GetName(), .Val = val, .Type = vds->GetType(), .IsConst = vds->IsConst(),
-                                                                     .Access = vds->GetAccess(), .ManualInitialized = false, .IsStatic = vds->IsStatic() });
+                                                                     .Access = vds->GetAccess(), .ManualInitialized = false, .IsStatic = vds->IsStatic(),
+                                                                     .Index = vds->IsStatic() ? -1 : index++ });
                         }
                     }
                     break;
@@ -1539,6 +1769,7 @@ namespace marble {
                     if (!inRootMod(mod)) {
                         mod->Traits[tds->GetName()] = Trait { .Name = tds->GetName(), .Methods = {}, .Access = tds->GetAccess() };
                         Trait &t = mod->Traits.at(tds->GetName());
+                        invalidatePathCache();
                         for (auto stmt : tds->GetBody()) {
                             if (FunDeclStmt *method = llvm::dyn_cast<FunDeclStmt>(stmt)) {
                                 if (!method->IsDeclaration()) {
@@ -1547,8 +1778,8 @@ namespace marble {
                                         << method->GetName()
                                         << tds->GetName();
                                 }
-                                Function fun { .Name = method->GetName(), .RetType = method->GetRetType(), .Args = method->GetArgs(), .Body = method->GetBody(),
-                                            .IsDeclaration = method->IsDeclaration() };
+                                Function fun { .Name = method->GetName(), .RetType = resolveType(method->GetRetType(), mod), .Args = method->GetArgs(), .Body = method->GetBody(),
+                                            .IsDeclaration = method->IsDeclaration(), .Attrs = method->GetAttrs() };
                                 t.Methods.emplace(method->GetName(), Method { .Fun = fun, .Access = method->GetAccess(), .IsStatic = method->IsStatic() });
                             }
                             else {
@@ -1606,7 +1837,7 @@ namespace marble {
                                     << method->GetRetType().GetVal();
                                 return;
                             }
-                            if (method->IsDeclaration()) {
+                            if (method->IsDeclaration() && !mod->FromInterface) {
                                 _diag.Report(method->GetStartLoc(), ErrCannotDeclareHere)
                                     << llvm::SMRange(method->GetStartLoc(), method->GetEndLoc());
                                 continue;
@@ -1671,11 +1902,19 @@ namespace marble {
                                     }
                                 }
 
+                                // trait calls are trusted to be pure by the declaration, so every implementation must be pure too
+                                if ((traitFun.Attrs & FunAttrPure) && !method->HasAttr(FunAttrPure)) {
+                                    _diag.Report(method->GetStartLoc(), ErrCannotImplTraitMethod_NotPure)
+                                        << llvm::SMRange(method->GetStartLoc(), method->GetEndLoc())
+                                        << method->GetName()
+                                        << traitDef->Name;
+                                }
+
                                 implementedTraitMethods[method->GetName()] = true;
                             }
                             methods.push_back(method);
-                            Function fun { .Name = method->GetName(), .RetType = method->GetRetType(), .Args = method->GetArgs(), .Body = method->GetBody(),
-                                           .IsDeclaration = method->IsDeclaration() };
+                            Function fun { .Name = method->GetName(), .RetType = resolveType(method->GetRetType(), mod), .Args = method->GetArgs(), .Body = method->GetBody(),
+                                           .IsDeclaration = false, .Attrs = method->GetAttrs(), .Decl = method };
                             s->Methods.emplace(method->GetName(), Method { .Fun = fun, .Access = method->GetAccess(), .IsStatic = method->IsStatic() });
                         }
 
@@ -1692,38 +1931,11 @@ namespace marble {
                         }
 
                         for (auto &method : methods) {
-                            _vars.push({});
-                            if (!method->IsStatic()) {
-                                ASTType thisType = ASTType(ASTTypeKind::Struct, s->Name, false, 0);
-                                _vars.top().emplace("this", Variable { .Name = "this", .Type = thisType, .Val = ASTVal::GetDefaultByType(thisType), .IsConst = false,
-                                                                       .Access = AccessPriv });
-                            }
-                            for (auto arg : method->GetArgs()) {
-                                if (_vars.top().find(arg.GetName()) != _vars.top().end()) {
-                                    _diag.Report(method->GetStartLoc(), ErrRedefinitionVar)
-                                        << llvm::SMRange(method->GetStartLoc(), method->GetEndLoc())
-                                        << arg.GetName();
-                                }
-                                _vars.top().emplace(arg.GetName(), Variable { .Name = arg.GetName(), .Type = arg.GetType(),
-                                                                              .Val = arg.GetType().IsPointer() ? ASTVal(arg.GetType(), ASTValData { .i32Val = 0 }, false, false)
-                                                                                                               : ASTVal::GetDefaultByType(arg.GetType()),
-                                                                              .IsConst = arg.GetType().IsConst(), .Access = AccessPriv });
-                            }
-                            _funRetsTypes.push(method->GetRetType());
-                            bool hasRet;
-                            for (auto stmt : method->GetBody()) {
-                                if (stmt->GetKind() == NkRetStmt) {
-                                    hasRet = true;
-                                }
-                                Visit(stmt);
-                            }
-                            _funRetsTypes.pop();
-                            _vars.pop();
-
-                            if (!hasRet && method->GetRetType().GetTypeKind() != ASTTypeKind::Noth) {
-                                _diag.Report(method->GetStartLoc(), ErrNotAllPathsReturnsValue)
-                                    << llvm::SMRange(method->GetStartLoc(), method->GetEndLoc());
+                            if (method->IsDeclaration()) {
+                                continue;
                             }
+                            // a vtable refers to all methods of a trait implementation
+                            deferBody(&s->Methods.at(method->GetName()).Fun, method, mod, s, isTraitImpl);
                         }
                     }
                     break;
@@ -1744,6 +1956,103 @@ namespace marble {
         _currentMod = oldMod;
     }
 
+    void
+    SemanticAnalyzer::deferBody(const Function *fun, FunDeclStmt *decl, Module *mod, Struct *self, bool reached) {
+        if (!_importedBodyIdx.emplace(fun, _importedBodies.size()).second) {
+            return;
+        }
+        decl->SetUnchecked(true);
+        _importedBodies.push_back(ImportedBody { .Decl = decl, .Mod = mod, .Self = self, .Reached = false });
+        if (reached) {
+            requireBody(fun);
+        }
+    }
+
+    void
+    SemanticAnalyzer::requireBody(const Function *fun) {
+        auto it = _importedBodyIdx.find(fun);
+        if (it != _importedBodyIdx.end() && !_importedBodies[it->second].Reached) {
+            _importedBodies[it->second].Reached = true;
+            _reachedBodies.push_back(it->second);
+        }
+    }
+
+    // The bodies are analyzed after the root module, in the scope of the globals of their own module, so a call
+    // references further bodies only through this worklist
+    void
+    SemanticAnalyzer::analyzeReachedBodies() {
+        if (_checkAll) {
+            for (size_t i = 0; i < _importedBodies.size(); ++i) {
+                if (!_importedBodies[i].Reached) {
+                    _importedBodies[i].Reached = true;
+                    _reachedBodies.push_back(i);
+                }
+            }
+        }
+        Module *oldMod = _currentMod;
+        std::vector<std::unordered_map<std::string, Variable>> oldVars = std::move(_vars);
+        while (!_reachedBodies.empty()) {
+            ImportedBody body = _importedBodies[_reachedBodies.back()];
+            _reachedBodies.pop_back();
+            body.Decl->SetUnchecked(false);
+            _currentMod = body.Mod;
+            _vars.assign(1, body.Mod->Variables);
+            if (body.Self) {
+                analyzeMethodBody(body.Decl, body.Self);
+            }
+            else {
+                VisitFunDeclStmt(body.Decl);
+            }
+        }
+        _vars = std::move(oldVars);
+        _currentMod = oldMod;
+    }
+
+    void
+    SemanticAnalyzer::analyzeMethodBody(FunDeclStmt *method, Struct *s) {
+        _vars.emplace_back();
+        _nextSlot = 0;
+        if (!method->IsStatic()) {
+            ASTType thisType = ASTType(ASTTypeKind::Struct, s->Name, false, 0);
+            _vars.back().emplace("this", Variable { .Name = "this", .Type = thisType, .Val = getParamVal(thisType, _nextSlot), .IsConst = false,
+                                                   .Access = AccessPriv, .Slot = _nextSlot++ });
+        }
+        for (auto arg : method->GetArgs()) {
+            if (_vars.back().find(arg.GetName()) != _vars.back().end()) {
+                _diag.Report(method->GetStartLoc(), ErrRedefinitionVar)
+                    << llvm::SMRange(method->GetStartLoc(), method->GetEndLoc())
+                    << arg.GetName();
+            }
+            _vars.back().emplace(arg.GetName(), Variable { .Name = arg.GetName(), .Type = arg.GetType(), .Val = getParamVal(arg.GetType(), _nextSlot),
+                                                          .IsConst = arg.GetType().IsConst(), .Access = AccessPriv, .Slot = _nextSlot++ });
+        }
+        checkFunAttrs(method);
+        if (method->IsConst()) {
+            _diag.Report(method->GetStartLoc(), ErrCannotBeHere)
+                << llvm::SMRange(method->GetStartLoc(), method->GetEndLoc());
+        }
+        _funRetsTypes.push(method->GetRetType());
+        _inPureFun = method->HasAttr(FunAttrPure);
+        _currentFun = method;
+        bool hasRet = false;
+        for (auto stmt : method->GetBody()) {
+            if (stmt->GetKind() == NkRetStmt) {
+                hasRet = true;
+            }
+            Visit(stmt);
+        }
+        _currentFun = nullptr;
+        _inPureFun = false;
+        _funRetsTypes.pop();
+        _vars.pop_back();
+        method->SetNumSlots(_nextSlot);
+
+        if (!hasRet && method->GetRetType().GetTypeKind() != ASTTypeKind::Noth) {
+            _diag.Report(method->GetStartLoc(), ErrNotAllPathsReturnsValue)
+                << llvm::SMRange(method->GetStartLoc(), method->GetEndLoc());
+        }
+    }
+
     bool
     SemanticAnalyzer::inRootMod(const Module *mod) {
         if (!mod || !_rootMod) {
@@ -1760,6 +2069,369 @@ namespace marble {
         return false;
     }
 
+    void
+    SemanticAnalyzer::checkArenaEscape(const ASTVal &val, ArenaStorage storage, llvm::SMLoc startLoc, llvm::SMLoc endLoc) {
+        // the memory of a parameter is outside of the arenas of the function
+        if (val.GetArenaDepth() > (storage.Params ? 0 : storage.Depth)) {
+            _diag.Report(startLoc, ErrArenaPtrEscapes)
+                << llvm::SMRange(startLoc, endLoc);
+        }
+        addParamFlow(_currentFun, val.GetArenaParams(), storage);
+    }
+
+    // Records that the memory of `params` of `fun` is stored into `storage`, returns whether it is new
+    bool
+    SemanticAnalyzer::addParamFlow(const FunDeclStmt *fun, uint64_t params, ArenaStorage storage) {
+        if (!fun || !params) {
+            return false;
+        }
+        ParamFlow &flow = _paramFlows[fun];
+        if (storage.Params) {
+            bool changed = false;
+            for (unsigned i = 0; i < 64; ++i) {
+                if (params & paramMask(i)) {
+                    uint64_t &into = flow.StoredInto[i];
+                    uint64_t old = into;
+                    into |= storage.Params & ~paramMask(i);
+                    changed |= into != old;
+                }
+            }
+            return changed;
+        }
+        // a parameter outlives the arenas of the function and its local variables
+        if (storage.Local || storage.Depth != 0 || (flow.Escapes & params) == params) {
+            return false;
+        }
+        flow.Escapes |= params;
+        return true;
+    }
+
+    // Returns where an assignment to a field of `obj` stores the value
+    SemanticAnalyzer::ArenaStorage
+    SemanticAnalyzer::getStorageArena(Expr *obj, const ASTVal &objVal) {
+        if (objVal.GetType().IsPointer()) {
+            return getArena(objVal);
+        }
+        Expr *root = obj;
+        while (FieldAccessExpr *fae = llvm::dyn_cast<FieldAccessExpr>(root)) {
+            if (fae->GetObjType().IsPointer()) {
+                break;
+            }
+            root = fae->GetObject();
+        }
+        if (VarExpr *ve = llvm::dyn_cast<VarExpr>(root)) {
+            return getVarArena(ve->GetName(), false);
+        }
+        return getArena(objVal);    // a structure value lives where the pointer it is read through leads
+    }
+
+    // Returns where the storage of the variable is, or where it leads if `pointee` and it is a pointer
+    SemanticAnalyzer::ArenaStorage
+    SemanticAnalyzer::getVarArena(const std::string &name, bool pointee) {
+        size_t scope;
+        Variable *var = lookupVar(name, scope);
+        if (!var) {
+            return ArenaStorage {};
+        }
+        if (pointee && var->Type.IsPointer()) {
+            return var->Val ? getArena(*var->Val) : ArenaStorage {};
+        }
+        if (name == "this") {   // `this` is the object of the caller
+            return ArenaStorage { .Params = getArena(*var->Val).Params };
+        }
+        return ArenaStorage { .Depth = var->ArenaDepth, .Local = scope != 0 };
+    }
+
+    // A structure variable keeps what is stored into its fields, directly or by its methods
+    void
+    SemanticAnalyzer::mergeIntoLocalVar(Expr *obj, const ASTVal &val) {
+        while (FieldAccessExpr *fae = llvm::dyn_cast<FieldAccessExpr>(obj)) {
+            if (fae->GetObjType().IsPointer()) {
+                return;
+            }
+            obj = fae->GetObject();
+        }
+        VarExpr *ve = llvm::dyn_cast<VarExpr>(obj);
+        if (!ve || ve->GetName() == "this") {
+            return;
+        }
+        // a global is checked against its storage instead
+        size_t scope;
+        Variable *var = lookupVar(ve->GetName(), scope);
+        if (var && scope != 0 && !var->Type.IsPointer() && var->Val) {
+            setArena(*var->Val, mergeArenas(getArena(*var->Val), getArena(val)));
+        }
+    }
+
+    void
+    SemanticAnalyzer::deferArenaCall(const FunDeclStmt *callee, std::vector<ArenaStorage> args, llvm::SMLoc startLoc, llvm::SMLoc endLoc) {
+        for (auto &arg : args) {
+            if (arg.Depth != 0 || arg.Params) {
+                _arenaCalls.push_back(ArenaCall { .Caller = _currentFun, .Callee = callee, .Args = std::move(args), .StartLoc = startLoc, .EndLoc = endLoc });
+                return;
+            }
+        }
+    }
+
+    // Stores the arguments where the callee stores its parameters. Without `report` only the flows of the parameters of
+    // the caller are collected, returns whether they changed
+    bool
+    SemanticAnalyzer::applyArenaCall(const ArenaCall &call, bool report) {
+        const ParamFlow *flow = nullptr;
+        if (auto it = _paramFlows.find(call.Callee); call.Callee && it != _paramFlows.end()) {
+            flow = &it->second;
+        }
+        bool changed = false;
+        bool escapes = false;
+        auto store = [&](const ArenaStorage &arg, const ArenaStorage &storage) {
+            if (report) {
+                escapes |= arg.Depth > (storage.Params ? 0 : storage.Depth);
+            }
+            else {
+                changed |= addParamFlow(call.Caller, arg.Params, storage);
+            }
+        };
+        for (unsigned i = 0; i < call.Args.size(); ++i) {
+            if (!call.Callee || (flow && (flow->Escapes & paramMask(i)))) {
+                store(call.Args[i], ArenaStorage {});
+            }
+            if (!flow) {
+                continue;
+            }
+            if (auto into = flow->StoredInto.find(std::min(i, 63u)); into != flow->StoredInto.end()) {
+                for (unsigned j = 0; j < call.Args.size(); ++j) {
+                    if (j != i && (into->second & paramMask(j))) {
+                        store(call.Args[i], call.Args[j]);
+                    }
+                }
+            }
+        }
+        if (escapes) {
+            _diag.Report(call.StartLoc, ErrArenaPtrEscapes)
+                << llvm::SMRange(call.StartLoc, call.EndLoc);
+        }
+        return changed;
+    }
+
+    // A function passes the flows of its parameters on to its callers, so they are collected up to a fixed point first
+    void
+    SemanticAnalyzer::checkArenaCalls() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto &call : _arenaCalls) {
+                changed |= applyArenaCall(call, false);
+            }
+        }
+        for (auto &call : _arenaCalls) {
+            applyArenaCall(call, true);
+        }
+    }
+
+    // The source of the library without the bodies which the analysis of a caller does not need. Kept are the bodies
+    // of `const` functions, which may be evaluated at compile time, and of the functions which pass the memory of their
+    // parameters on, which the arena checks of their callers follow. A dropped body becomes `;` and keeps its lines,
+    // so the diagnostics point to the lines of the source.
+    std::string
+    SemanticAnalyzer::GetLibraryInterface(Module *mod) const {
+        if (mod->AST.empty()) {
+            return "";
+        }
+        std::vector<llvm::SMRange> bodies;
+        collectDroppedBodies(mod->AST, bodies);
+        std::sort(bodies.begin(), bodies.end(), [](llvm::SMRange a, llvm::SMRange b) {
+            return a.Start.getPointer() < b.Start.getPointer();
+        });
+        llvm::StringRef source = _srcMgr.getMemoryBuffer(_srcMgr.FindBufferContainingLoc(mod->AST.front()->GetStartLoc()))->getBuffer();
+        std::string interface;
+        const char *pos = source.begin();
+        for (llvm::SMRange body : bodies) {
+            interface.append(pos, body.Start.getPointer());
+            interface += ';';
+            pos = body.End.getPointer() + 1;   // after `}`
+            interface.append(std::count(body.Start.getPointer(), pos, '\n'), '\n');
+        }
+        interface.append(pos, source.end());
+        return interface;
+    }
+
+    bool
+    SemanticAnalyzer::passesParams(const FunDeclStmt *fun) const {
+        auto it = _paramFlows.find(fun);
+        if (it == _paramFlows.end()) {
+            return false;
+        }
+        return it->second.Escapes || std::any_of(it->second.StoredInto.begin(), it->second.StoredInto.end(), [](auto &into) {
+            return into.second != 0;
+        });
+    }
+
+    void
+    SemanticAnalyzer::collectDroppedBodies(const std::vector<Stmt *> &stmts, std::vector<llvm::SMRange> &bodies) const {
+        for (auto stmt : stmts) {
+            if (auto *fds = llvm::dyn_cast<FunDeclStmt>(stmt)) {
+                if (!fds->IsDeclaration() && !fds->IsConst() && !passesParams(fds)) {
+                    bodies.push_back(fds->GetBodyRange());
+                }
+            }
+            else if (auto *is = llvm::dyn_cast<ImplStmt>(stmt)) {
+                collectDroppedBodies(is->GetBody(), bodies);
+            }
+            else if (auto *mds = llvm::dyn_cast<ModuleDeclStmt>(stmt)) {
+                collectDroppedBodies(mds->GetBody(), bodies);
+            }
+        }
+    }
+
+    // Whether a value of the type may hold a pointer
+    bool
+    SemanticAnalyzer::hasPointers(ASTType type) {
+        if (type.IsPointer() || type.GetTypeKind() == ASTTypeKind::Trait) {
+            return true;
+        }
+        if (type.GetTypeKind() != ASTTypeKind::Struct) {
+            return false;
+        }
+        Struct *s = findStructByPath(type.GetVal());
+        if (!s) {
+            return true;
+        }
+        for (auto &[name, field] : s->Fields) {
+            if (!field.IsStatic && hasPointers(field.Type)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    ASTVal
+    SemanticAnalyzer::getParamVal(ASTType type, unsigned idx) {
+        ASTVal val = type.IsPointer() ? ASTVal(type, ASTValData { .i32Val = 0 }, false, false) : ASTVal::GetDefaultByType(type);
+        // also a structure without pointers, `this` is the object of the caller
+        if (hasPointers(type) || type.GetTypeKind() == ASTTypeKind::Struct) {
+            val.SetArenaParams(paramMask(idx));
+        }
+        return val;
+    }
+
+    SemanticAnalyzer::ArenaStorage
+    SemanticAnalyzer::getArena(const ASTVal &val) {
+        return ArenaStorage { .Depth = val.GetArenaDepth(), .Params = val.GetArenaParams() };
+    }
+
+    void
+    SemanticAnalyzer::setArena(ASTVal &val, ArenaStorage arena) {
+        val.SetArenaDepth(arena.Depth);
+        val.SetArenaParams(arena.Params);
+    }
+
+    SemanticAnalyzer::ArenaStorage
+    SemanticAnalyzer::mergeArenas(ArenaStorage lhs, ArenaStorage rhs) {
+        return ArenaStorage { .Depth = std::max(lhs.Depth, rhs.Depth), .Params = lhs.Params | rhs.Params, .Local = lhs.Local && rhs.Local };
+    }
+
+    void
+    SemanticAnalyzer::checkFunAttrs(FunDeclStmt *fds) {
+        static const std::pair<FunAttribute, FunAttribute> conflicts[] = {
+            { FunAttrInline, FunAttrNoInline },
+            { FunAttrFlatten, FunAttrNoInline },
+            { FunAttrCold, FunAttrHot },
+        };
+        static const std::unordered_map<unsigned, std::string> names = {
+            { FunAttrInline, "inline" },
+            { FunAttrNoInline, "noinline" },
+            { FunAttrCold, "cold" },
+            { FunAttrHot, "hot" },
+            { FunAttrFlatten, "flatten" },
+        };
+        for (auto &[first, second] : conflicts) {
+            if (fds->HasAttr(first) && fds->HasAttr(second)) {
+                _diag.Report(fds->GetStartLoc(), ErrConflictingAttributes)
+                    << llvm::SMRange(fds->GetStartLoc(), fds->GetEndLoc())
+                    << names.at(first)
+                    << names.at(second);
+            }
+        }
+        // an unoptimized function can be neither inlined nor have calls inlined into it
+        for (FunAttribute attr : { FunAttrInline, FunAttrFlatten }) {
+            if (fds->GetOptLevel() == 0 && fds->HasAttr(attr)) {
+                _diag.Report(fds->GetStartLoc(), ErrConflictingAttributes)
+                    << llvm::SMRange(fds->GetStartLoc(), fds->GetEndLoc())
+                    << "opt(0)"
+                    << names.at(attr);
+            }
+        }
+    }
+
+    void
+    SemanticAnalyzer::checkPurity(const std::string &what, llvm::SMLoc startLoc, llvm::SMLoc endLoc) {
+        if (_inPureFun) {
+            _diag.Report(startLoc, ErrImpureInPureFun)
+                << llvm::SMRange(startLoc, endLoc)
+                << what
+                << (_inConstFun ? "`const`" : "`@pure`");
+        }
+    }
+
+    void
+    SemanticAnalyzer::checkConstFun(const std::string &what, llvm::SMLoc startLoc, llvm::SMLoc endLoc) {
+        if (_inConstFun) {
+            _diag.Report(startLoc, ErrImpureInPureFun)
+                << llvm::SMRange(startLoc, endLoc)
+                << what
+                << "`const`";
+        }
+    }
+
+    void
+    SemanticAnalyzer::checkConstFunType(ASTType type, llvm::SMLoc startLoc, llvm::SMLoc endLoc) {
+        if (!ConstEvaluator::IsSupportedType(type)) {
+            _diag.Report(startLoc, ErrConstFunNonScalar)
+                << llvm::SMRange(startLoc, endLoc)
+                << type.ToString();
+        }
+    }
+
+    void
+    SemanticAnalyzer::evalConstCall(FunCallExpr *fce, Function *fun) {
+        if (fce->GetConstVal() || _failedConstCalls.count(fce) || !ConstEvaluator::IsSupportedType(fun->RetType)) {
+            return;
+        }
+        std::vector<ASTVal> args;
+        for (auto *arg : fce->GetArgs()) {
+            std::optional<ASTVal> val = ConstEvaluator::Fold(arg);
+            if (!val) {
+                return;     // the call is made at runtime
+            }
+            args.push_back(*val);
+        }
+        ConstEvaluator evaluator(_constEvalLimits);
+        if (std::optional<ASTVal> res = evaluator.Call(fun, _currentMod, args)) {
+            fce->SetConstVal(*res);
+            return;
+        }
+        _failedConstCalls.insert(fce);
+        // only a `const` variable needs the value now, elsewhere the call is made at runtime, where it may fail the same way
+        _diag.Report(fce->GetStartLoc(), _inConstInit ? ErrConstEvalFailed : WarnConstEvalFailed)
+            << llvm::SMRange(fce->GetStartLoc(), fce->GetEndLoc())
+            << fce->GetName()
+            << evaluator.GetError();
+    }
+
+    bool
+    SemanticAnalyzer::isLocalStorage(Expr *expr) {
+        if (FieldAccessExpr *fae = llvm::dyn_cast<FieldAccessExpr>(expr)) {
+            return fae->GetObjType().GetTypeKind() == ASTTypeKind::Struct && !fae->GetObjType().IsPointer() && isLocalStorage(fae->GetObject());
+        }
+        VarExpr *ve = llvm::dyn_cast<VarExpr>(expr);
+        if (!ve || ve->GetName() == "this") {   // `this` points to the caller's object
+            return false;
+        }
+        size_t scope;
+        Variable *var = lookupVar(ve->GetName(), scope);
+        return var && scope != 0 && !var->Type.IsPointer();
+    }
+
     Variable *
     SemanticAnalyzer::findVar(std::string name) {
         if (_currentMod->Variables.count(name)) {
@@ -1880,14 +2552,20 @@ namespace marble {
 
     bool
     SemanticAnalyzer::variableExists(std::string name) const {
-        auto varsCopy = _vars;
-        while (!varsCopy.empty()) {
-            if (auto var = varsCopy.top().find(name); var != varsCopy.top().end()) {
-                return true;
+        return std::any_of(_vars.begin(), _vars.end(), [&name](auto &scope) {
+            return scope.count(name) != 0;
+        });
+    }
+
+    Variable *
+    SemanticAnalyzer::lookupVar(const std::string &name, size_t &scope) {
+        for (size_t i = _vars.size(); i-- > 0;) {
+            if (auto it = _vars[i].find(name); it != _vars[i].end()) {
+                scope = i;
+                return &it->second;
             }
-            varsCopy.pop();
         }
-        return false;
+        return nullptr;
     }
 
     bool
@@ -1941,16 +2619,19 @@ namespace marble {
     std::vector<std::string>
     SemanticAnalyzer::splitPath(const std::string &path) {
         std::vector<std::string> result;
-        std::stringstream ss(path);
-        std::string item;
-        while (std::getline(ss, item, '/')) {
-            if (!item.empty()) {
-                result.push_back(item);
+        size_t start = 0;
+        while (start <= path.size()) {
+            size_t end = std::min(path.find('/', start), path.size());
+            if (end > start) {
+                result.push_back(path.substr(start, end - start));
             }
+            start = end + 1;
         }
         return result;
     }
 
+    // A name of the context module is found directly, other paths are split and resolved once. Only the found structures
+    // and traits are cached: a path which is not found yet may be declared later
     Struct *
     SemanticAnalyzer::findStructByPath(const std::string &path, Module *contextMod) {
         if (path.empty()) {
@@ -1959,11 +2640,54 @@ namespace marble {
         if (!contextMod) {
             contextMod = _currentMod ? _currentMod : _rootMod;
         }
-
         if (auto it = contextMod->Structs.find(path); it != contextMod->Structs.end()) {
             return &it->second;
         }
+        std::unordered_map<std::string, Struct *> &cache = _structPaths[contextMod];
+        if (auto it = cache.find(path); it != cache.end()) {
+            return it->second;
+        }
+        Struct *s = resolveStructPath(path, contextMod);
+        if (s) {
+            cache.emplace(path, s);
+        }
+        return s;
+    }
+
+    Trait *
+    SemanticAnalyzer::findTraitByPath(const std::string &path, Module *contextMod) {
+        if (path.empty()) {
+            return nullptr;
+        }
+        if (!contextMod) {
+            contextMod = _currentMod ? _currentMod : _rootMod;
+        }
+        if (auto it = contextMod->Traits.find(path); it != contextMod->Traits.end()) {
+            return &it->second;
+        }
+        std::unordered_map<std::string, Trait *> &cache = _traitPaths[contextMod];
+        if (auto it = cache.find(path); it != cache.end()) {
+            return it->second;
+        }
+        Trait *t = resolveTraitPath(path, contextMod);
+        if (t) {
+            cache.emplace(path, t);
+        }
+        return t;
+    }
+
+    void
+    SemanticAnalyzer::invalidatePathCache() {
+        if (!_structPaths.empty()) {
+            _structPaths.clear();
+        }
+        if (!_traitPaths.empty()) {
+            _traitPaths.clear();
+        }
+    }
 
+    Struct *
+    SemanticAnalyzer::resolveStructPath(const std::string &path, Module *contextMod) {
         auto parts = splitPath(path);
         if (parts.empty()) {
             return nullptr;
@@ -2012,18 +2736,7 @@ namespace marble {
     }
     
     Trait *
-    SemanticAnalyzer::findTraitByPath(const std::string &path, Module *contextMod) {
-        if (path.empty()) {
-            return nullptr;
-        }
-        if (!contextMod) {
-            contextMod = _currentMod ? _currentMod : _rootMod;
-        }
-
-        if (auto it = contextMod->Traits.find(path); it != contextMod->Traits.end()) {
-            return &it->second;
-        }
-
+    SemanticAnalyzer::resolveTraitPath(const std::string &path, Module *contextMod) {
         auto parts = splitPath(path);
         if (parts.empty()) {
             return nullptr;
@@ -2087,6 +2800,7 @@ namespace marble {
         Module *mod = new Module(name, fullPath, access);
         mod->AST = ast;
         mod->Parent = base;
+        mod->FromInterface = base->FromInterface;
         for (auto stmt : ast) {
             if (auto mds = llvm::dyn_cast<ModuleDeclStmt>(stmt)) {
                 mod->SubModules[mds->GetName()] = createModule(mod, mds->GetName(), mod->GetFullPath(), mds->GetAccess(), mds->GetBody());
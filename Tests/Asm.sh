@@ -0,0 +1,34 @@
+#!/bin/sh
+# Builds Asm.mr with `-emit=asm` and `-emit=asm-annotated`: both must define `main`, the annotated one must show the
+# source lines before their instructions and the summary of every function.
+# Usage: Tests/Asm.sh <marblec>, run from the directory with `Libs/`.
+MARBLEC=$1
+DIR=$(dirname "$0")
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+status=0
+"$MARBLEC" "$DIR/Asm.mr" -emit=asm -o "$TMP/Asm.s" || exit 1
+if ! grep -q '^main:' "$TMP/Asm.s"; then
+    echo "Asm: -emit=asm does not define main"
+    status=1
+fi
+
+"$MARBLEC" "$DIR/Asm.mr" -emit=asm-annotated -o "$TMP/Asm.annotated.s" || exit 1
+for line in 'Asm.mr:3:  return x * x;' \
+            'Asm.mr:7:  echo Square(7);' \
+            '#   instrs    latency      rthru  function'; do
+    if ! grep -qF "$line" "$TMP/Asm.annotated.s"; then
+        echo "Asm: -emit=asm-annotated has no line \`$line\`"
+        status=1
+    fi
+done
+for fun in Square main; do
+    if ! grep -q "^# $fun: [0-9]* instructions" "$TMP/Asm.annotated.s"; then
+        echo "Asm: -emit=asm-annotated has no summary of $fun"
+        status=1
+    fi
+done
+[ $status -eq 0 ] || cat "$TMP/Asm.annotated.s"
+exit $status
@@ -0,0 +1,21 @@
+#!/bin/sh
+# Compiles a test which must be rejected: every line with a `// error: <message>` comment must get exactly that error,
+# and no other line may get one.
+# Usage: Tests/Diagnostics.sh <marblec> <test.mr>, run from the directory with `Libs/`.
+MARBLEC=$1
+TEST=$2
+NAME=$(basename "$TEST" .mr)
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+"$MARBLEC" "$TEST" -emit=llvm -o "$TMP/$NAME.ll" > /dev/null 2> "$TMP/stderr"
+
+# `<line>: <message>` of the expected and of the reported errors
+grep -n '// error: ' "$TEST" | sed 's|^\([0-9]*\):.*// error: \(.*\)$|\1: \2|' | sort > "$TMP/expected"
+sed -n 's|^.*:\([0-9]*\):[0-9]*: error: \(.*\)$|\1: \2|p' "$TMP/stderr" | sort > "$TMP/reported"
+if ! diff "$TMP/expected" "$TMP/reported" > "$TMP/errors.diff"; then
+    echo "$NAME: the errors differ (< expected, > reported):"
+    cat "$TMP/errors.diff"
+    exit 1
+fi
@@ -0,0 +1,37 @@
+#!/bin/sh
+# Compiles a test program to LLVM IR with the given flags and checks the functions its comments name: after
+# `// ir: <function> has <text>` the definition of the function must contain the text, after `// ir: <function> lacks <text>`
+# it must not. `module` instead of a function checks the whole module.
+# Usage: Tests/IR.sh <marblec> <test.mr> [flags...], run from the directory with `Libs/`.
+MARBLEC=$1
+TEST=$2
+shift 2
+NAME=$(basename "$TEST" .mr)
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+"$MARBLEC" "$TEST" -emit=llvm -o "$TMP/$NAME.ll" "$@" || exit 1
+
+status=0
+grep '^// ir: ' "$TEST" | sed 's|^// ir: ||' > "$TMP/checks"
+while read -r fun check text; do
+    if [ "$fun" = module ]; then
+        cp "$TMP/$NAME.ll" "$TMP/fun.ll"
+    else
+        sed -n "/^define .* @$fun(/,/^}/p" "$TMP/$NAME.ll" > "$TMP/fun.ll"
+    fi
+    if [ ! -s "$TMP/fun.ll" ]; then
+        echo "$NAME $*: no definition of $fun"
+        status=1
+    elif [ "$check" = has ] && ! grep -qF -- "$text" "$TMP/fun.ll"; then
+        echo "$NAME $*: $fun has no \`$text\`:"
+        cat "$TMP/fun.ll"
+        status=1
+    elif [ "$check" = lacks ] && grep -qF -- "$text" "$TMP/fun.ll"; then
+        echo "$NAME $*: $fun has \`$text\`:"
+        cat "$TMP/fun.ll"
+        status=1
+    fi
+done < "$TMP/checks"
+exit $status
@@ -0,0 +1,29 @@
+#!/bin/sh
+# Runs an example with `--interp` and as a native executable, both must print the same to stdout and exit with the same
+# code.
+# Usage: Tests/Interp-Native.sh <marblec> <example.mr>, run from the directory with `Libs/`.
+MARBLEC=$1
+EXAMPLE=$2
+NAME=$(basename "$EXAMPLE" .mr)
+
+command -v clang > /dev/null || { echo "clang is not found, the test is skipped"; exit 77; }
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+"$MARBLEC" "$EXAMPLE" --interp > "$TMP/interp.out"
+interpStatus=$?
+"$MARBLEC" "$EXAMPLE" && mv "$NAME" "$TMP/$NAME" || exit 1     # executables are written to the current directory
+"$TMP/$NAME" > "$TMP/native.out"
+nativeStatus=$?
+
+status=0
+if ! diff "$TMP/interp.out" "$TMP/native.out" > "$TMP/out.diff"; then
+    echo "$NAME: the output differs (< --interp, > native):"
+    cat "$TMP/out.diff"
+    status=1
+fi
+if [ $interpStatus -ne $nativeStatus ]; then
+    echo "$NAME: exit code $interpStatus with --interp, but $nativeStatus natively"
+    status=1
+fi
+exit $status
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Builds Lazy-Sema.mr, which imports a module with a function that does not type check but is never referenced: its
+# body must not be analyzed, so the program compiles, unless `-fcheck-all` asks to analyze every body. The library is
+# copied next to the program as `Lib.mr`, the name of its module.
+# Usage: Tests/Lazy-Sema.sh <marblec>
+MARBLEC=$1
+DIR=$(cd "$(dirname "$0")" && pwd)
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+cp "$DIR/Lazy-Sema.mr" "$TMP/Lazy-Sema.mr"
+cp "$DIR/Lazy-Sema-Lib.mr" "$TMP/Lib.mr"
+cd "$TMP" || exit 1
+
+status=0
+if ! "$MARBLEC" Lazy-Sema.mr -emit=llvm -o Lazy-Sema.ll 2> errors.txt; then
+    echo "Lazy-Sema: the body of the unreferenced Unused is analyzed:"
+    cat errors.txt
+    status=1
+fi
+if "$MARBLEC" Lazy-Sema.mr -fcheck-all -emit=llvm -o Lazy-Sema.ll 2> errors.txt || ! grep -qF 'Lib.mr:11:' errors.txt; then
+    echo "Lazy-Sema: -fcheck-all does not report the error in Unused:"
+    cat errors.txt
+    status=1
+fi
+exit $status
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Runs Loop-Stack.mr at -O0 and -O2 under a 256 KiB stack limit: its loops declare locals in 10M iterations, so the
+# program crashes if they grow the stack.
+# Usage: Tests/Loop-Stack.sh <marblec>, run from the directory with `Libs/`.
+MARBLEC=$1
+DIR=$(dirname "$0")
+EXPECTED="25000005000000
+5666629"
+
+command -v clang > /dev/null || { echo "clang is not found, the test is skipped"; exit 77; }
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+status=0
+for opt in -O0 -O2; do
+    "$MARBLEC" "$DIR/Loop-Stack.mr" $opt && mv Loop-Stack "$TMP/Loop-Stack" || exit 1    # executables are written to the current directory
+    if ! out=$(ulimit -s 256 && "$TMP/Loop-Stack"); then
+        echo "Loop-Stack $opt: crashed under a 256 KiB stack"
+        status=1
+    elif [ "$out" != "$EXPECTED" ]; then
+        echo "Loop-Stack $opt: unexpected output:"
+        echo "$out"
+        status=1
+    fi
+done
+exit $status
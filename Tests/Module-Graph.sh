@@ -0,0 +1,28 @@
+#!/bin/sh
+# Prints the module graph of Module-Graph.mr with `-print-module-graph`: every file is loaded once, also when it is
+# imported with different paths, and is printed after the modules it imports. The imported modules are copied next to
+# the program as `A.mr` and `B.mr`, the names of their modules.
+# Usage: Tests/Module-Graph.sh <marblec>, run from the directory with `Libs/`.
+MARBLEC=$1
+DIR=$(cd "$(dirname "$0")" && pwd)
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+cp "$DIR/Module-Graph.mr" "$TMP/Module-Graph.mr"
+cp "$DIR/Module-Graph-A.mr" "$TMP/A.mr"
+cp "$DIR/Module-Graph-B.mr" "$TMP/B.mr"
+cp -r Libs "$TMP/Libs"
+cd "$TMP" || exit 1
+
+"$MARBLEC" Module-Graph.mr -print-module-graph -fno-precompiled-libs -emit=llvm -o Module-Graph.ll > graph.out || exit 1
+cat > expected.out << 'END'
+; Libs/Std/Math/mod.mr
+; ./B.mr
+; A.mr imports ./B.mr, Libs/Std/Math/mod.mr
+; Module-Graph.mr imports Libs/Std/Math/mod.mr, A.mr, ./B.mr
+END
+if ! diff expected.out graph.out > graph.diff; then
+    echo "Module-Graph: the module graph differs (< expected, > printed):"
+    cat graph.diff
+    exit 1
+fi
@@ -0,0 +1,44 @@
+#!/bin/sh
+# Builds a program which imports `Std.Math`. The library must be loaded from the interface stored with its precompiled
+# bitcode, and the program must print the same as with the library compiled from its source. An edited source makes the
+# bitcode stale, then the source is parsed again.
+# Usage: Tests/Precompiled-Lib.sh <marblec> <test.mr>, run from the directory with the precompiled `Libs/`.
+MARBLEC=$1
+TEST=$2
+NAME=$(basename "$TEST" .mr)
+
+command -v clang > /dev/null || { echo "clang is not found, the test is skipped"; exit 77; }
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+cp -r Libs "$TMP/Libs"
+cd "$TMP" || exit 1
+
+status=0
+"$MARBLEC" "$TEST" -print-module-graph > graph.out || exit 1
+if ! grep -q '^; Libs/Std/Math/mod.mr (interface)' graph.out; then
+    echo "Std.Math is not loaded from its interface:"
+    cat graph.out
+    status=1
+fi
+./"$NAME" > precompiled.out
+"$MARBLEC" "$TEST" -fno-precompiled-libs || exit 1
+./"$NAME" > source.out
+if ! diff precompiled.out source.out > out.diff; then
+    echo "the output differs (< precompiled, > from source):"
+    cat out.diff
+    status=1
+fi
+
+echo '// edited' >> Libs/Std/Math/mod.mr
+"$MARBLEC" "$TEST" -print-module-graph > graph.out || exit 1
+if grep -q '(interface)' graph.out; then
+    echo "the edited Std.Math is still loaded from its interface"
+    status=1
+fi
+./"$NAME" > edited.out
+if ! diff source.out edited.out > out.diff; then
+    echo "the output differs after editing Std.Math (< from source, > edited):"
+    cat out.diff
+    status=1
+fi
+exit $status
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Builds Pure-Profile.mr with `-finstrument=functions` at -O0 and -O2 and checks the call counts of the profile: the
+# optimizer must not merge the calls of a `@pure` function, which writes the counters of the profiler.
+# Usage: Tests/Pure-Profile.sh <marblec>, run from the directory with `Libs/`.
+MARBLEC=$1
+DIR=$(dirname "$0")
+
+command -v clang > /dev/null || { echo "clang is not found, the test is skipped"; exit 77; }
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+status=0
+for opt in -O0 -O2; do
+    "$MARBLEC" "$DIR/Pure-Profile.mr" $opt -finstrument=functions && mv Pure-Profile "$TMP/Pure-Profile" || exit 1     # executables are written to the current directory
+    if ! out=$(MARBLE_PROFILE="$TMP/profile.json" "$TMP/Pure-Profile" 2> /dev/null) || [ "$out" != "665667000" ]; then
+        echo "Pure-Profile $opt: unexpected output: $out"
+        status=1
+        continue
+    fi
+    for calls in '"name": "main", "calls": 1,' '"name": "Square", "calls": 2000,'; do
+        if ! grep -q "$calls" "$TMP/profile.json"; then
+            echo "Pure-Profile $opt: the profile has no $calls"
+            cat "$TMP/profile.json"
+            status=1
+        fi
+    done
+done
+exit $status
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Builds Remarks.mr at -O2 with `-Rpass=inline` and with `-fsave-optimization-record`: the remark that `Add` is inlined
+# into `main` must point at the call, on stderr and in the YAML record.
+# Usage: Tests/Remarks.sh <marblec>, run from the directory with `Libs/`.
+MARBLEC=$1
+DIR=$(dirname "$0")
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+status=0
+"$MARBLEC" "$DIR/Remarks.mr" -O2 -Rpass=inline -emit=llvm -o "$TMP/Remarks.ll" 2> "$TMP/remarks.txt" || exit 1
+if ! grep -qF "Remarks.mr:9:9: remark: 'Add' inlined into 'main'" "$TMP/remarks.txt"; then
+    echo "Remarks: no remark for the inlining of Add:"
+    cat "$TMP/remarks.txt"
+    status=1
+fi
+
+"$MARBLEC" "$DIR/Remarks.mr" -O2 -fsave-optimization-record -foptimization-record-file="$TMP/Remarks.opt.yaml" -emit=llvm \
+           -o "$TMP/Remarks.ll" || exit 1
+if ! grep -A3 -- '--- !Passed' "$TMP/Remarks.opt.yaml" | grep -qF '{ File: Remarks.mr, Line: 9, Column: 9 }'; then
+    echo "Remarks: the record has no passed remark at the call of Add:"
+    cat "$TMP/Remarks.opt.yaml"
+    status=1
+fi
+exit $status
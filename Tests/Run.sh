@@ -0,0 +1,32 @@
+#!/bin/sh
+# Builds a test program with the given flags and runs it: it must print what the `/* output:` comment at its end lists
+# and exit with the code of its `// exit: <code>` comment, 0 without one.
+# Usage: Tests/Run.sh <marblec> <test.mr> [flags...], run from the directory with `Libs/`.
+MARBLEC=$1
+TEST=$2
+shift 2
+NAME=$(basename "$TEST" .mr)
+
+command -v clang > /dev/null || { echo "clang is not found, the test is skipped"; exit 77; }
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+sed -n '/^\/\* output:/,/^\*\//p' "$TEST" | sed '1d;$d' | sed 's/^ \*//; s/^ //' > "$TMP/expected.out"
+EXPECTED_STATUS=$(sed -n 's|^// exit: \([0-9]*\)$|\1|p' "$TEST")
+
+"$MARBLEC" "$TEST" "$@" && mv "$NAME" "$TMP/$NAME" || exit 1     # executables are written to the current directory
+"$TMP/$NAME" > "$TMP/run.out"
+status=$?
+sed "s|$(dirname "$TEST")/||g" "$TMP/run.out" > "$TMP/actual.out"   # messages name the source relative to the test
+
+result=0
+if ! diff "$TMP/expected.out" "$TMP/actual.out" > "$TMP/out.diff"; then
+    echo "$NAME $*: the output differs (< expected, > actual):"
+    cat "$TMP/out.diff"
+    result=1
+fi
+if [ "$status" -ne "${EXPECTED_STATUS:-0}" ]; then
+    echo "$NAME $*: exit code $status, expected ${EXPECTED_STATUS:-0}"
+    result=1
+fi
+exit $result
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Builds Track-Allocs.mr with `-ftrack-allocs -freport-leaks` and checks the report written at exit: the counts of its
+# `new` sites, the arena and the leaked object.
+# Usage: Tests/Track-Allocs.sh <marblec>, run from the directory with `Libs/`.
+MARBLEC=$1
+DIR=$(dirname "$0")
+
+command -v clang > /dev/null || { echo "clang is not found, the test is skipped"; exit 77; }
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+"$MARBLEC" "$DIR/Track-Allocs.mr" -ftrack-allocs -freport-leaks && mv Track-Allocs "$TMP/Track-Allocs" || exit 1     # executables are written to the current directory
+"$TMP/Track-Allocs" 2>&1 | tr -s ' ' | sed 's/^ //' > "$TMP/report.txt"
+
+status=0
+for line in '10 10 160 0 16 Node at Track-Allocs.mr:9:24' \
+            '5 0 80 0 0 Node at Track-Allocs.mr:15:28' \
+            '10 160 Track-Allocs.mr:10:9' \
+            '5 80 Track-Allocs.mr:13:5' \
+            'Leaks: 1 objects, 16 bytes were not deleted' \
+            '1 16 Node at Track-Allocs.mr:12:25'; do
+    if ! grep -qxF "$line" "$TMP/report.txt"; then
+        echo "Track-Allocs: the report has no line \`$line\`"
+        status=1
+    fi
+done
+[ $status -eq 0 ] || cat "$TMP/report.txt"
+exit $status
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Builds Units.mr, whose modules are generated into units of their own, with every way `-flto` combines the units
+# that works without lld, and runs it: it must print what the `/* output:` comment at its end lists. The imported
+# module is copied next to the program as `Lib.mr`, the name of its module.
+# Usage: Tests/Units.sh <marblec>, run from the directory with `Libs/`.
+MARBLEC=$1
+DIR=$(cd "$(dirname "$0")" && pwd)
+
+command -v clang > /dev/null || { echo "clang is not found, the test is skipped"; exit 77; }
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+cp "$DIR/Units.mr" "$TMP/Units.mr"
+cp "$DIR/Units-Lib.mr" "$TMP/Lib.mr"
+cp -r Libs "$TMP/Libs"
+cd "$TMP" || exit 1
+sed -n '/^\/\* output:/,/^\*\//p' Units.mr | sed '1d;$d' | sed 's/^ \*//; s/^ //' > expected.out
+
+status=0
+for flags in "-flto=none" "-flto=full" "-O2 -flto=none" "-O2 -flto=full"; do
+    "$MARBLEC" Units.mr $flags -fno-precompiled-libs || { status=1; continue; }
+    ./Units > run.out
+    if ! diff expected.out run.out > out.diff; then
+        echo "Units $flags: the output differs (< expected, > actual):"
+        cat out.diff
+        status=1
+    fi
+done
+exit $status
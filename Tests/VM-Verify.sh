@@ -0,0 +1,48 @@
+#!/bin/sh
+# Saves an example as a `.mrbc` file and damages copies of it. The VM must reject every damaged file when it loads it,
+# before it runs any of its code.
+# Usage: Tests/VM-Verify.sh <marblec> <example.mr>, run from the directory with `Libs/`.
+MARBLEC=$1
+EXAMPLE=$2
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+"$MARBLEC" "$EXAMPLE" -emit=bc -o "$TMP/good.mrbc" || exit 1
+if ! "$MARBLEC" "$TMP/good.mrbc" > /dev/null; then
+    echo "the undamaged file is rejected"
+    exit 1
+fi
+
+# damage <name> <offset> <octal byte>: a copy of the file with the byte at the offset replaced
+damage() {
+    cp "$TMP/good.mrbc" "$TMP/$1.mrbc"
+    printf "\\$3" | dd of="$TMP/$1.mrbc" bs=1 seek="$2" conv=notrunc 2> /dev/null
+}
+
+status=0
+# expect <name> <error>: loading the file must fail with the error and print nothing to stdout
+expect() {
+    "$MARBLEC" "$TMP/$1.mrbc" > "$TMP/$1.out" 2> "$TMP/$1.err"
+    code=$?
+    if [ $code -ne 1 ] || [ -s "$TMP/$1.out" ] || ! grep -qF "$2" "$TMP/$1.err"; then
+        echo "$1: expected to be rejected with \`$2\`, got exit code $code:"
+        cat "$TMP/$1.out" "$TMP/$1.err"
+        status=1
+    fi
+}
+
+CODE_OFFSET=$(od -An -tu8 -j64 -N8 "$TMP/good.mrbc" | tr -d ' ')     # `CodeOffset` of the header
+SIZE=$(wc -c < "$TMP/good.mrbc")
+
+damage magic 0 130
+expect magic "not a bytecode file"
+damage version 4 377
+expect version "unsupported bytecode version"
+head -c $((SIZE - 4)) "$TMP/good.mrbc" > "$TMP/truncated.mrbc"
+expect truncated "truncated bytecode file"
+damage opcode "$CODE_OFFSET" 377
+expect opcode "invalid instruction"
+damage register $((CODE_OFFSET + 1)) 377
+expect register "invalid instruction"
+exit $status
@@ -0,0 +1,43 @@
+#!/bin/sh
+# Runs an example with `--vm`, and saves it with `-emit=bc` and runs the `.mrbc` file. Both must print the same to stdout
+# and exit with the same code as with `--interp`, and as the native executable when `clang` is found.
+# Usage: Tests/VM.sh <marblec> <example.mr>, run from the directory with `Libs/`.
+MARBLEC=$1
+EXAMPLE=$2
+NAME=$(basename "$EXAMPLE" .mr)
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# run <kind> <command...>: the output goes to <kind>.out and the exit code to <kind>.status
+run() {
+    kind=$1
+    shift
+    "$@" > "$TMP/$kind.out"
+    echo $? > "$TMP/$kind.status"
+}
+
+run interp "$MARBLEC" "$EXAMPLE" --interp
+run vm "$MARBLEC" "$EXAMPLE" --vm
+"$MARBLEC" "$EXAMPLE" -emit=bc -o "$TMP/$NAME.mrbc" || exit 1
+run mrbc "$MARBLEC" "$TMP/$NAME.mrbc"
+kinds="vm mrbc"
+if command -v clang > /dev/null; then
+    "$MARBLEC" "$EXAMPLE" && mv "$NAME" "$TMP/$NAME" || exit 1     # executables are written to the current directory
+    run native "$TMP/$NAME"
+    kinds="$kinds native"
+fi
+
+status=0
+for kind in $kinds; do
+    if ! diff "$TMP/interp.out" "$TMP/$kind.out" > "$TMP/out.diff"; then
+        echo "$NAME: the output differs (< --interp, > $kind):"
+        cat "$TMP/out.diff"
+        status=1
+    fi
+    if ! cmp -s "$TMP/interp.status" "$TMP/$kind.status"; then
+        echo "$NAME: exit code $(cat "$TMP/interp.status") with --interp, but $(cat "$TMP/$kind.status") with $kind"
+        status=1
+    fi
+done
+exit $status